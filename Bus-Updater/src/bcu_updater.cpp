@@ -6,6 +6,7 @@
  */
 
 #include "bcu_updater.h"
+#include "update.h"
 
 #ifdef DUMP_TELEGRAMS
 #define d(x) {serial.println(x);}
@@ -35,6 +36,12 @@ void BcuUpdate::processTelegram()
             }
         }
     }
+    else if (destAddr && (apci & APCI_GROUP_MASK) == APCI_GROUP_VALUE_WRITE_PDU
+            && (bus.telegram[5] & 0x0f) > 1)
+    {
+        d("processMulticastTelegram\n");
+        handleMulticastTelegram(destAddr, &bus.telegram[8], (bus.telegram[5] & 0x0f) - 1);
+    }
     // At the end: discard the received telegram
     bus.discardReceivedTelegram();
 }
@@ -8,13 +8,21 @@
 #include "boot_descriptor_block.h"
 #include "crc.h"
 
+// The same as in sblib/platform.h, which cannot be included from C
+#ifdef IAP_EMULATION
+extern unsigned char FLASH[];
+#   define FLASH_BASE_ADDRESS FLASH
+#else
+#   define FLASH_BASE_ADDRESS ((unsigned char *) 0)
+#endif
+
 #if 1
 unsigned int checkVectorTable(unsigned int start)
 {
     unsigned int i;
     unsigned int * address;
     unsigned int cs = 0;
-    address = (unsigned int *) start;
+    address = (unsigned int *) (FLASH_BASE_ADDRESS + start);
     for (i = 0; i < 8; i++, address++)
         cs += *address;
     return cs == 0;
@@ -32,7 +40,10 @@ unsigned int checkApplication(AppDescriptionBlock * block)
     if (block->startAddress == block->endAddress)
         return 0;
 
-    unsigned int crc = crc32(0xFFFFFFFF, (unsigned char *) block->startAddress,
+    if (VERIFIED_MARKER(block) == (block->crc ^ VERIFIED_MAGIC))
+        return checkVectorTable(block->startAddress);
+
+    unsigned int crc = crc32(0xFFFFFFFF, FLASH_BASE_ADDRESS + block->startAddress,
             block->endAddress - block->startAddress);
     if (crc == block->crc)
     {
@@ -43,6 +54,6 @@ unsigned int checkApplication(AppDescriptionBlock * block)
 
 inline unsigned char * getAppVersion(AppDescriptionBlock * block)
 {
-    return (unsigned char *) (block->appVersionAddress);
+    return FLASH_BASE_ADDRESS + block->appVersionAddress;
 }
 
@@ -18,6 +18,27 @@ extern "C"
 #define BOOT_BLOCK_SIZE  0x100
 #define BOOT_BLOCK_PAGE ((FIRST_SECTOR / BOOT_BLOCK_SIZE) - 1)
 
+/*
+ * All addresses in the descriptors and the updater protocol are flash addresses
+ * of the device, they are accessed with FLASH_BASE_ADDRESS + address.
+ *
+ * The last word of a boot descriptor page is the verified marker. It is set to
+ * (crc ^ VERIFIED_MAGIC) after the CRC of the application was checked, so the
+ * following boots do not need to calculate the CRC again. It is set to 0 before
+ * the application area is modified. The marker is programmed without erasing
+ * the page.
+ */
+#define VERIFIED_MAGIC   0x5AFEB007
+
+/*
+ * The page below the boot descriptor blocks holds the progress of a resumable
+ * stream transfer. The flash region of the bootloader (MFlash64 in .cproject)
+ * ends at this page, so the linker fails if the code grows into it.
+ */
+#define PROGRESS_ADDRESS (FIRST_SECTOR - 3 * BOOT_BLOCK_SIZE)
+#define VERIFIED_MARKER(block) \
+    (*(unsigned int *) ((unsigned char *) (block) + BOOT_BLOCK_SIZE - 4))
+
 typedef struct
 {
     unsigned int startAddress;
@@ -30,6 +51,15 @@ unsigned int checkApplication(AppDescriptionBlock * block);
 
 unsigned char * getAppVersion(AppDescriptionBlock * block);
 
+/*
+ * Program the verified marker of a boot descriptor block.
+ *
+ * @param block - the boot descriptor block in the flash
+ * @param value - the value of the marker, only bits that are 1 in the flash can be cleared
+ * @return the IAP status
+ */
+unsigned int programVerifiedMarker(AppDescriptionBlock * block, unsigned int value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,8 @@
 #include <sblib/internal/variables.h>
 #include <sblib/io_pin_names.h>
 #include "bcu_updater.h"
+#include "update.h"
+#include "serial_update.h"
 
 static BcuUpdate _bcu = BcuUpdate();
 BcuBase& bcu = _bcu;
@@ -52,6 +54,10 @@ void setup()
 
 void loop()
 {
+    updaterLoop();
+#ifdef SERIAL_UPDATE
+    serialUpdateLoop();
+#endif
     if (blinky.expired())
     {
         if (bcu.directConnection())
@@ -92,6 +98,9 @@ void run_updater()
 #ifdef DUMP_TELEGRAMS
     serial.setRxPin(PIO3_1);
     serial.setTxPin(PIO3_0);
+#endif
+#ifdef SERIAL_UPDATE
+    serialUpdateBegin();
 #endif
     setup();
 
@@ -116,12 +125,17 @@ int main(void)
     {
         run_updater();
     }
-    AppDescriptionBlock * block = (AppDescriptionBlock *) FIRST_SECTOR;
+    AppDescriptionBlock * block = (AppDescriptionBlock *) (FLASH_BASE_ADDRESS + FIRST_SECTOR);
     block--;
     for (int i = 0; i < 2; i++, block--)
     {
         if (checkApplication(block))
+        {
+            // Skip the CRC check of the application on the next boot
+            if (VERIFIED_MARKER(block) == 0xFFFFFFFF)
+                programVerifiedMarker(block, block->crc ^ VERIFIED_MAGIC);
             jumpToApplication(block->startAddress);
+        }
     }
     run_updater();
     return 0;
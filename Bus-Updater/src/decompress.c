@@ -0,0 +1,69 @@
+/*
+ *  decompress.c - Decoder for compressed firmware data.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#include "decompress.h"
+
+void decompressInit(DecompressState * state, unsigned char * out, unsigned int size)
+{
+    state->out = out;
+    state->size = size;
+    state->pos = 0;
+    state->flags = 0;
+    state->flagCount = 0;
+    state->matchPending = 0;
+}
+
+unsigned int decompress(DecompressState * state, const unsigned char * data, unsigned int count)
+{
+    unsigned int distance, length;
+    unsigned char * src;
+    unsigned char * dst;
+
+    while (count--)
+    {
+        if (state->matchPending)
+        {   // second byte of a back reference
+            distance = (((*data & 0xf0) << 4) | state->matchLow) + 1;
+            length = (*data++ & 0x0f) + DECOMPRESS_MIN_MATCH;
+            state->matchPending = 0;
+
+            if (distance > state->pos)
+                return DECOMPRESS_INVALID_REF;
+            if (state->pos + length > state->size)
+                return DECOMPRESS_OVERFLOW;
+
+            // byte by byte, the source may overlap with the destination
+            dst = state->out + state->pos;
+            src = dst - distance;
+            state->pos += length;
+            while (length--)
+                *dst++ = *src++;
+        }
+        else if (!state->flagCount)
+        {
+            state->flags = *data++;
+            state->flagCount = 8;
+        }
+        else
+        {
+            state->flagCount--;
+            if (state->flags & 1)
+            {   // literal byte
+                if (state->pos >= state->size)
+                    return DECOMPRESS_OVERFLOW;
+                state->out[state->pos++] = *data++;
+            }
+            else
+            {   // first byte of a back reference
+                state->matchLow = *data++;
+                state->matchPending = 1;
+            }
+            state->flags >>= 1;
+        }
+    }
+    return DECOMPRESS_OK;
+}
@@ -0,0 +1,81 @@
+/*
+ *  decompress.h - Decoder for compressed firmware data.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef _DECOMPRESS_H_
+#define _DECOMPRESS_H_ 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The data is compressed with a LZSS variant that uses the output buffer as
+ * the dictionary, so no additional RAM is required:
+ *
+ *   A flag byte is followed by 8 items. Bit 0 of the flag byte describes the
+ *   first item, bit 7 the last one. The last flag byte of a block may be
+ *   followed by less than 8 items.
+ *     flag bit = 1  a literal byte
+ *     flag bit = 0  a back reference of 2 bytes:
+ *                     byte 0  bits 0-7 of (distance - 1)
+ *                     byte 1  bits 4-7: bits 8-11 of (distance - 1)
+ *                             bits 0-3: length - DECOMPRESS_MIN_MATCH
+ *
+ *   The distance is counted backwards from the current output position,
+ *   a back reference must not point before the start of the output buffer.
+ *   Every block that is programmed with one UPD_PROGRAM command has to be
+ *   compressed on its own.
+ *
+ * The decoder keeps its state between calls, so the compressed data can be
+ * split into telegrams at any byte.
+ */
+
+#define DECOMPRESS_MIN_MATCH 3
+
+enum
+{
+    DECOMPRESS_OK = 0,          //!< The data was decoded
+    DECOMPRESS_OVERFLOW = 1,    //!< The output buffer is too small
+    DECOMPRESS_INVALID_REF = 2  //!< A back reference points before the output buffer
+};
+
+typedef struct
+{
+    unsigned char * out;        //!< The output buffer
+    unsigned int size;          //!< The size of the output buffer
+    unsigned int pos;           //!< The current position in the output buffer
+    unsigned char flags;        //!< The remaining bits of the current flag byte
+    unsigned char flagCount;    //!< The number of remaining bits in flags
+    unsigned char matchLow;     //!< The first byte of a split back reference
+    unsigned char matchPending; //!< 1 if matchLow is valid
+} DecompressState;
+
+/*
+ * Initialize the decoder.
+ *
+ * @param state - the decoder state
+ * @param out - the output buffer
+ * @param size - the size of the output buffer
+ */
+void decompressInit(DecompressState * state, unsigned char * out, unsigned int size);
+
+/*
+ * Decode a chunk of compressed data.
+ *
+ * @param state - the decoder state
+ * @param data - the compressed data
+ * @param count - the number of bytes in data
+ * @return DECOMPRESS_OK on success, else the error code
+ */
+unsigned int decompress(DecompressState * state, const unsigned char * data, unsigned int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
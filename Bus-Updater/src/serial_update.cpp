@@ -0,0 +1,166 @@
+/*
+ *  serial_update.cpp - The serial transport of the updater protocol.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "serial_update.h"
+
+#ifdef SERIAL_UPDATE
+
+#include <sblib/serial.h>
+#include <sblib/timer.h>
+#include <sblib/ioports.h>
+#include <crc.h>
+#include "update.h"
+
+#include <string.h>
+
+#define FRAME_START 0xA5
+#define HEADER_SIZE 3   // sequence number and length
+#define CRC_SIZE    4
+
+enum
+{
+    RX_WAIT_START,      //!< waiting for the start byte
+    RX_FRAME            //!< receiving the frame
+};
+
+// The received frame, starting with the sequence number
+static unsigned char rxFrame[HEADER_SIZE + SERIAL_UPDATE_MAX_PAYLOAD + CRC_SIZE];
+static unsigned int rxCount;
+static unsigned char rxState;
+static unsigned int rxTime;
+
+// The last reply, starting with the sequence number
+static unsigned char txFrame[HEADER_SIZE + 1 + 12 + CRC_SIZE];
+static unsigned int txLength;
+
+static unsigned char expectedSeq;
+
+/*
+ * Append the CRC to a frame and send it.
+ */
+static void sendFrame(unsigned char * frame, unsigned int length)
+{
+    unsigned int crc = crc32(0xFFFFFFFF, frame, HEADER_SIZE + length);
+
+    frame[HEADER_SIZE + length] = crc;
+    frame[HEADER_SIZE + length + 1] = crc >> 8;
+    frame[HEADER_SIZE + length + 2] = crc >> 16;
+    frame[HEADER_SIZE + length + 3] = crc >> 24;
+
+    serial.write(FRAME_START);
+    for (unsigned int i = 0; i < HEADER_SIZE + length + CRC_SIZE; i++)
+        serial.write(frame[i]);
+}
+
+/*
+ * Send an empty frame that acknowledges the last processed frame.
+ */
+static void sendAck()
+{
+    unsigned char frame[HEADER_SIZE + CRC_SIZE];
+
+    frame[0] = expectedSeq - 1;
+    frame[1] = 0;
+    frame[2] = 0;
+    sendFrame(frame, 0);
+}
+
+/*
+ * Process a received frame.
+ */
+static void processFrame()
+{
+    unsigned int length = rxFrame[1] | (rxFrame[2] << 8);
+    unsigned char * payload = rxFrame + HEADER_SIZE;
+    unsigned char * crc = payload + length;
+    unsigned char seq = rxFrame[0];
+
+    if (crc32(0xFFFFFFFF, rxFrame, HEADER_SIZE + length)
+            != (unsigned int) (crc[0] | (crc[1] << 8) | (crc[2] << 16) | (crc[3] << 24))
+            || !length)
+    {
+        sendAck();
+    }
+    else if (seq == expectedSeq)
+    {
+        // The reply is built aside, the last reply is kept if the frame is not processed
+        unsigned char reply[sizeof(txFrame) - HEADER_SIZE - CRC_SIZE];
+        unsigned int replyLength = processUpdateRequest(payload[0], payload + 1,
+                length - 1, reply + 1, reply);
+
+        if (replyLength == 4 && reply[0] == UPD_SEND_LAST_ERROR
+                && (unsigned int) (reply[1] | (reply[2] << 8) | (reply[3] << 16) | (reply[4] << 24))
+                    == UPD_STREAM_BUSY)
+        {   // the page buffers are in use, the host sends this frame again
+            sendAck();
+            return;
+        }
+        if (replyLength)
+            replyLength++;
+
+        txFrame[0] = seq;
+        txFrame[1] = replyLength;
+        txFrame[2] = 0;
+        memcpy(txFrame + HEADER_SIZE, reply, replyLength);
+        txLength = replyLength;
+        sendFrame(txFrame, txLength);
+        expectedSeq++;
+    }
+    else if (seq == (unsigned char) (expectedSeq - 1) && txFrame[0] == seq)
+    {   // the host did not receive the last reply
+        sendFrame(txFrame, txLength);
+    }
+    else sendAck();
+}
+
+void serialUpdateBegin()
+{
+    serial.setRxPin(PIO3_1);
+    serial.setTxPin(PIO3_0);
+    serial.begin(SERIAL_UPDATE_BAUDRATE);
+    rxState = RX_WAIT_START;
+    expectedSeq = 0;
+    txFrame[0] = 0xff;
+}
+
+void serialUpdateLoop()
+{
+    int ch;
+
+    if (rxState != RX_WAIT_START && elapsed(rxTime) > SERIAL_UPDATE_FRAME_TIMEOUT)
+        rxState = RX_WAIT_START;
+
+    while ((ch = serial.read()) >= 0)
+    {
+        if (rxState == RX_WAIT_START)
+        {
+            if (ch == FRAME_START)
+            {
+                rxState = RX_FRAME;
+                rxCount = 0;
+                rxTime = millis();
+            }
+            continue;
+        }
+
+        rxFrame[rxCount++] = ch;
+        if (rxCount == HEADER_SIZE
+                && (unsigned int) (rxFrame[1] | (rxFrame[2] << 8)) > SERIAL_UPDATE_MAX_PAYLOAD)
+        {   // not a valid frame, wait for the next start byte
+            rxState = RX_WAIT_START;
+        }
+        else if (rxCount > HEADER_SIZE
+                && rxCount == HEADER_SIZE + (rxFrame[1] | (rxFrame[2] << 8)) + CRC_SIZE)
+        {
+            rxState = RX_WAIT_START;
+            processFrame();
+        }
+    }
+}
+
+#endif /* SERIAL_UPDATE */
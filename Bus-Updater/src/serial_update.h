@@ -0,0 +1,67 @@
+/*
+ *  serial_update.h - The serial transport of the updater protocol.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef SERIAL_UPDATE_H_
+#define SERIAL_UPDATE_H_
+
+#ifdef SERIAL_UPDATE
+
+#ifdef DUMP_TELEGRAMS
+#   error "SERIAL_UPDATE and DUMP_TELEGRAMS both use the serial port"
+#endif
+
+#ifndef SERIAL_UPDATE_BAUDRATE
+#   define SERIAL_UPDATE_BAUDRATE 115200
+#endif
+
+/**
+ * The maximum size of the payload of a frame: the command, 256 bytes of data
+ * and the arguments of the command.
+ */
+#define SERIAL_UPDATE_MAX_PAYLOAD (1 + 256 + 15)
+
+/**
+ * A frame that is not complete after this time in milliseconds is discarded.
+ */
+#define SERIAL_UPDATE_FRAME_TIMEOUT 50
+
+/**
+ * Serial transport of the updater protocol.
+ *
+ * The commands of update.cpp are sent in frames:
+ *   0     0xA5
+ *   1     sequence number
+ *   2-3   length of the payload, LSB first
+ *   4-    payload: the command followed by its data
+ *   last  CRC32 of bytes 1 to the end of the payload, LSB first
+ *
+ * A frame may carry more data than a telegram, e.g. UPD_SEND_DATA or
+ * UPD_STREAM_DATA with a whole page.
+ *
+ * The device answers every frame with a frame of the same format. Its sequence
+ * number acknowledges all frames up to this number, its payload is the reply of
+ * the command. The host may send several frames without waiting for the replies.
+ * A frame with a bad CRC or an unexpected sequence number is discarded and
+ * answered with an empty frame that acknowledges the last processed frame. The
+ * host then sends all frames after it again (go-back-N). A repeated frame of the
+ * last processed sequence number is answered with the last reply again. An empty
+ * frame is answered with the acknowledge of the last processed frame, the host
+ * uses it to synchronize the sequence numbers. UPD_STREAM_DATA is not processed
+ * while both page buffers are in use: the frame is answered like a discarded
+ * frame, and the host sends it again.
+ */
+void serialUpdateBegin();
+
+/**
+ * Receive and process the frames. Call from the main loop.
+ */
+void serialUpdateLoop();
+
+#endif /* SERIAL_UPDATE */
+
+#endif /* SERIAL_UPDATE_H_ */
@@ -16,7 +16,9 @@
 #include <sblib/io_pin_names.h>
 #include <sblib/serial.h>
 #include <bcu_updater.h>
+#include <update.h>
 #include <crc.h>
+#include <decompress.h>
 #include <boot_descriptor_block.h>
 
 /**
@@ -35,6 +37,11 @@
  *           If the RAM buffer is not yet full a T_ACK_PDU will be returned, otherwise a T_NACK_PDU
  *           The address of the RAM buffer will be automatically incremented.
  *           After a Program or Boot Desc Aupdate, the RAM buffer address will be reseted.
+ *    UPD_SEND_DATA_COMPRESSED
+ *      9-   compressed data (see decompress.h) which will be decompressed into the RAM buffer.
+ *           Returns UPD_RAM_BUFFER_OVERFLOW or UPD_INVALID_COMPRESSED_DATA on error.
+ *           The compressed data of one block can be split into telegrams at any byte.
+ *           UPD_PROGRAM and UPD_UPDATE_BOOT_DESC check the CRC of the decompressed data.
  *    UPD_PROGRAM
  *      9-12 How many bytes of the RMA Buffer should be programmed. Be aware that ths value nees to be one of the following
  *           256, 512, 1024, 4096 (required by the IAP of the LPC11xx devices)
@@ -46,10 +53,74 @@
  *      9-12 The CRC of the data downloaded via the UPD_SEND_DATA commands. If the CRC does not match the
  *           programming returns an error
  *        13 Which boot block should be used
+ *    UPD_STREAM_START
+ *      9-12 Flash address of the stream, must be the start of a sector
+ *     13-16 Length of the stream in bytes
+ *     17-20 optional: ID of the image, e.g. its CRC. If the ID is not 0 the progress of
+ *           the transfer is stored in the flash. If the progress of the same image is
+ *           found, the stream continues at the resume point (see UPD_REQUEST_RESUME).
+ *           Starts the streaming mode: the data is collected in two page buffers.
+ *           While one page is programmed the next one is received. The sectors are
+ *           erased ahead of the data. Programming and erasing is done by updaterLoop()
+ *           while the bus is idle.
+ *           The stream commands must not be mixed with the other data commands.
+ *    UPD_STREAM_DATA
+ *      9-   the data of the stream. Returns UPD_STREAM_BUSY if both page buffers are
+ *           in use, the host has to send the telegram again. If programming a page failed
+ *           the error of the page is returned and the stream is stopped.
+ *    UPD_STREAM_END
+ *      9-12 The CRC of the whole stream. Programs the remaining pages and returns
+ *           UDP_CRC_ERROR if the CRC of the programmed flash does not match.
+ *    UPD_REQUEST_STREAM_STATUS
+ *           Returns UPD_RESPONSE_STREAM_STATUS: the number of programmed pages (4 bytes),
+ *           the error of the stream (4 bytes) and the number of received bytes (4 bytes).
+ *    UPD_REQUEST_RESUME
+ *      9-12 ID of the image
+ *           Returns UPD_RESPONSE_RESUME: the flash address (4 bytes) and length (4 bytes)
+ *           of the interrupted stream, and the offset of the first page that was not
+ *           programmed (4 bytes). All values are 0 if no progress of the image is stored.
+ *           The host continues with UPD_STREAM_START and the data from this offset.
+ *    UPD_MULTICAST_JOIN
+ *      9-10 Group address of the multicast update, 0 to leave the update group
+ *           The device receives the multicast data sent to this group (see below).
+ *    UPD_MULTICAST_REPAIR
+ *      9-10 Index of a missing chunk of the current window
+ *     11-   The data of the chunk
+ *    UPD_MULTICAST_COMMIT
+ *      9-12 The CRC of the current window. Programs the window if it is complete and
+ *           the CRC matches.
+ *    UPD_REQUEST_MULTICAST_STATUS
+ *      9-10 Index of the first chunk of the bitmap
+ *           Returns UPD_RESPONSE_MULTICAST_STATUS: the number of missing chunks (2 bytes),
+ *           the error of the window (2 bytes), the index of the first chunk of the
+ *           bitmap (2 bytes) and the bitmap of 48 chunks (6 bytes, bit = 1: missing)
  *    UPD_REQ_DATA
  *      ???
  *    UPD_GET_LAST_ERROR
  *      Returns the reason why the last memory write PDU had a T_NACK_PDU
+ *    UPD_REQUEST_CRC
+ *      9-12 Flash address of the first block
+ *     13-16 Size of a block, e.g. 256 for a page or 4096 for a sector
+ *        17 Number of blocks (1-3)
+ *           Returns UPD_RESPONSE_CRC with the CRC of every block (4 bytes each), calculated
+ *           like the CRC of UPD_PROGRAM. The host only needs to send the blocks that differ.
+ *
+ *    Multicast update:
+ *      The data is sent with A_GroupValue_Write telegrams to the group address of
+ *      UPD_MULTICAST_JOIN. The data of a telegram is:
+ *      0-1  Index of the chunk. A chunk contains MC_CHUNK_SIZE bytes of the window.
+ *      2-   The data of the chunk
+ *      Index 0xFFFE starts a new window of up to 4096 bytes:
+ *      2-5  Flash address of the window, must be the start of a sector that is
+ *           allowed to be erased (not the bootloader)
+ *      6-7  Length of the window
+ *      Index 0xFFFF commits the window:
+ *      2-5  The CRC of the window. If the window is complete and the CRC matches,
+ *           it is programmed by updaterLoop().
+ *      Afterwards the host polls every device with UPD_REQUEST_MULTICAST_STATUS,
+ *      sends the missing chunks with UPD_MULTICAST_REPAIR and commits the window
+ *      with UPD_MULTICAST_COMMIT.
+ *      All numbers are sent LSB first.
  *
  *    Workflow:
  *      - erase the sector which needs to be programmed (UPD_ERASE_SECTOR)
@@ -60,54 +131,89 @@
  *      - update the boot descriptor block so that the bootloader is able to start the new
  *        application (UPD_UPDATE_BOOT_DESC)
  *      - restart the board (UPD_RESTART)
+ *
+ *    The commands and the errors are defined in update.h.
  */
-enum
-{
-    UPD_ERASE_SECTOR = 0,
-    UPD_SEND_DATA = 1,
-    UPD_PROGRAM = 2,
-    UPD_UPDATE_BOOT_DESC = 3,
-    UPD_REQ_DATA = 10,
-    UPD_GET_LAST_ERROR = 20,
-    UPD_SEND_LAST_ERROR = 21,
-    UPD_UNLOCK_DEVICE = 30,
-    UPD_REQUEST_UID = 31,
-    UPD_RESPONSE_UID = 32,
-    UPD_APP_VERSION_REQUEST = 33,
-    UPD_APP_VERSION_RESPONSE = 34,
-    UPD_RESET = 35,
-};
 
 #define DEVICE_LOCKED   ((unsigned int ) 0x5AA55AA5)
 #define DEVICE_UNLOCKED ((unsigned int ) ~DEVICE_LOCKED)
 #define ADDRESS2SECTOR(a) ((a + 4095) / 4096)
 
-enum UPD_Status
+unsigned char __attribute__ ((aligned (4))) ramBuffer[4096];
+static unsigned int ramLocation;
+static DecompressState decoder;
+
+/*
+ * The state of the streaming mode. The two page buffers are the first two
+ * pages of ramBuffer.
+ */
+static bool streamActive;
+static unsigned int streamStart;    //!< the flash address of the stream
+static unsigned int streamEnd;      //!< the end address of the stream
+static unsigned int streamAddress;  //!< the flash address of the page that is being received
+static unsigned int streamFill;     //!< the number of bytes in the fill buffer
+static unsigned int streamErased;   //!< the flash is erased from streamStart up to this address
+static unsigned int streamPending;  //!< the address of the page to program, 0 if none
+static unsigned char streamBuffer;  //!< the index of the fill buffer
+static unsigned int streamPages;    //!< the number of programmed pages
+static unsigned int streamError;    //!< the first error of the stream
+static unsigned int streamImageId;  //!< the ID of the image, 0 if the progress is not stored
+
+/*
+ * The state of the multicast update. The window is received into ramBuffer.
+ */
+enum
 {
-    UDP_UNKONW_COMMAND = 0x100       //<! received command is not defined
-    ,
-    UDP_CRC_ERROR                     //<! CRC calculated on the device
-                                      //<! and by the updater don't match
-    ,
-    UPD_ADDRESS_NOT_ALLOWED_TO_FLASH //<! specifed address cannot be programmed
-    ,
-    UPD_SECTOR_NOT_ALLOWED_TO_ERASE  //<! the specified sector cannot be erased
-    ,
-    UPD_RAM_BUFFER_OVERFLOW          //<! internal buffer for storing the data
-                                     //<! would overflow
-    ,
-    UPD_WRONG_DESCRIPTOR_BLOCK     //<! the boot descriptor block does not exist
-    ,
-    UPD_APPLICATION_NOT_STARTABLE //<! the programmed application is not startable
-    ,
-    UPD_DEVICE_LOCKED                //<! the device is still locked
-    ,
-    UPD_UID_MISMATCH               //<! UID sent to unlock the device is invalid
-    ,
-    UDP_NOT_IMPLEMENTED = 0xFFFF    //<! this command is not yet implemented
+    MC_IDLE,        //!< not in an update group
+    MC_JOINED,      //!< waiting for a window
+    MC_RECEIVING,   //!< receiving the chunks of a window
+    MC_PROGRAM,     //!< the window is complete and waits to be programmed
+    MC_DONE,        //!< the window was programmed
+    MC_ERROR        //!< the window failed, see mcError
 };
 
-unsigned char ramBuffer[4096];
+#define MC_CHUNK_SIZE 10
+#define MC_CHUNKS ((sizeof(ramBuffer) + MC_CHUNK_SIZE - 1) / MC_CHUNK_SIZE)
+#define MC_INDEX_BEGIN  0xFFFE
+#define MC_INDEX_COMMIT 0xFFFF
+
+static unsigned char mcState;
+static unsigned short mcGroup;          //!< the group address of the update group
+static unsigned int mcAddress;          //!< the flash address of the window
+static unsigned int mcLength;           //!< the length of the window
+static unsigned int mcMissing;          //!< the number of missing chunks
+static unsigned int mcError;            //!< the error of the window
+static unsigned char mcBitmap[(MC_CHUNKS + 7) / 8]; //!< bit = 1: chunk is missing
+
+#define PROGRESS_MAGIC 0x53475250
+
+/*
+ * The progress of a stream transfer in the flash page at PROGRESS_ADDRESS.
+ * A bit of the bitmap is cleared when the page of the stream is programmed
+ * and verified, without erasing the progress page.
+ */
+typedef struct
+{
+    unsigned int magic;     //!< PROGRESS_MAGIC
+    unsigned int imageId;   //!< the ID of the image
+    unsigned int start;     //!< the flash address of the stream
+    unsigned int length;    //!< the length of the stream
+    unsigned int bitmap[(BOOT_BLOCK_SIZE - 16) / 4]; //!< one bit per page, 1 = not yet programmed
+} ProgressRecord;
+
+#define PROGRESS_MAX_PAGES ((BOOT_BLOCK_SIZE - 16) * 8)
+
+static ProgressRecord * const progress = (ProgressRecord *) (FLASH_BASE_ADDRESS + PROGRESS_ADDRESS);
+
+/*
+ * Start filling the RAM buffer from the beginning.
+ */
+static void resetRamBuffer()
+{
+    ramLocation = 0;
+    decompressInit(&decoder, ramBuffer, sizeof(ramBuffer));
+    streamActive = false;
+}
 
 /*
  * a direct cast does not work due to possible miss aligned addresses.
@@ -168,19 +274,403 @@ inline bool addressAllowedToProgram(unsigned int start, unsigned int length)
     return !((start >= __vectors_start__) && (end <= _etext));
 }
 
-unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
-        unsigned char * data)
+/*
+ * Program a part of an already programmed flash page.
+ *
+ * @param address - the flash address, the part must not cross a page boundary
+ * @param data - the data to program
+ * @param count - the number of bytes to program
+ * @return the IAP status
+ */
+static unsigned int programPartOfPage(byte * address, const void * data,
+        unsigned int count)
+{
+    unsigned int page[FLASH_PAGE_SIZE / 4];
+    unsigned int offset = (address - FLASH_BASE_ADDRESS) & (FLASH_PAGE_SIZE - 1);
+
+    // Bytes that are 0xff leave the programmed flash untouched
+    memset(page, 0xff, sizeof(page));
+    memcpy((byte *) page + offset, data, count);
+    unsigned int error = iapProgram(address - offset, (byte *) page, FLASH_PAGE_SIZE);
+
+    // The IAP compares the whole page, which also holds the data that was
+    // programmed before. Only the programmed part has to match.
+    if (error == IAP_COMPARE_ERROR && !memcmp(address, data, count))
+        error = IAP_SUCCESS;
+    return error;
+}
+
+unsigned int programVerifiedMarker(AppDescriptionBlock * block, unsigned int value)
+{
+    return programPartOfPage((byte *) &VERIFIED_MARKER(block), &value, 4);
+}
+
+/*
+ * Test if the stored progress belongs to an image.
+ */
+static bool progressMatches(unsigned int imageId, unsigned int start, unsigned int length)
+{
+    return progress->magic == PROGRESS_MAGIC && progress->imageId == imageId
+            && progress->start == start && progress->length == length;
+}
+
+/*
+ * @return the offset of the first page of the stored progress that is not yet programmed.
+ */
+static unsigned int progressResumeOffset()
+{
+    unsigned int offset = 0;
+
+    for (unsigned int i = 0; offset < progress->length; i++, offset += FLASH_PAGE_SIZE)
+    {
+        if (progress->bitmap[i >> 5] & (1 << (i & 31)))
+            break;
+    }
+    return offset < progress->length ? offset : progress->length;
+}
+
+/*
+ * Store the progress of a new stream.
+ */
+static unsigned int progressBegin()
+{
+    unsigned int header[4] = { PROGRESS_MAGIC, streamImageId, streamStart,
+            streamEnd - streamStart };
+    unsigned int error = iapErasePage(PROGRESS_ADDRESS / FLASH_PAGE_SIZE);
+
+    if (error == IAP_SUCCESS)
+        error = programPartOfPage((byte *) progress, header, sizeof(header));
+    return error;
+}
+
+/*
+ * Mark a page of the stream as programmed.
+ */
+static unsigned int progressPageDone(unsigned int address)
+{
+    unsigned int page = (address - streamStart) / FLASH_PAGE_SIZE;
+    unsigned int value = progress->bitmap[page >> 5] & ~(1 << (page & 31));
+
+    return programPartOfPage((byte *) &progress->bitmap[page >> 5], &value, 4);
+}
+
+/*
+ * Clear the verified markers of both boot descriptor blocks before the
+ * application area is modified.
+ */
+static void invalidateVerifiedMarkers()
+{
+    AppDescriptionBlock * block = (AppDescriptionBlock *) (FLASH_BASE_ADDRESS + FIRST_SECTOR);
+
+    for (int i = 0; i < 2; i++)
+    {
+        block--;
+        if (VERIFIED_MARKER(block))
+            programVerifiedMarker(block, 0);
+    }
+}
+
+/*
+ * Erase the next sector or program the pending page of the stream.
+ * Only one flash operation is done per call.
+ *
+ * @param eraseAhead - also erase the next sector if no page is pending
+ * @return true if a flash operation was done
+ */
+static bool streamFlashOperation(bool eraseAhead)
+{
+    if (!streamActive || streamError)
+        return false;
+
+    if (streamPending)
+    {
+        if (streamPending >= streamErased)
+        {
+            if (sectorAllowedToErease(iapSectorOfAddress(FLASH_BASE_ADDRESS + streamErased)))
+                streamError = iapEraseSector(iapSectorOfAddress(FLASH_BASE_ADDRESS + streamErased));
+            else
+                streamError = UPD_SECTOR_NOT_ALLOWED_TO_ERASE;
+            streamErased += FLASH_SECTOR_SIZE;
+            return true;
+        }
+
+        byte * buffer = ramBuffer + (streamBuffer ^ 1) * FLASH_PAGE_SIZE;
+        streamError = iapProgram(FLASH_BASE_ADDRESS + streamPending, buffer, FLASH_PAGE_SIZE);
+        if (!streamError && streamImageId)
+        {   // only a verified page may be skipped by a resumed transfer
+            if (memcmp(FLASH_BASE_ADDRESS + streamPending, buffer, FLASH_PAGE_SIZE))
+                streamError = UPD_VERIFY_FAILED;
+            else
+                streamError = progressPageDone(streamPending);
+        }
+        streamPending = 0;
+        if (!streamError)
+            streamPages++;
+        return true;
+    }
+
+    if (eraseAhead && streamErased < streamEnd
+            && streamErased < streamAddress + FLASH_SECTOR_SIZE)
+    {
+        if (sectorAllowedToErease(iapSectorOfAddress(FLASH_BASE_ADDRESS + streamErased)))
+            streamError = iapEraseSector(iapSectorOfAddress(FLASH_BASE_ADDRESS + streamErased));
+        else
+            streamError = UPD_SECTOR_NOT_ALLOWED_TO_ERASE;
+        streamErased += FLASH_SECTOR_SIZE;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Hand the fill buffer over for programming and switch to the other buffer.
+ */
+static void streamPageComplete()
+{
+    memset(ramBuffer + streamBuffer * FLASH_PAGE_SIZE + streamFill, 0xff,
+            FLASH_PAGE_SIZE - streamFill);
+    streamPending = streamAddress;
+    streamBuffer ^= 1;
+    streamAddress += FLASH_PAGE_SIZE;
+    streamFill = 0;
+}
+
+/*
+ * Add data to the stream.
+ *
+ * @return the status of the stream
+ */
+static unsigned int streamData(unsigned char * data, unsigned int count)
+{
+    unsigned int pageSize = streamEnd - streamAddress;
+
+    if (!streamActive)
+        return UPD_STREAM_NOT_STARTED;
+    if (streamError)
+        return streamError;
+    if (streamFill + count > pageSize)
+        return UPD_RAM_BUFFER_OVERFLOW;
+
+    // A telegram that completes a page while the other page is not yet programmed
+    // is rejected. A frame of more than a page waits for the flash instead.
+    if (pageSize > FLASH_PAGE_SIZE)
+        pageSize = FLASH_PAGE_SIZE;
+    if (streamPending && count < FLASH_PAGE_SIZE && streamFill + count >= pageSize)
+        return UPD_STREAM_BUSY;
+
+    while (count)
+    {
+        pageSize = streamEnd - streamAddress;
+        if (pageSize > FLASH_PAGE_SIZE)
+            pageSize = FLASH_PAGE_SIZE;
+
+        unsigned int n = pageSize - streamFill;
+        if (n > count)
+            n = count;
+
+        memcpy(ramBuffer + streamBuffer * FLASH_PAGE_SIZE + streamFill, data, n);
+        streamFill += n;
+        data += n;
+        count -= n;
+
+        if (streamFill == pageSize)
+        {
+            while (streamPending && streamFlashOperation(false))
+                ;
+            if (streamError)
+                return streamError;
+            streamPageComplete();
+        }
+    }
+    return IAP_SUCCESS;
+}
+
+/*
+ * Program the remaining data of the stream and check the CRC of the stream.
+ */
+static unsigned int streamFinish(unsigned int crc)
+{
+    if (!streamActive)
+        return UPD_STREAM_NOT_STARTED;
+
+    while (streamFlashOperation(false))
+        ;
+    if (streamFill && !streamError)
+    {
+        streamPageComplete();
+        while (streamFlashOperation(false))
+            ;
+    }
+    streamActive = false;
+
+    if (streamError)
+        return streamError;
+    if (crc32(0xFFFFFFFF, FLASH_BASE_ADDRESS + streamStart, streamEnd - streamStart) != crc)
+        streamError = UDP_CRC_ERROR;
+    if (streamImageId)
+    {   // the progress is not needed any more
+        unsigned int error = iapErasePage(PROGRESS_ADDRESS / FLASH_PAGE_SIZE);
+        if (!streamError)
+            streamError = error;
+    }
+    return streamError;
+}
+
+/*
+ * Join the update group: the group address is added to the address table in RAM,
+ * so the bus accepts the telegrams. A group address of 0 leaves the update group.
+ */
+static void multicastJoin(unsigned int group)
+{
+    byte * tab = addrTable();
+
+    resetRamBuffer();
+    mcGroup = group;
+    if (group)
+    {
+        tab[0] = 1;
+        tab[3] = group >> 8;
+        tab[4] = group;
+        mcState = MC_JOINED;
+    }
+    else
+    {
+        tab[0] = 0;
+        mcState = MC_IDLE;
+    }
+}
+
+/*
+ * Start the reception of a new window.
+ */
+static void multicastBegin(unsigned int address, unsigned int length)
+{
+    unsigned int chunks = (length + MC_CHUNK_SIZE - 1) / MC_CHUNK_SIZE;
+
+    mcAddress = address;
+    mcLength = length;
+    if ((address & (FLASH_SECTOR_SIZE - 1)) || !length || length > sizeof(ramBuffer)
+            || !addressAllowedToProgram(address, length))
+    {
+        mcError = UPD_ADDRESS_NOT_ALLOWED_TO_FLASH;
+        mcState = MC_ERROR;
+        return;
+    }
+    if (!sectorAllowedToErease(iapSectorOfAddress(FLASH_BASE_ADDRESS + address)))
+    {
+        mcError = UPD_SECTOR_NOT_ALLOWED_TO_ERASE;
+        mcState = MC_ERROR;
+        return;
+    }
+
+    memset(ramBuffer, 0xff, sizeof(ramBuffer));
+    memset(mcBitmap, 0, sizeof(mcBitmap));
+    for (unsigned int i = 0; i < chunks; i++)
+        mcBitmap[i >> 3] |= 1 << (i & 7);
+    mcMissing = chunks;
+    mcError = IAP_SUCCESS;
+    mcState = MC_RECEIVING;
+}
+
+/*
+ * Store a chunk of the window.
+ */
+static unsigned int multicastChunk(unsigned int index, unsigned char * data,
+        unsigned int count)
+{
+    unsigned int offset = index * MC_CHUNK_SIZE;
+
+    if (mcState != MC_RECEIVING)
+        return UPD_MULTICAST_NOT_RECEIVING;
+    if (offset >= mcLength || count > MC_CHUNK_SIZE || offset + count > mcLength)
+        return UPD_RAM_BUFFER_OVERFLOW;
+
+    memcpy(ramBuffer + offset, data, count);
+    if (mcBitmap[index >> 3] & (1 << (index & 7)))
+    {
+        mcBitmap[index >> 3] &= ~(1 << (index & 7));
+        mcMissing--;
+    }
+    return IAP_SUCCESS;
+}
+
+/*
+ * Check the window. If it is complete and the CRC matches, it is marked for programming.
+ */
+static unsigned int multicastCommit(unsigned int crc)
+{
+    if (mcState != MC_RECEIVING)
+        return mcState == MC_PROGRAM || mcState == MC_DONE ? IAP_SUCCESS : UPD_MULTICAST_NOT_RECEIVING;
+    if (mcMissing)
+        return UPD_MULTICAST_INCOMPLETE;
+
+    if (crc32(0xFFFFFFFF, ramBuffer, mcLength) != crc)
+    {
+        mcError = UDP_CRC_ERROR;
+        mcState = MC_ERROR;
+        return mcError;
+    }
+    mcState = MC_PROGRAM;
+    return IAP_SUCCESS;
+}
+
+/*
+ * Erase the sector of the window and program it.
+ */
+static void multicastProgram()
 {
-    unsigned int count = data[0] & 0x0f;
+    invalidateVerifiedMarkers();
+    mcError = iapEraseSector(iapSectorOfAddress(FLASH_BASE_ADDRESS + mcAddress));
+    if (mcError == IAP_SUCCESS)
+        mcError = iapProgram(FLASH_BASE_ADDRESS + mcAddress, ramBuffer, sizeof(ramBuffer));
+    mcState = mcError == IAP_SUCCESS ? MC_DONE : MC_ERROR;
+}
+
+void handleMulticastTelegram(unsigned int groupAddr, unsigned char * data,
+        unsigned int count)
+{
+    if (mcState == MC_IDLE || groupAddr != mcGroup || count < 2)
+        return;
+
+    unsigned int index = data[0] | (data[1] << 8);
+    data += 2;
+    count -= 2;
+
+    if (index == MC_INDEX_BEGIN)
+    {
+        if (count >= 6)
+            multicastBegin(streamToUIn32(data), data[4] | (data[5] << 8));
+    }
+    else if (index == MC_INDEX_COMMIT)
+    {
+        // devices with missing chunks wait for the repair
+        if (count >= 4 && mcState == MC_RECEIVING && !mcMissing)
+            multicastCommit(streamToUIn32(data));
+    }
+    else multicastChunk(index, data, count);
+}
+
+void updaterLoop()
+{
+    if (streamActive && bus.idle())
+        streamFlashOperation(true);
+    if (mcState == MC_PROGRAM && bus.idle())
+        multicastProgram();
+}
+
+unsigned int processUpdateRequest(unsigned char cmd, unsigned char * data,
+        unsigned int count, unsigned char * reply, unsigned char * replyCmd)
+{
+    unsigned int replyLength = 0;
+    unsigned int dataLength = count;
     unsigned int address;
-    static unsigned int ramLocation;
     static unsigned int deviceLocked = DEVICE_LOCKED;
     unsigned int crc = 0xFFFFFFFF;
     static unsigned int lastError = 0;
     unsigned int sendLastError = 0;
 
     digitalWrite(PIN_INFO, !digitalRead(PIN_INFO));
-    switch (data[2])
+    switch (cmd)
     {
         case UPD_UNLOCK_DEVICE:
             if (!((BcuUpdate &) bcu).progPinStatus())
@@ -199,7 +689,7 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
                 {
                     for (unsigned int i = 0; i < 12; i++)
                     {
-                        if (data[i + 3] != uid[i])
+                        if (data[i] != uid[i])
                         {
                             lastError = UPD_UID_MISMATCH;
                         }
@@ -212,7 +702,7 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
                 }
             }
             sendLastError = true;
-            ramLocation = 0;
+            resetRamBuffer();
             crc = 0xFFFFFFFF;
             break;
         case UPD_REQUEST_UID:
@@ -222,8 +712,9 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
                 lastError = iapReadUID(uid);
                 if (lastError == IAP_SUCCESS)
                 {
-                    *sendTel = _prepareReturnTelegram(12, UPD_RESPONSE_UID);
-                    memcpy(bcu.sendTelegram + 10, uid, 12);
+                    replyLength = 12;
+                    *replyCmd = UPD_RESPONSE_UID;
+                    memcpy(reply, uid, 12);
                 }
                 break;
             }
@@ -237,15 +728,43 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
                 lastError = UPD_DEVICE_LOCKED;
         	sendLastError = true;
             break;
+        case UPD_REQUEST_CRC:
+            if (deviceLocked == DEVICE_UNLOCKED)
+            {
+                unsigned int blockSize = streamToUIn32(data + 4);
+                unsigned int blocks = data[4 + 4];
+                address = streamToUIn32(data);
+                if (count >= 9 && blocks >= 1 && blocks <= 3 && blockSize
+                        && blockSize <= iapFlashSize()
+                        && address < (unsigned int) iapFlashSize()
+                        && blocks * blockSize <= iapFlashSize() - address)
+                {
+                    replyLength = blocks * 4;
+                    *replyCmd = UPD_RESPONSE_CRC;
+                    for (unsigned int i = 0; i < blocks; i++, address += blockSize)
+                    {
+                        crc = crc32(0xFFFFFFFF, FLASH_BASE_ADDRESS + address, blockSize);
+                        UIn32ToStream(reply + i * 4, crc);
+                    }
+                    lastError = IAP_SUCCESS;
+                    break;
+                }
+                else
+                    lastError = UPD_ADDRESS_NOT_ALLOWED_TO_READ;
+            }
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
         case UPD_APP_VERSION_REQUEST:
-            unsigned char * appversion;
-            appversion = getAppVersion(
-                    (AppDescriptionBlock *) (FIRST_SECTOR
-                            - (1 + data[3]) * BOOT_BLOCK_SIZE));
-            if (((unsigned int) appversion) < 0x50000)
+            AppDescriptionBlock * block;
+            block = (AppDescriptionBlock *) (FLASH_BASE_ADDRESS + FIRST_SECTOR
+                    - (1 + data[0]) * BOOT_BLOCK_SIZE);
+            if (block->appVersionAddress < 0x50000)
             {
-                *sendTel = _prepareReturnTelegram(12, UPD_APP_VERSION_RESPONSE);
-                memcpy(bcu.sendTelegram + 10, appversion, 12);
+                replyLength = 12;
+                *replyCmd = UPD_APP_VERSION_RESPONSE;
+                memcpy(reply, getAppVersion(block), 12);
                 lastError = IAP_SUCCESS;
             }
             else
@@ -254,16 +773,17 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
         case UPD_ERASE_SECTOR:
             if (deviceLocked == DEVICE_UNLOCKED)
             {
-                if (sectorAllowedToErease(data[3]))
+                if (sectorAllowedToErease(data[0]))
                 {
-                    lastError = iapEraseSector(data[3]);
+                    invalidateVerifiedMarkers();
+                    lastError = iapEraseSector(data[0]);
                 }
                 else
                     lastError = UPD_SECTOR_NOT_ALLOWED_TO_ERASE;
             }
             else
                 lastError = UPD_DEVICE_LOCKED;
-            ramLocation = 0;
+            resetRamBuffer();
             sendLastError = true;
             break;
         case UPD_SEND_DATA:
@@ -271,8 +791,8 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
             {
                 if ((ramLocation + count) <= sizeof(ramBuffer))
                 {
-                    memcpy((void *) &ramBuffer[ramLocation], data + 3, count);
-                    crc = crc32(crc, data + 3, count);
+                    memcpy((void *) &ramBuffer[ramLocation], data, count);
+                    crc = crc32(crc, data, count);
                     ramLocation += count;
                     lastError = IAP_SUCCESS;
                 }
@@ -283,15 +803,164 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
                 lastError = UPD_DEVICE_LOCKED;
             sendLastError = true;
             break;
+        case UPD_SEND_DATA_COMPRESSED:
+            if (deviceLocked == DEVICE_UNLOCKED)
+            {
+                if (decoder.pos != ramLocation)
+                {   // plain data was sent since the last reset
+                    decoder.pos = ramLocation;
+                }
+                switch (decompress(&decoder, data, count))
+                {
+                    case DECOMPRESS_OK:
+                        lastError = IAP_SUCCESS;
+                        break;
+                    case DECOMPRESS_OVERFLOW:
+                        lastError = UPD_RAM_BUFFER_OVERFLOW;
+                        break;
+                    default:
+                        lastError = UPD_INVALID_COMPRESSED_DATA;
+                        break;
+                }
+                ramLocation = decoder.pos;
+            }
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_STREAM_START:
+            if (deviceLocked == DEVICE_UNLOCKED)
+            {
+                address = streamToUIn32(data);
+                count = streamToUIn32(data + 4);
+                resetRamBuffer();
+                if (!(address & (FLASH_SECTOR_SIZE - 1)) && count
+                        && addressAllowedToProgram(address, count))
+                {
+                    invalidateVerifiedMarkers();
+                    streamActive = true;
+                    streamStart = streamAddress = streamErased = address;
+                    streamEnd = address + count;
+                    streamFill = 0;
+                    streamPending = 0;
+                    streamBuffer = 0;
+                    streamPages = 0;
+                    streamError = 0;
+                    streamImageId = 0;
+                    if (dataLength >= 12 && count <= PROGRESS_MAX_PAGES * FLASH_PAGE_SIZE)
+                        streamImageId = streamToUIn32(data + 4 + 4);
+
+                    if (streamImageId && progressMatches(streamImageId, address, count))
+                    {   // continue an interrupted transfer of the same image
+                        streamAddress += progressResumeOffset();
+                        streamPages = (streamAddress - streamStart) / FLASH_PAGE_SIZE;
+                        // the sector of the resume point is already erased
+                        streamErased = (streamAddress + FLASH_SECTOR_SIZE - 1)
+                                & ~(FLASH_SECTOR_SIZE - 1);
+                    }
+                    else if (streamImageId)
+                        streamError = progressBegin();
+                    lastError = streamError;
+                }
+                else
+                    lastError = UPD_ADDRESS_NOT_ALLOWED_TO_FLASH;
+            }
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_STREAM_DATA:
+            if (deviceLocked == DEVICE_UNLOCKED)
+                lastError = streamData(data, count);
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_STREAM_END:
+            if (deviceLocked == DEVICE_UNLOCKED)
+                lastError = streamFinish(streamToUIn32(data));
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_REQUEST_STREAM_STATUS:
+            replyLength = 12;
+            *replyCmd = UPD_RESPONSE_STREAM_STATUS;
+            UIn32ToStream(reply, streamPages);
+            UIn32ToStream(reply + 4, streamError);
+            UIn32ToStream(reply + 8, streamAddress + streamFill - streamStart);
+            lastError = IAP_SUCCESS;
+            break;
+        case UPD_REQUEST_RESUME:
+            replyLength = 12;
+            *replyCmd = UPD_RESPONSE_RESUME;
+            memset(reply, 0, 12);
+            if (progress->magic == PROGRESS_MAGIC && progress->imageId == streamToUIn32(data))
+            {
+                UIn32ToStream(reply, progress->start);
+                UIn32ToStream(reply + 4, progress->length);
+                UIn32ToStream(reply + 8, progressResumeOffset());
+            }
+            lastError = IAP_SUCCESS;
+            break;
+        case UPD_MULTICAST_JOIN:
+            if (deviceLocked == DEVICE_UNLOCKED)
+            {
+                multicastJoin(data[0] | (data[1] << 8));
+                lastError = IAP_SUCCESS;
+            }
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_MULTICAST_REPAIR:
+            if (deviceLocked == DEVICE_UNLOCKED && count >= 2)
+                lastError = multicastChunk(data[0] | (data[1] << 8), data + 2, count - 2);
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_MULTICAST_COMMIT:
+            if (deviceLocked == DEVICE_UNLOCKED)
+            {
+                lastError = multicastCommit(streamToUIn32(data));
+                if (mcState == MC_PROGRAM)
+                    multicastProgram();
+                if (mcState == MC_ERROR)
+                    lastError = mcError;
+            }
+            else
+                lastError = UPD_DEVICE_LOCKED;
+            sendLastError = true;
+            break;
+        case UPD_REQUEST_MULTICAST_STATUS:
+            {
+                unsigned int first = (data[0] | (data[1] << 8)) & ~7;
+                replyLength = 12;
+                *replyCmd = UPD_RESPONSE_MULTICAST_STATUS;
+                reply[0] = mcMissing;
+                reply[1] = mcMissing >> 8;
+                reply[2] = mcError;
+                reply[3] = mcError >> 8;
+                reply[4] = first;
+                reply[5] = first >> 8;
+                for (unsigned int i = 0; i < 6; i++)
+                {
+                    unsigned int pos = (first >> 3) + i;
+                    reply[6 + i] = pos < sizeof(mcBitmap) ? mcBitmap[pos] : 0;
+                }
+                lastError = IAP_SUCCESS;
+            }
+            break;
         case UPD_PROGRAM:
             if (deviceLocked == DEVICE_UNLOCKED)
             {
-                count = streamToUIn32(data + 3);
-                address = streamToUIn32(data + 3 + 4);
+                count = streamToUIn32(data);
+                address = streamToUIn32(data + 4);
                 if (addressAllowedToProgram(address, count))
                 {
                     crc = crc32(0xFFFFFFFF, ramBuffer, count);
-                    if (crc == streamToUIn32(data + 3 + 4 + 4))
+                    if (crc == streamToUIn32(data + 4 + 4))
                     {
                         if (count > 1024)
                         {
@@ -309,7 +978,8 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
                         {
                             count = 256;
                         }
-                        lastError = iapProgram((byte *) address, ramBuffer,
+                        invalidateVerifiedMarkers();
+                        lastError = iapProgram(FLASH_BASE_ADDRESS + address, ramBuffer,
                                 count);
                     }
                     else
@@ -320,23 +990,26 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
             }
             else
                 lastError = UPD_DEVICE_LOCKED;
-            ramLocation = 0;
+            resetRamBuffer();
             crc = 0xFFFFFFFF;
             sendLastError = true;
             break;
         case UPD_UPDATE_BOOT_DESC:
-            if (deviceLocked == DEVICE_UNLOCKED && data[7] < 2)
+            if (deviceLocked == DEVICE_UNLOCKED && data[4] < 2)
             {
                 crc = crc32(0xFFFFFFFF, ramBuffer, 256);
-                address = FIRST_SECTOR - (1 + data[7]) * BOOT_BLOCK_SIZE; // start address of the descriptor block
-                if (crc == streamToUIn32(data + 3))
+                address = FIRST_SECTOR - (1 + data[4]) * BOOT_BLOCK_SIZE; // start address of the descriptor block
+                if (crc == streamToUIn32(data))
                 {
-                    if (checkApplication((AppDescriptionBlock *) ramBuffer))
+                    AppDescriptionBlock * block = (AppDescriptionBlock *) ramBuffer;
+                    VERIFIED_MARKER(block) = 0xFFFFFFFF; // force a full check
+                    if (checkApplication(block))
                     {
-						lastError = iapErasePage(BOOT_BLOCK_PAGE - data[7]);
+                        VERIFIED_MARKER(block) = block->crc ^ VERIFIED_MAGIC;
+						lastError = iapErasePage(BOOT_BLOCK_PAGE - data[4]);
 						if (lastError == IAP_SUCCESS)
 						{
-							lastError = iapProgram((byte *) address, ramBuffer,
+							lastError = iapProgram(FLASH_BASE_ADDRESS + address, ramBuffer,
 									256);
 						}
                     }
@@ -348,7 +1021,7 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
             }
             else
                 lastError = UPD_DEVICE_LOCKED;
-            ramLocation = 0;
+            resetRamBuffer();
             crc = 0xFFFFFFFF;
             sendLastError = true;
             break;
@@ -378,8 +1051,21 @@ unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
     }
     if (sendLastError)
     {
-        *sendTel = _prepareReturnTelegram(4, UPD_SEND_LAST_ERROR);
-        UIn32ToStream(bcu.sendTelegram + 10, lastError);
+        replyLength = 4;
+        *replyCmd = UPD_SEND_LAST_ERROR;
+        UIn32ToStream(reply, lastError);
     }
+    return replyLength;
+}
+
+unsigned char handleMemoryRequests(int apciCmd, bool * sendTel,
+        unsigned char * data)
+{
+    unsigned char replyCmd;
+    unsigned int replyLength = processUpdateRequest(data[2], data + 3, data[0] & 0x0f,
+            bcu.sendTelegram + 10, &replyCmd);
+
+    if (replyLength)
+        *sendTel = _prepareReturnTelegram(replyLength, replyCmd);
     return T_ACK_PDU;
 }
@@ -0,0 +1,119 @@
+/*
+ *  update.h - The updater protocol.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef UPDATE_H_
+#define UPDATE_H_
+
+/**
+ * The commands of the updater protocol, see update.cpp.
+ */
+enum
+{
+    UPD_ERASE_SECTOR = 0,
+    UPD_SEND_DATA = 1,
+    UPD_PROGRAM = 2,
+    UPD_UPDATE_BOOT_DESC = 3,
+    UPD_SEND_DATA_COMPRESSED = 4,
+    UPD_STREAM_START = 5,
+    UPD_STREAM_DATA = 6,
+    UPD_STREAM_END = 7,
+    UPD_MULTICAST_JOIN = 8,
+    UPD_MULTICAST_REPAIR = 9,
+    UPD_REQ_DATA = 10,
+    UPD_MULTICAST_COMMIT = 11,
+    UPD_GET_LAST_ERROR = 20,
+    UPD_SEND_LAST_ERROR = 21,
+    UPD_UNLOCK_DEVICE = 30,
+    UPD_REQUEST_UID = 31,
+    UPD_RESPONSE_UID = 32,
+    UPD_APP_VERSION_REQUEST = 33,
+    UPD_APP_VERSION_RESPONSE = 34,
+    UPD_RESET = 35,
+    UPD_REQUEST_CRC = 36,
+    UPD_RESPONSE_CRC = 37,
+    UPD_REQUEST_STREAM_STATUS = 38,
+    UPD_RESPONSE_STREAM_STATUS = 39,
+    UPD_REQUEST_RESUME = 40,
+    UPD_RESPONSE_RESUME = 41,
+    UPD_REQUEST_MULTICAST_STATUS = 42,
+    UPD_RESPONSE_MULTICAST_STATUS = 43,
+};
+
+/**
+ * The errors of the updater protocol, returned with UPD_SEND_LAST_ERROR. Values
+ * below 0x100 are IAP status codes.
+ */
+enum UPD_Status
+{
+    UDP_UNKONW_COMMAND = 0x100       //<! received command is not defined
+    ,
+    UDP_CRC_ERROR                     //<! CRC calculated on the device
+                                      //<! and by the updater don't match
+    ,
+    UPD_ADDRESS_NOT_ALLOWED_TO_FLASH //<! specifed address cannot be programmed
+    ,
+    UPD_SECTOR_NOT_ALLOWED_TO_ERASE  //<! the specified sector cannot be erased
+    ,
+    UPD_RAM_BUFFER_OVERFLOW          //<! internal buffer for storing the data
+                                     //<! would overflow
+    ,
+    UPD_WRONG_DESCRIPTOR_BLOCK     //<! the boot descriptor block does not exist
+    ,
+    UPD_APPLICATION_NOT_STARTABLE //<! the programmed application is not startable
+    ,
+    UPD_DEVICE_LOCKED                //<! the device is still locked
+    ,
+    UPD_UID_MISMATCH               //<! UID sent to unlock the device is invalid
+    ,
+    UPD_INVALID_COMPRESSED_DATA    //<! the compressed data contains an invalid back reference
+    ,
+    UPD_ADDRESS_NOT_ALLOWED_TO_READ  //<! the specified range is not inside the flash
+    ,
+    UPD_STREAM_NOT_STARTED         //<! stream data was received without UPD_STREAM_START
+    ,
+    UPD_STREAM_BUSY                //<! both page buffers are in use, send the data again
+    ,
+    UPD_VERIFY_FAILED              //<! the programmed page differs from the data
+    ,
+    UPD_MULTICAST_NOT_RECEIVING    //<! no multicast window is being received
+    ,
+    UPD_MULTICAST_INCOMPLETE       //<! chunks of the multicast window are missing
+    ,
+    UDP_NOT_IMPLEMENTED = 0xFFFF    //<! this command is not yet implemented
+};
+
+/**
+ * Process a request of the updater protocol, independent of the transport.
+ * See update.cpp for the commands.
+ *
+ * @param cmd - the command
+ * @param data - the data of the command
+ * @param count - the number of bytes in data
+ * @param reply - the buffer for the data of the reply, at least 12 bytes
+ * @param replyCmd - receives the command of the reply
+ * @return the number of bytes in reply, 0 if no reply shall be sent
+ */
+unsigned int processUpdateRequest(unsigned char cmd, unsigned char * data,
+        unsigned int count, unsigned char * reply, unsigned char * replyCmd);
+
+/**
+ * Process a multicast update telegram (A_GroupValue_Write).
+ *
+ * @param groupAddr - the destination group address
+ * @param data - the data of the telegram
+ * @param count - the number of bytes in data
+ */
+void handleMulticastTelegram(unsigned int groupAddr, unsigned char * data,
+        unsigned int count);
+
+/**
+ * Do the pending flash operations of the updater. Call from the main loop.
+ */
+void updaterLoop();
+
+#endif /* UPDATE_H_ */
@@ -113,5 +113,5 @@ void loop()
 		}
     }
     // Sleep until the next 1 msec timer interrupt occurs (or shorter)
-    __WFI();
+    waitForInterrupt();
 }
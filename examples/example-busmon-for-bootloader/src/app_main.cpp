@@ -58,5 +58,5 @@ void loop()
     }
 
     // Sleep until the next 1 msec timer interrupt occurs (or shorter)
-    __WFI();
+    waitForInterrupt();
 }
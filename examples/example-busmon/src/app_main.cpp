@@ -45,6 +45,11 @@ void loop()
 
 	if (bus.telegramReceived())
     {
+#ifdef BUSMON_TIMESTAMPS
+        // The time of the telegram, for test/bus-trace/busmon2trace
+        serial.print(millis());
+        serial.print(": ");
+#endif
         for (int i = 0; i < bus.telegramLen; ++i)
         {
             if (i) serial.print(" ");
@@ -58,5 +63,5 @@ void loop()
     }
 
     // Sleep until the next 1 msec timer interrupt occurs (or shorter)
-    __WFI();
+    waitForInterrupt();
 }
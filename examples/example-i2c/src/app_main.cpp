@@ -295,7 +295,7 @@ void loop()
     bReadTimer=false;
   }
   // Sleep until the next interrupt happens
-  __WFI();
+  waitForInterrupt();
 }
 
 /******************************************************************************
@@ -57,5 +57,5 @@ void setup()
 void loop()
 {
     // Sleep until the next interrupt happens
-    __WFI();
+    waitForInterrupt();
 }
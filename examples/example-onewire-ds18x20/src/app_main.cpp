@@ -151,5 +151,5 @@ void loop()
   }
 
   // Sleep until the next interrupt happens
-  __WFI();
+  waitForInterrupt();
 }
@@ -49,5 +49,5 @@ void setup()
  */
 void loop()
 {
-    __WFI(); // sleep until the next interrupt occurs
+    waitForInterrupt(); // sleep until the next interrupt occurs
 }
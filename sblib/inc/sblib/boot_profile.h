@@ -0,0 +1,67 @@
+/*
+ *  boot_profile.h - Measure the time of the startup stages.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_boot_profile_h
+#define sblib_boot_profile_h
+
+#include <sblib/types.h>
+
+class Print;
+
+/**
+ * The startup stages that are measured by the boot profiler.
+ */
+enum BootStage
+{
+    BOOT_LIB_SETUP,      //!< The library is set up, the system timer is running
+    BOOT_FLASH_SIZE,     //!< The flash size is known
+    BOOT_READ_EEPROM,    //!< The user EEPROM is read
+    BOOT_BUS_BEGIN,      //!< The bus is started
+    BOOT_SETUP,          //!< The application's setup() is finished
+    BOOT_FIRST_LOOP,     //!< The first main loop iteration is started
+    BOOT_FIRST_ACK,      //!< The first telegram for us is acknowledged
+    BOOT_STAGES          //!< The number of stages
+};
+
+#ifdef BOOT_PROFILE
+/**
+ * Mark the end of a startup stage. Only the first mark of each stage is recorded.
+ * Does nothing if BOOT_PROFILE is not defined.
+ *
+ * @param stage - the stage, see enum BootStage.
+ */
+#  define BOOT_PROFILE_MARK(stage) bootProfileMark(stage)
+#else
+#  define BOOT_PROFILE_MARK(stage)
+#endif
+
+/**
+ * Record the time of a startup stage. Use BOOT_PROFILE_MARK() instead.
+ *
+ * @param stage - the stage, see enum BootStage.
+ */
+void bootProfileMark(int stage);
+
+/**
+ * Get the time of a startup stage.
+ *
+ * @param stage - the stage, see enum BootStage.
+ * @return The time in microseconds since the system timer was started, 0 if the
+ *         stage was not reached yet.
+ */
+unsigned int bootProfileTime(int stage);
+
+/**
+ * Print the time of all startup stages, one line per stage: the name, the time
+ * since the system timer was started and the duration of the stage, both in
+ * microseconds.
+ *
+ * @param out - the output, e.g. serial.
+ */
+void bootProfileReport(Print& out);
+
+#endif /*sblib_boot_profile_h*/
@@ -11,6 +11,21 @@
 #define sblib_buffered_stream_h
 
 #include <sblib/stream.h>
+#include <sblib/ring_buffer.h>
+
+/**
+ * The size of the read buffer in bytes. Must be a power of two.
+ */
+#ifndef BUFFERED_STREAM_READ_SIZE
+#  define BUFFERED_STREAM_READ_SIZE 128
+#endif
+
+/**
+ * The size of the write buffer in bytes. Must be a power of two.
+ */
+#ifndef BUFFERED_STREAM_WRITE_SIZE
+#  define BUFFERED_STREAM_WRITE_SIZE 128
+#endif
 
 /**
  * A stream class that has a read and a write buffer.
@@ -47,16 +62,13 @@ public:
 
     enum
     {
-        BUFFER_SIZE = 128,  //!< The size of the internal read/write buffers in bytes.
-        BUFFER_SIZE_MASK = BUFFER_SIZE-1
+        READ_BUFFER_SIZE = BUFFERED_STREAM_READ_SIZE,    //!< The size of the read buffer in bytes.
+        WRITE_BUFFER_SIZE = BUFFERED_STREAM_WRITE_SIZE   //!< The size of the write buffer in bytes.
     };
 
 protected:
-    volatile int readHead, readTail;   //!< head and tail index for the read buffer
-    volatile int writeHead, writeTail; //!< head and tail index for the write buffer
-
-    byte readBuffer[BUFFER_SIZE];      //!< the read buffer
-    byte writeBuffer[BUFFER_SIZE];     //!< the write buffer
+    RingBuffer<byte, READ_BUFFER_SIZE> readBuffer;   //!< the read buffer, filled by the subclass
+    RingBuffer<byte, WRITE_BUFFER_SIZE> writeBuffer; //!< the write buffer, emptied by the subclass
 
     /**
      * Test if the read buffer is full.
@@ -76,20 +88,18 @@ protected:
 
 inline void BufferedStream::clearBuffers()
 {
-    readHead = 0;
-    readTail = 0;
-    writeHead = 0;
-    writeTail = 0;
+    readBuffer.clear();
+    writeBuffer.clear();
 }
 
 ALWAYS_INLINE bool BufferedStream::readBufferFull()
 {
-    return ((readTail + 1) & BufferedStream::BUFFER_SIZE_MASK) == readHead;
+    return readBuffer.full();
 }
 
 ALWAYS_INLINE bool BufferedStream::writeBufferFull()
 {
-    return ((writeTail + 1) & BufferedStream::BUFFER_SIZE_MASK) == writeHead;
+    return writeBuffer.full();
 }
 
 #endif //sblib_buffered_stream_h
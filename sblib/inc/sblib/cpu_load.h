@@ -0,0 +1,87 @@
+/*
+ *  cpu_load.h - Measure the CPU load and the duration of the main loop.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_cpu_load_h
+#define sblib_cpu_load_h
+
+#include <sblib/types.h>
+
+class Print;
+
+/**
+ * The length of the window the CPU load is averaged over, in milliseconds.
+ */
+#ifndef CPU_LOAD_WINDOW
+#  define CPU_LOAD_WINDOW 1000
+#endif
+
+/**
+ * The number of buckets of the loop duration histogram. Bucket 0 counts the
+ * iterations below 32 usec, bucket n the iterations from 2^(n+4) to
+ * 2^(n+5)-1 usec. The last bucket counts everything longer.
+ */
+#define CPU_LOAD_BUCKETS 16
+
+#ifdef CPU_LOAD
+/**
+ * Mark the start of a main loop iteration. Does nothing if CPU_LOAD is not
+ * defined. With CPU_LOAD defined, waitForInterrupt() also measures the time
+ * the processor sleeps.
+ */
+#  define CPU_LOAD_LOOP() cpuLoadLoop()
+#else
+#  define CPU_LOAD_LOOP()
+#endif
+
+/**
+ * Record the duration of the last main loop iteration and update the CPU load
+ * when the window is over. Use CPU_LOAD_LOOP() instead.
+ */
+void cpuLoadLoop();
+
+/**
+ * Sleep until an interrupt occurs and add the time slept to the idle time.
+ * Use waitForInterrupt() instead. Interrupts are disabled while the time is
+ * measured, the interrupt that wakes the processor up is handled afterwards.
+ * Call it with interrupts enabled.
+ */
+void cpuLoadWaitForInterrupt();
+
+/**
+ * @return The CPU load of the last window in percent: the time the processor
+ *         did not sleep in waitForInterrupt(). 0 until the first window is over.
+ */
+unsigned int cpuLoad();
+
+/**
+ * @return The longest main loop iteration in microseconds.
+ */
+unsigned int cpuLoadMaxLoopTime();
+
+/**
+ * Get the number of main loop iterations of a bucket of the histogram.
+ *
+ * @param bucket - the bucket, 0 .. CPU_LOAD_BUCKETS-1.
+ * @return The number of iterations.
+ */
+unsigned int cpuLoadLoopCount(int bucket);
+
+/**
+ * Clear the histogram, the maximum loop time and the CPU load.
+ */
+void cpuLoadReset();
+
+/**
+ * Print the CPU load, the maximum loop time and the non empty buckets of the
+ * histogram, one line per bucket: the range in microseconds and the number of
+ * iterations.
+ *
+ * @param out - the output, e.g. serial.
+ */
+void cpuLoadReport(Print& out);
+
+#endif /*sblib_cpu_load_h*/
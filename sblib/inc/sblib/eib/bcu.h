@@ -18,6 +18,8 @@
 #include <sblib/eib/user_memory.h>
 #include <sblib/utils.h>
 #include <sblib/mem_mapper.h>
+#include <sblib/eib/config_image.h>
+#include <sblib/eib/parameter_cache.h>
 #include <sblib/usr_callback.h>
 
 
@@ -50,6 +52,28 @@ public:
      */
     void setMemMapper(MemMapper *mapper);
 
+    /**
+     * Allow the bulk transfer of the configuration image, see class ConfigImage.
+     * Must be called before begin().
+     *
+     * @param image - a pointer to an instance of a ConfigImage object
+     */
+    void setConfigImage(ConfigImage *image);
+
+    /**
+     * @return The configuration image transfer, 0 if not used.
+     */
+    ConfigImage* getConfigImage() const;
+
+    /**
+     * Set the cache of the decoded application parameters. The parameters are decoded
+     * when begin() is called and when memory write telegrams change them.
+     * Must be called before begin().
+     *
+     * @param cache - a pointer to an instance of a ParameterCache object
+     */
+    void setParameterCache(ParameterCache *cache);
+
     /**
      * Set a callback class to notify the user program of some events
      */
@@ -126,6 +150,8 @@ protected:
 
 private:
     MemMapper *memMapper;
+    ConfigImage *configImage;
+    ParameterCache *parameterCache;
     UsrCallback *usrCallback;
     bool sendGrpTelEnabled;        //!< Sending of group telegrams is enabled. Usually set, but can be disabled.
     unsigned int groupTelWaitMillis;
@@ -145,6 +171,23 @@ inline int BCU::connectedTo()
 inline void BCU::setMemMapper(MemMapper *mapper)
 {
     memMapper = mapper;
+    setUserMemoryMapper(mapper);
+}
+
+inline void BCU::setConfigImage(ConfigImage *image)
+{
+    configImage = image;
+    setUserMemoryConfigImage(image);
+}
+
+inline ConfigImage* BCU::getConfigImage() const
+{
+    return configImage;
+}
+
+inline void BCU::setParameterCache(ParameterCache *cache)
+{
+    parameterCache = cache;
 }
 
 inline void BCU::setUsrCallback(UsrCallback *callback)
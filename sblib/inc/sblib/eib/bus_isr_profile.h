@@ -0,0 +1,136 @@
+/*
+ *  bus_isr_profile.h - Measure the execution time of the bus interrupt handler.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_bus_isr_profile_h
+#define sblib_bus_isr_profile_h
+
+#include <sblib/types.h>
+
+class Print;
+
+/**
+ * The number of states of the bus, see Bus::State.
+ */
+#define BUS_ISR_PROFILE_STATES 10
+
+/**
+ * The number of buckets of the histogram of the execution times. Bucket 0
+ * counts the calls below 32 cycles, bucket n the calls from 16 << n to
+ * (32 << n) - 1 cycles, the last bucket all longer calls.
+ */
+#define BUS_ISR_PROFILE_BUCKETS 8
+
+/**
+ * The default budget of one call of the interrupt handler in microseconds:
+ * a quarter of a bit time. The handler has to be finished before the next
+ * edge of a bit, and the main loop needs the rest of the time.
+ */
+#define BUS_ISR_PROFILE_DEFAULT_BUDGET 26
+
+/**
+ * The execution times of the bus interrupt handler in one state of the bus.
+ * The times are in clock cycles, or in the ticks of the clock that was set
+ * with busIsrProfileSetClock().
+ */
+struct BusIsrStateProfile
+{
+    unsigned int calls;         //!< The number of calls that started in this state
+    unsigned short minTime;     //!< The shortest call, 0 if there was no call
+    unsigned short maxTime;     //!< The longest call
+    unsigned short overruns;    //!< The number of calls that took longer than the budget
+    unsigned short histogram[BUS_ISR_PROFILE_BUCKETS]; //!< The calls by execution time
+};
+
+#ifdef BUS_ISR_PROFILE
+/**
+ * Start the measurement of a call of the bus interrupt handler.
+ * Does nothing if BUS_ISR_PROFILE is not defined.
+ *
+ * @param state - the state of the bus when the handler is called.
+ */
+#  define BUS_ISR_PROFILE_ENTER(state) busIsrProfileEnter(state)
+
+/**
+ * End the measurement of a call of the bus interrupt handler.
+ * Does nothing if BUS_ISR_PROFILE is not defined.
+ */
+#  define BUS_ISR_PROFILE_LEAVE() busIsrProfileLeave()
+#else
+#  define BUS_ISR_PROFILE_ENTER(state)
+#  define BUS_ISR_PROFILE_LEAVE()
+#endif
+
+/**
+ * Start the measurement of a call. Use BUS_ISR_PROFILE_ENTER() instead.
+ *
+ * @param state - the state of the bus, see Bus::State.
+ */
+void busIsrProfileEnter(int state);
+
+/**
+ * End the measurement of a call. Use BUS_ISR_PROFILE_LEAVE() instead.
+ */
+void busIsrProfileLeave();
+
+/**
+ * Get the execution times of the calls that started in a state of the bus.
+ *
+ * @param state - the state of the bus, see Bus::State.
+ * @return The execution times.
+ */
+const BusIsrStateProfile& busIsrProfile(int state);
+
+/**
+ * A clock for the measurement, it counts up.
+ */
+typedef unsigned int (*BusIsrProfileClock)();
+
+/**
+ * Set the clock for the measurement. The default is the system timer, which
+ * counts the clock cycles. The host tests count the register accesses of the
+ * peripheral emulation instead.
+ *
+ * @param clock - the clock, 0 for the system timer.
+ */
+void busIsrProfileSetClock(BusIsrProfileClock clock);
+
+/**
+ * Set the budget of one call of the interrupt handler.
+ *
+ * @param cycles - the budget in clock cycles.
+ */
+void busIsrProfileSetBudget(unsigned int cycles);
+
+/**
+ * @return The budget of one call of the interrupt handler in clock cycles.
+ */
+unsigned int busIsrProfileBudget();
+
+/**
+ * Test if a call of the interrupt handler took longer than the budget since
+ * the last call of busIsrProfileReset().
+ *
+ * @return True if the budget was exceeded.
+ */
+bool busIsrProfileAlarm();
+
+/**
+ * Clear the execution times of all states. The budget is not changed.
+ */
+void busIsrProfileReset();
+
+/**
+ * Print the execution times, one line per state that was measured: the name
+ * of the state, the number of calls, the shortest and the longest call in
+ * clock cycles, the share of the longest call in a bit time, the number of
+ * calls over the budget and the histogram.
+ *
+ * @param out - the output, e.g. serial.
+ */
+void busIsrProfileReport(Print& out);
+
+#endif /*sblib_bus_isr_profile_h*/
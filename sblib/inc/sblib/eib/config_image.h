@@ -0,0 +1,207 @@
+/*
+ *  config_image.h - Bulk transfer of the configuration image.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_config_image_h
+#define sblib_config_image_h
+
+#include <sblib/types.h>
+#include <sblib/platform.h>
+#include <sblib/eib/bcu_type.h>
+
+/**
+ * The default address of the configuration image window.
+ */
+#ifndef CONFIG_IMAGE_WINDOW
+#  define CONFIG_IMAGE_WINDOW 0xc000
+#endif
+
+/**
+ * The size of the control block at the start of the configuration image window.
+ */
+#define CONFIG_IMAGE_CTRL_SIZE 16
+
+/**
+ * The states of the configuration image transfer.
+ */
+enum ConfigImageState
+{
+    CIS_IDLE = 0,        //!< No transfer active
+    CIS_RECEIVING = 1,   //!< The image is being received
+    CIS_VERIFIED = 2,    //!< The image is complete and the CRC matches
+    CIS_ACTIVATING = 3,  //!< The image was copied to the user EEPROM which is not yet written
+    CIS_ERROR = 4        //!< The transfer failed, see ConfigImageError
+};
+
+/**
+ * The errors of the configuration image transfer.
+ */
+enum ConfigImageError
+{
+    CIE_OK = 0,          //!< No error
+    CIE_SEQUENCE = 1,    //!< Data was not written in sequence or without a begin command
+    CIE_LENGTH = 2,      //!< The image is incomplete
+    CIE_CRC = 3,         //!< The CRC of the image does not match
+    CIE_COMMAND = 4,     //!< Unknown command
+    CIE_FLASH = 5        //!< The staging area overlaps the application in flash
+};
+
+/**
+ * The commands that are written to the first byte of the control block.
+ */
+enum ConfigImageCommand
+{
+    CIC_BEGIN = 1,       //!< Begin a transfer: erases the staging area
+    CIC_COMMIT = 2,      //!< Verify the image. Followed by the CRC-32 of the image, MSB first
+    CIC_ABORT = 3        //!< Abort the transfer
+};
+
+/**
+ * Bulk transfer of a complete configuration image (the user EEPROM) into a staging
+ * area in flash, with CRC check and atomic activation.
+ *
+ * The image is transferred with memory write telegrams into a window of the user
+ * memory address space. The window starts with a control block of CONFIG_IMAGE_CTRL_SIZE
+ * bytes, followed by USER_EEPROM_SIZE bytes for the image:
+ *
+ * 1. Write CIC_BEGIN to the control block.
+ * 2. Write the image in ascending order. A write that is not in sequence is rejected,
+ *    so an interrupted transfer can be continued at the offset from the control block.
+ * 3. Write CIC_COMMIT and the CRC-32 of the image to the control block.
+ * 4. BCU1: the image is activated immediately. Other BCUs: the image is activated
+ *    when the application object receives "load completed". The load state of the
+ *    address table, association table and application object is then set to "loaded".
+ *
+ * Reading the control block returns: state (ConfigImageState), error (ConfigImageError),
+ * received bytes (16 bit, MSB first), image size (16 bit, MSB first).
+ *
+ * The staging area is the flash sector below the user EEPROM sector. The application
+ * must not use it: CIC_BEGIN fails with CIE_FLASH if the application image reaches
+ * into it. The request of the activation is recorded in the staging area.
+ * If the device is reset before the activated image is written to the user EEPROM,
+ * it is activated again by bcu.begin(). A verified image whose activation was not
+ * requested is not activated after a reset. A memory write to the user EEPROM discards
+ * a verified image that is not yet activated.
+ *
+ * Usage:
+ *     ConfigImage configImage;
+ *     bcu.setConfigImage(&configImage); // before bcu.begin()
+ */
+class ConfigImage
+{
+public:
+    /**
+     * Create a configuration image transfer.
+     *
+     * @param windowAddr - the 16 bit address of the window in the user memory address space.
+     */
+    ConfigImage(unsigned int windowAddr = CONFIG_IMAGE_WINDOW);
+
+    /**
+     * @return The first address of the window.
+     */
+    unsigned int windowStart() const;
+
+    /**
+     * @return The address after the window.
+     */
+    unsigned int windowEnd() const;
+
+    /**
+     * @return The state of the transfer, see ConfigImageState.
+     */
+    int state() const;
+
+    /**
+     * Read from the window.
+     *
+     * @param addr - the 16 bit address.
+     * @param data - the buffer that receives the data.
+     * @param count - the number of bytes to read.
+     * @return True on success.
+     */
+    bool read(int addr, byte* data, int count);
+
+    /**
+     * Write to the window.
+     *
+     * @param addr - the 16 bit address.
+     * @param data - the data to write.
+     * @param count - the number of bytes to write.
+     * @return True on success.
+     */
+    bool write(int addr, const byte* data, int count);
+
+    /**
+     * Activate a verified image: copy it to the user EEPROM. Called when the
+     * application object receives "load completed".
+     *
+     * @return False if a transfer is active but the image is not verified, else true.
+     */
+    bool activate();
+
+    /**
+     * Activate an image again whose activation was requested but interrupted
+     * by a reset. Called by bcu.begin().
+     */
+    void recover();
+
+    /**
+     * Mark the activation as finished. Called after the user EEPROM is written.
+     */
+    void eepromWritten();
+
+    /**
+     * Discard a verified image that is not yet activated. Called by userMemoryWrite()
+     * when the user EEPROM is written, as the activation would overwrite the write.
+     */
+    void discard();
+
+private:
+    void command(const byte* data, int count);
+    void programPage(int page);
+    void writeHeader(bool requested, bool activated);
+    void copyImage();
+    unsigned int stagingCrc(unsigned int length) const;
+    byte* stagingPtr() const;
+
+    unsigned int windowAddr;  //!< The start address of the window
+    unsigned int received;    //!< The number of bytes received
+    byte imageState;          //!< The state of the transfer, see ConfigImageState
+    byte error;               //!< The last error, see ConfigImageError
+    unsigned int crc;         //!< The CRC of the verified image
+    byte __attribute__ ((aligned (4))) buffer[FLASH_PAGE_SIZE]; //!< The page that is being received
+};
+
+
+//
+//  Inline functions
+//
+
+inline unsigned int ConfigImage::windowStart() const
+{
+    return windowAddr;
+}
+
+inline unsigned int ConfigImage::windowEnd() const
+{
+    return windowAddr + CONFIG_IMAGE_CTRL_SIZE + USER_EEPROM_SIZE;
+}
+
+inline int ConfigImage::state() const
+{
+    return imageState;
+}
+
+#ifdef IAP_EMULATION
+/**
+ * The host has no linker symbols of the application: the end of the application
+ * image in flash, as offset from the flash base, for the CIC_BEGIN check.
+ */
+extern unsigned int emuImageEnd;
+#endif
+
+#endif /*sblib_config_image_h*/
@@ -0,0 +1,142 @@
+/*
+ *  parameter_cache.h - Decoded application parameters.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_parameter_cache_h
+#define sblib_parameter_cache_h
+
+#include <sblib/types.h>
+#include <stddef.h>
+
+/**
+ * The description of a parameter field in the user memory.
+ *
+ * The field is read big endian, like all KNX data. It starts bitOffset bits after the
+ * most significant bit of the byte at addr and is bits long. bitOffset + bits must not
+ * exceed 32. The raw value is multiplied with factor and divided by divisor.
+ */
+struct ParameterDesc
+{
+    word addr;           //!< The address of the parameter in the user memory
+    byte bitOffset;      //!< The offset of the field in bits, 0..7, counted from the MSB
+    byte bits;           //!< The size of the field in bits, 1..32
+    short factor;        //!< The raw value is multiplied with the factor..
+    short divisor;       //!< ..and divided by the divisor
+    word valueOffset;    //!< The offset of the decoded value in the parameter struct
+    byte valueSize;      //!< The size of the decoded value in the parameter struct: 1, 2 or 4
+};
+
+/**
+ * Describe a parameter field.
+ *
+ * @param addr - the address of the parameter in the user memory.
+ * @param bitOffset - the offset of the field in bits, counted from the MSB.
+ * @param bits - the size of the field in bits.
+ * @param factor - the raw value is multiplied with the factor..
+ * @param divisor - ..and divided by the divisor
+ * @param type - the type of the parameter struct.
+ * @param field - the field of the parameter struct that receives the value.
+ */
+#define PARAMETER(addr, bitOffset, bits, factor, divisor, type, field) \
+    { addr, bitOffset, bits, factor, divisor, offsetof(type, field), sizeof(((type*) 0)->field) }
+
+/**
+ * Decoded application parameters that are cached in RAM.
+ *
+ * The application describes its parameters with a table of ParameterDesc and gets
+ * a struct with the decoded values. When memory write telegrams change the user memory,
+ * only the parameters of the changed range are decoded again. This is done when the
+ * connection is closed. The callback is called for every parameter whose value changed,
+ * also for the initial values when bcu.begin() is called.
+ *
+ * Example:
+ *     struct Params { byte mode; bool invert; unsigned short delayMs; };
+ *     static const ParameterDesc paramDescs[] =
+ *     {
+ *         PARAMETER(0x4400, 0, 4, 1, 1, Params, mode),
+ *         PARAMETER(0x4400, 4, 1, 1, 1, Params, invert),
+ *         PARAMETER(0x4401, 0, 16, 100, 1, Params, delayMs)
+ *     };
+ *     Params params;
+ *     ParameterCache paramCache(paramDescs, 3, &params, paramChanged);
+ *
+ *     bcu.setParameterCache(&paramCache); // before bcu.begin()
+ */
+class ParameterCache
+{
+public:
+    /**
+     * The type of the callback that is called when a parameter changed.
+     *
+     * @param index - the index of the parameter in the descriptor table.
+     */
+    typedef void (*ChangedCallback)(int index);
+
+    /**
+     * Create a parameter cache.
+     *
+     * @param descs - the parameter descriptors.
+     * @param count - the number of parameter descriptors.
+     * @param values - the struct that receives the decoded values.
+     * @param changed - the callback that is called when a parameter changed, may be 0.
+     */
+    ParameterCache(const ParameterDesc* descs, int count, void* values, ChangedCallback changed = 0);
+
+    /**
+     * Mark a range of the user memory as changed.
+     *
+     * @param addr - the address of the changed range.
+     * @param count - the number of bytes that changed.
+     */
+    void markDirty(int addr, int count);
+
+    /**
+     * Mark all parameters as changed.
+     */
+    void markAllDirty();
+
+    /**
+     * Test if there are changed parameters that are not decoded yet.
+     */
+    bool isDirty() const;
+
+    /**
+     * Decode the parameters of the changed range and call the callback for every
+     * parameter whose value changed.
+     *
+     * @param all - call the callback for every decoded parameter, also if its value
+     *              did not change. Used by bcu.begin() for the initial values.
+     */
+    void update(bool all = false);
+
+    /**
+     * Decode a parameter from the user memory.
+     *
+     * @param index - the index of the parameter in the descriptor table.
+     * @return The decoded value.
+     */
+    int decode(int index) const;
+
+private:
+    const ParameterDesc* descs;  //!< The parameter descriptors
+    int count;                   //!< The number of parameter descriptors
+    byte* values;                //!< The decoded values
+    ChangedCallback changed;     //!< The callback for changed parameters
+    unsigned int dirtyStart;     //!< The start of the changed range
+    unsigned int dirtyEnd;       //!< The end of the changed range, equal to dirtyStart if none
+};
+
+
+//
+//  Inline functions
+//
+
+inline bool ParameterCache::isDirty() const
+{
+    return dirtyStart != dirtyEnd;
+}
+
+#endif /*sblib_parameter_cache_h*/
@@ -0,0 +1,108 @@
+/*
+ *  telegram_latency.h - Measure the latency of the stages of a telegram.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_telegram_latency_h
+#define sblib_telegram_latency_h
+
+#include <sblib/types.h>
+
+class Print;
+
+/**
+ * The stages in the life of a telegram.
+ */
+enum LatencyStage
+{
+    LATENCY_RECEIVED,    //!< The bus interrupt handler received a telegram for us
+    LATENCY_PROCESSED,   //!< The BCU starts processing the received telegram
+    LATENCY_QUEUED,      //!< A telegram was passed to Bus::sendTelegram()
+    LATENCY_ON_WIRE,     //!< The start bit of the current telegram to send is on the bus
+    LATENCY_ACKED,       //!< The current telegram to send was acknowledged
+    LATENCY_FINISHED     //!< The current telegram to send is done, acknowledged or not
+};
+
+/**
+ * The latencies between the stages that are measured.
+ *
+ * The time from processing a received telegram to queuing a telegram is
+ * measured for the first telegram that is queued after processing, before
+ * the next telegram is received: the response of the BCU, e.g. a T_ACK, or
+ * the response of the application.
+ * The time until the telegram is on the bus and acknowledged is measured from
+ * the first transmission, repeats included.
+ */
+enum LatencyInterval
+{
+    LATENCY_RX_PROCESSED,     //!< From receiving to processing a telegram
+    LATENCY_PROCESSED_QUEUED, //!< From processing a telegram to queuing the response
+    LATENCY_QUEUED_ON_WIRE,   //!< From queuing to sending a telegram
+    LATENCY_ON_WIRE_ACK,      //!< From sending to acknowledging a telegram
+    LATENCY_INTERVALS         //!< The number of intervals
+};
+
+/**
+ * The number of buckets of the latency histograms. Bucket 0 counts the
+ * latencies below 64 usec, then there are two buckets per power of two up to
+ * 4 seconds. The last bucket counts everything longer.
+ */
+#define LATENCY_BUCKETS 34
+
+#ifdef TELEGRAM_LATENCY
+/**
+ * Mark a stage of a telegram. Does nothing if TELEGRAM_LATENCY is not defined.
+ *
+ * @param stage - the stage, see enum LatencyStage.
+ */
+#  define TELEGRAM_LATENCY_MARK(stage) telegramLatencyMark(stage)
+#else
+#  define TELEGRAM_LATENCY_MARK(stage)
+#endif
+
+/**
+ * Record the time of a stage. Use TELEGRAM_LATENCY_MARK() instead.
+ *
+ * @param stage - the stage, see enum LatencyStage.
+ */
+void telegramLatencyMark(int stage);
+
+/**
+ * @param interval - the interval, see enum LatencyInterval.
+ * @return The number of telegrams that were measured.
+ */
+unsigned int telegramLatencyCount(int interval);
+
+/**
+ * Get a percentile of the latency. The latency is rounded up to the end of
+ * the bucket of the histogram, but not above the maximum.
+ *
+ * @param interval - the interval, see enum LatencyInterval.
+ * @param percent - the percentile, e.g. 50 for the median.
+ * @return The latency in microseconds, 0 if there was no telegram.
+ */
+unsigned int telegramLatencyPercentile(int interval, int percent);
+
+/**
+ * @param interval - the interval, see enum LatencyInterval.
+ * @return The maximum latency in microseconds.
+ */
+unsigned int telegramLatencyMax(int interval);
+
+/**
+ * Clear the latencies of all intervals. The telegrams that are in progress
+ * are not measured.
+ */
+void telegramLatencyReset();
+
+/**
+ * Print the latencies, one line per interval: the name of the interval, the
+ * number of telegrams, p50, p99 and the maximum in microseconds.
+ *
+ * @param out - the output, e.g. serial.
+ */
+void telegramLatencyReport(Print& out);
+
+#endif /*sblib_telegram_latency_h*/
@@ -15,6 +15,8 @@
 
 class UserRam;
 class UserEeprom;
+class MemMapper;
+class ConfigImage;
 
 
 /**
@@ -38,14 +40,69 @@ extern UserEeprom& userEeprom;
 extern byte userEepromData[USER_EEPROM_SIZE];
 
 /**
- * Get a pointer to a user RAM or EEPROM location. This function translates from
- * BCU addresses to native addresses.
+ * Get a pointer to a user memory location. This function translates from
+ * BCU addresses to native addresses. The address is resolved in constant time
+ * with a page map, see userMemoryRead().
+ *
+ * The tables of the BCU are accessed linearly through this pointer, so only the
+ * user RAM and the user EEPROM are resolved. Memory of the memory mapper is only
+ * contiguous within a page of 256 bytes, use userMemoryRead() for it.
  *
  * @param addr - the 16bit BCU address into user RAM or EEPROM.
- * @return A pointer to the memory location.
+ * @return A pointer to the memory location, 0 if the address is not in the user RAM
+ *         or EEPROM.
  */
 byte* userMemoryPtr(int addr);
 
+/**
+ * Read a block from the user memory address space. The address space consists of
+ * the user RAM, the user EEPROM, the load state of the system interface objects
+ * (BIM112 only) and all addresses that are mapped by the memory mapper.
+ * User RAM and user EEPROM take precedence over the memory mapper.
+ *
+ * @param addr - the 16bit BCU address of the block.
+ * @param data - the buffer that receives the data.
+ * @param count - the number of bytes to read.
+ * @return True if the whole block is readable, false if not. In this case the
+ *         buffer is filled with zeros.
+ */
+bool userMemoryRead(int addr, byte* data, int count);
+
+/**
+ * Write a block to the user memory address space. Writing to the user EEPROM
+ * marks the EEPROM as modified.
+ *
+ * @param addr - the 16bit BCU address of the block.
+ * @param data - the data to write.
+ * @param count - the number of bytes to write.
+ * @return True if the whole block was written, false if the block is not
+ *         writable.
+ */
+bool userMemoryWrite(int addr, const byte* data, int count);
+
+/**
+ * Set the memory mapper that provides the memory that is neither user RAM nor
+ * user EEPROM. Called by BCU::setMemMapper().
+ *
+ * @param mapper - the memory mapper, 0 to disable.
+ */
+void setUserMemoryMapper(MemMapper* mapper);
+
+/**
+ * Set the configuration image transfer whose window is mapped into the user memory
+ * address space. Called by BCU::setConfigImage().
+ *
+ * @param image - the configuration image transfer, 0 to disable.
+ */
+void setUserMemoryConfigImage(ConfigImage* image);
+
+/**
+ * Set the start address of the user RAM.
+ *
+ * @param addr - the 16bit BCU address of the user RAM.
+ */
+void setUserRamStart(int addr);
+
 
 /**
  * The user RAM.
@@ -283,24 +340,6 @@ inline bool UserEeprom::isModified() const
     return userEepromModified;
 }
 
-inline byte* userMemoryPtr(int addr)
-{
-    extern int userRamStart;
-
-    if (addr >= USER_EEPROM_START && addr < USER_EEPROM_END)
-        return userEepromData + (addr - USER_EEPROM_START);
-    else if (addr >= userRamStart && addr < (userRamStart + USER_RAM_SIZE))
-        return userRamData + (addr - userRamStart);
-    return 0;
-}
-
-inline void setUserRamStart(int addr)
-{
-    extern int userRamStart;
-
-    userRamStart = addr;
-}
-
 inline int getUserRamStart(void)
 {
     extern int userRamStart;
@@ -92,8 +92,18 @@ IAP_Status iapReadUID(byte* uid);
 IAP_Status iapReadPartID(unsigned int* partId);
 
 /**
- * Get the size of the flash memory. This is done by probing the flash sectors
- * until an error is encountered.
+ * Get the flash size of a part from its part ID.
+ * See the LPC111x user manual UM10398, chapter "Read Part Identification number".
+ *
+ * @param partId - the part ID, see iapReadPartID().
+ * @return The flash size in bytes, 0 if unknown.
+ */
+int iapFlashSizeOfPartId(unsigned int partId);
+
+/**
+ * Get the size of the flash memory. The size is IAP_FLASH_SIZE if defined, else
+ * it is derived from the part ID. Only for unknown parts the flash sectors are
+ * probed until an error is encountered.
  *
  * @return the size of the flash memory.
  */
@@ -13,6 +13,10 @@
 #include <sblib/platform.h>
 #include <sblib/types.h>
 
+#ifdef CPU_LOAD
+#  include <sblib/cpu_load.h>
+#endif
+
 /**
  * Interrupt handlers have fixed names. You need to give your interrupt handler the
  * correct name, then it is used automatically when it's interrupt is enabled. The
@@ -53,6 +57,7 @@ void interrupts();
 
 /**
  * Wait for an interrupt. Puts the processor to sleep until an interrupt occurs.
+ * With CPU_LOAD defined, the time slept is measured, see cpu_load.h
  */
 void waitForInterrupt();
 
@@ -111,7 +116,11 @@ ALWAYS_INLINE void interrupts()
 
 ALWAYS_INLINE void waitForInterrupt()
 {
+#ifdef CPU_LOAD
+    cpuLoadWaitForInterrupt();
+#else
     __WFI();
+#endif
 }
 
 ALWAYS_INLINE void enableInterrupt(IRQn_Type interruptType)
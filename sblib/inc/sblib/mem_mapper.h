@@ -14,6 +14,7 @@
 #define SBLIB_MEM_MAPPER_H_
 
 #include <sblib/platform.h>
+#include <sblib/types.h>
 
 #define MEM_MAPPER_SUCCESS         0
 #define MEM_MAPPER_INVALID_ADDRESS -1
@@ -21,6 +22,16 @@
 #define MEM_MAPPER_OUT_OF_MEMORY   -4
 #define MEM_MAPPER_INVALID_LENGTH  -8
 
+/**
+ * Number of 32 bit value slots of the log range, see MemMapper::addLogRange().
+ */
+#ifndef MEM_MAPPER_LOG_SLOTS
+#  define MEM_MAPPER_LOG_SLOTS     16
+#endif
+#if MEM_MAPPER_LOG_SLOTS > 31
+#  error "MEM_MAPPER_LOG_SLOTS must fit into one flash page of records"
+#endif
+
 class MemMapper
 {
 public:
@@ -90,6 +101,28 @@ public:
      */
     int addRange(int virtAddress, int length);
 
+    /**
+     * Add a log structured range for values that change often, e.g. counters or
+     * operating hours. The first MEM_MAPPER_LOG_SLOTS * 4 bytes of the range can
+     * be accessed like any other mapped memory. Every write appends a small record
+     * (slot, check byte, value) to the active flash page with one program operation
+     * instead of an erase cycle. The current values are kept in RAM. A flash page is
+     * only erased when the active page is full: then the next page of the range is
+     * erased and all current values are compacted into it.
+     *
+     * Appending relies on the flash accepting a second program operation of a page
+     * where only erased bytes change. The records are written immediately, so the
+     * application should not update them while a telegram is being received.
+     *
+     * Only one log range per MemMapper is supported. Call this method on every
+     * startup, like addRange(), to restore the values.
+     *
+     * @param virtAddress - a page aligned 16 bit virtual address
+     * @param length - the size of the range, at least two pages
+     * @return 0 on success, else error
+     */
+    int addLogRange(int virtAddress, int length = 2 * FLASH_PAGE_SIZE);
+
     /**
      * Force writing all pending data to flash
      *
@@ -164,6 +197,11 @@ public:
     /**
      * Access the user EEPROM as a pointer
      *
+     * For an address of the log range the pointer points to the copy of the
+     * values in RAM. It is only valid for reading: a write through it is not
+     * appended to the log and is lost on the next reset. Use writeMem() or
+     * setUInt32() to change the values of the log range.
+     *
      * @param virtAddresss - the virtual address of the data block.
      * @param forceFlash - force pending data to be flashed before operation
      * @return a pointer to the desired data
@@ -183,6 +221,12 @@ private:
     int getFlashPageNum(int virtAddress) const;
     unsigned int getUIntX(int virtAddress, int length);
     int setUIntX(int virtAddress, int length, int val);
+    int reservePage();
+    bool isLogAddress(int virtAddress) const;
+    int logWrite(int virtAddress, const byte *data, int length);
+    int logAppend(int slot);
+    int logCompact();
+    byte* logPagePtr(int page) const;
 
     unsigned int flashBase; //memory layout: flashBase + 0 = allocTable, flashBase + 1 = usableMemory
     unsigned int flashBasePage;
@@ -201,6 +245,14 @@ private:
     bool autoAddPage;
     mutable bool flashMemModified;
     mutable bool allocTableModified;
+
+    int logVirtPage;        //!< The virtual page of the log range
+    int logPages;           //!< The number of flash pages of the log range, 0 if unused
+    int logActive;          //!< The active page of the log range, -1 if none
+    int logOffset;          //!< The offset of the next free record in the active page
+    unsigned int logSequence; //!< The sequence number of the active page
+    unsigned int logValid;  //!< Bit mask of the slots that have a value
+    mutable byte logData[MEM_MAPPER_LOG_SLOTS * 4]; //!< The current values of the slots
 };
 
 #endif /* SBLIB_MEM_MAPPER_H_ */
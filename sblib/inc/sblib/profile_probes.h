@@ -0,0 +1,114 @@
+/*
+ *  profile_probes.h - Record the time spent in the hot paths of the main loop.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_profile_probes_h
+#define sblib_profile_probes_h
+
+#include <sblib/types.h>
+
+class Print;
+
+/**
+ * The number of events in the ring buffer of the profiling probes.
+ * Older events are overwritten.
+ */
+#ifndef PROFILE_BUFFER_SIZE
+#  define PROFILE_BUFFER_SIZE 32
+#endif
+
+/**
+ * The profiling probes of the library. The application can use its own
+ * probes from PROBE_USER on.
+ */
+enum ProfileProbeId
+{
+    PROBE_BCU_LOOP,            //!< BCU::loop()
+    PROBE_PROCESS_TELEGRAM,    //!< BCU::processTelegram()
+    PROBE_WRITE_USER_EEPROM,   //!< writeUserEeprom()
+    PROBE_MEM_MAPPER_FLASH,    //!< MemMapper::doFlash()
+    PROBE_DS18X20,             //!< DS18x20::readTemperature()
+    PROBE_DHT,                 //!< DHT::readData()
+    PROBE_BH1750,              //!< BH1750::GetLux()
+    PROBE_DS3231,              //!< Ds3231::GetTime()
+    PROBE_USER = 16,           //!< The first probe of the application
+    PROBE_MAX = 32             //!< The number of probes
+};
+
+/**
+ * An event of the profiling probes.
+ */
+struct ProfileEvent
+{
+    unsigned int time;         //!< The time in microseconds, see micros()
+    byte probe;                //!< The probe, see enum ProfileProbeId
+    bool exit;                 //!< True when the probe was left, false when it was entered
+};
+
+#ifdef PROFILE_PROBES
+/**
+ * Record the time of entering and leaving the current scope: the enter event
+ * is recorded here, the exit event at the end of the scope. Use it only in the
+ * main loop, not in interrupt handlers.
+ * Does nothing if PROFILE_PROBES is not defined.
+ *
+ * @param probe - the probe, see enum ProfileProbeId.
+ */
+#  define PROFILE_PROBE(probe) ProfileProbe _profileProbe(probe)
+#else
+#  define PROFILE_PROBE(probe)
+#endif
+
+/**
+ * Record an event in the ring buffer. Use PROFILE_PROBE() instead.
+ *
+ * @param probe - the probe, see enum ProfileProbeId.
+ * @param exit - true when the probe is left, false when it is entered.
+ */
+void profileRecord(int probe, bool exit);
+
+/**
+ * @return The number of events in the ring buffer.
+ */
+int profileEventCount();
+
+/**
+ * Get an event of the ring buffer.
+ *
+ * @param index - the index of the event, 0 is the oldest event.
+ * @return The event.
+ */
+const ProfileEvent& profileEvent(int index);
+
+/**
+ * Clear the ring buffer.
+ */
+void profileClear();
+
+/**
+ * Print the events of the ring buffer, oldest first, one line per event: the
+ * time in microseconds, the name or the number of the probe, ">" for entering
+ * and "<" for leaving. When the matching enter event is still in the buffer,
+ * the duration in microseconds is printed too.
+ *
+ * @param out - the output, e.g. serial.
+ */
+void profileDump(Print& out);
+
+/**
+ * A profiling probe, see PROFILE_PROBE().
+ */
+class ProfileProbe
+{
+public:
+    ProfileProbe(int probe) : probe(probe) { profileRecord(probe, false); }
+    ~ProfileProbe() { profileRecord(probe, true); }
+
+private:
+    int probe;
+};
+
+#endif /*sblib_profile_probes_h*/
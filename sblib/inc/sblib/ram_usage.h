@@ -0,0 +1,139 @@
+/*
+ *  ram_usage.h - Measure the stack usage and the fill level of the buffers.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_ram_usage_h
+#define sblib_ram_usage_h
+
+#include <sblib/types.h>
+
+class Print;
+
+/**
+ * The value that the unused stack is painted with.
+ */
+#define STACK_PAINT 0xdeadbeef
+
+/**
+ * The buffers whose fill level is measured. The application can register its
+ * own buffers from RAM_BUFFER_USER on.
+ *
+ * The ring buffer of the profiling probes overwrites its oldest events when it
+ * is full, so a peak of its size means that events were lost.
+ *
+ * The page buffers of ConfigImage and MemMapper are not listed: they hold a
+ * whole flash page whenever they are used, so they have no fill level. Their
+ * size is FLASH_PAGE_SIZE each.
+ */
+enum RamBufferId
+{
+    RAM_SERIAL_RX,          //!< The read buffer of the serial port
+    RAM_SERIAL_TX,          //!< The write buffer of the serial port
+    RAM_BUS_SEND_QUEUE,     //!< The send queue of the bus, in telegrams
+    RAM_PROFILE_EVENTS,     //!< The ring buffer of the profiling probes, in events
+    RAM_BUFFER_USER = 8,    //!< The first buffer of the application
+    RAM_BUFFER_MAX = 16     //!< The number of buffers
+};
+
+#ifdef RAM_USAGE
+/**
+ * Paint the unused stack. Does nothing if RAM_USAGE is not defined.
+ */
+#  define RAM_USAGE_PAINT_STACK() stackPaint()
+
+/**
+ * Register a buffer. Does nothing if RAM_USAGE is not defined.
+ *
+ * @param id - the buffer, see enum RamBufferId.
+ * @param name - the name of the buffer for the report.
+ * @param size - the size of the buffer.
+ */
+#  define RAM_USAGE_REGISTER(id, name, size) ramUsageRegister(id, name, size)
+
+/**
+ * Record the current fill level of a buffer. Can be used in interrupt handlers.
+ * Does nothing if RAM_USAGE is not defined.
+ *
+ * @param id - the buffer, see enum RamBufferId.
+ * @param level - the fill level, in the unit of the size of the buffer.
+ */
+#  define RAM_USAGE_FILL(id, level) ramUsageFill(id, level)
+#else
+#  define RAM_USAGE_PAINT_STACK()
+#  define RAM_USAGE_REGISTER(id, name, size)
+#  define RAM_USAGE_FILL(id, level)
+#endif
+
+#ifdef IAP_EMULATION
+/**
+ * The number of words of the emulated stack.
+ */
+#  define EMU_STACK_WORDS 512
+
+/**
+ * The host has no stack of the processor: this array stands in for the RAM
+ * between the static data and the top of the stack.
+ */
+extern unsigned int emuStack[EMU_STACK_WORDS];
+#endif
+
+/**
+ * Paint the stack below the current stack pointer with STACK_PAINT.
+ * Use RAM_USAGE_PAINT_STACK() instead, as early as possible in main().
+ */
+void stackPaint();
+
+/**
+ * @return The size of the stack in bytes: the RAM between the static data
+ *         and the top of the stack.
+ */
+unsigned int stackSize();
+
+/**
+ * Get the high water mark of the stack: the stack that was used since it
+ * was painted. This scans the stack, do not call it in interrupt handlers.
+ *
+ * @return The used stack in bytes.
+ */
+unsigned int stackHighWater();
+
+/**
+ * Register a buffer. Use RAM_USAGE_REGISTER() instead.
+ *
+ * @param id - the buffer, see enum RamBufferId.
+ * @param name - the name of the buffer for the report.
+ * @param size - the size of the buffer.
+ */
+void ramUsageRegister(int id, const char* name, unsigned int size);
+
+/**
+ * Record the fill level of a buffer. Use RAM_USAGE_FILL() instead.
+ *
+ * @param id - the buffer, see enum RamBufferId.
+ * @param level - the fill level.
+ */
+void ramUsageFill(int id, unsigned int level);
+
+/**
+ * @param id - the buffer, see enum RamBufferId.
+ * @return The highest fill level of the buffer.
+ */
+unsigned int ramUsagePeak(int id);
+
+/**
+ * Clear the highest fill levels of all buffers.
+ */
+void ramUsageReset();
+
+/**
+ * Print the stack usage and the registered buffers, one line per buffer:
+ * the name, the highest fill level and the size.
+ *
+ * @param out - the output, e.g. serial.
+ */
+void ramUsageReport(Print& out);
+
+#endif /*sblib_ram_usage_h*/
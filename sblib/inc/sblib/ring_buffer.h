@@ -0,0 +1,319 @@
+/*
+ *  ring_buffer.h - A ring buffer for one producer and one consumer.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+#ifndef sblib_ring_buffer_h
+#define sblib_ring_buffer_h
+
+#include <sblib/types.h>
+
+#include <string.h>
+
+/**
+ * Keep the compiler from moving memory accesses across this point. The
+ * Cortex-M0 executes in order and has no data cache, so this is all the
+ * ordering that an interrupt handler and the main loop need.
+ */
+#define RING_BUFFER_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/**
+ * A ring buffer for one producer and one consumer, e.g. an interrupt handler
+ * and the main loop. The producer only calls the push functions, the consumer
+ * only the pop functions, then no locking is required. The producer writes
+ * the elements before it publishes them by advancing the write index, the
+ * consumer reads the elements before it frees them by advancing the read index.
+ *
+ * The indexes run freely and are masked on access, so all N elements can be
+ * used. The elements are copied with memcpy().
+ *
+ * @param T - the type of the elements.
+ * @param N - the number of elements, a power of two.
+ */
+template <typename T, int N>
+class RingBuffer
+{
+public:
+    RingBuffer();
+
+    /**
+     * Remove all elements. Neither the producer nor the consumer may use the
+     * buffer meanwhile.
+     */
+    void clear();
+
+    /**
+     * @return The number of elements in the buffer.
+     */
+    int count() const;
+
+    /**
+     * @return The number of elements that can be pushed.
+     */
+    int space() const;
+
+    /**
+     * @return True if the buffer is empty.
+     */
+    bool empty() const;
+
+    /**
+     * @return True if the buffer is full.
+     */
+    bool full() const;
+
+    /**
+     * @return The number of elements the buffer can hold.
+     */
+    static int size();
+
+    /**
+     * Push an element. Producer only.
+     *
+     * @param item - the element.
+     * @return True if the element was pushed, false if the buffer is full.
+     */
+    bool push(const T& item);
+
+    /**
+     * Push as many elements as fit into the buffer. Producer only.
+     *
+     * @param data - the elements.
+     * @param count - the number of elements.
+     * @return The number of elements that were pushed.
+     */
+    int push(const T* data, int count);
+
+    /**
+     * Get the oldest element without removing it. Consumer only.
+     * The buffer must not be empty.
+     *
+     * @return The oldest element.
+     */
+    const T& peek() const;
+
+    /**
+     * Pop the oldest element. Consumer only.
+     *
+     * @param item - the element is stored here.
+     * @return True if an element was popped, false if the buffer is empty.
+     */
+    bool pop(T& item);
+
+    /**
+     * Pop up to count elements. Consumer only.
+     *
+     * @param data - the elements are stored here.
+     * @param count - the maximum number of elements.
+     * @return The number of elements that were popped.
+     */
+    int pop(T* data, int count);
+
+    /**
+     * Get the free elements up to the end of the buffer, for filling them in
+     * place. Make them available with commit(). Producer only.
+     *
+     * @param length - the number of contiguous free elements is stored here.
+     * @return The first free element.
+     */
+    T* writeSpan(int& length);
+
+    /**
+     * Make elements that were filled with writeSpan() available. Producer only.
+     *
+     * @param count - the number of elements, at most the length of the span.
+     */
+    void commit(int count);
+
+    /**
+     * Get the elements up to the end of the buffer, for reading them in place.
+     * Free them with consume(). Consumer only.
+     *
+     * @param length - the number of contiguous elements is stored here.
+     * @return The oldest element.
+     */
+    const T* readSpan(int& length);
+
+    /**
+     * Free elements that were read with readSpan(). Consumer only.
+     *
+     * @param count - the number of elements, at most the length of the span.
+     */
+    void consume(int count);
+
+private:
+    enum { MASK = N - 1 };
+
+    // Fails to compile if N is not a power of two
+    typedef char sizeIsPowerOfTwo[(N > 0 && (N & (N - 1)) == 0) ? 1 : -1];
+
+    volatile unsigned int writeIndex;  //!< Advanced by the producer
+    volatile unsigned int readIndex;   //!< Advanced by the consumer
+    T items[N];
+};
+
+
+//
+//  Inline functions
+//
+
+template <typename T, int N>
+inline RingBuffer<T, N>::RingBuffer()
+    : writeIndex(0)
+    , readIndex(0)
+{
+}
+
+template <typename T, int N>
+inline void RingBuffer<T, N>::clear()
+{
+    writeIndex = 0;
+    readIndex = 0;
+}
+
+template <typename T, int N>
+ALWAYS_INLINE int RingBuffer<T, N>::count() const
+{
+    return writeIndex - readIndex;
+}
+
+template <typename T, int N>
+ALWAYS_INLINE int RingBuffer<T, N>::space() const
+{
+    return N - (writeIndex - readIndex);
+}
+
+template <typename T, int N>
+ALWAYS_INLINE bool RingBuffer<T, N>::empty() const
+{
+    return writeIndex == readIndex;
+}
+
+template <typename T, int N>
+ALWAYS_INLINE bool RingBuffer<T, N>::full() const
+{
+    return writeIndex - readIndex == N;
+}
+
+template <typename T, int N>
+ALWAYS_INLINE int RingBuffer<T, N>::size()
+{
+    return N;
+}
+
+template <typename T, int N>
+inline bool RingBuffer<T, N>::push(const T& item)
+{
+    unsigned int index = writeIndex;
+    if (index - readIndex == N)
+        return false;
+
+    items[index & MASK] = item;
+    RING_BUFFER_BARRIER();
+    writeIndex = index + 1;
+    return true;
+}
+
+template <typename T, int N>
+int RingBuffer<T, N>::push(const T* data, int count)
+{
+    int pushed = 0;
+
+    // Up to two spans, the second one when the buffer wraps around
+    for (int span = 0; span < 2 && pushed < count; ++span)
+    {
+        int length;
+        T* dest = writeSpan(length);
+        if (length > count - pushed)
+            length = count - pushed;
+        if (!length)
+            break;
+
+        memcpy(dest, data + pushed, length * sizeof(T));
+        commit(length);
+        pushed += length;
+    }
+    return pushed;
+}
+
+template <typename T, int N>
+ALWAYS_INLINE const T& RingBuffer<T, N>::peek() const
+{
+    return items[readIndex & MASK];
+}
+
+template <typename T, int N>
+inline bool RingBuffer<T, N>::pop(T& item)
+{
+    unsigned int index = readIndex;
+    if (index == writeIndex)
+        return false;
+
+    RING_BUFFER_BARRIER();
+    item = items[index & MASK];
+    RING_BUFFER_BARRIER();
+    readIndex = index + 1;
+    return true;
+}
+
+template <typename T, int N>
+int RingBuffer<T, N>::pop(T* data, int count)
+{
+    int popped = 0;
+
+    for (int span = 0; span < 2 && popped < count; ++span)
+    {
+        int length;
+        const T* src = readSpan(length);
+        if (length > count - popped)
+            length = count - popped;
+        if (!length)
+            break;
+
+        memcpy(data + popped, src, length * sizeof(T));
+        consume(length);
+        popped += length;
+    }
+    return popped;
+}
+
+template <typename T, int N>
+inline T* RingBuffer<T, N>::writeSpan(int& length)
+{
+    unsigned int index = writeIndex;
+    int unused = N - (index - readIndex);
+    int toEnd = N - (index & MASK);
+
+    length = unused < toEnd ? unused : toEnd;
+    return items + (index & MASK);
+}
+
+template <typename T, int N>
+inline void RingBuffer<T, N>::commit(int count)
+{
+    RING_BUFFER_BARRIER();
+    writeIndex = writeIndex + count;
+}
+
+template <typename T, int N>
+inline const T* RingBuffer<T, N>::readSpan(int& length)
+{
+    unsigned int index = readIndex;
+    int used = writeIndex - index;
+    int toEnd = N - (index & MASK);
+
+    length = used < toEnd ? used : toEnd;
+    RING_BUFFER_BARRIER();
+    return items + (index & MASK);
+}
+
+template <typename T, int N>
+inline void RingBuffer<T, N>::consume(int count)
+{
+    RING_BUFFER_BARRIER();
+    readIndex = readIndex + count;
+}
+
+#endif /*sblib_ring_buffer_h*/
@@ -122,7 +122,31 @@ public:
     virtual int write(byte ch);
 
     /**
-     * Wait until all bytes are written.
+     * Write some bytes. The bytes are copied into the write buffer as a block.
+     * Waits until all bytes fit into the write buffer.
+     *
+     * @param data - the bytes to write.
+     * @param count - the number of bytes to write.
+     * @return The number of bytes that were written.
+     */
+    virtual int write(const byte* data, int count);
+
+    /**
+     * Write as many bytes as fit into the write buffer, without waiting.
+     *
+     * @param data - the bytes to write.
+     * @param count - the number of bytes to write.
+     * @return The number of bytes that were written, 0 if the write buffer is full.
+     */
+    int tryWrite(const byte* data, int count);
+
+    /**
+     * @return The number of bytes that can be written without waiting.
+     */
+    int availableForWrite();
+
+    /**
+     * Wait until all bytes are sent.
      */
     virtual void flush();
 
@@ -141,6 +165,12 @@ protected:
      * Handle the serial interrupt.
      */
     void interruptHandler();
+
+    /**
+     * Move bytes from the write buffer to the transmit FIFO of the UART, if
+     * it is empty. Call it with the UART interrupt disabled.
+     */
+    void fillTxFifo();
 };
 
 
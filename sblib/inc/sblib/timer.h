@@ -40,6 +40,15 @@ void delayMicroseconds(unsigned int usec);
  */
 unsigned int millis();
 
+/**
+ * Get the number of microseconds that elapsed since the last reset or processor start.
+ * Please note that the time overflows and restarts at zero after 71,5 minutes. Use the
+ * difference of two calls to measure a duration.
+ *
+ * @return The number of microseconds.
+ */
+unsigned int micros();
+
 /**
  * Get the number of milliseconds that elapsed since the reference time.
  *
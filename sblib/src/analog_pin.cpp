@@ -48,7 +48,8 @@ void analogEnd()
 int analogRead(int channel)
 {
     LPC_ADC->CR &= 0xffffff00;
-    LPC_ADC->DR[channel]; // read the channel to clear the "done" flag
+    volatile unsigned int discard = LPC_ADC->DR[channel]; // read the channel to clear the "done" flag
+    (void) discard;
 
     LPC_ADC->CR |= (1 << channel) | ADC_START_NOW; // start the ADC reading
 
@@ -0,0 +1,67 @@
+/*
+ *  boot_profile.cpp - Measure the time of the startup stages.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/boot_profile.h>
+
+#include <sblib/print.h>
+#include <sblib/timer.h>
+
+// The time of the stages in microseconds
+static unsigned int bootStageTime[BOOT_STAGES];
+
+// Bit mask of the stages that are reached
+static unsigned int bootStagesReached;
+
+static const char* const bootStageNames[BOOT_STAGES] =
+{
+    "lib setup",
+    "flash size",
+    "read eeprom",
+    "bus begin",
+    "setup",
+    "first loop",
+    "first ack"
+};
+
+void bootProfileMark(int stage)
+{
+    if (bootStagesReached & (1 << stage))
+        return;
+
+    bootStageTime[stage] = micros();
+    bootStagesReached |= 1 << stage;
+}
+
+unsigned int bootProfileTime(int stage)
+{
+    return (bootStagesReached & (1 << stage)) ? bootStageTime[stage] : 0;
+}
+
+void bootProfileReport(Print& out)
+{
+    unsigned int last = 0;
+
+    for (int stage = 0; stage < BOOT_STAGES; ++stage)
+    {
+        unsigned int time = bootStageTime[stage];
+
+        out.print(bootStageNames[stage]);
+        out.print(": ");
+        if (!(bootStagesReached & (1 << stage)))
+        {
+            out.println("-");
+            continue;
+        }
+
+        out.print(time);
+        out.print(" us, +");
+        out.print(time - last);
+        out.println(" us");
+        last = time;
+    }
+}
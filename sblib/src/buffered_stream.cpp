@@ -13,28 +13,21 @@
 
 int BufferedStream::read()
 {
-    if (readTail == readHead)
-        return -1;
-
-    int ch = readBuffer[readHead];
-
-    ++readHead;
-    readHead &= BufferedStream::BUFFER_SIZE_MASK;
+    byte ch;
 
+    if (!readBuffer.pop(ch))
+        return -1;
     return ch;
 }
 
 int BufferedStream::peek()
 {
-    if (readTail == readHead)
+    if (readBuffer.empty())
         return -1;
-    return readBuffer[readHead];
+    return readBuffer.peek();
 }
 
 int BufferedStream::available()
 {
-    int num = readTail - readHead;
-    if (num < 0) num += BufferedStream::BUFFER_SIZE;
-
-    return num;
+    return readBuffer.count();
 }
@@ -0,0 +1,135 @@
+/*
+ *  cpu_load.cpp - Measure the CPU load and the duration of the main loop.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/cpu_load.h>
+
+#include <sblib/interrupt.h>
+#include <sblib/print.h>
+#include <sblib/timer.h>
+
+// The loop duration histogram
+static unsigned int loopCounts[CPU_LOAD_BUCKETS];
+static unsigned int maxLoopTime;
+
+// The start of the current main loop iteration
+static unsigned int loopStart;
+static bool looping;
+
+// The current window of the CPU load
+static unsigned int windowStart;
+static unsigned int windowIdle;
+
+// The CPU load of the last window in percent
+static unsigned int lastLoad;
+
+/*
+ * Get the histogram bucket of a loop duration.
+ */
+static int loopBucket(unsigned int usec)
+{
+    int bucket = 0;
+    usec >>= 5;
+
+    while (usec && bucket < CPU_LOAD_BUCKETS - 1)
+    {
+        usec >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void cpuLoadLoop()
+{
+    unsigned int now = micros();
+
+    if (!looping)
+    {
+        looping = true;
+        loopStart = now;
+        windowStart = now;
+        windowIdle = 0;
+        return;
+    }
+
+    unsigned int duration = now - loopStart;
+    loopStart = now;
+
+    if (duration > maxLoopTime)
+        maxLoopTime = duration;
+    ++loopCounts[loopBucket(duration)];
+
+    unsigned int window = now - windowStart;
+    if (window >= CPU_LOAD_WINDOW * 1000U)
+    {
+        unsigned int idle = windowIdle;
+        if (idle > window)
+            idle = window;
+
+        lastLoad = ((window - idle) / (window / 1000) + 5) / 10;
+        windowStart = now;
+        windowIdle = 0;
+    }
+}
+
+void cpuLoadWaitForInterrupt()
+{
+    // The interrupt wakes the processor up but is not handled before it is
+    // enabled again, so its time is not counted as idle time
+    noInterrupts();
+    unsigned int start = micros();
+    __WFI();
+    windowIdle += micros() - start;
+    interrupts();
+}
+
+unsigned int cpuLoad()
+{
+    return lastLoad;
+}
+
+unsigned int cpuLoadMaxLoopTime()
+{
+    return maxLoopTime;
+}
+
+unsigned int cpuLoadLoopCount(int bucket)
+{
+    return loopCounts[bucket];
+}
+
+void cpuLoadReset()
+{
+    for (int bucket = 0; bucket < CPU_LOAD_BUCKETS; ++bucket)
+        loopCounts[bucket] = 0;
+
+    maxLoopTime = 0;
+    lastLoad = 0;
+    looping = false;
+}
+
+void cpuLoadReport(Print& out)
+{
+    out.print("cpu load ");
+    out.print(lastLoad);
+    out.print("%, max loop ");
+    out.print(maxLoopTime);
+    out.println(" us");
+
+    for (int bucket = 0; bucket < CPU_LOAD_BUCKETS; ++bucket)
+    {
+        if (!loopCounts[bucket])
+            continue;
+
+        out.print(bucket ? 16U << bucket : 0U);
+        out.print("..");
+        if (bucket < CPU_LOAD_BUCKETS - 1)
+            out.print((32U << bucket) - 1);
+        out.print(" us: ");
+        out.println(loopCounts[bucket]);
+    }
+}
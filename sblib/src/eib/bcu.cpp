@@ -16,6 +16,7 @@
 #include <string.h>
 #include <sblib/internal/variables.h>
 #include <sblib/mem_mapper.h>
+#include <sblib/profile_probes.h>
 
 #if defined DUMP_TELEGRAMS || defined DUMP_MEM_OPS
 #include <sblib/serial.h>
@@ -27,6 +28,13 @@ extern volatile unsigned int systemTime;
 void BCU::_begin()
 {
     readUserEeprom();
+    if (configImage)
+        configImage->recover();
+    if (parameterCache)
+    {
+        parameterCache->markAllDirty();
+        parameterCache->update(true);
+    }
     sendGrpTelEnabled = true;
     groupTelSent = millis();
     groupTelWaitMillis = 0; // 0 disables limit
@@ -38,6 +46,8 @@ void BCU::end()
         usrCallback->Notify(USR_CALLBACK_BCU_END);
     BcuBase::end();
     writeUserEeprom();
+    if (configImage)
+        configImage->eepromWritten();
     if (memMapper)
     {
         memMapper->doFlash();
@@ -48,6 +58,8 @@ void BCU::loop()
 {
     if (!enabled)
         return;
+
+    PROFILE_PROBE(PROBE_BCU_LOOP);
     BcuBase::loop();
 
     if (sendGrpTelEnabled && !bus.sendingTelegram())
@@ -72,6 +84,10 @@ void BCU::loop()
         connectedAddr = 0;
     }
 
+    // Decode the changed parameters when the download is finished
+    if (parameterCache && connectedAddr == 0 && parameterCache->isDirty())
+        parameterCache->update();
+
     if (userEeprom.isModified() && bus.idle() && bus.telegramLen == 0 && connectedAddr == 0)
     {
         if (writeUserEepromTime)
@@ -85,6 +101,10 @@ void BCU::loop()
                 {
                     memMapper->doFlash();
                 }
+                if (configImage)
+                {
+                    configImage->eepromWritten();
+                }
             }
         }
         else writeUserEepromTime = millis() + 50;
@@ -108,6 +128,7 @@ void BCU::sendConControlTelegram(int cmd, int senderSeqNo)
 
 void BCU::processTelegram()
 {
+    PROFILE_PROBE(PROBE_PROCESS_TELEGRAM);
     unsigned short destAddr = (bus.telegram[3] << 8) | bus.telegram[4];
     unsigned char tpci = bus.telegram[6] & 0xc3; // Transport control field (see KNX 3/3/4 p.6 TPDU)
     unsigned short apci = ((bus.telegram[6] & 3) << 8) | bus.telegram[7];
@@ -173,48 +194,6 @@ bool BCU::processDeviceDescriptorReadTelegram(int id)
     return false; // unknown device descriptor
 }
 
-static void cpyToUserRam(unsigned int address, unsigned char * buffer, unsigned int count)
-{
-    address -= getUserRamStart();
-    if ((address > 0x60) || ((address + count) < 0x60))
-    {
-        memcpy(userRamData + address, buffer, count);
-    }
-    else
-    {
-        while (count--)
-        {
-            if (address == 0x60)
-                userRam.status = * buffer;
-            else
-                userRamData[address] = * buffer;
-            buffer++;
-            address++;
-        }
-    }
-}
-
-static void cpyFromUserRam(unsigned int address, unsigned char * buffer, unsigned int count)
-{
-    address -= getUserRamStart();
-    if ((address > 0x60) || ((address + count) < 0x60))
-    {
-        memcpy(buffer, userRamData + address, count);
-    }
-    else
-    {
-        while (count--)
-        {
-            if (address == 0x60)
-                * buffer = userRam.status;
-            else
-                * buffer = userRamData[address];
-            buffer++;
-            address++;
-        }
-    }
-}
-
 void BCU::processDirectTelegram(int apci)
 {
     const int senderAddr = (bus.telegram[1] << 8) | bus.telegram[2];
@@ -230,6 +209,8 @@ void BCU::processDirectTelegram(int apci)
     if (connectedAddr != senderAddr) // ensure that the sender is correct
         return;
 
+    int imageState = configImage ? configImage->state() : CIS_IDLE;
+
     connectedTime = systemTime;
     sendTelegram[6] = 0;
 
@@ -265,19 +246,6 @@ void BCU::processDirectTelegram(int apci)
             }
             serial.println("");
 #endif
-            if(memMapper && memMapper->isMapped(address))
-            {
-                memMapper->writeMemPtr(address, bus.telegram + 10, count);
-            }
-
-            if (address >= USER_EEPROM_START && address < USER_EEPROM_END)
-            {
-                memcpy(userEepromData + (address - USER_EEPROM_START), bus.telegram + 10, count);
-                userEeprom.modified();
-            }
-            else if (address >= getUserRamStart() && address < (getUserRamStart() + USER_RAM_SIZE))
-                cpyToUserRam(address, bus.telegram + 10, count);
-
             sendAck = T_ACK_PDU;
 
 #ifdef LOAD_CONTROL_ADDR
@@ -289,6 +257,8 @@ void BCU::processDirectTelegram(int apci)
                 break;
             }
 #endif
+            if (userMemoryWrite(address, bus.telegram + 10, count) && parameterCache)
+                parameterCache->markDirty(address, count);
 
 #if BCU_TYPE != BCU1_TYPE
             if (userRam.deviceControl & DEVCTRL_MEM_AUTO_RESPONSE)
@@ -298,19 +268,7 @@ void BCU::processDirectTelegram(int apci)
 
         if (apciCmd == APCI_MEMORY_READ_PDU)
         {
-            if (address >= USER_EEPROM_START && address < USER_EEPROM_END) {
-                  memcpy(sendTelegram + 10, userEepromData + (address - USER_EEPROM_START), count);
-            }
-            else if (address >= getUserRamStart() && address < (getUserRamStart() + USER_RAM_SIZE))
-                cpyFromUserRam(address, sendTelegram + 10, count);
-#ifdef LOAD_STATE_ADDR
-            else if (address >= LOAD_STATE_ADDR && address < LOAD_STATE_ADDR + 8)
-                memcpy(sendTelegram + 10, userEeprom.loadState + (address - LOAD_STATE_ADDR), count);
-#endif
-            if(memMapper && memMapper->isMapped(address))
-            {
-                memMapper->readMemPtr(address, sendTelegram + 10, count);
-            }
+            userMemoryRead(address, sendTelegram + 10, count);
 #ifdef DUMP_MEM_OPS
             serial.print("readMem: ");
             serial.print(address, HEX, 4);
@@ -407,6 +365,13 @@ void BCU::processDirectTelegram(int apci)
         break;
     }
 
+    // A configuration image was activated: all parameters may have changed
+    if (parameterCache && imageState != CIS_ACTIVATING && configImage &&
+        configImage->state() == CIS_ACTIVATING)
+    {
+        parameterCache->markAllDirty();
+    }
+
     if (sendTel)
         sendAck = T_ACK_PDU;
 
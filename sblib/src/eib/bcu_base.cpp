@@ -16,6 +16,8 @@
 #include <sblib/internal/functions.h>
 #include <sblib/internal/variables.h>
 #include <sblib/internal/iap.h>
+#include <sblib/boot_profile.h>
+#include <sblib/eib/telegram_latency.h>
 #include <string.h>
 
 #ifdef DUMP_TELEGRAMS
@@ -41,6 +43,7 @@ BcuBase::BcuBase()
 void BcuBase::begin_BCU(int manufacturer, int deviceType, int version)
 {
 	_begin();
+    BOOT_PROFILE_MARK(BOOT_READ_EEPROM);
 #ifdef DUMP_TELEGRAMS
     serial.begin(115200);
     serial.println("Telegram dump enabled");
@@ -84,6 +87,7 @@ void BcuBase::begin_BCU(int manufacturer, int deviceType, int version)
     writeUserEepromTime = 0;
     enabled = true;
     bus.begin();
+    BOOT_PROFILE_MARK(BOOT_BUS_BEGIN);
     progButtonDebouncer.init(1);
 }
 
@@ -141,7 +145,11 @@ void BcuBase::loop()
 #endif
 
     if (bus.telegramReceived() && !bus.sendingTelegram() && (userRam.status & BCU_STATUS_TL))
+    {
+        // Before processing, the responses are queued by processTelegram()
+        TELEGRAM_LATENCY_MARK(LATENCY_PROCESSED);
         processTelegram();
+    }
 
     if (progPin)
     {
@@ -16,6 +16,10 @@
 #include <sblib/eib/addr_tables.h>
 #include <sblib/eib/user_memory.h>
 #include <sblib/eib/properties.h>
+#include <sblib/boot_profile.h>
+#include <sblib/ram_usage.h>
+#include <sblib/eib/bus_isr_profile.h>
+#include <sblib/eib/telegram_latency.h>
 
 /*
  * The timer16_1 is used as follows:
@@ -100,6 +104,7 @@ void Bus::begin()
     sendNextTel = 0;
     sendTriesMax = 4;
     collision = false;
+    RAM_USAGE_REGISTER(RAM_BUS_SEND_QUEUE, "bus send queue", 2);
 
     timer.begin();
     timer.pwmEnable(pwmChannel);
@@ -186,6 +191,7 @@ void Bus::handleTelegram(bool valid)
         if (!(userRam.status & BCU_STATUS_TL))
         {
             telegramLen = nextByteIndex;
+            TELEGRAM_LATENCY_MARK(LATENCY_RECEIVED);
 
             if (userRam.status & BCU_STATUS_LL)
                 sendAck = SB_BUS_ACK;
@@ -194,6 +200,8 @@ void Bus::handleTelegram(bool valid)
         {
             telegramLen = nextByteIndex;
             sendAck = SB_BUS_ACK;
+            BOOT_PROFILE_MARK(BOOT_FIRST_ACK);
+            TELEGRAM_LATENCY_MARK(LATENCY_RECEIVED);
         }
     }
     else if (nextByteIndex == 1)   // Received a spike or a bus acknowledgment
@@ -201,6 +209,10 @@ void Bus::handleTelegram(bool valid)
         currentByte &= 0xff;
         if ((currentByte == SB_BUS_ACK || sendTries > sendTriesMax) && sendCurTelegram && sendTries > 0)
         {
+             if (currentByte == SB_BUS_ACK)
+             {
+                 TELEGRAM_LATENCY_MARK(LATENCY_ACKED);
+             }
              sendNextTelegram();
         }
     }
@@ -225,6 +237,8 @@ void Bus::handleTelegram(bool valid)
 
 void Bus::sendNextTelegram()
 {
+    TELEGRAM_LATENCY_MARK(LATENCY_FINISHED);
+
     sendCurTelegram[0] = 0;
     sendCurTelegram = sendNextTel;
     sendNextTel = 0;
@@ -238,6 +252,8 @@ void Bus::timerInterruptHandler()
     bool timeout;
     int time;
 
+    BUS_ISR_PROFILE_ENTER(state);
+
     // Debug output
     D(digitalWrite(PIO0_6, ++tick & 1));  // brown: interrupt tick
     D(digitalWrite(PIO3_0, state==Bus::SEND_BIT_0)); // red
@@ -389,6 +405,10 @@ STATE_SWITCH:
                 goto STATE_SWITCH;
             }
 
+            if (!sendAck)
+            {
+                TELEGRAM_LATENCY_MARK(LATENCY_ON_WIRE);
+            }
             state = Bus::SEND_BIT_0;
             break;
         }
@@ -499,6 +519,7 @@ STATE_SWITCH:
     }
 
     timer.resetFlags();
+    BUS_ISR_PROFILE_LEAVE();
 }
 
 /**
@@ -554,9 +575,11 @@ void Bus::sendTelegram(unsigned char* telegram, unsigned short length)
     if (!sendCurTelegram) sendCurTelegram = telegram;
     else if (!sendNextTel) sendNextTel = telegram;
     else fatalError();   // soft fault: send buffer overflow
+    RAM_USAGE_FILL(RAM_BUS_SEND_QUEUE, sendNextTel ? 2 : 1);
 
     // Start sending if the bus is idle
     noInterrupts();
+    TELEGRAM_LATENCY_MARK(LATENCY_QUEUED);
     if (state == IDLE)
     {
         sendTries = 0;
@@ -0,0 +1,169 @@
+/*
+ *  bus_isr_profile.cpp - Measure the execution time of the bus interrupt handler.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/eib/bus_isr_profile.h>
+
+#include <sblib/platform.h>
+#include <sblib/print.h>
+#include <sblib/timer.h>
+
+// Time between two bits (104 usec)
+#define BIT_TIME 104
+
+// The execution times by state
+static BusIsrStateProfile busIsrStates[BUS_ISR_PROFILE_STATES];
+
+// The budget in clock cycles, 0 for the default
+static unsigned int busIsrBudget;
+
+// A call took longer than the budget
+static bool busIsrAlarm;
+
+// The state and the clock at the start of the current call
+static int busIsrState;
+static unsigned int busIsrStart;
+
+static const char* const busIsrStateNames[BUS_ISR_PROFILE_STATES] =
+{
+    "IDLE",
+    "RECV_BYTE",
+    "RECV_START",
+    "SEND_INIT",
+    "SEND_START_BIT",
+    "SEND_BIT_0",
+    "SEND_BIT",
+    "SEND_BIT_WAIT",
+    "SEND_WAIT",
+    "SEND_END"
+};
+
+/*
+ * The default clock for the measurement: the system timer, made to count up.
+ */
+static unsigned int systemTimerClock()
+{
+    return SysTick->LOAD - SysTick->VAL;
+}
+
+// The clock for the measurement
+static BusIsrProfileClock busIsrClock = systemTimerClock;
+
+void busIsrProfileEnter(int state)
+{
+    busIsrState = state;
+    busIsrStart = busIsrClock();
+}
+
+void busIsrProfileLeave()
+{
+    unsigned int time = busIsrClock() - busIsrStart;
+
+    // The system timer was reloaded during the call
+    if ((int) time < 0 && busIsrClock == systemTimerClock)
+        time += SysTick->LOAD + 1;
+    if (time > 0xffff)
+        time = 0xffff;
+
+    BusIsrStateProfile& prof = busIsrStates[busIsrState];
+    if (!prof.calls || time < prof.minTime)
+        prof.minTime = time;
+    if (time > prof.maxTime)
+        prof.maxTime = time;
+    ++prof.calls;
+
+    if (time > busIsrProfileBudget())
+    {
+        if (prof.overruns < 0xffff)
+            ++prof.overruns;
+        busIsrAlarm = true;
+    }
+
+    int bucket = 0;
+    for (unsigned int limit = 32; time >= limit && bucket < BUS_ISR_PROFILE_BUCKETS - 1; limit <<= 1)
+        ++bucket;
+    if (prof.histogram[bucket] < 0xffff)
+        ++prof.histogram[bucket];
+}
+
+const BusIsrStateProfile& busIsrProfile(int state)
+{
+    return busIsrStates[state];
+}
+
+void busIsrProfileSetClock(BusIsrProfileClock clock)
+{
+    busIsrClock = clock ? clock : systemTimerClock;
+}
+
+void busIsrProfileSetBudget(unsigned int cycles)
+{
+    busIsrBudget = cycles;
+}
+
+unsigned int busIsrProfileBudget()
+{
+    if (busIsrBudget)
+        return busIsrBudget;
+    return microsecondsToClockCycles(BUS_ISR_PROFILE_DEFAULT_BUDGET);
+}
+
+bool busIsrProfileAlarm()
+{
+    return busIsrAlarm;
+}
+
+void busIsrProfileReset()
+{
+    for (int state = 0; state < BUS_ISR_PROFILE_STATES; ++state)
+    {
+        BusIsrStateProfile& prof = busIsrStates[state];
+
+        prof.calls = 0;
+        prof.minTime = 0;
+        prof.maxTime = 0;
+        prof.overruns = 0;
+        for (int bucket = 0; bucket < BUS_ISR_PROFILE_BUCKETS; ++bucket)
+            prof.histogram[bucket] = 0;
+    }
+    busIsrAlarm = false;
+}
+
+void busIsrProfileReport(Print& out)
+{
+    unsigned int bitCycles = microsecondsToClockCycles(BIT_TIME);
+
+    for (int state = 0; state < BUS_ISR_PROFILE_STATES; ++state)
+    {
+        const BusIsrStateProfile& prof = busIsrStates[state];
+        if (!prof.calls)
+            continue;
+
+        out.print(busIsrStateNames[state]);
+        out.print(": ");
+        out.print(prof.calls);
+        out.print(" calls, ");
+        out.print(prof.minTime);
+        out.print("..");
+        out.print(prof.maxTime);
+        out.print(" cycles, ");
+        out.print(prof.maxTime * 100 / bitCycles);
+        out.print("% of a bit, ");
+        out.print(prof.overruns);
+        out.print(" over budget,");
+
+        for (int bucket = 0; bucket < BUS_ISR_PROFILE_BUCKETS; ++bucket)
+        {
+            out.print(" ");
+            out.print(prof.histogram[bucket]);
+        }
+        out.println();
+    }
+
+    if (busIsrAlarm)
+        out.println("ALARM: budget exceeded");
+}
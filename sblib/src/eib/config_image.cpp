@@ -0,0 +1,298 @@
+/*
+ *  config_image.cpp - Bulk transfer of the configuration image.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/eib/config_image.h>
+
+#include <sblib/eib/bus.h>
+#include <sblib/eib/properties.h>
+#include <sblib/eib/user_memory.h>
+#include <sblib/internal/iap.h>
+#include <sblib/utils.h>
+
+#include <string.h>
+
+// The magic word of the staging header
+#define STAGING_MAGIC 0x474d4943
+
+// The number of flash pages of the image
+#define IMAGE_PAGES ((USER_EEPROM_SIZE + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE)
+
+// The offset of the header in the staging sector
+#define HEADER_OFFSET (FLASH_SECTOR_SIZE - FLASH_PAGE_SIZE)
+
+#ifdef IAP_EMULATION
+unsigned int emuImageEnd;
+#  define IMAGE_END emuImageEnd
+#else
+// The linker symbols of the end of the code and of the initialized data
+extern unsigned int _etext[];
+extern unsigned int _data[];
+extern unsigned int _edata[];
+// The initial values of the data are stored in flash behind the code
+#  define IMAGE_END ((unsigned int) _etext + ((unsigned int) _edata - (unsigned int) _data))
+#endif
+
+/*
+ * The header of the staging area. It is written when the image is verified.
+ * The requested word is programmed to 0 when the activation is requested,
+ * the activated word when the image is written to the user EEPROM.
+ */
+struct StagingHeader
+{
+    unsigned int magic;      //!< STAGING_MAGIC
+    unsigned int length;     //!< The length of the image
+    unsigned int crc;        //!< The CRC-32 of the image
+    unsigned int requested;  //!< 0xffffffff until the activation is requested
+    unsigned int activated;  //!< 0xffffffff until the activation is finished
+};
+
+/*
+ * Calculate the CRC-32 (polynom 0xedb88320) of a block.
+ */
+static unsigned int calcCrc32(unsigned int crc, const byte* data, unsigned int count)
+{
+    crc = ~crc;
+    while (count--)
+    {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+ConfigImage::ConfigImage(unsigned int windowAddr)
+:windowAddr(windowAddr)
+,received(0)
+,imageState(CIS_IDLE)
+,error(CIE_OK)
+,crc(0)
+{
+}
+
+byte* ConfigImage::stagingPtr() const
+{
+    return FLASH_BASE_ADDRESS + iapFlashSize() - 2 * FLASH_SECTOR_SIZE;
+}
+
+unsigned int ConfigImage::stagingCrc(unsigned int length) const
+{
+    return calcCrc32(0, stagingPtr(), length);
+}
+
+void ConfigImage::programPage(int page)
+{
+    // Wait for an idle bus, the interrupts are disabled while programming
+    while (!bus.idle())
+        ;
+
+    if (iapProgram(stagingPtr() + page * FLASH_PAGE_SIZE, buffer, FLASH_PAGE_SIZE) != IAP_SUCCESS)
+        fatalError();
+}
+
+void ConfigImage::writeHeader(bool requested, bool activated)
+{
+    StagingHeader* header = (StagingHeader*) buffer;
+
+    // Bytes that are 0xff leave the already programmed header untouched
+    memset(buffer, 0xff, FLASH_PAGE_SIZE);
+    header->magic = STAGING_MAGIC;
+    header->length = USER_EEPROM_SIZE;
+    header->crc = crc;
+    if (requested)
+        header->requested = 0;
+    if (activated)
+        header->activated = 0;
+
+    programPage(HEADER_OFFSET / FLASH_PAGE_SIZE);
+}
+
+void ConfigImage::command(const byte* data, int count)
+{
+    switch (data[0])
+    {
+    case CIC_BEGIN:
+        if ((unsigned int) (stagingPtr() - FLASH_BASE_ADDRESS) < IMAGE_END)
+        {
+            imageState = CIS_ERROR;
+            error = CIE_FLASH;
+            break;
+        }
+
+        while (!bus.idle())
+            ;
+        if (iapEraseSector(iapSectorOfAddress(stagingPtr())) != IAP_SUCCESS)
+            fatalError();
+
+        received = 0;
+        imageState = CIS_RECEIVING;
+        error = CIE_OK;
+        break;
+
+    case CIC_COMMIT:
+        if (imageState != CIS_RECEIVING || count < 5)
+        {
+            error = CIE_SEQUENCE;
+            break;
+        }
+        if (received < USER_EEPROM_SIZE)
+        {
+            error = CIE_LENGTH;
+            break;
+        }
+
+        crc = (data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
+        if (stagingCrc(USER_EEPROM_SIZE) != crc)
+        {
+            imageState = CIS_ERROR;
+            error = CIE_CRC;
+            break;
+        }
+
+        writeHeader(false, false);
+        imageState = CIS_VERIFIED;
+#if BCU_TYPE == BCU1_TYPE
+        activate();
+#endif
+        break;
+
+    case CIC_ABORT:
+        imageState = CIS_IDLE;
+        error = CIE_OK;
+        break;
+
+    default:
+        error = CIE_COMMAND;
+        break;
+    }
+}
+
+bool ConfigImage::write(int addr, const byte* data, int count)
+{
+    unsigned int offset = addr - windowAddr;
+
+    if (offset < CONFIG_IMAGE_CTRL_SIZE)
+    {
+        if (offset != 0 || count < 1)
+            return false;
+
+        command(data, count);
+        return error == CIE_OK;
+    }
+
+    offset -= CONFIG_IMAGE_CTRL_SIZE;
+    if (imageState != CIS_RECEIVING || offset != received || offset + count > USER_EEPROM_SIZE)
+    {
+        error = CIE_SEQUENCE;
+        return false;
+    }
+
+    while (count-- > 0)
+    {
+        buffer[received & (FLASH_PAGE_SIZE - 1)] = *data++;
+        ++received;
+
+        if ((received & (FLASH_PAGE_SIZE - 1)) == 0 || received == USER_EEPROM_SIZE)
+        {   // the page is complete, or the last page of the image
+            int last = (received - 1) & (FLASH_PAGE_SIZE - 1);
+            memset(buffer + last + 1, 0xff, FLASH_PAGE_SIZE - 1 - last);
+            programPage((received - 1) / FLASH_PAGE_SIZE);
+        }
+    }
+
+    return true;
+}
+
+bool ConfigImage::read(int addr, byte* data, int count)
+{
+    unsigned int offset = addr - windowAddr;
+
+    for (; count > 0; --count, ++offset)
+    {
+        if (offset < CONFIG_IMAGE_CTRL_SIZE)
+        {
+            switch (offset)
+            {
+            case 0: *data++ = imageState; break;
+            case 1: *data++ = error; break;
+            case 2: *data++ = received >> 8; break;
+            case 3: *data++ = received; break;
+            case 4: *data++ = USER_EEPROM_SIZE >> 8; break;
+            case 5: *data++ = USER_EEPROM_SIZE & 0xff; break;
+            default: *data++ = 0; break;
+            }
+        }
+        else
+        {
+            unsigned int pos = offset - CONFIG_IMAGE_CTRL_SIZE;
+            if (pos >= received)
+                *data++ = 0xff;
+            else if ((pos & ~(FLASH_PAGE_SIZE - 1)) == (received & ~(FLASH_PAGE_SIZE - 1)))
+                *data++ = buffer[pos & (FLASH_PAGE_SIZE - 1)]; // not yet programmed
+            else *data++ = stagingPtr()[pos];
+        }
+    }
+
+    return true;
+}
+
+bool ConfigImage::activate()
+{
+    if (imageState == CIS_RECEIVING || imageState == CIS_ERROR)
+        return false;
+    if (imageState != CIS_VERIFIED)
+        return true;
+
+    // A reset before the image is written to the user EEPROM continues here
+    writeHeader(true, false);
+    copyImage();
+    return true;
+}
+
+void ConfigImage::copyImage()
+{
+    memcpy(userEepromData, stagingPtr(), USER_EEPROM_SIZE);
+#if BCU_TYPE != BCU1_TYPE
+    userEeprom.loadState[OT_ADDR_TABLE] = LS_LOADED;
+    userEeprom.loadState[OT_ASSOC_TABLE] = LS_LOADED;
+    userEeprom.loadState[OT_APPLICATION] = LS_LOADED;
+#endif
+    userEeprom.modified();
+
+    imageState = CIS_ACTIVATING;
+}
+
+void ConfigImage::recover()
+{
+    const StagingHeader* header = (const StagingHeader*) (stagingPtr() + HEADER_OFFSET);
+
+    // Only an activation that was requested and not finished is continued
+    if (header->magic != STAGING_MAGIC || header->requested != 0 || header->activated != 0xffffffff ||
+        header->length != USER_EEPROM_SIZE || stagingCrc(header->length) != header->crc)
+    {
+        return;
+    }
+
+    crc = header->crc;
+    copyImage();
+}
+
+void ConfigImage::eepromWritten()
+{
+    if (imageState != CIS_ACTIVATING)
+        return;
+
+    writeHeader(true, true);
+    imageState = CIS_IDLE;
+}
+
+void ConfigImage::discard()
+{
+    if (imageState == CIS_VERIFIED)
+        imageState = CIS_IDLE;
+}
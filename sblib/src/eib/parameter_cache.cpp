@@ -0,0 +1,114 @@
+/*
+ *  parameter_cache.cpp - Decoded application parameters.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/eib/parameter_cache.h>
+
+#include <sblib/eib/user_memory.h>
+
+#include <string.h>
+
+ParameterCache::ParameterCache(const ParameterDesc* descs, int count, void* values,
+    ChangedCallback changed)
+:descs(descs)
+,count(count)
+,values((byte*) values)
+,changed(changed)
+,dirtyStart(0)
+,dirtyEnd(0)
+{
+}
+
+void ParameterCache::markDirty(int addr, int count)
+{
+    unsigned int end = addr + count;
+
+    if (dirtyStart == dirtyEnd)
+    {
+        dirtyStart = addr;
+        dirtyEnd = end;
+        return;
+    }
+
+    if ((unsigned int) addr < dirtyStart)
+        dirtyStart = addr;
+    if (end > dirtyEnd)
+        dirtyEnd = end;
+}
+
+void ParameterCache::markAllDirty()
+{
+    dirtyStart = 0;
+    dirtyEnd = 0x10000;
+}
+
+int ParameterCache::decode(int index) const
+{
+    const ParameterDesc& desc = descs[index];
+    int numBytes = (desc.bitOffset + desc.bits + 7) >> 3;
+    byte data[4];
+    unsigned int raw = 0;
+
+    userMemoryRead(desc.addr, data, numBytes);
+    for (int i = 0; i < numBytes; ++i)
+        raw = (raw << 8) | data[i];
+
+    raw >>= (numBytes << 3) - desc.bitOffset - desc.bits;
+    if (desc.bits < 32)
+        raw &= (1U << desc.bits) - 1;
+
+    int value = raw;
+    if (desc.factor != 1)
+        value *= desc.factor;
+    if (desc.divisor > 1)
+        value /= desc.divisor;
+    return value;
+}
+
+void ParameterCache::update(bool all)
+{
+    if (dirtyStart == dirtyEnd)
+        return;
+
+    unsigned int start = dirtyStart;
+    unsigned int end = dirtyEnd;
+    dirtyStart = dirtyEnd = 0;
+
+    for (int index = 0; index < count; ++index)
+    {
+        const ParameterDesc& desc = descs[index];
+        unsigned int descEnd = desc.addr + ((desc.bitOffset + desc.bits + 7) >> 3);
+
+        if (descEnd <= start || desc.addr >= end)
+            continue;
+
+        int value = decode(index);
+        byte* ptr = values + desc.valueOffset;
+        bool differs;
+
+        switch (desc.valueSize)
+        {
+        case 1:
+            differs = *ptr != (byte) value;
+            *ptr = value;
+            break;
+
+        case 2:
+            differs = *(unsigned short*) ptr != (unsigned short) value;
+            *(unsigned short*) ptr = value;
+            break;
+
+        default:
+            differs = *(int*) ptr != value;
+            *(int*) ptr = value;
+            break;
+        }
+
+        if ((differs || all) && changed)
+            changed(index);
+    }
+}
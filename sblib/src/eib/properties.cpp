@@ -77,6 +77,13 @@ int loadProperty(int objectIdx, const byte* data, int len)
         return LS_LOADING; // reply: Loading
 
     case 2: // Load completed
+        if (objectIdx == OT_APPLICATION)
+        {
+            // Activate a configuration image that was transferred in bulk
+            ConfigImage* image = ((BCU&) bcu).getConfigImage();
+            if (image && !image->activate())
+                return LS_ERROR;
+        }
         return LS_LOADED; // reply: Loaded
 
     case 3: // Load data: handled below
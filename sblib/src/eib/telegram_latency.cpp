@@ -0,0 +1,212 @@
+/*
+ *  telegram_latency.cpp - Measure the latency of the stages of a telegram.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/eib/telegram_latency.h>
+
+#include <sblib/print.h>
+#include <sblib/timer.h>
+
+/*
+ * The latencies of one interval.
+ */
+struct LatencyHistogram
+{
+    unsigned int count;
+    unsigned int max;
+    unsigned short buckets[LATENCY_BUCKETS];
+};
+
+static LatencyHistogram latencies[LATENCY_INTERVALS];
+
+// The times of the stages of the last received telegram
+static unsigned int receivedAt, processedAt;
+static bool receivedPending, processedPending;
+
+// The times the telegrams of the send queue were queued
+static unsigned int queuedAt[2];
+static int queuedCount;
+
+// The time the current telegram to send was put on the bus
+static unsigned int onWireAt;
+static bool onWire;
+
+static const char* const latencyNames[LATENCY_INTERVALS] =
+{
+    "rx->processed",
+    "processed->queued",
+    "queued->on wire",
+    "on wire->ack"
+};
+
+/*
+ * Get the bucket of a latency.
+ */
+static int latencyBucket(unsigned int usec)
+{
+    if (usec < 64)
+        return 0;
+
+    int octave = 0;
+    while (octave < 16 && usec >= (128U << octave))
+        ++octave;
+    if (octave >= 16)
+        return LATENCY_BUCKETS - 1;
+
+    // The bit below the highest bit selects the half of the octave
+    return 1 + octave * 2 + ((usec >> (octave + 5)) & 1);
+}
+
+/*
+ * Get the largest latency of a bucket.
+ */
+static unsigned int latencyBucketEnd(int bucket)
+{
+    if (bucket == 0)
+        return 63;
+    if (bucket >= LATENCY_BUCKETS - 1)
+        return 0xffffffff;
+
+    int octave = (bucket - 1) >> 1;
+    return (64U << octave) + (((bucket - 1) & 1) + 1) * (32U << octave) - 1;
+}
+
+static void latencyRecord(int interval, unsigned int usec)
+{
+    LatencyHistogram& hist = latencies[interval];
+
+    ++hist.count;
+    if (usec > hist.max)
+        hist.max = usec;
+
+    unsigned short& calls = hist.buckets[latencyBucket(usec)];
+    if (calls < 0xffff)
+        ++calls;
+}
+
+void telegramLatencyMark(int stage)
+{
+    unsigned int now = micros();
+
+    switch (stage)
+    {
+    case LATENCY_RECEIVED:
+        receivedAt = now;
+        receivedPending = true;
+        processedPending = false;
+        break;
+
+    case LATENCY_PROCESSED:
+        if (!receivedPending)
+            break;
+        latencyRecord(LATENCY_RX_PROCESSED, now - receivedAt);
+        receivedPending = false;
+        processedAt = now;
+        processedPending = true;
+        break;
+
+    case LATENCY_QUEUED:
+        if (processedPending)
+        {
+            latencyRecord(LATENCY_PROCESSED_QUEUED, now - processedAt);
+            processedPending = false;
+        }
+        if (queuedCount < 2)
+            queuedAt[queuedCount++] = now;
+        break;
+
+    case LATENCY_ON_WIRE:
+        if (onWire || !queuedCount)
+            break;
+        latencyRecord(LATENCY_QUEUED_ON_WIRE, now - queuedAt[0]);
+        onWireAt = now;
+        onWire = true;
+        break;
+
+    case LATENCY_ACKED:
+        if (onWire)
+            latencyRecord(LATENCY_ON_WIRE_ACK, now - onWireAt);
+        break;
+
+    case LATENCY_FINISHED:
+        if (queuedCount)
+        {
+            queuedAt[0] = queuedAt[1];
+            --queuedCount;
+        }
+        onWire = false;
+        break;
+    }
+}
+
+unsigned int telegramLatencyCount(int interval)
+{
+    return latencies[interval].count;
+}
+
+unsigned int telegramLatencyPercentile(int interval, int percent)
+{
+    const LatencyHistogram& hist = latencies[interval];
+    if (!hist.count)
+        return 0;
+
+    // The number of telegrams up to the percentile, rounded up
+    unsigned int target = (hist.count * percent + 99) / 100;
+    unsigned int sum = 0;
+
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+    {
+        sum += hist.buckets[bucket];
+        if (sum >= target)
+        {
+            unsigned int end = latencyBucketEnd(bucket);
+            return end < hist.max ? end : hist.max;
+        }
+    }
+    return hist.max;
+}
+
+unsigned int telegramLatencyMax(int interval)
+{
+    return latencies[interval].max;
+}
+
+void telegramLatencyReset()
+{
+    for (int interval = 0; interval < LATENCY_INTERVALS; ++interval)
+    {
+        LatencyHistogram& hist = latencies[interval];
+
+        hist.count = 0;
+        hist.max = 0;
+        for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+            hist.buckets[bucket] = 0;
+    }
+
+    // Telegrams that are in progress are not measured
+    receivedPending = false;
+    processedPending = false;
+    queuedCount = 0;
+    onWire = false;
+}
+
+void telegramLatencyReport(Print& out)
+{
+    for (int interval = 0; interval < LATENCY_INTERVALS; ++interval)
+    {
+        out.print(latencyNames[interval]);
+        out.print(": ");
+        out.print(latencies[interval].count);
+        out.print(" telegrams, p50 ");
+        out.print(telegramLatencyPercentile(interval, 50));
+        out.print(" us, p99 ");
+        out.print(telegramLatencyPercentile(interval, 99));
+        out.print(" us, max ");
+        out.print(latencies[interval].max);
+        out.println(" us");
+    }
+}
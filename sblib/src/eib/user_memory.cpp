@@ -13,6 +13,10 @@
 #include <sblib/internal/iap.h>
 #include <sblib/eib/bus.h>
 #include <sblib/core.h>
+#include <sblib/mem_mapper.h>
+#include <sblib/eib/config_image.h>
+#include <sblib/utils.h>
+#include <sblib/profile_probes.h>
 
 #include <string.h>
 
@@ -33,10 +37,267 @@ volatile byte userEepromModified;
 volatile unsigned int writeUserEepromTime;
 int userRamStart = USER_RAM_START_DEFAULT;
 
+/*
+ * The types of the regions of the user memory address space.
+ */
+enum UserMemoryType
+{
+    UMT_NONE,         //!< Not mapped, must be the first entry of userMemoryRegions
+    UMT_USER_RAM,     //!< The user RAM
+    UMT_USER_EEPROM,  //!< The user EEPROM
+#ifdef LOAD_STATE_ADDR
+    UMT_LOAD_STATE,   //!< The load state of the system interface objects
+#endif
+    UMT_CONFIG_IMAGE, //!< The window of the configuration image transfer
+    UMT_COUNT
+};
+
+/*
+ * A region of the user memory address space.
+ */
+struct UserMemoryRegion
+{
+    unsigned int start;  //!< The first address of the region
+    unsigned int end;    //!< The address after the region
+    byte* data;          //!< The backing memory
+    bool writable;       //!< True if the region is writable
+};
+
+/*
+ * The regions of the user memory address space, indexed by UserMemoryType.
+ * The start of the user RAM is set when the page map is built.
+ */
+static UserMemoryRegion userMemoryRegions[UMT_COUNT] =
+{
+    { 0, 0, 0, false },
+    { 0, 0, userRamData, true },
+    { USER_EEPROM_START, USER_EEPROM_END, userEepromData, true },
+#ifdef LOAD_STATE_ADDR
+    { LOAD_STATE_ADDR, LOAD_STATE_ADDR + sizeof(((UserEeprom*) 0)->loadState),
+      userEepromData + OFFSET_OF(UserEeprom, loadState), false },
+#endif
+    { 0, 0, 0, true },
+};
+
+/*
+ * The page map of the user memory address space. There is one entry for every
+ * 256 byte page of the 16 bit address space. An entry contains up to two regions
+ * (UserMemoryType) that overlap the page: one in the low and one in the high nibble.
+ * A page that is overlapped by more regions is marked with PAGE_SHARED, its
+ * regions are searched. Addresses that are not found here are looked up in the
+ * memory mapper.
+ */
+#define PAGE_SHARED 0xff
+
+static byte userMemoryPageMap[256];
+static bool userMemoryPageMapValid;
+
+static MemMapper* userMemoryMapper;
+static ConfigImage* userMemoryConfigImage;
+
+/*
+ * Build the page map of the user memory address space.
+ */
+static void buildUserMemoryPageMap()
+{
+    userMemoryRegions[UMT_USER_RAM].start = userRamStart;
+    userMemoryRegions[UMT_USER_RAM].end = userRamStart + USER_RAM_SIZE;
+
+    memset(userMemoryPageMap, UMT_NONE, sizeof(userMemoryPageMap));
+
+    for (int type = UMT_NONE + 1; type < UMT_COUNT; ++type)
+    {
+        const UserMemoryRegion& region = userMemoryRegions[type];
+        if (region.start >= region.end)
+            continue; // not used, e.g. no configuration image
+
+        for (unsigned int page = region.start >> 8; page <= ((region.end - 1) >> 8) && page < 256; ++page)
+        {
+            byte entry = userMemoryPageMap[page];
+            if (!(entry & 0x0f))
+                userMemoryPageMap[page] = type;
+            else if (!(entry & 0xf0))
+                userMemoryPageMap[page] |= type << 4;
+            else userMemoryPageMap[page] = PAGE_SHARED;
+        }
+    }
+
+    userMemoryPageMapValid = true;
+}
+
+/*
+ * Find the region of the user memory address space that contains a block.
+ *
+ * @param addr - the 16bit BCU address of the block.
+ * @param count - the size of the block.
+ * @return The region, or 0 if the block is not within a single region.
+ */
+static const UserMemoryRegion* findUserMemoryRegion(int addr, int count)
+{
+    if (addr < 0 || addr > 0xffff)
+        return 0;
+
+    if (!userMemoryPageMapValid)
+        buildUserMemoryPageMap();
+
+    byte entry = userMemoryPageMap[addr >> 8];
+    if (entry == PAGE_SHARED)
+    {
+        for (int type = UMT_NONE + 1; type < UMT_COUNT; ++type)
+        {
+            const UserMemoryRegion* region = &userMemoryRegions[type];
+            if ((unsigned) addr >= region->start && (unsigned) addr < region->end)
+                return (unsigned) (addr + count) <= region->end ? region : 0;
+        }
+        return 0;
+    }
+
+    const UserMemoryRegion* region = &userMemoryRegions[entry & 0x0f];
+    if ((unsigned) addr < region->start || (unsigned) addr >= region->end)
+        region = &userMemoryRegions[entry >> 4];
+
+    if ((unsigned) addr >= region->start && (unsigned) (addr + count) <= region->end)
+        return region;
+    return 0;
+}
+
+void setUserMemoryMapper(MemMapper* mapper)
+{
+    userMemoryMapper = mapper;
+}
+
+void setUserMemoryConfigImage(ConfigImage* image)
+{
+    userMemoryConfigImage = image;
+    userMemoryRegions[UMT_CONFIG_IMAGE].start = image ? image->windowStart() : 0;
+    userMemoryRegions[UMT_CONFIG_IMAGE].end = image ? image->windowEnd() : 0;
+    userMemoryPageMapValid = false;
+}
+
+void setUserRamStart(int addr)
+{
+    userRamStart = addr;
+    userMemoryPageMapValid = false;
+}
+
+byte* userMemoryPtr(int addr)
+{
+    const UserMemoryRegion* region = findUserMemoryRegion(addr, 1);
+
+    if (region && region->data)
+        return region->data + (addr - region->start);
+    return 0;
+}
+
+/*
+ * Copy to the user RAM. The BCU1 status byte at 0x60 is stored at the end of
+ * the user RAM.
+ */
+static void cpyToUserRam(unsigned int address, const byte * buffer, unsigned int count)
+{
+    address -= getUserRamStart();
+    if ((address > 0x60) || ((address + count) < 0x60))
+    {
+        memcpy(userRamData + address, buffer, count);
+    }
+    else
+    {
+        while (count--)
+        {
+            if (address == 0x60)
+                userRam.status = * buffer;
+            else
+                userRamData[address] = * buffer;
+            buffer++;
+            address++;
+        }
+    }
+}
+
+/*
+ * Copy from the user RAM. The BCU1 status byte at 0x60 is stored at the end of
+ * the user RAM.
+ */
+static void cpyFromUserRam(unsigned int address, byte * buffer, unsigned int count)
+{
+    address -= getUserRamStart();
+    if ((address > 0x60) || ((address + count) < 0x60))
+    {
+        memcpy(buffer, userRamData + address, count);
+    }
+    else
+    {
+        while (count--)
+        {
+            if (address == 0x60)
+                * buffer = userRam.status;
+            else
+                * buffer = userRamData[address];
+            buffer++;
+            address++;
+        }
+    }
+}
+
+bool userMemoryRead(int addr, byte* data, int count)
+{
+    const UserMemoryRegion* region = findUserMemoryRegion(addr, count);
+
+    if (region == &userMemoryRegions[UMT_USER_RAM])
+        cpyFromUserRam(addr, data, count);
+    else if (region == &userMemoryRegions[UMT_CONFIG_IMAGE])
+        return userMemoryConfigImage->read(addr, data, count);
+    else if (region)
+        memcpy(data, region->data + (addr - region->start), count);
+    else if (userMemoryMapper && userMemoryMapper->isMapped(addr))
+    {
+        if (userMemoryMapper->readMemPtr(addr, data, count) != MEM_MAPPER_SUCCESS)
+            return false;
+    }
+    else
+    {
+        memset(data, 0, count);
+        return false;
+    }
+    return true;
+}
+
+bool userMemoryWrite(int addr, const byte* data, int count)
+{
+    const UserMemoryRegion* region = findUserMemoryRegion(addr, count);
+
+    if (region && !region->writable)
+        return false;
+
+    if (region == &userMemoryRegions[UMT_USER_RAM])
+        cpyToUserRam(addr, data, count);
+    else if (region == &userMemoryRegions[UMT_CONFIG_IMAGE])
+        return userMemoryConfigImage->write(addr, data, count);
+    else if (region)
+    {
+        memcpy(region->data + (addr - region->start), data, count);
+        if (region == &userMemoryRegions[UMT_USER_EEPROM])
+        {
+            userEeprom.modified();
+            if (userMemoryConfigImage)
+                userMemoryConfigImage->discard();
+        }
+    }
+    else if (userMemoryMapper && userMemoryMapper->isMapped(addr))
+        return userMemoryMapper->writeMemPtr(addr, (byte*) data, count) == MEM_MAPPER_SUCCESS;
+    else return false;
+
+    return true;
+}
+
 #define NUM_EEPROM_PAGES     (FLASH_SECTOR_SIZE / USER_EEPROM_FLASH_SIZE)
 #define FLASH_SECTOR_ADDRESS (FLASH_BASE_ADDRESS + iapFlashSize() - FLASH_SECTOR_SIZE)
 #define LAST_EEPROM_PAGE     (FLASH_SECTOR_ADDRESS + USER_EEPROM_FLASH_SIZE * (NUM_EEPROM_PAGES - 1))
 
+// The page of the user EEPROM that was read or written last, 0 if none
+static byte* validPage;
+static bool validPageKnown;
+
 /*
  * Find the last valid page in the flash sector
  */
@@ -56,9 +317,33 @@ byte* findValidPage()
     return 0;
 }
 
+/*
+ * Get the last valid page in the flash sector. The page of the last read or
+ * write is used as long as the flash still matches it: it must be in use and
+ * the page after it must be unused. Any other flash write to the sector, e.g.
+ * by a flash update, makes it search the page again.
+ */
+static byte* lastValidPage()
+{
+    if (validPageKnown)
+    {
+        byte* next = validPage ? validPage + USER_EEPROM_FLASH_SIZE : FLASH_SECTOR_ADDRESS;
+
+        if ((!validPage || validPage[USER_EEPROM_SIZE - 1] != 0xff) &&
+            (validPage == LAST_EEPROM_PAGE || next[USER_EEPROM_SIZE - 1] == 0xff))
+        {
+            return validPage;
+        }
+    }
+
+    return findValidPage();
+}
+
 void readUserEeprom()
 {
     byte* page = findValidPage();
+    validPage = page;
+    validPageKnown = true;
 
     if (page) memcpy(userEepromData, page, USER_EEPROM_SIZE);
     else memset(userEepromData, 0, USER_EEPROM_SIZE);
@@ -72,12 +357,15 @@ void writeUserEeprom()
     if (!userEepromModified)
         return;
 
+    PROFILE_PROBE(PROBE_WRITE_USER_EEPROM);
+
     // Wait for an idle bus and then disable the interrupts
     while (!bus.idle())
         ;
     noInterrupts();
 
-    byte* page = findValidPage();
+    // The page is usually known from readUserEeprom() or the last write
+    byte* page = lastValidPage();
     if (page == LAST_EEPROM_PAGE)
     {
         // Erase the sector
@@ -108,6 +396,8 @@ void writeUserEeprom()
 #endif
     if (rc != IAP_SUCCESS) fatalError(); // flashing failed
 
+    validPage = page;
+    validPageKnown = true;
     interrupts();
     userEepromModified = 0;
 }
@@ -13,6 +13,13 @@
 
 #include <sblib/i2c.h>
 
+#ifdef IAP_EMULATION
+// On the host the I2C controller is emulated with a virtual time that passes in WFI
+#  define WAIT_FOR_I2C() __WFI()
+#else
+#  define WAIT_FOR_I2C()
+#endif
+
 static I2C * i2c_m_pInstance;
 I2C* I2C::m_pInstance = 0;
 
@@ -318,6 +325,7 @@ bool I2C::I2CStart( void )
     
   while((this->I2CMasterState != I2CSTATE_PENDING) && (timeout < MAX_TIMEOUT))
   {
+    WAIT_FOR_I2C();
     timeout++;
   }
 
@@ -374,7 +382,8 @@ uint16_t I2C::I2CEngine( void )
   }
 
   // wait until the state is a terminal state
-  while (this->I2CMasterState < 0x100);
+  while (this->I2CMasterState < 0x100)
+    WAIT_FOR_I2C();
 
   return ( this->I2CMasterState );
 }
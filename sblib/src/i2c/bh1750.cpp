@@ -13,6 +13,7 @@
 #include <sblib/i2c.h>
 
 #include <sblib/i2c/bh1750.h>
+#include <sblib/profile_probes.h>
 
 I2C *i2c_bh17;
 
@@ -88,6 +89,7 @@ bool BH1750::PowerDownBH1750()
 *****************************************************************************/
 bool BH1750::GetLux()
 {
+  PROFILE_PROBE(PROBE_BH1750);
   bool bRet= false;
   uint8_t uSendData[2];
   uSendData[0] = BH17_CONFIG;
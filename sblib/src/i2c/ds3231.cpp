@@ -13,6 +13,7 @@
 #include <sblib/i2c.h>
 
 #include <sblib/i2c/ds3231.h>
+#include <sblib/profile_probes.h>
 
 I2C *i2c_ds32;
 
@@ -104,6 +105,7 @@ bool Ds3231::SetTime(ds3231_time_t time)
 *****************************************************************************/
 bool Ds3231::GetTime(ds3231_time_t* time)
 {
+  PROFILE_PROBE(PROBE_DS3231);
   uint8_t data[3];
 
   data[0] = SECONDS;
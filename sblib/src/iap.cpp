@@ -10,6 +10,7 @@
 
 #include <sblib/interrupt.h>
 #include <sblib/platform.h>
+#include <sblib/boot_profile.h>
 #include <string.h>
 
 // The maximum memory that is tested when searching for the flash size, in bytes
@@ -18,6 +19,46 @@
 // The increments when searching for the flash size
 #define FLASH_SIZE_SEARCH_INC 0x2000
 
+/**
+ * The flash size of the parts with a part ID that does not encode the flash size.
+ * See the LPC111x user manual UM10398, chapter "Read Part Identification number".
+ */
+static const struct
+{
+    unsigned int partId;
+    unsigned short flashKb;
+} partFlashSizes[] =
+{
+    { 0x0A07102B, 4 },  { 0x1A07102B, 4 },   // LPC1110
+    { 0x0A16D02B, 8 },  { 0x1A16D02B, 8 },   // LPC1111
+    { 0x041E502B, 8 },  { 0x2516D02B, 8 },
+    { 0x0416502B, 8 },  { 0x2516902B, 8 },
+    { 0x0A24902B, 16 }, { 0x1A24902B, 16 },  // LPC1112
+    { 0x042D502B, 16 }, { 0x2524D02B, 16 },
+    { 0x0425502B, 16 }, { 0x2524902B, 16 },
+    { 0x0434502B, 24 }, { 0x2532902B, 24 },  // LPC1113
+    { 0x0434102B, 24 }, { 0x2532102B, 24 },
+    { 0x0A40902B, 32 }, { 0x1A40902B, 32 },  // LPC1114
+    { 0x0444502B, 32 }, { 0x2540902B, 32 },
+    { 0x0444102B, 32 }, { 0x2540102B, 32 },
+    { 0x1421102B, 16 }, { 0x1440102B, 32 },  // LPC11C12, LPC11C14
+    { 0x1431102B, 16 }, { 0x1430102B, 32 }   // LPC11C22, LPC11C24
+};
+
+int iapFlashSizeOfPartId(unsigned int partId)
+{
+    // LPC111x XL parts (0x000n00xy): the flash size in 8 kB steps is in bits 4..7
+    if ((partId & 0xfff0ff00) == 0 && (partId & 0xf0))
+        return ((partId >> 4) & 0x0f) * 0x2000;
+
+    for (unsigned int i = 0; i < sizeof(partFlashSizes) / sizeof(partFlashSizes[0]); ++i)
+    {
+        if (partFlashSizes[i].partId == partId)
+            return partFlashSizes[i].flashKb * 1024;
+    }
+    return 0;
+}
+
 
 /**
  * IAP command codes.
@@ -210,6 +251,21 @@ int iapFlashSize()
     if (iapFlashBytes)
         return iapFlashBytes;
 
+#ifdef IAP_FLASH_SIZE
+    iapFlashBytes = IAP_FLASH_SIZE;
+#else
+    unsigned int partId;
+    if (iapReadPartID(&partId) == IAP_SUCCESS)
+        iapFlashBytes = iapFlashSizeOfPartId(partId);
+#endif
+
+    if (iapFlashBytes)
+    {
+        BOOT_PROFILE_MARK(BOOT_FLASH_SIZE);
+        return iapFlashBytes;
+    }
+
+    // Unknown part: search for the first invalid sector
     IAP_Parameter p;
     p.cmd = CMD_BLANK_CHECK;
 
@@ -230,5 +286,6 @@ int iapFlashSize()
     }
 
     iapFlashBytes = sector * FLASH_SECTOR_SIZE;
+    BOOT_PROFILE_MARK(BOOT_FLASH_SIZE);
     return iapFlashBytes;
 }
@@ -11,7 +11,10 @@
 #include <sblib/main.h>
 
 #include <sblib/eib.h>
+#include <sblib/boot_profile.h>
+#include <sblib/cpu_load.h>
 #include <sblib/interrupt.h>
+#include <sblib/ram_usage.h>
 #include <sblib/timer.h>
 
 #include <sblib/internal/functions.h>
@@ -46,11 +49,16 @@ void loop_noapp()
  */
 int main()
 {
+    RAM_USAGE_PAINT_STACK();
     lib_setup();
+    BOOT_PROFILE_MARK(BOOT_LIB_SETUP);
     setup();
+    BOOT_PROFILE_MARK(BOOT_SETUP);
 
     while (1)
     {
+        BOOT_PROFILE_MARK(BOOT_FIRST_LOOP);
+        CPU_LOAD_LOOP();
         bcu.loop();
         if (bcu.applicationRunning())
             loop();
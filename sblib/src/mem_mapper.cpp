@@ -14,9 +14,55 @@
 #include <sblib/internal/iap.h>
 #include <sblib/utils.h>
 #include <sblib/mem_mapper.h>
+#include <sblib/profile_probes.h>
 #include <string.h>
 #include <sys/param.h>
 
+// The magic word of a log page header
+#define LOG_MAGIC 0x31474f4c
+
+// An empty slot entry of a log record
+#define LOG_SLOT_EMPTY 0xff
+
+/*
+ * The header of a log page.
+ */
+struct LogPageHeader
+{
+    unsigned int magic;     //!< LOG_MAGIC if the page is valid
+    unsigned int sequence;  //!< Incremented on every compaction, the highest one is active
+};
+
+/*
+ * A record of a log page.
+ */
+struct LogRecord
+{
+    byte slot;              //!< The slot number, LOG_SLOT_EMPTY if unused
+    byte check;             //!< CRC-8 of slot and value
+    byte reserved[2];
+    byte value[4];          //!< The slot contents
+};
+
+#define LOG_RECORDS_PER_PAGE ((FLASH_PAGE_SIZE - sizeof(LogPageHeader)) / sizeof(LogRecord))
+
+/*
+ * Calculate the check byte of a log record: CRC-8 with the polynom x^8+x^2+x+1
+ * over the slot number and the value.
+ */
+static byte logRecordCheck(const LogRecord* rec)
+{
+    byte crc = 0;
+
+    for (int i = -1; i < 4; ++i)
+    {
+        crc ^= (i < 0) ? rec->slot : rec->value[i];
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
 
 MemMapper::MemMapper(unsigned int flashBase, unsigned int flashSize, bool autoAddPage) :
         flashBase(flashBase), flashSize(flashSize), autoAddPage(autoAddPage)
@@ -27,11 +73,18 @@ MemMapper::MemMapper(unsigned int flashBase, unsigned int flashSize, bool autoAd
     writePage = 0;
     allocTableModified = false;
     flashMemModified = false;
-    memcpy(allocTable, (byte *)flashBase, FLASH_PAGE_SIZE);
+    memcpy(allocTable, FLASH_BASE_ADDRESS + flashBase, FLASH_PAGE_SIZE);
+    logVirtPage = 0;
+    logPages = 0;
+    logActive = -1;
+    logOffset = 0;
+    logSequence = 0;
+    logValid = 0;
 }
 
 int MemMapper::doFlash(void) const
 {
+    PROFILE_PROBE(PROBE_MEM_MAPPER_FLASH);
     int ret = 0;
     if (allocTableModified)
     {
@@ -39,7 +92,7 @@ int MemMapper::doFlash(void) const
         {
             fatalError();
         }
-        if (iapProgram((byte *)flashBase, allocTable, FLASH_PAGE_SIZE) != IAP_SUCCESS)
+        if (iapProgram(FLASH_BASE_ADDRESS + flashBase, allocTable, FLASH_PAGE_SIZE) != IAP_SUCCESS)
         {
             fatalError();
         }
@@ -52,7 +105,7 @@ int MemMapper::doFlash(void) const
         {
             fatalError();
         }
-        if (iapProgram((byte *) (writePage << 8), writeBuf, FLASH_PAGE_SIZE)
+        if (iapProgram(FLASH_BASE_ADDRESS + (writePage << 8), writeBuf, FLASH_PAGE_SIZE)
                 != IAP_SUCCESS)
         {
             fatalError();
@@ -63,7 +116,7 @@ int MemMapper::doFlash(void) const
     return ret;
 }
 
-int MemMapper::allocatePage(int virtPage)
+int MemMapper::reservePage()
 {
     if (lastAllocated == 0)
     { // not yet found the highest used entry
@@ -82,12 +135,20 @@ int MemMapper::allocatePage(int virtPage)
     }
     if (lastAllocated == 0)
     {  // no pages allocated yet.
-        writePage = flashBasePage + 1;
-    } else
+        return flashBasePage + 1;
+    }
+    lastAllocated++;
+    return lastAllocated;
+}
+
+int MemMapper::allocatePage(int virtPage)
+{
+    int flashPage = reservePage();
+    if (flashPage < 0)
     {
-        lastAllocated++;
-        writePage = lastAllocated;
+        return flashPage;
     }
+    writePage = flashPage;
     memset(writeBuf, 0, FLASH_PAGE_SIZE);
 
     allocTable[virtPage] = writePage ^ 0xff;
@@ -132,6 +193,177 @@ int MemMapper::addRange(int virtAddress, int length)
     return MEM_MAPPER_SUCCESS;
 }
 
+int MemMapper::addLogRange(int virtAddress, int length)
+{
+    if (logPages)
+    {
+        return MEM_MAPPER_INVALID_ADDRESS; // only one log range is supported
+    }
+    if (length < 2 * FLASH_PAGE_SIZE)
+    {
+        return MEM_MAPPER_INVALID_LENGTH;
+    }
+
+    int result = addRange(virtAddress, length);
+    if (result != MEM_MAPPER_SUCCESS)
+    {
+        return result;
+    }
+
+    logVirtPage = virtAddress >> 8;
+    logPages = length >> 8;
+    logActive = -1;
+    logSequence = 0;
+    logValid = 0;
+    memset(logData, 0, sizeof(logData));
+
+    // Find the page with the highest sequence number
+    for (int page = 0; page < logPages; ++page)
+    {
+        const LogPageHeader* header = (const LogPageHeader*) logPagePtr(page);
+        if (header->magic == LOG_MAGIC && (logActive < 0 || header->sequence > logSequence))
+        {
+            logActive = page;
+            logSequence = header->sequence;
+        }
+    }
+    if (logActive < 0)
+    {
+        return MEM_MAPPER_SUCCESS;
+    }
+
+    // Replay the records of the active page
+    const LogRecord* rec = (const LogRecord*) (logPagePtr(logActive) + sizeof(LogPageHeader));
+    unsigned int idx;
+    for (idx = 0; idx < LOG_RECORDS_PER_PAGE && rec->slot != LOG_SLOT_EMPTY; ++idx, ++rec)
+    {
+        if (rec->slot >= MEM_MAPPER_LOG_SLOTS || rec->check != logRecordCheck(rec))
+        {   // Interrupted write: do not append to this page anymore
+            idx = LOG_RECORDS_PER_PAGE;
+            break;
+        }
+        memcpy(logData + rec->slot * 4, rec->value, 4);
+        logValid |= 1 << rec->slot;
+    }
+    logOffset = sizeof(LogPageHeader) + idx * sizeof(LogRecord);
+
+    return MEM_MAPPER_SUCCESS;
+}
+
+byte* MemMapper::logPagePtr(int page) const
+{
+    return FLASH_BASE_ADDRESS + (getFlashPageNum((logVirtPage + page) << 8) << 8);
+}
+
+bool MemMapper::isLogAddress(int virtAddress) const
+{
+    return logPages && (virtAddress >> 8) >= logVirtPage
+        && (virtAddress >> 8) < logVirtPage + logPages;
+}
+
+int MemMapper::logWrite(int virtAddress, const byte *data, int length)
+{
+    int offset = virtAddress - (logVirtPage << 8);
+
+    if (offset < 0 || offset + length > (int) sizeof(logData))
+    {
+        return MEM_MAPPER_INVALID_ADDRESS;
+    }
+
+    while (length > 0)
+    {
+        int slot = offset >> 2;
+        bool changed = !(logValid & (1 << slot));
+
+        for (; length > 0 && (offset >> 2) == slot; ++offset, ++data, --length)
+        {
+            if (logData[offset] != *data)
+            {
+                logData[offset] = *data;
+                changed = true;
+            }
+        }
+
+        if (changed)
+        {
+            logValid |= 1 << slot;
+            int result = logAppend(slot);
+            if (result != MEM_MAPPER_SUCCESS)
+            {
+                return result;
+            }
+        }
+    }
+    return MEM_MAPPER_SUCCESS;
+}
+
+int MemMapper::logAppend(int slot)
+{
+    if (logActive < 0 || logOffset + sizeof(LogRecord) > FLASH_PAGE_SIZE)
+    {
+        return logCompact();
+    }
+
+    // The write buffer is used as scratch buffer, flush it first
+    doFlash();
+    writePage = 0;
+
+    // Program the records that are already in the page again, the flash
+    // compares the whole page after programming it
+    byte* flashPtr = logPagePtr(logActive);
+    memcpy(writeBuf, flashPtr, FLASH_PAGE_SIZE);
+    LogRecord* rec = (LogRecord*) (writeBuf + logOffset);
+    rec->slot = slot;
+    memcpy(rec->value, logData + slot * 4, 4);
+    rec->check = logRecordCheck(rec);
+
+    if (iapProgram(flashPtr, writeBuf, FLASH_PAGE_SIZE) != IAP_SUCCESS)
+    {
+        fatalError();
+    }
+    logOffset += sizeof(LogRecord);
+    return MEM_MAPPER_SUCCESS;
+}
+
+int MemMapper::logCompact()
+{
+    int page = logActive < 0 ? 0 : (logActive + 1) % logPages;
+
+    doFlash();
+    writePage = 0;
+
+    memset(writeBuf, 0xff, FLASH_PAGE_SIZE);
+    LogPageHeader* header = (LogPageHeader*) writeBuf;
+    header->magic = LOG_MAGIC;
+    header->sequence = ++logSequence;
+
+    LogRecord* rec = (LogRecord*) (writeBuf + sizeof(LogPageHeader));
+    for (int slot = 0; slot < MEM_MAPPER_LOG_SLOTS; ++slot)
+    {
+        if (logValid & (1 << slot))
+        {
+            rec->slot = slot;
+            memcpy(rec->value, logData + slot * 4, 4);
+            rec->check = logRecordCheck(rec);
+            ++rec;
+        }
+    }
+
+    byte* flashPtr = logPagePtr(page);
+    if (iapErasePage(iapPageOfAddress(flashPtr)) != IAP_SUCCESS)
+    {
+        fatalError();
+    }
+    if (iapProgram(flashPtr, writeBuf, FLASH_PAGE_SIZE) != IAP_SUCCESS)
+    {
+        fatalError();
+    }
+
+    logActive = page;
+    logOffset = ((byte*) rec) - writeBuf;
+    return MEM_MAPPER_SUCCESS;
+}
+
 int MemMapper::getFlashPageNum(int virtAddress) const
 {
     int virtPage = virtAddress >> 8;
@@ -146,6 +378,11 @@ int MemMapper::getFlashPageNum(int virtAddress) const
 
 int MemMapper::writeMem(int virtAddress, byte data)
 {
+    if (isLogAddress(virtAddress))
+    {
+        return logWrite(virtAddress, &data, 1);
+    }
+
     int flashPageNum = getFlashPageNum(virtAddress);
     if (flashPageNum < 0)
     {
@@ -157,7 +394,7 @@ int MemMapper::writeMem(int virtAddress, byte data)
         writePage = flashPageNum;
         if (writePage != 0)
         { // swap flash page into write buffer
-            memcpy(writeBuf, (byte *)(writePage << 8), FLASH_PAGE_SIZE);
+            memcpy(writeBuf, FLASH_BASE_ADDRESS + (writePage << 8), FLASH_PAGE_SIZE);
         }
     }
 
@@ -181,6 +418,10 @@ int MemMapper::writeMem(int virtAddress, byte data)
 
 int MemMapper::writeMemPtr(int virtAddress, byte *data, int length)
 {
+    if (isLogAddress(virtAddress))
+    {
+        return logWrite(virtAddress, data, length);
+    }
     for (int i = 0; i < length; i++)
     {
         int result;
@@ -195,6 +436,13 @@ int MemMapper::writeMemPtr(int virtAddress, byte *data, int length)
 
 int MemMapper::readMem(int virtAddress, byte &data, bool forceFlash)
 {
+    if (isLogAddress(virtAddress))
+    {
+        byte* ptr = memoryPtr(virtAddress, false);
+        data = ptr ? *ptr : 0x00;
+        return ptr ? MEM_MAPPER_SUCCESS : MEM_MAPPER_INVALID_ADDRESS;
+    }
+
     int flashPageNum = getFlashPageNum(virtAddress);
 
     if (flashPageNum < 0)
@@ -215,7 +463,7 @@ int MemMapper::readMem(int virtAddress, byte &data, bool forceFlash)
         data = writeBuf[virtAddress & 0xff];
     } else
     {
-        data = ((byte*) (flashPageNum << 8))[virtAddress & 0xff];
+        data = (FLASH_BASE_ADDRESS + (flashPageNum << 8))[virtAddress & 0xff];
     }
     return MEM_MAPPER_SUCCESS;
 }
@@ -242,6 +490,12 @@ bool MemMapper::isMapped(int virtAddress)
 
 byte* MemMapper::memoryPtr(int virtAddress, bool forceFlash) const
 {
+    if (isLogAddress(virtAddress))
+    {
+        int offset = virtAddress - (logVirtPage << 8);
+        return offset < (int) sizeof(logData) ? logData + offset : NULL;
+    }
+
     int flashPageNum = getFlashPageNum(virtAddress);
 
     if (flashPageNum < 0)
@@ -259,7 +513,7 @@ byte* MemMapper::memoryPtr(int virtAddress, bool forceFlash) const
     {
         return writeBuf + (virtAddress & 0xff);
     }
-    return ((byte*) (flashPageNum << 8) + (virtAddress & 0xff));
+    return FLASH_BASE_ADDRESS + (flashPageNum << 8) + (virtAddress & 0xff);
 }
 
  unsigned char MemMapper::getUInt8(int virtAddress)
@@ -312,6 +566,21 @@ int MemMapper::setUIntX(int virtAddress, int length, int val)
 {
 	unsigned int ret = 0;
 	int address;
+
+	if (isLogAddress(virtAddress))
+	{   // Collect the bytes to write them with a single log record
+		byte buf[4];
+		for(int i = 0; i < length; i++)
+		{
+			if(endianess == BIG_ENDIAN)
+				buf[length - i - 1] = val & 0xff;
+			else
+				buf[i] = val & 0xff;
+			val >>= 8;
+		}
+		return logWrite(virtAddress, buf, length);
+	}
+
 	for(int i = 0; i < length; i++)
 	{
 		if(endianess == BIG_ENDIAN)
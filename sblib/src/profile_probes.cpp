@@ -0,0 +1,114 @@
+/*
+ *  profile_probes.cpp - Record the time spent in the hot paths of the main loop.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/profile_probes.h>
+
+#include <sblib/print.h>
+#include <sblib/ram_usage.h>
+#include <sblib/timer.h>
+
+// The ring buffer of the events
+static ProfileEvent profileEvents[PROFILE_BUFFER_SIZE];
+
+// The index of the next event to write
+static int profileHead;
+
+// The number of events in the ring buffer
+static int profileCount;
+
+static const char* const profileProbeNames[PROBE_USER] =
+{
+    "bcu loop",
+    "process telegram",
+    "write user eeprom",
+    "mem mapper flash",
+    "ds18x20",
+    "dht",
+    "bh1750",
+    "ds3231"
+};
+
+void profileRecord(int probe, bool exit)
+{
+    ProfileEvent& event = profileEvents[profileHead];
+
+    event.time = micros();
+    event.probe = probe;
+    event.exit = exit;
+
+    if (++profileHead >= PROFILE_BUFFER_SIZE)
+        profileHead = 0;
+    if (profileCount < PROFILE_BUFFER_SIZE)
+    {
+        if (!profileCount)
+            RAM_USAGE_REGISTER(RAM_PROFILE_EVENTS, "profile events", PROFILE_BUFFER_SIZE);
+
+        ++profileCount;
+        RAM_USAGE_FILL(RAM_PROFILE_EVENTS, profileCount);
+    }
+}
+
+int profileEventCount()
+{
+    return profileCount;
+}
+
+const ProfileEvent& profileEvent(int index)
+{
+    index += profileHead - profileCount;
+    if (index < 0)
+        index += PROFILE_BUFFER_SIZE;
+    return profileEvents[index];
+}
+
+void profileClear()
+{
+    profileHead = 0;
+    profileCount = 0;
+}
+
+void profileDump(Print& out)
+{
+    // The time of the last enter event of each probe, if it is in the buffer
+    unsigned int enterTime[PROBE_MAX];
+    unsigned int entered = 0;
+
+    for (int i = 0; i < profileCount; ++i)
+    {
+        const ProfileEvent& event = profileEvent(i);
+        int probe = event.probe & (PROBE_MAX - 1);
+
+        out.print(event.time);
+        out.print(" ");
+        if (probe < PROBE_USER && profileProbeNames[probe])
+            out.print(profileProbeNames[probe]);
+        else
+        {
+            out.print("probe ");
+            out.print(probe);
+        }
+
+        if (!event.exit)
+        {
+            out.println(" >");
+            enterTime[probe] = event.time;
+            entered |= 1 << probe;
+            continue;
+        }
+
+        out.print(" <");
+        if (entered & (1 << probe))
+        {
+            out.print(" ");
+            out.print(event.time - enterTime[probe]);
+            out.print(" us");
+            entered &= ~(1 << probe);
+        }
+        out.println();
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ *  ram_usage.cpp - Measure the stack usage and the fill level of the buffers.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <sblib/ram_usage.h>
+
+#include <sblib/print.h>
+
+#ifdef IAP_EMULATION
+unsigned int emuStack[EMU_STACK_WORDS];
+
+#  define STACK_BOTTOM emuStack
+#  define STACK_TOP    (emuStack + EMU_STACK_WORDS)
+#else
+// Provided by the linker script: the end of the static data and the top of the stack
+extern unsigned int _pvHeapStart[];
+extern unsigned int _vStackTop[];
+
+#  define STACK_BOTTOM _pvHeapStart
+#  define STACK_TOP    _vStackTop
+#endif
+
+// The number of words below the stack pointer that are not painted,
+// for the stack frame of stackPaint()
+#define PAINT_MARGIN 32
+
+/*
+ * A registered buffer.
+ */
+struct RamBuffer
+{
+    const char* name;
+    unsigned short size;
+    volatile unsigned short peak;
+};
+
+static RamBuffer buffers[RAM_BUFFER_MAX];
+
+void stackPaint()
+{
+    unsigned int marker;
+    unsigned int* end = &marker - PAINT_MARGIN;
+
+    // On the host the stack pointer is outside of the emulated stack
+    if (end < STACK_BOTTOM || end > STACK_TOP)
+        end = STACK_TOP;
+
+    for (unsigned int* pos = STACK_BOTTOM; pos < end; ++pos)
+        *pos = STACK_PAINT;
+}
+
+unsigned int stackSize()
+{
+    return (STACK_TOP - STACK_BOTTOM) * sizeof(unsigned int);
+}
+
+unsigned int stackHighWater()
+{
+    unsigned int* pos = STACK_BOTTOM;
+    while (pos < STACK_TOP && *pos == STACK_PAINT)
+        ++pos;
+
+    return (STACK_TOP - pos) * sizeof(unsigned int);
+}
+
+void ramUsageRegister(int id, const char* name, unsigned int size)
+{
+    buffers[id].name = name;
+    buffers[id].size = size;
+}
+
+void ramUsageFill(int id, unsigned int level)
+{
+    if (level > buffers[id].peak)
+        buffers[id].peak = level;
+}
+
+unsigned int ramUsagePeak(int id)
+{
+    return buffers[id].peak;
+}
+
+void ramUsageReset()
+{
+    for (int id = 0; id < RAM_BUFFER_MAX; ++id)
+        buffers[id].peak = 0;
+}
+
+void ramUsageReport(Print& out)
+{
+    out.print("stack: ");
+    out.print(stackHighWater());
+    out.print(" of ");
+    out.print(stackSize());
+    out.println(" bytes");
+
+    for (int id = 0; id < RAM_BUFFER_MAX; ++id)
+    {
+        const RamBuffer& buffer = buffers[id];
+        if (!buffer.name)
+            continue;
+
+        out.print(buffer.name);
+        out.print(": ");
+        out.print((unsigned int) buffer.peak);
+        out.print(" of ");
+        out.println((unsigned int) buffer.size);
+    }
+}
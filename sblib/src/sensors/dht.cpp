@@ -13,6 +13,7 @@
 #include <sblib/digital_pin.h>
 
 #include <sblib/sensors/dht.h>
+#include <sblib/profile_probes.h>
 
 /*****************************************************************************
 ** Function name:  DHTInit
@@ -50,6 +51,7 @@ void DHT::DHTInit(int pin,int DHTtype)
 *****************************************************************************/
 bool DHT::readData(bool bForceRead)
 {
+  PROFILE_PROBE(PROBE_DHT);
   bool bRet= false;
   this->_lastError= ERROR_NONE;
   int currenttime = millis();
@@ -12,6 +12,7 @@
 #include <sblib/core.h>
 
 #include <sblib/sensors/ds18x20.h>
+#include <sblib/profile_probes.h>
 
 
 /*****************************************************************************
@@ -107,6 +108,7 @@ bool DS18x20::Search(uint8_t uMaxDeviceSearch)
 *****************************************************************************/
 bool DS18x20::readTemperature( sDS18x20 *sDev)
 {
+  PROFILE_PROBE(PROBE_DS18X20);
   bool bRet= false;
   if( ( sDev->type != DS_UNKNOWN || sDev->addr[0] ) && this->_OW_DS18x->OneWireReset() )
   {
@@ -13,6 +13,7 @@
 #include <sblib/digital_pin.h>
 #include <sblib/interrupt.h>
 #include <sblib/platform.h>
+#include <sblib/ram_usage.h>
 
 
 // UART line status: receive data ready bit: RBR holds an unread character
@@ -45,6 +46,16 @@
 // UART transmit-hold-register-empty interrupt
 #define UART_IE_THRE 0x02
 
+// The size of the transmit FIFO of the UART
+#define UART_TX_FIFO_SIZE 16
+
+#ifdef IAP_EMULATION
+// On the host the UART is emulated with a virtual time that passes in WFI
+#  define WAIT_FOR_UART() __WFI()
+#else
+#  define WAIT_FOR_UART()
+#endif
+
 
 Serial::Serial(int rxPin, int txPin)
 {
@@ -86,6 +97,9 @@ void Serial::begin(int baudRate, SerialConfig config)
     flush();
     clearBuffers();
 
+    RAM_USAGE_REGISTER(RAM_SERIAL_RX, "serial rx", READ_BUFFER_SIZE);
+    RAM_USAGE_REGISTER(RAM_SERIAL_TX, "serial tx", WRITE_BUFFER_SIZE);
+
     // Drop data from the RX FIFO
     while (LPC_UART->LSR & LSR_RDR)
         val = LPC_UART->RBR;
@@ -106,13 +120,13 @@ int Serial::write(byte ch)
 
     // wait until the transmitter hold register is free
    while (!(LPC_UART->LSR & LSR_THRE))
-       ;
+       WAIT_FOR_UART();
    LPC_UART->THR = ch;
    return 1;
 
 #else
 
-    if (writeHead == writeTail && (LPC_UART->LSR & LSR_THRE))
+    if (writeBuffer.empty() && (LPC_UART->LSR & LSR_THRE))
     {
         // Transmitter hold register and write buffer are empty -> directly send
         LPC_UART->THR = ch;
@@ -120,30 +134,88 @@ int Serial::write(byte ch)
         return 1;
     }
 
-    int writeTailNext = (writeTail + 1) & BufferedStream::BUFFER_SIZE_MASK;
-
     // Wait until the output buffer has space
-    while (writeHead == writeTailNext)
-        ;
+    while (!writeBuffer.push(ch))
+        WAIT_FOR_UART();
 
-    writeBuffer[writeTail] = ch;
-    writeTail = writeTailNext;
     LPC_UART->IER |= UART_IE_THRE;
+    RAM_USAGE_FILL(RAM_SERIAL_TX, writeBuffer.count());
 
     return 1;
 
 #endif
 }
 
-void Serial::flush()
+int Serial::write(const byte* data, int count)
 {
 #ifdef SERIAL_WRITE_DIRECT
-    while ((LPC_UART->LSR & (LSR_THRE|LSR_TEMT)) != (LSR_THRE|LSR_TEMT))
-        ;
+
+    return Print::write(data, count);
+
+#else
+
+    int written = 0;
+
+    while (written < count)
+    {
+        int len = tryWrite(data + written, count - written);
+        if (!len)
+            WAIT_FOR_UART();
+        written += len;
+    }
+
+    return written;
+
+#endif
+}
+
+int Serial::tryWrite(const byte* data, int count)
+{
+#ifdef SERIAL_WRITE_DIRECT
+
+    if (!(LPC_UART->LSR & LSR_THRE))
+        return 0;
+
+    if (count > UART_TX_FIFO_SIZE)
+        count = UART_TX_FIFO_SIZE;
+    for (int i = 0; i < count; ++i)
+        LPC_UART->THR = data[i];
+    return count;
+
+#else
+
+    count = writeBuffer.push(data, count);
+    if (!count)
+        return 0;
+    RAM_USAGE_FILL(RAM_SERIAL_TX, writeBuffer.count());
+
+    // Start sending if the transmitter is idle
+    disableInterrupt(UART_IRQn);
+    fillTxFifo();
+    enableInterrupt(UART_IRQn);
+
+    return count;
+
+#endif
+}
+
+int Serial::availableForWrite()
+{
+#ifdef SERIAL_WRITE_DIRECT
+    return (LPC_UART->LSR & LSR_THRE) ? UART_TX_FIFO_SIZE : 0;
 #else
-    while (writeHead != writeTail)
-    		;
+    return writeBuffer.space();
+#endif
+}
+
+void Serial::flush()
+{
+#ifndef SERIAL_WRITE_DIRECT
+    while (!writeBuffer.empty())
+        WAIT_FOR_UART();
 #endif
+    while ((LPC_UART->LSR & (LSR_THRE|LSR_TEMT)) != (LSR_THRE|LSR_TEMT))
+        WAIT_FOR_UART();
 }
 
 int Serial::read()
@@ -161,28 +233,26 @@ int Serial::read()
     return ch;
 }
 
-void Serial::interruptHandler()
+void Serial::fillTxFifo()
 {
+    // THRE is set when the transmit FIFO is empty
     if (LPC_UART->LSR & LSR_THRE)
     {
-        if (writeHead == writeTail)
-        {
-            LPC_UART->IER &= ~UART_IE_THRE;
-        }
-        else
-        {
-            LPC_UART->THR = writeBuffer[writeHead];
-
-            ++writeHead;
-            writeHead &= BufferedStream::BUFFER_SIZE_MASK;
-        }
+        byte ch;
+        for (int i = 0; i < UART_TX_FIFO_SIZE && writeBuffer.pop(ch); ++i)
+            LPC_UART->THR = ch;
     }
 
-    while ((LPC_UART->LSR & LSR_RDR) && !readBufferFull())
-    {
-        readBuffer[readTail] = LPC_UART->RBR;
+    if (writeBuffer.empty())
+        LPC_UART->IER &= ~UART_IE_THRE;
+    else LPC_UART->IER |= UART_IE_THRE;
+}
 
-        ++readTail;
-        readTail &= BufferedStream::BUFFER_SIZE_MASK;
-    }
+void Serial::interruptHandler()
+{
+    fillTxFifo();
+
+    while ((LPC_UART->LSR & LSR_RDR) && !readBufferFull())
+        readBuffer.push(LPC_UART->RBR);
+    RAM_USAGE_FILL(RAM_SERIAL_RX, readBuffer.count());
 }
@@ -120,7 +120,10 @@ int SPI::transfer(int val, SpiTransferMode transferMode)
 {
     // Clear all remaining data in the receive FIFO
     while (port.SR & SSP_SR_RNE)
-        port.DR;  // reading is supported without assignment to a temporary variable
+    {
+        volatile int discard = port.DR;
+        (void) discard;
+    }
 
     // Clear the interrupt status
     port.ICR = SSP_ICR_BITMASK;
@@ -144,7 +147,10 @@ void SPI::transferBlock(uint16_t * sndData, int bytes, uint16_t * recData, bool
 {
     // Clear all remaining data in the receive FIFO
     while (port.SR & SSP_SR_RNE)
-        port.DR;  // reading is supported without assignment to a temporary variable
+    {
+        volatile int discard = port.DR;
+        (void) discard;
+    }
 
     this->sndData = sndData;
     this->recData = recData;
@@ -10,6 +10,7 @@
 
 #include <sblib/timer.h>
 
+#include <sblib/interrupt.h>
 #include <sblib/internal/variables.h>
 
 
@@ -28,7 +29,7 @@ void delay(unsigned int msec)
     {
         if (lastSystemTime == systemTime)
         {
-            __WFI();
+            waitForInterrupt();
         }
         else
         {
@@ -38,6 +39,30 @@ void delay(unsigned int msec)
     }
 }
 
+unsigned int micros()
+{
+    unsigned int msec, val;
+
+    // Read again if the system timer interrupt incremented systemTime meanwhile
+    do
+    {
+        msec = systemTime;
+        val = SysTick->VAL;
+    }
+    while (msec != systemTime);
+
+    // The system timer reached zero but its interrupt is not handled yet,
+    // e.g. when called with disabled interrupts
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        val = SysTick->VAL;
+        ++msec;
+    }
+
+    // SysTick is counting down from SysTick->LOAD to 0 once every millisecond
+    return msec * 1000 + clockCyclesToMicroseconds(SysTick->LOAD - val);
+}
+
 #ifndef IAP_EMULATION
 void delayMicroseconds(unsigned int usec)
 {
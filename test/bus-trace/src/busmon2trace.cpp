@@ -0,0 +1,185 @@
+/*
+ *  busmon2trace.cpp - Convert the output of the bus monitor to a binary trace.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  The input is the text that examples/example-busmon prints: one frame per
+ *  line as hex bytes with the checksum, e.g.
+ *      BC 11 01 08 01 E1 00 81 5B
+ *  A line may start with the time of the frame in milliseconds, as printed by
+ *  the bus monitor when compiled with BUSMON_TIMESTAMPS:
+ *      123456: BC 11 01 08 01 E1 00 81 5B
+ *  A line with a single byte is the acknowledge of the previous frame. Lines
+ *  that are no frames, like the greeting of the bus monitor, are skipped.
+ *
+ *  Frames without a time are placed after the previous frame as if the bus
+ *  was busy with the given load: a frame, its acknowledge and the 50 bit
+ *  times a sender waits for a free bus.
+ *
+ *  Usage: busmon2trace [-l load] busmon.txt output.trace
+ *    -l the bus load in percent for frames without a time, default 100
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus_trace.h"
+
+// The time of one bit on the bus in microseconds
+#define BIT_TIME 104
+
+// The time a sender waits for a free bus: 50 bit times
+#define FREE_BUS_TIME (50 * BIT_TIME)
+
+// The time of an acknowledge after a frame: 15 bit times pause and one byte
+#define ACK_TIME (15 * BIT_TIME + 13 * BIT_TIME)
+
+/*
+ * Parse a line of the bus monitor.
+ *
+ * @param line - the line.
+ * @param record - the frame, the time is not changed.
+ * @param msec - set to the time in milliseconds, or -1 if the line has no time.
+ * @return True if the line contains a frame.
+ */
+static bool parseLine(const char* line, TraceRecord* record, long long* msec)
+{
+    const char* pos = line;
+    char* end;
+
+    *msec = -1;
+    while (isspace(*pos))
+        ++pos;
+
+    const char* colon = strchr(pos, ':');
+    if (colon)
+    {
+        *msec = strtoll(pos, &end, 10);
+        if (end == pos || end != colon)
+            return false;
+        pos = colon + 1;
+    }
+
+    record->length = 0;
+    for (;;)
+    {
+        while (isspace(*pos))
+            ++pos;
+        if (!*pos)
+            break;
+
+        if (!isxdigit(pos[0]) || !isxdigit(pos[1]) || (pos[2] && !isspace(pos[2])))
+            return false;
+        if (record->length >= TRACE_MAX_FRAME)
+            return false;
+
+        record->data[record->length++] = strtol(pos, &end, 16);
+        pos = end;
+    }
+
+    record->ack = 0;
+    return record->length > 0;
+}
+
+int main(int argc, char** argv)
+{
+    TraceRecord pending, record;
+    unsigned long long lastTime = 0;
+    unsigned int frames = 0, acks = 0, skipped = 0;
+    bool havePending = false;
+    int load = 100;
+    int arg = 1;
+    char line[1024];
+    long long msec;
+
+    if (argc > 2 && !strcmp(argv[arg], "-l"))
+    {
+        load = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (argc - arg != 2 || load <= 0 || load > 100)
+    {
+        fprintf(stderr, "usage: %s [-l load] busmon.txt output.trace\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[arg], "r");
+    if (!in)
+    {
+        perror(argv[arg]);
+        return 1;
+    }
+    FILE* out = fopen(argv[arg + 1], "wb");
+    if (!out || !traceWriteHeader(out))
+    {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+
+    memset(&pending, 0, sizeof(pending));
+    while (fgets(line, sizeof(line), in))
+    {
+        if (!parseLine(line, &record, &msec))
+        {
+            ++skipped;
+            continue;
+        }
+
+        if (record.length == 1)
+        {   // the acknowledge of the previous frame
+            if (havePending && !pending.ack)
+            {
+                pending.ack = record.data[0];
+                ++acks;
+            }
+            else ++skipped;
+            continue;
+        }
+
+        if (msec >= 0)
+            record.time = msec * 1000;
+        else if (!havePending)
+            record.time = traceFrameTime(record.length);
+        else
+        {
+            unsigned int busy = ACK_TIME + FREE_BUS_TIME + traceFrameTime(record.length);
+            record.time = pending.time + busy * 100ULL / load;
+        }
+
+        if (havePending)
+        {
+            if (record.time < pending.time)
+                record.time = pending.time;
+            if (!traceWrite(out, &pending, lastTime))
+            {
+                perror(argv[arg + 1]);
+                return 1;
+            }
+            lastTime = pending.time;
+        }
+
+        pending = record;
+        havePending = true;
+        ++frames;
+    }
+
+    if (havePending && !traceWrite(out, &pending, lastTime))
+    {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+
+    fclose(in);
+    if (fclose(out))
+    {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+
+    printf("%u frames, %u acknowledges, %u lines skipped\n", frames, acks, skipped);
+    return 0;
+}
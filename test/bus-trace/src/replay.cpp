@@ -0,0 +1,365 @@
+/*
+ *  replay.cpp - Replay a bus trace against the library in the host emulation.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  The replay loads the user EEPROM image of a device into the emulated flash,
+ *  starts the BCU and feeds every telegram of a trace (see bus_trace.h) to
+ *  bcu.processTelegram() at the time of the trace. It reports:
+ *    - the processing time of the telegrams on the PC, per kind of telegram
+ *    - the telegrams that the device sent in response
+ *    - the depth of the send queue of the device over time
+ *
+ *  The send queue is modelled: a telegram of the device is sent when the bus
+ *  is free, that is 50 bit times after the end of the previous frame, and it
+ *  has to end before the next frame of the trace starts. The telegrams of the
+ *  device are always acknowledged. The send queue of the library holds two
+ *  telegrams (Bus::sendCurTelegram and Bus::sendNextTel), a deeper queue means
+ *  that the device would have blocked in Bus::sendTelegram().
+ *
+ *  If the library blocks while processing a telegram because its send queue
+ *  is full, a timer signal takes the telegrams out of the queue like the bus
+ *  interrupt would do. This is counted as a stall, the time of the stall is
+ *  not included in the processing time.
+ *
+ *  Usage: bus-trace-replay [-c results.csv] eeprom.bin input.trace
+ *    eeprom.bin  the user EEPROM of the device, USER_EEPROM_SIZE bytes, as
+ *                read from USER_EEPROM_START
+ *    -c          writes a line for every telegram as CSV:
+ *                index,time_us,length,kind,ns,responses,queue_depth
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define private public
+#define protected public
+#include <sblib/eib/bus.h>
+#undef protected
+#undef private
+#include <sblib/eib.h>
+#include <sblib/eib/apci.h>
+#include <sblib/eib/user_memory.h>
+#include <sblib/eib/sblib_default_objects.h>
+#include <sblib/internal/iap.h>
+#include <sblib/internal/variables.h>
+#include "iap_emu.h"
+#include "bus_trace.h"
+
+// The time of one bit on the bus in microseconds
+#define BIT_TIME 104
+
+// The time a sender waits for a free bus: 50 bit times
+#define FREE_BUS_TIME (50 * BIT_TIME)
+
+// The time of an acknowledge after a frame: 15 bit times pause and one byte
+#define ACK_TIME (15 * BIT_TIME + 13 * BIT_TIME)
+
+// The size of the send queue of the library
+#define LIB_QUEUE_SIZE 2
+
+// The size of the modelled send queue
+#define QUEUE_SIZE 1024
+
+// The time after that a blocked library is unblocked, in microseconds
+#define STALL_TIMEOUT 50000
+
+// The kinds of telegrams
+enum
+{
+    KIND_GROUP_WRITE,
+    KIND_GROUP_READ,
+    KIND_GROUP_RESPONSE,
+    KIND_GROUP_OTHER,
+    KIND_BROADCAST,
+    KIND_INDIVIDUAL_OWN,
+    KIND_INDIVIDUAL_OTHER,
+    KIND_INVALID,
+    KIND_COUNT
+};
+
+static const char* kindNames[KIND_COUNT] =
+{
+    "group write", "group read", "group response", "group other",
+    "broadcast", "individual own", "individual other", "invalid"
+};
+
+/*
+ * A telegram in the modelled send queue.
+ */
+struct QueuedTelegram
+{
+    unsigned long long readyAt;     //!< The time the telegram was queued
+    int length;                     //!< The length with the checksum
+    byte data[Bus::TELEGRAM_SIZE];  //!< The telegram
+};
+
+static QueuedTelegram queue[QUEUE_SIZE];
+static int queueHead, queueCount;
+static unsigned long long txFreeAt;      // The time the device may start to send
+static unsigned long long currentTime;   // The time of the current telegram
+
+/*
+ * The statistics of a kind of telegrams.
+ */
+struct KindStats
+{
+    unsigned int count;             //!< The number of telegrams
+    unsigned int responses;         //!< The telegrams the device sent in response
+    double totalNs;                 //!< The total processing time
+    double maxNs;                   //!< The longest processing time
+};
+
+static KindStats kindStats[KIND_COUNT];
+static volatile unsigned int stalls;
+static unsigned int responses, dropped, sent;
+static unsigned int overLibQueue;
+static int maxDepth;
+static double depthSum;
+
+static long long nanoTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Move the telegrams from the send queue of the library to the modelled queue.
+ */
+static void collectSent()
+{
+    while (bus.sendCurTelegram)
+    {
+        if (queueCount < QUEUE_SIZE)
+        {
+            QueuedTelegram& tel = queue[(queueHead + queueCount) % QUEUE_SIZE];
+            tel.readyAt = currentTime;
+            tel.length = telegramSize(bus.sendCurTelegram) + 1;
+            if (tel.length > Bus::TELEGRAM_SIZE)
+                tel.length = Bus::TELEGRAM_SIZE;
+            memcpy(tel.data, (const byte*) bus.sendCurTelegram, tel.length);
+            ++queueCount;
+        }
+        else ++dropped;
+
+        ++responses;
+        bus.sendCurTelegram = bus.sendNextTel;
+        bus.sendNextTel = 0;
+    }
+    bus.state = Bus::IDLE;
+}
+
+/*
+ * The library blocks in Bus::sendTelegram(): do what the bus interrupt would do.
+ */
+static void stallHandler(int signal)
+{
+    ++stalls;
+    collectSent();
+}
+
+/*
+ * Send the queued telegrams that fit on the bus before the given time.
+ */
+static void drainQueue(unsigned long long until)
+{
+    while (queueCount)
+    {
+        QueuedTelegram& tel = queue[queueHead];
+        unsigned long long start = txFreeAt > tel.readyAt ? txFreeAt : tel.readyAt;
+        unsigned long long end = start + FREE_BUS_TIME + traceFrameTime(tel.length) + ACK_TIME;
+
+        if (end > until)
+            break;
+
+        txFreeAt = end;
+        queueHead = (queueHead + 1) % QUEUE_SIZE;
+        --queueCount;
+        ++sent;
+    }
+}
+
+static int telegramKind(const TraceRecord& record)
+{
+    if (record.length < 8 || record.length != telegramSize(record.data) + 1)
+        return KIND_INVALID;
+
+    int dest = (record.data[3] << 8) | record.data[4];
+    int apci = ((record.data[6] & 3) << 8) | record.data[7];
+
+    if (!(record.data[5] & 0x80))
+        return dest == bus.ownAddress() ? KIND_INDIVIDUAL_OWN : KIND_INDIVIDUAL_OTHER;
+    if (dest == 0)
+        return KIND_BROADCAST;
+
+    switch (apci & APCI_GROUP_MASK)
+    {
+    case APCI_GROUP_VALUE_WRITE_PDU: return KIND_GROUP_WRITE;
+    case APCI_GROUP_VALUE_READ_PDU: return KIND_GROUP_READ;
+    case APCI_GROUP_VALUE_RESPONSE_PDU: return KIND_GROUP_RESPONSE;
+    }
+    return KIND_GROUP_OTHER;
+}
+
+static void loadEeprom(const char* fileName)
+{
+    static byte image[USER_EEPROM_SIZE];
+
+    FILE* file = fopen(fileName, "rb");
+    if (!file)
+    {
+        perror(fileName);
+        exit(1);
+    }
+    memset(image, 0xff, sizeof(image));
+    size_t size = fread(image, 1, sizeof(image), file);
+    fclose(file);
+    if (!size)
+    {
+        fprintf(stderr, "%s: the EEPROM image is empty\n", fileName);
+        exit(1);
+    }
+
+    IAP_Init_Flash(0xFF);
+    memcpy(FLASH_BASE_ADDRESS + iapFlashSize() - FLASH_SECTOR_SIZE, image, USER_EEPROM_SIZE);
+
+    // Start with the manufacturer, device type and version of the image
+    const UserEeprom& eeprom = *(const UserEeprom*) image;
+    bcu.begin((eeprom.manufacturerH << 8) | eeprom.manufacturerL,
+              (eeprom.deviceTypeH << 8) | eeprom.deviceTypeL, eeprom.version);
+}
+
+int main(int argc, char** argv)
+{
+    FILE* csv = 0;
+    int arg = 1;
+
+    if (argc > 2 && !strcmp(argv[arg], "-c"))
+    {
+        csv = fopen(argv[arg + 1], "w");
+        if (!csv)
+        {
+            perror(argv[arg + 1]);
+            return 1;
+        }
+        fprintf(csv, "index,time_us,length,kind,ns,responses,queue_depth\n");
+        arg += 2;
+    }
+    if (argc - arg != 2)
+    {
+        fprintf(stderr, "usage: %s [-c results.csv] eeprom.bin input.trace\n", argv[0]);
+        return 1;
+    }
+
+    FILE* trace = fopen(argv[arg + 1], "rb");
+    if (!trace)
+    {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+    if (!traceReadHeader(trace))
+    {
+        fprintf(stderr, "%s: not a trace file\n", argv[arg + 1]);
+        return 1;
+    }
+
+    loadEeprom(argv[arg]);
+    signal(SIGALRM, stallHandler);
+
+    TraceRecord record;
+    struct itimerval watchdog, off;
+    unsigned int index = 0;
+    int result;
+
+    memset(&record, 0, sizeof(record));
+    memset(&off, 0, sizeof(off));
+    memset(&watchdog, 0, sizeof(watchdog));
+    watchdog.it_value.tv_usec = STALL_TIMEOUT;
+    watchdog.it_interval.tv_usec = STALL_TIMEOUT;
+
+    while ((result = traceRead(trace, &record)) > 0)
+    {
+        int kind = telegramKind(record);
+        unsigned int before = responses;
+
+        // The frame of the trace started when the bus was free
+        unsigned long long frameStart = record.time - traceFrameTime(record.length);
+        drainQueue(frameStart < record.time ? frameStart : 0);
+        currentTime = record.time;
+        systemTime = record.time / 1000;
+
+        unsigned long long busyUntil = record.time + (record.ack ? ACK_TIME : 0);
+        if (txFreeAt < busyUntil)
+            txFreeAt = busyUntil;
+
+        double ns = 0;
+        if (kind != KIND_INVALID && record.length <= Bus::TELEGRAM_SIZE)
+        {
+            memcpy(bus.telegram, record.data, record.length);
+            bus.telegramLen = record.length;
+
+            unsigned int stallsBefore = stalls;
+            setitimer(ITIMER_REAL, &watchdog, 0);
+            long long start = nanoTime();
+            bcu.processTelegram();
+            long long end = nanoTime();
+            setitimer(ITIMER_REAL, &off, 0);
+
+            ns = end - start - (stalls - stallsBefore) * STALL_TIMEOUT * 1000.0;
+            if (ns < 0)
+                ns = 0;
+            collectSent();
+        }
+
+        KindStats& stats = kindStats[kind];
+        ++stats.count;
+        stats.responses += responses - before;
+        stats.totalNs += ns;
+        if (ns > stats.maxNs)
+            stats.maxNs = ns;
+
+        if (queueCount > maxDepth)
+            maxDepth = queueCount;
+        if (queueCount > LIB_QUEUE_SIZE)
+            ++overLibQueue;
+        depthSum += queueCount;
+
+        if (csv)
+        {
+            fprintf(csv, "%u,%llu,%d,%s,%.0f,%u,%d\n", index, record.time, record.length,
+                    kindNames[kind], ns, responses - before, queueCount);
+        }
+        ++index;
+    }
+    fclose(trace);
+    if (csv)
+        fclose(csv);
+
+    if (result < 0)
+        fprintf(stderr, "%s: the trace is truncated after %u frames\n", argv[arg + 1], index);
+
+    drainQueue((unsigned long long) -1);
+
+    printf("%-18s %8s %10s %10s %10s\n", "kind", "count", "responses", "avg[ns]", "max[ns]");
+    for (int kind = 0; kind < KIND_COUNT; ++kind)
+    {
+        const KindStats& stats = kindStats[kind];
+        if (!stats.count)
+            continue;
+        printf("%-18s %8u %10u %10.0f %10.0f\n", kindNames[kind], stats.count, stats.responses,
+               stats.totalNs / stats.count, stats.maxNs);
+    }
+
+    printf("\n%u telegrams in %.3f s, %u responses, %u sent, %u dropped\n",
+           index, record.time / 1e6, responses, sent, dropped);
+    printf("send queue: max depth %d, average depth %.2f, %u telegrams with more than %d queued, %u stalls\n",
+           maxDepth, index ? depthSum / index : 0.0, overLibQueue, LIB_QUEUE_SIZE, stalls);
+    return result < 0 ? 1 : 0;
+}
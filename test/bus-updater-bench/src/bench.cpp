@@ -0,0 +1,528 @@
+/*
+ *  bench.cpp - Throughput benchmark of the Bus-Updater in the host emulation.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  The benchmark runs the request handling of the updater (update.cpp) against
+ *  the emulated flash of the test library and transfers an application image
+ *  with the different transfer modes of the updater protocol. The flash is
+ *  verified after every transfer.
+ *
+ *  The time is not measured on the PC but derived from a model of the TP1 bus
+ *  and the LPC11xx flash:
+ *    - every request is a connection oriented memory write telegram. It is
+ *      acknowledged with a T_ACK telegram and answered with a memory response
+ *      that is acknowledged by the host with a T_ACK telegram. Every telegram
+ *      is acknowledged on the link layer.
+ *    - a character on the bus takes 13 bit times (start, 8 data, parity, stop
+ *      and 2 bits pause), the bus is idle for 50 bit times before a telegram
+ *      and 15 bit times before a link layer acknowledge.
+ *    - erasing a sector or a page takes FLASH_ERASE_US, programming takes
+ *      FLASH_PROGRAM_US per 256 bytes. A flash operation of a request delays the
+ *      acknowledge of the request. A flash operation of updaterLoop() overlaps
+ *      with the bus traffic, but a request that arrives while the flash is busy
+ *      is delayed until the operation is finished (stall).
+ *
+ *  Usage: bus-updater-bench [image.bin]
+ *    Without an image a synthetic image of DEFAULT_IMAGE_SIZE bytes is used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sblib/eib.h>
+#include <sblib/eib/bus.h>
+#include <sblib/internal/iap.h>
+#include <sblib/io_pin_names.h>
+#include <bcu_updater.h>
+#include <update.h>
+#include <crc.h>
+#include <decompress.h>
+#include <boot_descriptor_block.h>
+#include "iap_emu.h"
+
+static BcuUpdate _bcu = BcuUpdate();
+BcuBase& bcu = _bcu;
+
+Bus bus(timer16_1, PIN_EIB_RX, PIN_EIB_TX, CAP0, MAT0);
+
+// The updater must not erase or program the range of the running program.
+// The bench has no running program in the emulated flash.
+extern const unsigned int __vectors_start__ = 0;
+extern const unsigned int _etext = 0;
+
+// The time of one bit on the bus in microseconds (9600 baud)
+#define BIT_US (1000000.0 / 9600)
+
+// The time the host needs to send the next request, in microseconds
+#ifndef HOST_TURNAROUND_US
+#  define HOST_TURNAROUND_US 2000
+#endif
+
+// The time to erase a sector or a page, in microseconds
+#define FLASH_ERASE_US 100000.0
+
+// The time to program 256 bytes, in microseconds
+#define FLASH_PROGRAM_US 1000.0
+
+// The flash address of the application
+#define IMAGE_ADDRESS FIRST_SECTOR
+
+// The size of the synthetic image
+#define DEFAULT_IMAGE_SIZE (3 * SECTOR_SIZE)
+
+// The maximum size of an image: the flash between the application start and
+// the config staging sector (the last two sectors are used by the user EEPROM)
+#define MAX_IMAGE_SIZE (FLASH_SIZE - 2 * SECTOR_SIZE - IMAGE_ADDRESS)
+
+// The maximum payload of a request
+#define MAX_PAYLOAD 12
+
+// The size of the header of a memory write or response telegram, with the checksum
+#define TELEGRAM_OVERHEAD 11
+
+// The size of a T_ACK telegram, with the checksum
+#define T_ACK_SIZE 8
+
+/*
+ * The statistics of one transfer.
+ */
+struct Stats
+{
+    unsigned int requests;    //!< The number of requests of the host
+    unsigned int retries;     //!< The number of requests that were sent again
+    unsigned int telegrams;   //!< The number of telegrams on the bus
+    unsigned int busBytes;    //!< The number of bytes on the bus, without acknowledges
+    unsigned int payload;     //!< The number of payload bytes of the requests
+    double busUs;             //!< The time the bus was busy
+    double blockingUs;        //!< The flash time of the requests
+    double overlappedUs;      //!< The flash time of updaterLoop()
+    double stallUs;           //!< The time requests waited for the flash
+    double clockUs;           //!< The total time
+    double flashBusyUntil;    //!< The end of the current flash operation of updaterLoop()
+};
+
+static Stats stats;
+
+static unsigned char image[MAX_IMAGE_SIZE];
+static unsigned int imageSize;
+static unsigned char descriptor[BOOT_BLOCK_SIZE];
+
+static void putUInt32(unsigned char * data, unsigned int value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static unsigned int getUInt32(const unsigned char * data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+}
+
+/*
+ * The time of a telegram of the given size on the bus, including the link
+ * layer acknowledge.
+ */
+static double telegramTime(unsigned int size)
+{
+    stats.telegrams++;
+    stats.busBytes += size;
+    return (50 + 13 * size + 15 + 13) * BIT_US;
+}
+
+/*
+ * The flash time of the IAP calls since the snapshot.
+ */
+struct FlashSnapshot
+{
+    int erase;
+    int erasePage;
+    unsigned int programmed;
+};
+
+static FlashSnapshot flashSnapshot()
+{
+    FlashSnapshot s;
+    s.erase = iap_calls[I_ERASE];
+    s.erasePage = iap_calls[I_ERASE_PAGE];
+    s.programmed = iap_programmed_bytes;
+    return s;
+}
+
+static double flashTime(const FlashSnapshot & before)
+{
+    unsigned int erases = iap_calls[I_ERASE] - before.erase
+            + iap_calls[I_ERASE_PAGE] - before.erasePage;
+    unsigned int programmed = iap_programmed_bytes - before.programmed;
+    return erases * FLASH_ERASE_US + programmed * FLASH_PROGRAM_US / PAGE_SIZE;
+}
+
+/*
+ * Let the device run updaterLoop() while the bus is idle until the given time.
+ */
+static void runDevice(double until)
+{
+    while (stats.flashBusyUntil < until)
+    {
+        double start = stats.flashBusyUntil > stats.clockUs ? stats.flashBusyUntil : stats.clockUs;
+        FlashSnapshot before = flashSnapshot();
+        updaterLoop();
+        double cost = flashTime(before);
+        if (cost == 0)
+            break;
+        stats.overlappedUs += cost;
+        stats.flashBusyUntil = start + cost;
+    }
+}
+
+/*
+ * Send a request to the device and wait for the reply.
+ *
+ * @return The error that the device returned, 0 on success.
+ */
+static unsigned int request(unsigned char cmd, unsigned char * data, unsigned int count)
+{
+    unsigned char reply[MAX_PAYLOAD];
+    unsigned char replyCmd = 0;
+    double start;
+
+    // the bus is idle while the host prepares the request
+    runDevice(stats.clockUs + HOST_TURNAROUND_US);
+    stats.clockUs += HOST_TURNAROUND_US;
+    if (stats.clockUs < stats.flashBusyUntil)
+    {   // the interrupts are disabled while the flash is busy
+        stats.stallUs += stats.flashBusyUntil - stats.clockUs;
+        stats.clockUs = stats.flashBusyUntil;
+    }
+
+    stats.requests++;
+    stats.payload += count;
+    start = stats.clockUs;
+    stats.clockUs += telegramTime(TELEGRAM_OVERHEAD + count);
+
+    FlashSnapshot before = flashSnapshot();
+    unsigned int replyLength = processUpdateRequest(cmd, data, count, reply, &replyCmd);
+    double cost = flashTime(before);
+    stats.blockingUs += cost;
+    stats.clockUs += cost;
+
+    stats.clockUs += telegramTime(T_ACK_SIZE);
+    if (replyLength)
+    {
+        stats.clockUs += telegramTime(TELEGRAM_OVERHEAD + replyLength);
+        stats.clockUs += telegramTime(T_ACK_SIZE);
+    }
+    stats.busUs += stats.clockUs - start - cost;
+
+    if (replyCmd == UPD_SEND_LAST_ERROR && replyLength >= 4)
+        return getUInt32(reply);
+    return 0;
+}
+
+/*
+ * Send a request that has to succeed.
+ */
+static void requestOk(unsigned char cmd, unsigned char * data, unsigned int count)
+{
+    unsigned int error = request(cmd, data, count);
+    if (error)
+    {
+        fprintf(stderr, "command %d failed with error 0x%x\n", cmd, error);
+        exit(1);
+    }
+}
+
+/*
+ * Send a block of data in requests of MAX_PAYLOAD bytes.
+ */
+static void sendData(unsigned char cmd, const unsigned char * data, unsigned int count)
+{
+    unsigned char buffer[MAX_PAYLOAD];
+
+    while (count)
+    {
+        unsigned int n = count < MAX_PAYLOAD ? count : MAX_PAYLOAD;
+        memcpy(buffer, data, n);
+        if (cmd == UPD_STREAM_DATA)
+        {
+            unsigned int error;
+            while ((error = request(cmd, buffer, n)) == UPD_STREAM_BUSY)
+                stats.retries++;
+            if (error)
+            {
+                fprintf(stderr, "stream data failed with error 0x%x\n", error);
+                exit(1);
+            }
+        }
+        else requestOk(cmd, buffer, n);
+        data += n;
+        count -= n;
+    }
+}
+
+/*
+ * Compress a block with the LZSS format of decompress.h. Greedy matching, the
+ * block is compressed on its own.
+ *
+ * @return The size of the compressed data.
+ */
+static unsigned int compress(const unsigned char * in, unsigned int count, unsigned char * out)
+{
+    unsigned int pos = 0;
+    unsigned int outPos = 0;
+    unsigned int flagPos = 0;
+    unsigned int items = 8;
+
+    while (pos < count)
+    {
+        if (items == 8)
+        {
+            flagPos = outPos++;
+            out[flagPos] = 0;
+            items = 0;
+        }
+
+        unsigned int bestLength = 0;
+        unsigned int bestDistance = 0;
+        unsigned int first = pos > 4096 ? pos - 4096 : 0;
+        for (unsigned int i = first; i < pos; i++)
+        {
+            unsigned int length = 0;
+            while (length < 15 + DECOMPRESS_MIN_MATCH && pos + length < count
+                    && in[i + length] == in[pos + length])
+            {
+                length++;
+            }
+            if (length > bestLength)
+            {
+                bestLength = length;
+                bestDistance = pos - i;
+            }
+        }
+
+        if (bestLength >= DECOMPRESS_MIN_MATCH)
+        {
+            out[outPos++] = bestDistance - 1;
+            out[outPos++] = (((bestDistance - 1) >> 8) << 4) | (bestLength - DECOMPRESS_MIN_MATCH);
+            pos += bestLength;
+        }
+        else
+        {
+            out[flagPos] |= 1 << items;
+            out[outPos++] = in[pos++];
+        }
+        items++;
+    }
+    return outPos;
+}
+
+/*
+ * The size that UPD_PROGRAM programs for a block of the given size.
+ */
+static unsigned int programSize(unsigned int count)
+{
+    if (count > 1024)
+        return 4096;
+    if (count > 512)
+        return 1024;
+    if (count > 256)
+        return 512;
+    return 256;
+}
+
+static void unlock()
+{
+    unsigned char uid[MAX_PAYLOAD];
+    memset(uid, 0, sizeof(uid));
+    requestOk(UPD_UNLOCK_DEVICE, uid, sizeof(uid));
+}
+
+/*
+ * Transfer the boot descriptor with UPD_SEND_DATA and UPD_UPDATE_BOOT_DESC.
+ */
+static void updateBootDescriptor()
+{
+    unsigned char data[5];
+
+    sendData(UPD_SEND_DATA, descriptor, BOOT_BLOCK_SIZE);
+    putUInt32(data, crc32(0xFFFFFFFF, descriptor, BOOT_BLOCK_SIZE));
+    data[4] = 0;
+    requestOk(UPD_UPDATE_BOOT_DESC, data, 5);
+}
+
+/*
+ * The classic transfer: erase a sector, send it to the RAM buffer and program it.
+ *
+ * @param compressed - send the data with UPD_SEND_DATA_COMPRESSED.
+ */
+static void transferClassic(bool compressed)
+{
+    static unsigned char packed[SECTOR_SIZE + SECTOR_SIZE / 8 + 1];
+    unsigned char data[12];
+
+    unlock();
+    for (unsigned int offset = 0; offset < imageSize; offset += SECTOR_SIZE)
+    {
+        unsigned int count = imageSize - offset;
+        if (count > SECTOR_SIZE)
+            count = SECTOR_SIZE;
+        count = programSize(count);
+
+        data[0] = (IMAGE_ADDRESS + offset) / SECTOR_SIZE;
+        requestOk(UPD_ERASE_SECTOR, data, 1);
+
+        if (compressed)
+            sendData(UPD_SEND_DATA_COMPRESSED, packed, compress(image + offset, count, packed));
+        else sendData(UPD_SEND_DATA, image + offset, count);
+
+        putUInt32(data, count);
+        putUInt32(data + 4, IMAGE_ADDRESS + offset);
+        putUInt32(data + 8, crc32(0xFFFFFFFF, image + offset, count));
+        requestOk(UPD_PROGRAM, data, 12);
+    }
+    updateBootDescriptor();
+}
+
+/*
+ * The streaming transfer.
+ *
+ * @param imageId - the ID of the image for a resumable transfer, 0 if not resumable.
+ */
+static void transferStream(unsigned int imageId)
+{
+    unsigned char data[12];
+
+    unlock();
+    putUInt32(data, IMAGE_ADDRESS);
+    putUInt32(data + 4, imageSize);
+    putUInt32(data + 8, imageId);
+    requestOk(UPD_STREAM_START, data, imageId ? 12 : 8);
+    sendData(UPD_STREAM_DATA, image, imageSize);
+    putUInt32(data, crc32(0xFFFFFFFF, image, imageSize));
+    requestOk(UPD_STREAM_END, data, 4);
+    updateBootDescriptor();
+}
+
+/*
+ * Create a synthetic image: words of a small vocabulary with some random bytes
+ * in between, which compresses similar to the code of an application.
+ */
+static void createImage()
+{
+    unsigned int vocabulary[64];
+    unsigned int seed = 0x12345678;
+
+    for (unsigned int i = 0; i < 64; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        vocabulary[i] = seed;
+    }
+
+    imageSize = DEFAULT_IMAGE_SIZE;
+    for (unsigned int i = 0; i < imageSize; i += 4)
+    {
+        seed = seed * 1103515245 + 12345;
+        unsigned int word = (seed >> 16) & 3 ? vocabulary[(seed >> 8) & 63] : seed;
+        putUInt32(image + i, word);
+    }
+}
+
+static void loadImage(const char * fileName)
+{
+    FILE * file = fopen(fileName, "rb");
+    if (!file)
+    {
+        perror(fileName);
+        exit(1);
+    }
+    memset(image, 0xFF, sizeof(image));
+    imageSize = fread(image, 1, sizeof(image), file);
+    fclose(file);
+    imageSize = (imageSize + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+/*
+ * Make the image startable and create the boot descriptor.
+ */
+static void prepareImage()
+{
+    unsigned int sum = 0;
+
+    // the checksum of the first 8 words of the vector table must be 0
+    for (unsigned int i = 0; i < 7 * 4; i += 4)
+        sum += getUInt32(image + i);
+    putUInt32(image + 7 * 4, -sum);
+
+    memset(descriptor, 0xFF, sizeof(descriptor));
+    putUInt32(descriptor, IMAGE_ADDRESS);
+    putUInt32(descriptor + 4, IMAGE_ADDRESS + imageSize);
+    putUInt32(descriptor + 8, crc32(0xFFFFFFFF, image, imageSize));
+    putUInt32(descriptor + 12, IMAGE_ADDRESS + 0xC0);
+}
+
+static void verify(const char * name)
+{
+    AppDescriptionBlock * block = (AppDescriptionBlock *) (FLASH + FIRST_SECTOR - BOOT_BLOCK_SIZE);
+
+    if (memcmp(FLASH + IMAGE_ADDRESS, image, imageSize))
+    {
+        fprintf(stderr, "%s: the flash differs from the image\n", name);
+        exit(1);
+    }
+    if (!checkApplication(block))
+    {
+        fprintf(stderr, "%s: the application is not startable\n", name);
+        exit(1);
+    }
+}
+
+static void run(const char * name, void (*transfer)(unsigned int), unsigned int arg)
+{
+    IAP_Init_Flash(0xFF);
+    memset(&stats, 0, sizeof(stats));
+
+    transfer(arg);
+
+    runDevice(1e30);
+    if (stats.clockUs < stats.flashBusyUntil)
+        stats.clockUs = stats.flashBusyUntil;
+    verify(name);
+
+    printf("%-12s %6u %8u %7u %7u %8u %9.0f %9.0f %9.0f %9.0f %9.0f %8.0f\n",
+            name, imageSize, stats.requests, stats.retries, stats.telegrams,
+            stats.busBytes, stats.busUs / 1000, stats.blockingUs / 1000,
+            stats.overlappedUs / 1000, stats.stallUs / 1000, stats.clockUs / 1000,
+            imageSize * 1e6 / stats.clockUs);
+}
+
+static void classic(unsigned int compressed)
+{
+    transferClassic(compressed);
+}
+
+static void stream(unsigned int imageId)
+{
+    transferStream(imageId);
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc > 1)
+        loadImage(argv[1]);
+    else createImage();
+    prepareImage();
+
+    printf("%-12s %6s %8s %7s %7s %8s %9s %9s %9s %9s %9s %8s\n",
+            "mode", "bytes", "requests", "retries", "tgrams", "busbytes",
+            "bus[ms]", "block[ms]", "ovl[ms]", "stall[ms]", "total[ms]", "bytes/s");
+    run("classic", classic, false);
+    run("compressed", classic, true);
+    run("stream", stream, 0);
+    run("resumable", stream, crc32(0xFFFFFFFF, image, imageSize));
+    return 0;
+}
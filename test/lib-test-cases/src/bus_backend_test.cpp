@@ -0,0 +1,212 @@
+/*
+ *  bus_backend_test.cpp - Tests of the connection of the bus to a host bus backend
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+
+#define private public
+#define protected public
+#include "sblib/eib/bus.h"
+#undef protected
+#undef private
+#include "sblib/eib/addr_tables.h"
+#include "sblib/eib/user_memory.h"
+#include "bus_backend.h"
+
+#include <string.h>
+
+#define OWN_ADDR   0x11fe
+#define GROUP_ADDR 0x0801
+#define OTHER_ADDR 0x0802
+
+/*
+ * A backend that returns the events of a test and records the frames and
+ * acknowledges of the connector.
+ */
+class TestBackend: public BusBackend
+{
+public:
+    TestBackend()
+    {
+        eventCount = sentCount = ackCount = 0;
+    }
+
+    virtual bool send(const byte* frame, int length)
+    {
+        memcpy(sentFrames[sentCount], frame, length);
+        sentLengths[sentCount++] = length;
+        return true;
+    }
+
+    virtual bool acknowledge(int ack)
+    {
+        acks[ackCount++] = ack;
+        return true;
+    }
+
+    virtual int wait(BusEvent* event, int timeout)
+    {
+        if (!eventCount)
+            return event->type = BUS_EVENT_NONE;
+
+        *event = events[0];
+        memmove(events, events + 1, --eventCount * sizeof(BusEvent));
+        return event->type;
+    }
+
+    void frame(int dest, bool group)
+    {
+        BusEvent& event = events[eventCount++];
+        const byte data[] = { 0xbc, 0x11, 0x01, byte(dest >> 8), byte(dest), byte(group ? 0xe1 : 0x61), 0x00, 0x81 };
+
+        event.type = BUS_EVENT_FRAME;
+        event.length = sizeof(data) + 1;
+        memcpy(event.data, data, sizeof(data));
+        event.data[sizeof(data)] = checksum(data, sizeof(data));
+    }
+
+    void sent(int ack)
+    {
+        BusEvent& event = events[eventCount++];
+        event.type = BUS_EVENT_SENT;
+        event.ack = ack;
+    }
+
+    static byte checksum(const byte* data, int length)
+    {
+        byte result = 0xff;
+        for (int i = 0; i < length; ++i)
+            result ^= data[i];
+        return result;
+    }
+
+    BusEvent events[8];
+    int eventCount;
+    byte sentFrames[8][Bus::TELEGRAM_SIZE];
+    int sentLengths[8];
+    int sentCount;
+    int acks[8];
+    int ackCount;
+};
+
+static void _setup()
+{
+    userEeprom.addrTab[0] = OWN_ADDR >> 8;
+    userEeprom.addrTab[1] = OWN_ADDR & 0xff;
+    byte* tab = addrTable();
+    tab[0] = 1;
+    tab[3] = GROUP_ADDR >> 8;
+    tab[4] = GROUP_ADDR & 0xff;
+    userRam.status |= BCU_STATUS_LL | BCU_STATUS_TL;
+
+    bus.ownAddr = OWN_ADDR;
+    bus.telegramLen = 0;
+    bus.sendCurTelegram = 0;
+    bus.sendNextTel = 0;
+    bus.sendTriesMax = 3;
+}
+
+TEST_CASE("Bus backend: receive telegrams", "[BUS][BACKEND]")
+{
+    TestBackend backend;
+    BusConnector connector(backend);
+    _setup();
+
+    backend.frame(GROUP_ADDR, true);
+    backend.frame(OTHER_ADDR, true);
+    backend.frame(GROUP_ADDR, true);
+    backend.frame(OWN_ADDR, false);
+    for (int i = 0; i < 4; ++i)
+        REQUIRE(connector.poll(0));
+
+    // Our group and address are accepted, the other group is not acknowledged.
+    // Like the bus, a telegram that is not processed yet is overwritten.
+    REQUIRE(backend.ackCount == 4);
+    REQUIRE(backend.acks[0] == SB_BUS_ACK);
+    REQUIRE(backend.acks[1] == -1);
+    REQUIRE(backend.acks[2] == SB_BUS_ACK);
+    REQUIRE(backend.acks[3] == SB_BUS_ACK);
+    REQUIRE(bus.telegramLen == 9);
+    REQUIRE(bus.telegram[3] == (OWN_ADDR >> 8));
+    REQUIRE(bus.telegram[4] == (OWN_ADDR & 0xff));
+
+    bus.discardReceivedTelegram();
+    backend.frame(OWN_ADDR, false);
+    REQUIRE(connector.poll(0));
+    REQUIRE(backend.acks[4] == SB_BUS_ACK);
+    REQUIRE(bus.telegramLen == 9);
+    REQUIRE(connector.received == 5);
+    REQUIRE(connector.accepted == 4);
+    REQUIRE(connector.overwritten == 2);
+}
+
+TEST_CASE("Bus backend: send telegrams", "[BUS][BACKEND]")
+{
+    TestBackend backend;
+    BusConnector connector(backend);
+    byte first[Bus::TELEGRAM_SIZE] = { 0xbc, 0x00, 0x00, 0x08, 0x01, 0xe1, 0x00, 0x81 };
+    byte second[Bus::TELEGRAM_SIZE] = { 0xbc, 0x00, 0x00, 0x08, 0x02, 0xe1, 0x00, 0x80 };
+    _setup();
+
+    bus.sendTelegram(first, 8);
+    bus.sendTelegram(second, 8);
+    REQUIRE(connector.poll(0));
+    REQUIRE(backend.sentCount == 1);
+    REQUIRE(backend.sentLengths[0] == 9);
+    REQUIRE(backend.sentFrames[0][1] == (OWN_ADDR >> 8));
+    REQUIRE(backend.sentFrames[0][2] == (OWN_ADDR & 0xff));
+    REQUIRE(TestBackend::checksum(backend.sentFrames[0], 9) == 0);
+
+    // Nothing is sent until the frame is over
+    REQUIRE(connector.poll(0));
+    REQUIRE(backend.sentCount == 1);
+
+    backend.sent(SB_BUS_ACK);
+    REQUIRE(connector.poll(0));
+    REQUIRE(first[0] == 0);
+    REQUIRE(bus.sendCurTelegram == second);
+
+    REQUIRE(connector.poll(0));
+    REQUIRE(backend.sentCount == 2);
+    REQUIRE(backend.sentFrames[1][4] == 0x02);
+
+    backend.sent(SB_BUS_ACK);
+    REQUIRE(connector.poll(0));
+    REQUIRE(!bus.sendingTelegram());
+    REQUIRE(connector.acked == 2);
+    REQUIRE(connector.repeats == 0);
+}
+
+TEST_CASE("Bus backend: repeat telegrams that are not acknowledged", "[BUS][BACKEND]")
+{
+    TestBackend backend;
+    BusConnector connector(backend);
+    byte telegram[Bus::TELEGRAM_SIZE] = { 0xbc, 0x00, 0x00, 0x08, 0x01, 0xe1, 0x00, 0x81 };
+    _setup();
+
+    bus.sendTelegram(telegram, 8);
+    for (int i = 0; i < 4; ++i)
+    {
+        REQUIRE(connector.poll(0));
+        REQUIRE(backend.sentCount == i + 1);
+        backend.sent(i & 1 ? SB_BUS_NACK : -1);
+        REQUIRE(connector.poll(0));
+    }
+
+    // The first frame and 3 repeats, the repeats without the repeat flag
+    REQUIRE(!bus.sendingTelegram());
+    REQUIRE(backend.sentCount == 4);
+    REQUIRE(backend.sentFrames[0][0] == 0xbc);
+    for (int i = 1; i < 4; ++i)
+    {
+        REQUIRE(backend.sentFrames[i][0] == 0x9c);
+        REQUIRE(TestBackend::checksum(backend.sentFrames[i], 9) == 0);
+    }
+    REQUIRE(connector.sent == 4);
+    REQUIRE(connector.repeats == 3);
+    REQUIRE(connector.failed == 1);
+}
@@ -0,0 +1,121 @@
+/*
+ *  bus_isr_profile_test.cpp - Tests of the execution time of the bus interrupt handler
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "bus_sim.h"
+#include "report_buffer.h"
+
+#include <sblib/eib/bus.h>
+#include <sblib/eib/bus_isr_profile.h>
+#include <sblib/print.h>
+
+#include <string.h>
+
+#define OWN_ADDR   0x11fe
+#define NODE_ADDR  0x1101
+#define GROUP_ADDR 0x0801
+
+// The maximum time of a test in microseconds
+#define TIMEOUT 2000000
+
+// The budget of one call of the interrupt handler in register accesses.
+// The longest state, SEND_WAIT, needs 17 accesses.
+#define HOST_BUDGET 24
+
+// A group write telegram to GROUP_ADDR, without the checksum
+static const byte groupWrite[] = { 0xbc, 0x00, 0x00, 0x08, 0x01, 0xe1, 0x00, 0x81 };
+
+/*
+ * The clock of the profile: the register accesses of the emulation, which do
+ * not depend on the speed of the host.
+ */
+static unsigned int _registerAccesses()
+{
+    return emuRegisterAccesses;
+}
+
+/*
+ * Receive a telegram of a node, then send a telegram to the node.
+ */
+static void _receiveAndSend()
+{
+    BusSim sim;
+    sim.begin(OWN_ADDR);
+    sim.addGroup(GROUP_ADDR);
+
+    int node = sim.addNode(NODE_ADDR);
+    sim.node(node).groups[sim.node(node).groupCount++] = GROUP_ADDR;
+
+    REQUIRE(sim.nodeSend(node, groupWrite, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+
+    byte telegram[SIM_TELEGRAM_SIZE];
+    memcpy(telegram, groupWrite, sizeof(groupWrite));
+    REQUIRE(sim.send(telegram, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+
+    REQUIRE(sim.stats.dutReceived == 1);
+    REQUIRE(sim.stats.dutDelivered == 1);
+}
+
+TEST_CASE("Bus interrupt profile: every state stays within the budget", "[BUS][SIM][PROFILE]")
+{
+    busIsrProfileSetClock(_registerAccesses);
+    busIsrProfileSetBudget(HOST_BUDGET);
+    busIsrProfileReset();
+    _receiveAndSend();
+
+    for (int state = Bus::IDLE; state <= Bus::SEND_END; ++state)
+    {
+        const BusIsrStateProfile& prof = busIsrProfile(state);
+        INFO("state " << state << ": " << prof.minTime << ".." << prof.maxTime);
+
+        REQUIRE(prof.calls > 0);
+        REQUIRE(prof.minTime > 0);
+        REQUIRE(prof.minTime <= prof.maxTime);
+        REQUIRE(prof.maxTime <= HOST_BUDGET);
+        REQUIRE(prof.overruns == 0);
+
+        unsigned int calls = 0;
+        for (int bucket = 0; bucket < BUS_ISR_PROFILE_BUCKETS; ++bucket)
+            calls += prof.histogram[bucket];
+        REQUIRE(calls == prof.calls);
+    }
+    REQUIRE(!busIsrProfileAlarm());
+
+    ReportBuffer report;
+    busIsrProfileReport(report);
+    REQUIRE(strstr(report.text, "RECV_BYTE: ") != 0);
+    REQUIRE(strstr(report.text, "SEND_BIT: ") != 0);
+    REQUIRE(strstr(report.text, "ALARM") == 0);
+
+    busIsrProfileSetClock(0);
+    busIsrProfileSetBudget(0);
+}
+
+TEST_CASE("Bus interrupt profile: the alarm is raised over budget", "[BUS][SIM][PROFILE]")
+{
+    busIsrProfileSetClock(_registerAccesses);
+    busIsrProfileSetBudget(4);
+    busIsrProfileReset();
+    _receiveAndSend();
+
+    REQUIRE(busIsrProfileAlarm());
+    REQUIRE(busIsrProfile(Bus::SEND_WAIT).overruns == busIsrProfile(Bus::SEND_WAIT).calls);
+    REQUIRE(busIsrProfile(Bus::RECV_BYTE).overruns == 0);
+
+    ReportBuffer report;
+    busIsrProfileReport(report);
+    REQUIRE(strstr(report.text, "ALARM") != 0);
+
+    busIsrProfileReset();
+    REQUIRE(!busIsrProfileAlarm());
+    REQUIRE(busIsrProfile(Bus::SEND_WAIT).calls == 0);
+    busIsrProfileSetClock(0);
+    busIsrProfileSetBudget(0);
+}
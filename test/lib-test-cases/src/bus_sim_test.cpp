@@ -0,0 +1,174 @@
+/*
+ *  bus_sim_test.cpp - Tests of the bus interrupt handler with the simulated TP1 bus
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "bus_sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define OWN_ADDR   0x11fe
+#define NODE_ADDR  0x1101
+#define OTHER_ADDR 0x1102
+#define GROUP_ADDR 0x0801
+
+// The maximum time of a test in microseconds
+#define TIMEOUT 2000000
+
+// A group write telegram to GROUP_ADDR, without the checksum
+static const byte groupWrite[] = { 0xbc, 0x00, 0x00, 0x08, 0x01, 0xe1, 0x00, 0x81 };
+
+static byte lastReceived[SIM_TELEGRAM_SIZE];
+static int lastReceivedLength;
+
+static void _received(const byte* telegram, int length)
+{
+    memcpy(lastReceived, telegram, length);
+    lastReceivedLength = length;
+}
+
+static void _setup(BusSim& sim)
+{
+    lastReceivedLength = 0;
+    sim.begin(OWN_ADDR);
+    sim.addGroup(GROUP_ADDR);
+    sim.received = _received;
+}
+
+TEST_CASE("Bus simulation: the device receives a telegram", "[BUS][SIM]")
+{
+    BusSim sim;
+    _setup(sim);
+
+    int node = sim.addNode(NODE_ADDR);
+    REQUIRE(sim.nodeSend(node, groupWrite, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+
+    REQUIRE(sim.stats.dutReceived == 1);
+    REQUIRE(lastReceivedLength == sizeof(groupWrite) + 1);
+    REQUIRE(lastReceived[1] == (NODE_ADDR >> 8));
+    REQUIRE(lastReceived[2] == (NODE_ADDR & 0xff));
+    REQUIRE(memcmp(lastReceived + 3, groupWrite + 3, sizeof(groupWrite) - 3) == 0);
+
+    REQUIRE(sim.node(node).acked == 1);
+    REQUIRE(sim.stats.acks == 1);
+    REQUIRE(sim.stats.repeats == 0);
+    REQUIRE(sim.stats.corrupted == 0);
+}
+
+TEST_CASE("Bus simulation: the device sends a telegram", "[BUS][SIM]")
+{
+    BusSim sim;
+    _setup(sim);
+
+    int node = sim.addNode(NODE_ADDR);
+    sim.node(node).groups[sim.node(node).groupCount++] = GROUP_ADDR;
+
+    byte telegram[SIM_TELEGRAM_SIZE];
+    memcpy(telegram, groupWrite, sizeof(groupWrite));
+    REQUIRE(sim.send(telegram, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+
+    REQUIRE(sim.node(node).received == 1);
+    REQUIRE(sim.node(node).rxTelegram[1] == (OWN_ADDR >> 8));
+    REQUIRE(sim.node(node).rxTelegram[2] == (OWN_ADDR & 0xff));
+    REQUIRE(sim.stats.dutDelivered == 1);
+    REQUIRE(sim.stats.dutFinished == 1);
+    REQUIRE(sim.stats.telegrams == 1);
+    REQUIRE(sim.stats.repeats == 0);
+    REQUIRE(sim.stats.corrupted == 0);
+}
+
+TEST_CASE("Bus simulation: the device repeats a telegram that is not acknowledged", "[BUS][SIM]")
+{
+    BusSim sim;
+    _setup(sim);
+
+    byte telegram[SIM_TELEGRAM_SIZE];
+    memcpy(telegram, groupWrite, sizeof(groupWrite));
+    REQUIRE(sim.send(telegram, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+
+    // the first transmission and 3 repeats
+    REQUIRE(sim.stats.telegrams == 4);
+    REQUIRE(sim.stats.repeats == 3);
+    REQUIRE(sim.stats.missedAcks == 4);
+    REQUIRE(sim.stats.dutDelivered == 0);
+    REQUIRE(sim.stats.dutFinished == 1);
+    REQUIRE(sim.stats.corrupted == 0);
+}
+
+TEST_CASE("Bus simulation: collision of the device and a node", "[BUS][SIM]")
+{
+    bool collided = false;
+
+    // The device and the node wait for the end of a telegram of a third node.
+    // Vary the start of the node until both start within the same bit.
+    for (unsigned int delay = 0; delay < 10 * SIM_BIT_TIME && !collided; delay += 5)
+    {
+        BusSim sim;
+        _setup(sim);
+
+        int node = sim.addNode(NODE_ADDR);
+        sim.node(node).startDelay = delay;
+        sim.node(node).groups[sim.node(node).groupCount++] = GROUP_ADDR;
+        int other = sim.addNode(OTHER_ADDR);
+
+        REQUIRE(sim.nodeSend(other, groupWrite, sizeof(groupWrite)));
+        sim.run(6000);
+
+        byte telegram[SIM_TELEGRAM_SIZE];
+        memcpy(telegram, groupWrite, sizeof(groupWrite));
+        REQUIRE(sim.send(telegram, sizeof(groupWrite)));
+        REQUIRE(sim.nodeSend(node, groupWrite, sizeof(groupWrite)));
+        REQUIRE(sim.runUntilIdle(TIMEOUT));
+
+        // Both telegrams arrive, whoever wins the arbitration
+        REQUIRE(sim.stats.dutDelivered == 1);
+        REQUIRE(sim.stats.dutReceived == 2);
+        REQUIRE(sim.node(node).acked == 1);
+        REQUIRE(sim.stats.corrupted == 0);
+        collided = sim.stats.collisions > 0;
+    }
+    REQUIRE(collided);
+}
+
+TEST_CASE("Bus simulation: load", "[.][BUS][SIM][LOAD]")
+{
+    BusSim sim;
+    _setup(sim);
+
+    int nodes[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        nodes[i] = sim.addNode(NODE_ADDR + i);
+        sim.node(nodes[i]).startDelay = i * 3;
+    }
+    sim.node(nodes[0]).groups[sim.node(nodes[0]).groupCount++] = GROUP_ADDR;
+
+    byte telegram[SIM_TELEGRAM_SIZE];
+    for (int round = 0; round < 50; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+            sim.nodeSend(nodes[i], groupWrite, sizeof(groupWrite));
+        memcpy(telegram, groupWrite, sizeof(groupWrite));
+        sim.send(telegram, sizeof(groupWrite));
+        sim.runUntilIdle(TIMEOUT);
+    }
+
+    printf("time %llu us, telegrams %u, repeats %u, acks %u, missed acks %u, collisions %u\n",
+        sim.time(), sim.stats.telegrams, sim.stats.repeats, sim.stats.acks,
+        sim.stats.missedAcks, sim.stats.collisions);
+    printf("delivered %u, failed %u, device received %u, device delivered %u, interrupts %u\n",
+        sim.stats.delivered, sim.stats.failed, sim.stats.dutReceived,
+        sim.stats.dutDelivered, sim.stats.interrupts);
+    printf("goodput %.0f bytes/s, bus load %.1f%%\n",
+        sim.goodput(), sim.stats.busyTime * 100.0 / sim.time());
+
+    REQUIRE(sim.stats.corrupted == 0);
+}
@@ -0,0 +1,81 @@
+/*
+ *  bus_trace_test.cpp - Tests of the binary bus trace
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "bus_trace.h"
+
+#include <string.h>
+
+static void _setRecord(TraceRecord* record, unsigned long long time, int length, unsigned char ack)
+{
+    record->time = time;
+    record->ack = ack;
+    record->length = length;
+    for (int i = 0; i < length; ++i)
+        record->data[i] = i * 7 + length;
+}
+
+TEST_CASE("Bus trace: write and read", "[SBLIB][TRACE]")
+{
+    static const unsigned long long times[] = { 0, 127, 128, 1000000, 1ULL << 40 };
+    TraceRecord record, read;
+    unsigned long long lastTime = 0;
+    int i;
+
+    FILE* file = tmpfile();
+    REQUIRE(file != 0);
+    REQUIRE(traceWriteHeader(file));
+    for (i = 0; i < 5; ++i)
+    {
+        _setRecord(&record, times[i], i == 4 ? TRACE_MAX_FRAME : 8 + i, i & 1 ? 0xcc : 0);
+        REQUIRE(traceWrite(file, &record, lastTime));
+        lastTime = times[i];
+    }
+
+    // The time must not go backwards
+    _setRecord(&record, 5, 8, 0);
+    REQUIRE(!traceWrite(file, &record, lastTime));
+
+    rewind(file);
+    REQUIRE(traceReadHeader(file));
+    memset(&read, 0, sizeof(read));
+    for (i = 0; i < 5; ++i)
+    {
+        _setRecord(&record, times[i], i == 4 ? TRACE_MAX_FRAME : 8 + i, i & 1 ? 0xcc : 0);
+        REQUIRE(traceRead(file, &read) == 1);
+        REQUIRE(read.time == record.time);
+        REQUIRE(read.ack == record.ack);
+        REQUIRE(read.length == record.length);
+        REQUIRE(memcmp(read.data, record.data, record.length) == 0);
+    }
+    REQUIRE(traceRead(file, &read) == 0);
+    fclose(file);
+}
+
+TEST_CASE("Bus trace: invalid files", "[SBLIB][TRACE]")
+{
+    TraceRecord record;
+
+    FILE* file = tmpfile();
+    REQUIRE(file != 0);
+    fputs("BC 11 01 08 01 E1 00 81 5B\n", file);
+    rewind(file);
+    REQUIRE(!traceReadHeader(file));
+    fclose(file);
+
+    // A truncated frame: time, acknowledge, length 8 and only 3 bytes
+    file = tmpfile();
+    REQUIRE(file != 0);
+    REQUIRE(traceWriteHeader(file));
+    fwrite("\x10\x00\x08\xbc\x11\x01", 6, 1, file);
+    rewind(file);
+    REQUIRE(traceReadHeader(file));
+    record.time = 0;
+    REQUIRE(traceRead(file, &record) == -1);
+    fclose(file);
+}
@@ -0,0 +1,165 @@
+/*
+ *  config_image_test.cpp - Tests of the bulk transfer of the configuration image
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "iap_emu.h"
+
+#include <sblib/eib/config_image.h>
+#include <sblib/eib/properties.h>
+#include <sblib/eib/user_memory.h>
+#include <sblib/internal/iap.h>
+
+#include <string.h>
+
+// A new object for every boot, like the global object of the application
+static ConfigImage images[3];
+
+static byte oldEeprom[USER_EEPROM_SIZE];
+static byte newEeprom[USER_EEPROM_SIZE];
+
+static unsigned int crc32(const byte* data, unsigned int count)
+{
+    unsigned int crc = 0xffffffff;
+    while (count--)
+    {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+/*
+ * Transfer and commit the new image like ETS would.
+ */
+static void transferImage(ConfigImage& image)
+{
+    const unsigned int start = image.windowStart();
+    const unsigned int crc = crc32(newEeprom, USER_EEPROM_SIZE);
+    const byte begin[] = { CIC_BEGIN };
+    const byte commit[] = { CIC_COMMIT, byte(crc >> 24), byte(crc >> 16), byte(crc >> 8), byte(crc) };
+
+    REQUIRE(image.write(start, begin, sizeof(begin)));
+    for (int offset = 0; offset < USER_EEPROM_SIZE; offset += 10)
+    {
+        int count = USER_EEPROM_SIZE - offset < 10 ? USER_EEPROM_SIZE - offset : 10;
+        REQUIRE(image.write(start + CONFIG_IMAGE_CTRL_SIZE + offset, newEeprom + offset, count));
+    }
+    REQUIRE(image.write(start, commit, sizeof(commit)));
+}
+
+/*
+ * Reset the device: the user EEPROM is read from the flash, which still holds
+ * the old configuration.
+ */
+static void reset(ConfigImage& image)
+{
+    memcpy(userEepromData, oldEeprom, USER_EEPROM_SIZE);
+    image.recover();
+}
+
+static void setup()
+{
+    IAP_Init_Flash(0xff);
+    iapFlashSize();
+
+    for (int i = 0; i < USER_EEPROM_SIZE; ++i)
+    {
+        oldEeprom[i] = i;
+        newEeprom[i] = i * 3 + 1;
+    }
+
+#if BCU_TYPE != BCU1_TYPE
+    // The activation sets the load state of the tables to "loaded"
+    int loadState = userEeprom.loadState - userEepromData;
+    newEeprom[loadState + OT_ADDR_TABLE] = LS_LOADED;
+    newEeprom[loadState + OT_ASSOC_TABLE] = LS_LOADED;
+    newEeprom[loadState + OT_APPLICATION] = LS_LOADED;
+#endif
+    memcpy(userEepromData, oldEeprom, USER_EEPROM_SIZE);
+}
+
+TEST_CASE("Config image: the staging area must not overlap the application", "[SBLIB][CONFIG_IMAGE]")
+{
+    const byte begin[] = { CIC_BEGIN };
+    byte ctrl[2];
+
+    setup();
+
+    // The application reaches into the staging sector
+    emuImageEnd = iapFlashSize() - 2 * FLASH_SECTOR_SIZE + 1;
+    REQUIRE(!images[0].write(images[0].windowStart(), begin, sizeof(begin)));
+    REQUIRE(images[0].read(images[0].windowStart(), ctrl, sizeof(ctrl)));
+    REQUIRE(ctrl[0] == CIS_ERROR);
+    REQUIRE(ctrl[1] == CIE_FLASH);
+
+    emuImageEnd = iapFlashSize() - 2 * FLASH_SECTOR_SIZE;
+    REQUIRE(images[0].write(images[0].windowStart(), begin, sizeof(begin)));
+    REQUIRE(images[0].state() == CIS_RECEIVING);
+
+    emuImageEnd = 0;
+}
+
+#if BCU_TYPE != BCU1_TYPE
+TEST_CASE("Config image: a committed image is not activated by a reset", "[SBLIB][CONFIG_IMAGE]")
+{
+    setup();
+    transferImage(images[0]);
+    REQUIRE(images[0].state() == CIS_VERIFIED);
+
+    // ETS did not send "load completed" before the reset
+    reset(images[1]);
+    REQUIRE(images[1].state() == CIS_IDLE);
+    REQUIRE(memcmp(userEepromData, oldEeprom, USER_EEPROM_SIZE) == 0);
+}
+
+TEST_CASE("Config image: a memory write to the user EEPROM discards a committed image", "[SBLIB][CONFIG_IMAGE]")
+{
+    const byte value = 0x5a;
+
+    setup();
+    setUserMemoryConfigImage(&images[0]);
+    transferImage(images[0]);
+    REQUIRE(images[0].state() == CIS_VERIFIED);
+
+    REQUIRE(userMemoryWrite(USER_EEPROM_START, &value, 1));
+    REQUIRE(images[0].state() == CIS_IDLE);
+
+    // "load completed" keeps the written user EEPROM
+    REQUIRE(images[0].activate());
+    REQUIRE(userEepromData[0] == value);
+    REQUIRE(memcmp(userEepromData + 1, oldEeprom + 1, USER_EEPROM_SIZE - 1) == 0);
+
+    setUserMemoryConfigImage(0);
+}
+#endif
+
+TEST_CASE("Config image: a reset finishes a requested activation", "[SBLIB][CONFIG_IMAGE]")
+{
+    setup();
+    transferImage(images[0]);
+#if BCU_TYPE != BCU1_TYPE
+    // "load completed", BCU1 activates the image with the commit
+    REQUIRE(images[0].activate());
+#endif
+    REQUIRE(images[0].state() == CIS_ACTIVATING);
+    REQUIRE(memcmp(userEepromData, newEeprom, USER_EEPROM_SIZE) == 0);
+
+    // Reset before the user EEPROM was written
+    reset(images[1]);
+    REQUIRE(images[1].state() == CIS_ACTIVATING);
+    REQUIRE(memcmp(userEepromData, newEeprom, USER_EEPROM_SIZE) == 0);
+
+    // Once the user EEPROM is written a reset does not activate it again
+    images[1].eepromWritten();
+    REQUIRE(images[1].state() == CIS_IDLE);
+
+    reset(images[2]);
+    REQUIRE(images[2].state() == CIS_IDLE);
+    REQUIRE(memcmp(userEepromData, oldEeprom, USER_EEPROM_SIZE) == 0);
+}
@@ -0,0 +1,72 @@
+/*
+ *  cpu_load_test.cpp - Tests of the CPU load and loop duration measurement
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "periph_emu.h"
+#include "report_buffer.h"
+
+#include <sblib/cpu_load.h>
+#include <sblib/interrupt.h>
+#include <sblib/print.h>
+#include <sblib/timer.h>
+
+#include <string.h>
+
+/*
+ * A main loop iteration that is busy for some time and then sleeps until the
+ * next SysTick interrupt.
+ */
+static void loopIteration(unsigned int busyTime)
+{
+    CPU_LOAD_LOOP();
+    delayMicroseconds(busyTime);
+    waitForInterrupt();
+}
+
+TEST_CASE("CPU load of the main loop", "[sblib][CPU_LOAD]")
+{
+    periphEmu.begin();
+    cpuLoadReset();
+
+    // The first window is not over yet
+    for (int i = 0; i < CPU_LOAD_WINDOW / 2; ++i)
+        loopIteration(300);
+    REQUIRE(cpuLoad() == 0);
+
+    for (int i = 0; i < CPU_LOAD_WINDOW; ++i)
+        loopIteration(300);
+    REQUIRE(cpuLoad() == 30);
+
+    // Every iteration lasts one SysTick period
+    unsigned int maxLoop = cpuLoadMaxLoopTime();
+    REQUIRE(maxLoop >= 1000);
+    REQUIRE(maxLoop <= 1001);
+
+    for (int i = 0; i < 2 * CPU_LOAD_WINDOW; ++i)
+        loopIteration(800);
+    REQUIRE(cpuLoad() == 80);
+
+    // One iteration that blocks the main loop
+    loopIteration(20000);
+    loopIteration(100);
+    maxLoop = cpuLoadMaxLoopTime();
+    REQUIRE(maxLoop >= 20000);
+    REQUIRE(maxLoop <= 21000);
+    REQUIRE(cpuLoadLoopCount(10) == 1);
+
+    ReportBuffer report;
+    cpuLoadReport(report);
+    REQUIRE(strstr(report.text, "cpu load 80%, max loop ") != 0);
+    REQUIRE(strstr(report.text, "16384..32767 us: 1") != 0);
+
+    cpuLoadReset();
+    REQUIRE(cpuLoad() == 0);
+    REQUIRE(cpuLoadMaxLoopTime() == 0);
+    REQUIRE(cpuLoadLoopCount(10) == 0);
+    periphEmu.end();
+}
@@ -37,7 +37,7 @@ static void checkFlash(byte* address)
 
 TEST_CASE("Test of the basic EEPROM functions","[EEPROM][SBLIB]")
 {
-    int iap_save [5] ;
+    int iap_save [6] ;
     SECTION("Test bus.begin()")
     {
         IAP_Init_Flash(0xFF);
@@ -67,7 +67,7 @@ TEST_CASE("Test of the basic EEPROM functions","[EEPROM][SBLIB]")
 
 TEST_CASE("Enhanced EEPROM tests","[EEPROM][SBLIB][ERASE]")
 {
-    int iap_save [5] ;
+    int iap_save [6] ;
     unsigned int i;
     unsigned int ps = sizeof(pattern);
     SECTION("Start with empty FLASH")
@@ -0,0 +1,55 @@
+/*
+ *  iap_test.cpp - Tests of the flash size detection
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+
+#include <sblib/internal/iap.h>
+
+/*
+ * Part IDs and flash sizes of the LPC111x user manual UM10398.
+ */
+static const struct
+{
+    unsigned int partId;
+    int flashSize;
+} parts[] =
+{
+    { 0x0A07102B, 0x1000 },     // LPC1110FD20
+    { 0x1A16D02B, 0x2000 },     // LPC1111FDH20/002
+    { 0x041E502B, 0x2000 },     // LPC1111FHN33/101
+    { 0x2524D02B, 0x4000 },     // LPC1112FHN33/102
+    { 0x2532902B, 0x6000 },     // LPC1113FHN33/202
+    { 0x0A40902B, 0x8000 },     // LPC1114FDH28/102
+    { 0x2540102B, 0x8000 },     // LPC1114FBD48/302
+    { 0x1440102B, 0x8000 },     // LPC11C14FBD48/301
+    { 0x1431102B, 0x4000 },     // LPC11C22FBD48/301
+
+    // XL parts, the flash size is encoded in the part ID
+    { 0x00010013, 0x2000 },     // LPC1111FHN33/103
+    { 0x00020022, 0x4000 },     // LPC1112FHN33/203
+    { 0x00030030, 0x6000 },     // LPC1113FHN33/303
+    { 0x00040042, 0x8000 },     // LPC1114FHN33/203
+    { 0x00040060, 0xC000 },     // LPC1114FBD48/323
+    { 0x00040070, 0xE000 },     // LPC1114FBD48/333
+    { 0x00050080, 0x10000 },    // LPC1115FBD48/303
+
+    // Unknown parts
+    { 0x00000000, 0 },
+    { 0x00040000, 0 },
+    { 0x12345678, 0 },
+    { 0x0A40902C, 0 }
+};
+
+TEST_CASE("IAP: flash size of the part IDs", "[SBLIB][IAP]")
+{
+    for (unsigned int i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i)
+    {
+        INFO("part ID 0x" << std::hex << parts[i].partId);
+        REQUIRE(iapFlashSizeOfPartId(parts[i].partId) == parts[i].flashSize);
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ *  mem_mapper_test.cpp - Tests of the log range of the memory mapper
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "iap_emu.h"
+
+#include <sblib/mem_mapper.h>
+
+#include <string.h>
+
+extern unsigned char FLASH[];
+
+// The flash of the memory mapper, below the sector of the user EEPROM
+#define MAPPER_FLASH_BASE 0x5000
+#define MAPPER_FLASH_SIZE 0x1000
+
+// The virtual address of the log range
+#define LOG_ADDR 0x0100
+
+// The flash page of a page of the log range, the allocation table is the first page
+#define LOG_PAGE(page) (FLASH + MAPPER_FLASH_BASE + ((page) + 1) * FLASH_PAGE_SIZE)
+
+// The size of the page header and of a record of the log
+#define LOG_HEADER_SIZE 8
+#define LOG_RECORD_SIZE 8
+
+static void writeValue(MemMapper& mapper, int slot, unsigned int value)
+{
+    byte data[4] = { byte(value), byte(value >> 8), byte(value >> 16), byte(value >> 24) };
+    REQUIRE(mapper.writeMemPtr(LOG_ADDR + slot * 4, data, 4) == MEM_MAPPER_SUCCESS);
+}
+
+static unsigned int readValue(MemMapper& mapper, int slot)
+{
+    byte data[4];
+    REQUIRE(mapper.readMemPtr(LOG_ADDR + slot * 4, data, 4) == MEM_MAPPER_SUCCESS);
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+}
+
+TEST_CASE("Mem mapper: records are appended to the log", "[SBLIB][MEM_MAPPER]")
+{
+    IAP_Init_Flash(0xff);
+    MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+    REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+    REQUIRE(readValue(mapper, 0) == 0);
+
+    // The first write erases a page of the log
+    int erases = iap_calls[I_ERASE_PAGE];
+    writeValue(mapper, 0, 1);
+    REQUIRE(iap_calls[I_ERASE_PAGE] == erases + 1);
+
+    // The following writes only program the page
+    int programs = iap_calls[I_RAM2FLASH];
+    writeValue(mapper, 1, 0x12345678);
+    writeValue(mapper, 0, 2);
+    REQUIRE(iap_calls[I_ERASE_PAGE] == erases + 1);
+    REQUIRE(iap_calls[I_RAM2FLASH] == programs + 2);
+
+    // Writing the same value again does not add a record
+    writeValue(mapper, 1, 0x12345678);
+    REQUIRE(iap_calls[I_RAM2FLASH] == programs + 2);
+
+    REQUIRE(readValue(mapper, 0) == 2);
+    REQUIRE(readValue(mapper, 1) == 0x12345678);
+
+    // The records of the earlier writes stay in the page
+    const byte* rec = LOG_PAGE(0) + LOG_HEADER_SIZE;
+    REQUIRE(rec[0] == 0);
+    REQUIRE(rec[LOG_RECORD_SIZE] == 1);
+    REQUIRE(rec[2 * LOG_RECORD_SIZE] == 0);
+    REQUIRE(rec[3 * LOG_RECORD_SIZE] == 0xff);
+
+    // The pointer to a value of the log range points to the copy in RAM
+    REQUIRE(*mapper.memoryPtr(LOG_ADDR + 4) == 0x78);
+}
+
+TEST_CASE("Mem mapper: a full log page is compacted", "[SBLIB][MEM_MAPPER]")
+{
+    IAP_Init_Flash(0xff);
+    MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+    REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+
+    const int recordsPerPage = (FLASH_PAGE_SIZE - LOG_HEADER_SIZE) / LOG_RECORD_SIZE;
+    writeValue(mapper, 3, 0xcafe);
+
+    // Fill the first page
+    int erases = iap_calls[I_ERASE_PAGE];
+    for (int i = 1; i < recordsPerPage; ++i)
+        writeValue(mapper, 0, i);
+    REQUIRE(iap_calls[I_ERASE_PAGE] == erases);
+    REQUIRE(LOG_PAGE(1)[0] != 'L');
+
+    // The next write compacts the current values into the second page
+    writeValue(mapper, 0, 1000);
+    REQUIRE(iap_calls[I_ERASE_PAGE] == erases + 1);
+    REQUIRE(memcmp(LOG_PAGE(1), "LOG1", 4) == 0);
+
+    const byte* rec = LOG_PAGE(1) + LOG_HEADER_SIZE;
+    REQUIRE(rec[0] == 0);
+    REQUIRE(rec[LOG_RECORD_SIZE] == 3);
+    REQUIRE(rec[2 * LOG_RECORD_SIZE] == 0xff);
+
+    REQUIRE(readValue(mapper, 0) == 1000);
+    REQUIRE(readValue(mapper, 3) == 0xcafe);
+}
+
+TEST_CASE("Mem mapper: the log is rebuilt after a reset", "[SBLIB][MEM_MAPPER]")
+{
+    IAP_Init_Flash(0xff);
+    {
+        MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+        REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+
+        // Write enough values for two compactions
+        for (int i = 1; i <= 80; ++i)
+            writeValue(mapper, i & 1, i);
+        writeValue(mapper, 15, 0xdeadbeef);
+    }
+
+    // A new object like on the next startup
+    MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+    REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+    REQUIRE(readValue(mapper, 0) == 80);
+    REQUIRE(readValue(mapper, 1) == 79);
+    REQUIRE(readValue(mapper, 15) == 0xdeadbeef);
+    REQUIRE(readValue(mapper, 2) == 0);
+
+    // New records are appended to the active page
+    int erases = iap_calls[I_ERASE_PAGE];
+    writeValue(mapper, 2, 7);
+    REQUIRE(iap_calls[I_ERASE_PAGE] == erases);
+}
+
+TEST_CASE("Mem mapper: a torn record of the log is rejected", "[SBLIB][MEM_MAPPER]")
+{
+    IAP_Init_Flash(0xff);
+    {
+        MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+        REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+        writeValue(mapper, 0, 0x11111111);
+        writeValue(mapper, 1, 0x22222222);
+        writeValue(mapper, 1, 0x33333333);
+    }
+
+    // A reset while the last record was programmed: some bits are still erased
+    byte* torn = LOG_PAGE(0) + LOG_HEADER_SIZE + 2 * LOG_RECORD_SIZE;
+    REQUIRE(torn[0] == 1);
+    REQUIRE(torn[7] == 0x33);
+    torn[7] = 0xff;
+
+    int erases = iap_calls[I_ERASE_PAGE];
+    {
+        MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+        REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+        REQUIRE(readValue(mapper, 0) == 0x11111111);
+        REQUIRE(readValue(mapper, 1) == 0x22222222);
+
+        // Nothing is appended after the torn record, the values are compacted instead
+        writeValue(mapper, 2, 5);
+        REQUIRE(iap_calls[I_ERASE_PAGE] == erases + 1);
+        REQUIRE(memcmp(LOG_PAGE(1), "LOG1", 4) == 0);
+    }
+
+    MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+    REQUIRE(mapper.addLogRange(LOG_ADDR) == MEM_MAPPER_SUCCESS);
+    REQUIRE(readValue(mapper, 0) == 0x11111111);
+    REQUIRE(readValue(mapper, 1) == 0x22222222);
+    REQUIRE(readValue(mapper, 2) == 5);
+}
@@ -0,0 +1,98 @@
+/*
+ *  parameter_cache_test.cpp - Tests for the decoded parameter cache
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+
+#include "sblib/eib/parameter_cache.h"
+#include "sblib/eib/user_memory.h"
+
+#include <string.h>
+
+struct TestParams
+{
+    byte mode;
+    byte invert;
+    unsigned short delay;
+    int scaled;
+};
+
+static const ParameterDesc testParamDescs[] =
+{
+    PARAMETER(0x1a0, 0, 4, 1, 1, TestParams, mode),
+    PARAMETER(0x1a0, 4, 1, 1, 1, TestParams, invert),
+    PARAMETER(0x1a1, 0, 16, 1, 1, TestParams, delay),
+    PARAMETER(0x1a3, 3, 10, 5, 2, TestParams, scaled)
+};
+
+static int changedMask;
+
+static void testParamChanged(int index)
+{
+    changedMask |= 1 << index;
+}
+
+TEST_CASE("Parameter cache","[SBLIB][PARAMETER]")
+{
+    TestParams params;
+    ParameterCache cache(testParamDescs, 4, &params, testParamChanged);
+
+    memset(&params, 0, sizeof(params));
+    userEeprom[0x1a0] = 0xa8;  // mode 10, invert 1
+    userEeprom[0x1a1] = 0x12;  // delay 0x1234
+    userEeprom[0x1a2] = 0x34;
+    userEeprom[0x1a3] = 0x15;  // scaled: bits 3..12 = 0x2b4 = 692
+    userEeprom[0x1a4] = 0xa0;
+
+    SECTION("Decode all parameters")
+    {
+        changedMask = 0;
+        cache.markAllDirty();
+        REQUIRE(cache.isDirty());
+        cache.update();
+        REQUIRE(!cache.isDirty());
+
+        REQUIRE(params.mode == 10);
+        REQUIRE(params.invert == 1);
+        REQUIRE(params.delay == 0x1234);
+        REQUIRE(params.scaled == 692 * 5 / 2);
+        REQUIRE(changedMask == 0x0f);
+    }
+
+    SECTION("Decode the dirty range only")
+    {
+        cache.markAllDirty();
+        cache.update();
+
+        changedMask = 0;
+        userEeprom[0x1a0] = 0x38;  // mode 3, invert 1
+        userEeprom[0x1a2] = 0x35;  // not marked dirty
+        cache.markDirty(0x1a0, 1);
+        cache.update();
+
+        REQUIRE(params.mode == 3);
+        REQUIRE(params.invert == 1);
+        REQUIRE(params.delay == 0x1234);
+        REQUIRE(changedMask == 0x01);
+    }
+
+    SECTION("Report the initial values")
+    {
+        cache.markAllDirty();
+        cache.update();
+
+        // The values did not change, like on a restart with the same user EEPROM
+        changedMask = 0;
+        cache.markAllDirty();
+        cache.update();
+        REQUIRE(changedMask == 0);
+
+        cache.markAllDirty();
+        cache.update(true);
+        REQUIRE(changedMask == 0x0f);
+    }
+}
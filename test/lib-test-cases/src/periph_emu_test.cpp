@@ -0,0 +1,233 @@
+/*
+ *  periph_emu_test.cpp - Tests of the drivers with the emulated peripherals
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "periph_emu.h"
+#include "periph_models.h"
+
+#include <sblib/analog_pin.h>
+#include <sblib/digital_pin.h>
+#include <sblib/i2c.h>
+#include <sblib/i2c/bh1750.h>
+#include <sblib/i2c/ds3231.h>
+#include <sblib/lcd/font_5x7.h>
+#include <sblib/lcd/graphical_eadogs.h>
+#include <sblib/sensors/ds18x20.h>
+#include <sblib/serial.h>
+#include <sblib/spi.h>
+#include <sblib/timer.h>
+
+#include <string.h>
+
+static void _begin()
+{
+    periphEmu.begin();
+
+    // The I2C controller was reset, initialize it again
+    I2C::Instance()->I2CInit();
+}
+
+TEST_CASE("Peripheral emulation: Serial sends with the baud rate", "[PERIPH][UART]")
+{
+    static const char text[] = "Hello, host! More than the 16 bytes of the FIFO.";
+    const int len = sizeof(text) - 1;
+
+    _begin();
+    serial.begin(115200);
+    periphEmu.uartClearSent();
+
+    EmuTime start = periphEmu.now();
+    REQUIRE(serial.write((const byte*) text, len) == len);
+    serial.flush();
+    periphEmu.advance(periphEmu.cycles(1000));
+
+    REQUIRE(periphEmu.uartSentLength == len);
+    REQUIRE(memcmp(periphEmu.uartSent, text, len) == 0);
+    REQUIRE(periphEmu.stats.uartSent == (unsigned int) len);
+
+    // 10 bits per byte: at least len * 86 usec to send the text
+    EmuTime elapsed = periphEmu.now() - start;
+    REQUIRE(elapsed >= periphEmu.cycles(len * 86));
+    REQUIRE(periphEmu.stats.interrupts > 0);
+
+    serial.end();
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: Serial receives", "[PERIPH][UART]")
+{
+    static const uint8_t data[] = { 0x12, 0x34, 0x56, 0x78 };
+
+    _begin();
+    serial.begin(9600);
+
+    periphEmu.uartReceive(data, sizeof(data));
+    REQUIRE(serial.available() == 0);
+
+    // 4 bytes at 9600 baud need about 4.2 msec
+    delay(5);
+    REQUIRE(serial.available() == 4);
+    for (unsigned int i = 0; i < sizeof(data); ++i)
+        REQUIRE(serial.read() == data[i]);
+
+    serial.end();
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: the EA DOGS display receives text", "[PERIPH][SSP]")
+{
+    _begin();
+
+    EmuEADOGS display(PIO2_3);
+    periphEmu.attachSpi(0, &display);
+
+    LcdGraphicalEADOGS lcd(SPI_PORT_0, PIO0_9, PIO2_11, PIO2_3, PIO0_2, font_5x7);
+    lcd.begin();
+    lcd.clear();
+    REQUIRE(display.pixels(0, 0) == 0);
+
+    lcd.pos(10, 2);
+    lcd.print("A");
+
+    int idx = ('A' - font_5x7.firstChar) * font_5x7.charWidth;
+    for (int i = 0; i < font_5x7.charWidth; ++i)
+        REQUIRE(display.pixels(10 + i, 2) == font_5x7.data[idx + i]);
+    REQUIRE(display.page == 2);
+    REQUIRE(display.commands > 0);
+    REQUIRE(periphEmu.stats.spiFrames == display.commands + display.dataBytes);
+
+    lcd.end();
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: read the time of a DS3231", "[PERIPH][I2C]")
+{
+    _begin();
+
+    EmuDS3231 rtc;
+    rtc.regs[0] = 0x45; // 45 seconds
+    rtc.regs[1] = 0x30; // 30 minutes
+    rtc.regs[2] = 0x12; // 12 hours, 24 hour mode
+    periphEmu.attachI2C(&rtc);
+
+    Ds3231 ds3231;
+    REQUIRE(ds3231.Ds3231Init());
+
+    ds3231_time_t time;
+    REQUIRE(ds3231.GetTime(&time));
+    REQUIRE(time.seconds == 45);
+    REQUIRE(time.minutes == 30);
+    REQUIRE(time.hours == 12);
+    REQUIRE(!time.mode);
+
+    // Write, and write + repeated start + read. The driver does not wait
+    // for the stop condition of the last transfer.
+    periphEmu.advance(periphEmu.cycles(100));
+    REQUIRE(periphEmu.stats.i2cTransfers == 2);
+
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: a missing I2C device is not acknowledged", "[PERIPH][I2C]")
+{
+    _begin();
+
+    Ds3231 ds3231;
+    REQUIRE(ds3231.Ds3231Init());
+
+    ds3231_time_t time;
+    REQUIRE(!ds3231.GetTime(&time));
+
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: read the illuminance of a BH1750", "[PERIPH][I2C]")
+{
+    _begin();
+
+    EmuBH1750 sensor;
+    sensor.lux = 100;
+    periphEmu.attachI2C(&sensor);
+
+    BH1750 bh1750;
+    REQUIRE(bh1750.BH1750Init());
+
+    EmuTime start = periphEmu.now();
+    REQUIRE(bh1750.GetLux());
+
+    // High resolution mode 2: lux * 1.2 * 2
+    REQUIRE(bh1750.uLuxCurrent == 240);
+    REQUIRE(sensor.measurements == 1);
+
+    // The driver waits 200 msec before reading
+    EmuTime elapsed = periphEmu.now() - start;
+    REQUIRE(elapsed >= periphEmu.cycles(200000));
+
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: search and read a DS18B20", "[PERIPH][ONEWIRE]")
+{
+    static const uint8_t rom[8] = { DS18B20, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0 };
+
+    _begin();
+
+    EmuDS18B20 sensor(rom);
+    sensor.temperature = 21.5;
+    periphEmu.attachPin(PIO0_7, &sensor);
+
+    DS18x20 ds;
+    ds.DS18x20Init(PIO0_7, false);
+
+    REQUIRE(ds.Search(1));
+    REQUIRE(ds.m_foundDevices == 1);
+    REQUIRE(memcmp(ds.m_dsDev[0].addr, sensor.rom, 8) == 0);
+
+    REQUIRE(ds.readTemperature(&ds.m_dsDev[0]));
+    REQUIRE(ds.m_dsDev[0].lastReadOK);
+    REQUIRE(ds.m_dsDev[0].current_temperature == 21.5);
+    REQUIRE(sensor.conversions == 1);
+
+    ds.DS18x20DeInit();
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: analogRead converts the input", "[PERIPH][ADC]")
+{
+    _begin();
+
+    periphEmu.setAnalogInput(AD3, 512);
+    periphEmu.setAnalogInput(AD5, 1023);
+
+    analogBegin();
+    REQUIRE(analogRead(AD3) == 512);
+    REQUIRE(analogRead(AD5) == 1023);
+    REQUIRE(analogRead(AD3) == 512);
+    REQUIRE(periphEmu.stats.adcConversions == 3);
+
+    analogEnd();
+    periphEmu.end();
+}
+
+TEST_CASE("Peripheral emulation: pulseIn measures a pulse", "[PERIPH][GPIO]")
+{
+    _begin();
+
+    // The loop of pulseIn() reads the pin every 21 cycles
+    periphEmu.accessCycles = 21;
+
+    EmuLowPulse pulse(periphEmu.cycles(100), periphEmu.cycles(500));
+    periphEmu.attachPin(PIO1_5, &pulse);
+    pinMode(PIO1_5, INPUT);
+
+    unsigned int usec = pulseIn(PIO1_5, 0, 10000);
+    REQUIRE(usec >= 495);
+    REQUIRE(usec <= 505);
+
+    periphEmu.end();
+}
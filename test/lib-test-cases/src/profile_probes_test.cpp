@@ -0,0 +1,118 @@
+/*
+ *  profile_probes_test.cpp - Tests of micros() and the profiling probes
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "periph_emu.h"
+#include "periph_models.h"
+#include "report_buffer.h"
+
+#include <sblib/i2c.h>
+#include <sblib/i2c/bh1750.h>
+#include <sblib/print.h>
+#include <sblib/profile_probes.h>
+#include <sblib/timer.h>
+
+#include <string.h>
+
+TEST_CASE("micros() runs with the system timer", "[sblib][timer][PROFILE]")
+{
+    periphEmu.begin();
+
+    unsigned int start = micros();
+    delayMicroseconds(250);
+    unsigned int elapsed = micros() - start;
+    REQUIRE(elapsed >= 250);
+    REQUIRE(elapsed <= 251);
+
+    // Across some SysTick interrupts
+    start = micros();
+    unsigned int startMillis = millis();
+    delay(3);
+    elapsed = micros() - start;
+    unsigned int elapsedMillis = millis() - startMillis;
+    REQUIRE(elapsedMillis == 3);
+    REQUIRE(elapsed > 2000);
+    REQUIRE(elapsed <= 3000);
+
+    unsigned int last = micros();
+    for (int i = 0; i < 100; ++i)
+    {
+        delayMicroseconds(37);
+        unsigned int now = micros();
+        elapsed = now - last;
+        REQUIRE(elapsed >= 37);
+        REQUIRE(elapsed <= 38);
+        last = now;
+    }
+
+    periphEmu.end();
+}
+
+TEST_CASE("Profiling probes: a sensor driver is measured", "[PROFILE][I2C]")
+{
+    periphEmu.begin();
+    I2C::Instance()->I2CInit();
+
+    EmuBH1750 sensor;
+    sensor.lux = 100;
+    periphEmu.attachI2C(&sensor);
+
+    BH1750 bh1750;
+    REQUIRE(bh1750.BH1750Init());
+
+    profileClear();
+    REQUIRE(bh1750.GetLux());
+
+    REQUIRE(profileEventCount() == 2);
+    const ProfileEvent& enter = profileEvent(0);
+    const ProfileEvent& exit = profileEvent(1);
+    REQUIRE(enter.probe == PROBE_BH1750);
+    REQUIRE(!enter.exit);
+    REQUIRE(exit.probe == PROBE_BH1750);
+    REQUIRE(exit.exit);
+
+    // The driver waits 200 msec for the measurement
+    unsigned int duration = exit.time - enter.time;
+    REQUIRE(duration >= 200000);
+    REQUIRE(duration < 210000);
+
+    ReportBuffer dump;
+    profileDump(dump);
+    REQUIRE(strstr(dump.text, "bh1750 >") != 0);
+    REQUIRE(strstr(dump.text, "bh1750 < ") != 0);
+
+    periphEmu.end();
+}
+
+TEST_CASE("Profiling probes: the ring buffer keeps the newest events", "[PROFILE]")
+{
+    profileClear();
+    REQUIRE(profileEventCount() == 0);
+
+    for (int i = 0; i < PROFILE_BUFFER_SIZE + 8; ++i)
+    {
+        PROFILE_PROBE(PROBE_USER + (i & 3));
+    }
+
+    REQUIRE(profileEventCount() == PROFILE_BUFFER_SIZE);
+
+    // 2 events per probe, the first 8 probes are overwritten
+    REQUIRE(profileEvent(0).probe == PROBE_USER);
+    REQUIRE(!profileEvent(0).exit);
+    REQUIRE(profileEvent(1).exit);
+    REQUIRE(profileEvent(PROFILE_BUFFER_SIZE - 1).probe == PROBE_USER + 3);
+    REQUIRE(profileEvent(PROFILE_BUFFER_SIZE - 1).exit);
+
+    ReportBuffer dump;
+    profileDump(dump);
+    REQUIRE(strstr(dump.text, "probe 16 >") != 0);
+    REQUIRE(strstr(dump.text, "probe 19 < ") != 0);
+
+    profileClear();
+    REQUIRE(profileEventCount() == 0);
+}
@@ -0,0 +1,101 @@
+/*
+ *  ram_usage_test.cpp - Tests of the stack usage and buffer fill level measurement
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "periph_emu.h"
+#include "report_buffer.h"
+
+#include <sblib/print.h>
+#include <sblib/profile_probes.h>
+#include <sblib/ram_usage.h>
+#include <sblib/serial.h>
+#include <sblib/timer.h>
+
+#include <string.h>
+
+TEST_CASE("RAM usage: stack high water mark", "[sblib][RAM_USAGE]")
+{
+    stackPaint();
+    REQUIRE(stackSize() == EMU_STACK_WORDS * 4);
+    REQUIRE(stackHighWater() == 0);
+
+    // The stack grows down from the top
+    emuStack[EMU_STACK_WORDS - 1] = 0;
+    emuStack[EMU_STACK_WORDS - 20] = 0;
+    REQUIRE(stackHighWater() == 20 * 4);
+
+    // Words that happen to hold the paint do not hide deeper usage
+    emuStack[EMU_STACK_WORDS - 100] = STACK_PAINT + 1;
+    REQUIRE(stackHighWater() == 100 * 4);
+
+    stackPaint();
+    REQUIRE(stackHighWater() == 0);
+}
+
+TEST_CASE("RAM usage: peak fill level of the serial buffers", "[sblib][RAM_USAGE][UART]")
+{
+    static const uint8_t data[20] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    static const char text[] = "0123456789012345678901234567890123456789";
+
+    periphEmu.begin();
+    serial.begin(115200);
+    ramUsageReset();
+
+    // 20 bytes at 115200 baud need about 1.8 msec
+    periphEmu.uartReceive(data, sizeof(data));
+    delay(3);
+    REQUIRE(ramUsagePeak(RAM_SERIAL_RX) == sizeof(data));
+
+    while (serial.read() >= 0)
+        ;
+    REQUIRE(ramUsagePeak(RAM_SERIAL_RX) == sizeof(data));
+
+    // The text is copied into the write buffer as a block
+    serial.print(text);
+    serial.flush();
+    REQUIRE(ramUsagePeak(RAM_SERIAL_TX) == sizeof(text) - 1);
+
+    ramUsageFill(RAM_BUFFER_USER, 5);
+    ramUsageFill(RAM_BUFFER_USER, 3);
+    REQUIRE(ramUsagePeak(RAM_BUFFER_USER) == 5);
+
+    ramUsageRegister(RAM_BUFFER_USER, "app queue", 8);
+    ReportBuffer report;
+    ramUsageReport(report);
+    REQUIRE(strstr(report.text, "stack: ") != 0);
+    REQUIRE(strstr(report.text, "serial rx: 20 of 128") != 0);
+    REQUIRE(strstr(report.text, "app queue: 5 of 8") != 0);
+
+    ramUsageReset();
+    REQUIRE(ramUsagePeak(RAM_SERIAL_RX) == 0);
+    REQUIRE(ramUsagePeak(RAM_BUFFER_USER) == 0);
+
+    serial.end();
+    periphEmu.end();
+}
+
+TEST_CASE("RAM usage: fill level of the ring buffer of the profiling probes", "[sblib][RAM_USAGE][PROFILE]")
+{
+    profileClear();
+    ramUsageReset();
+
+    for (int i = 0; i < 3; ++i)
+        profileRecord(PROBE_USER, false);
+    REQUIRE(ramUsagePeak(RAM_PROFILE_EVENTS) == 3);
+
+    // The ring buffer overwrites the oldest events when it is full
+    for (int i = 0; i < PROFILE_BUFFER_SIZE; ++i)
+        profileRecord(PROBE_USER, false);
+    REQUIRE(ramUsagePeak(RAM_PROFILE_EVENTS) == PROFILE_BUFFER_SIZE);
+
+    ReportBuffer report;
+    ramUsageReport(report);
+    REQUIRE(strstr(report.text, "profile events: ") != 0);
+
+    profileClear();
+}
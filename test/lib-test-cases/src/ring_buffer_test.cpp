@@ -0,0 +1,108 @@
+/*
+ *  ring_buffer_test.cpp - Tests of the ring buffer template
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+
+#include <sblib/ring_buffer.h>
+
+TEST_CASE("Ring buffer: push and pop single elements", "[sblib][RING_BUFFER]")
+{
+    RingBuffer<int, 4> buffer;
+    int value;
+
+    REQUIRE(buffer.size() == 4);
+    REQUIRE(buffer.empty());
+    REQUIRE(!buffer.pop(value));
+
+    // All elements can be used
+    for (int i = 1; i <= 4; ++i)
+        REQUIRE(buffer.push(i * 10));
+    REQUIRE(buffer.full());
+    REQUIRE(buffer.count() == 4);
+    REQUIRE(buffer.space() == 0);
+    REQUIRE(!buffer.push(50));
+
+    REQUIRE(buffer.peek() == 10);
+    REQUIRE(buffer.pop(value));
+    REQUIRE(value == 10);
+    REQUIRE(buffer.space() == 1);
+
+    // Wrap around the end many times
+    for (int i = 5; i < 1000; ++i)
+    {
+        REQUIRE(buffer.push(i * 10));
+        REQUIRE(buffer.pop(value));
+        REQUIRE(value == (i - 3) * 10);
+    }
+    REQUIRE(buffer.count() == 3);
+
+    buffer.clear();
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.space() == 4);
+}
+
+TEST_CASE("Ring buffer: bulk push and pop", "[sblib][RING_BUFFER]")
+{
+    RingBuffer<byte, 16> buffer;
+    byte data[40], result[40];
+
+    for (int i = 0; i < (int) sizeof(data); ++i)
+        data[i] = i + 1;
+
+    REQUIRE(buffer.push(data, 10) == 10);
+    REQUIRE(buffer.pop(result, 6) == 6);
+    REQUIRE(result[5] == 6);
+
+    // Only the free space is filled, across the end of the buffer
+    REQUIRE(buffer.push(data + 10, 30) == 12);
+    REQUIRE(buffer.full());
+    REQUIRE(buffer.push(data + 22, 18) == 0);
+
+    REQUIRE(buffer.pop(result, sizeof(result)) == 16);
+    for (int i = 0; i < 16; ++i)
+        REQUIRE(result[i] == data[i + 6]);
+    REQUIRE(buffer.pop(result, sizeof(result)) == 0);
+}
+
+TEST_CASE("Ring buffer: spans", "[sblib][RING_BUFFER]")
+{
+    RingBuffer<byte, 8> buffer;
+    int length;
+
+    for (byte i = 0; i < 6; ++i)
+        buffer.push(i);
+    buffer.consume(5);
+
+    // The free elements up to the end of the buffer
+    byte* dest = buffer.writeSpan(length);
+    REQUIRE(length == 2);
+    dest[0] = 6;
+    dest[1] = 7;
+    buffer.commit(2);
+
+    // The rest of the free elements at the start
+    dest = buffer.writeSpan(length);
+    REQUIRE(length == 5);
+    dest[0] = 8;
+    buffer.commit(1);
+
+    const byte* src = buffer.readSpan(length);
+    REQUIRE(length == 3);
+    REQUIRE(src[0] == 5);
+    REQUIRE(src[2] == 7);
+    buffer.consume(3);
+
+    src = buffer.readSpan(length);
+    REQUIRE(length == 1);
+    REQUIRE(src[0] == 8);
+    buffer.consume(1);
+
+    REQUIRE(buffer.empty());
+    buffer.readSpan(length);
+    REQUIRE(length == 0);
+}
@@ -0,0 +1,113 @@
+/*
+ *  serial_test.cpp - Tests of the buffered writing of the serial port
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "periph_emu.h"
+
+#include <sblib/serial.h>
+
+#include <string.h>
+
+static void fillData(byte* data, int length)
+{
+    for (int i = 0; i < length; ++i)
+        data[i] = i * 7 + 3;
+}
+
+TEST_CASE("Serial: a block write fills the transmit FIFO in bursts", "[sblib][UART]")
+{
+    byte data[64];
+    fillData(data, sizeof(data));
+
+    periphEmu.begin();
+    serial.begin(115200);
+    periphEmu.uartClearSent();
+    unsigned int interrupts = periphEmu.stats.interrupts;
+
+    EmuTime start = periphEmu.now();
+    REQUIRE(serial.write(data, sizeof(data)) == (int) sizeof(data));
+    serial.flush();
+
+    REQUIRE(periphEmu.uartSentLength == (int) sizeof(data));
+    REQUIRE(memcmp(periphEmu.uartSent, data, sizeof(data)) == 0);
+
+    // One interrupt per 16 bytes, the first 16 bytes are written directly
+    unsigned int uartInterrupts = periphEmu.stats.interrupts - interrupts;
+    REQUIRE(uartInterrupts <= sizeof(data) / 16);
+
+    // The bytes are sent back to back: 10 bits per byte, about 86.7 usec
+    EmuTime elapsed = periphEmu.now() - start;
+    REQUIRE(elapsed >= periphEmu.cycles(sizeof(data) * 86));
+    REQUIRE(elapsed <= periphEmu.cycles((sizeof(data) + 1) * 87));
+
+    serial.end();
+    periphEmu.end();
+}
+
+TEST_CASE("Serial: tryWrite writes what fits into the buffer", "[sblib][UART]")
+{
+    const int bufferSpace = BufferedStream::WRITE_BUFFER_SIZE;
+    byte data[bufferSpace + 40];
+    fillData(data, sizeof(data));
+
+    periphEmu.begin();
+    serial.begin(115200);
+    periphEmu.uartClearSent();
+
+    REQUIRE(serial.availableForWrite() == bufferSpace);
+
+    // The UART takes the first 16 bytes into its transmit FIFO at once
+    int written = serial.tryWrite(data, sizeof(data));
+    REQUIRE(written == bufferSpace);
+    REQUIRE(serial.availableForWrite() == 16);
+
+    written += serial.tryWrite(data + written, sizeof(data) - written);
+    REQUIRE(written == bufferSpace + 16);
+    REQUIRE(serial.availableForWrite() == 0);
+    REQUIRE(serial.tryWrite(data + written, sizeof(data) - written) == 0);
+
+    // The rest is written when the UART took the next 16 bytes
+    serial.write(data + written, sizeof(data) - written);
+    serial.flush();
+
+    REQUIRE(periphEmu.uartSentLength == (int) sizeof(data));
+    REQUIRE(memcmp(periphEmu.uartSent, data, sizeof(data)) == 0);
+    REQUIRE(serial.availableForWrite() == bufferSpace);
+
+    serial.end();
+    periphEmu.end();
+}
+
+TEST_CASE("Serial: single bytes and blocks keep their order", "[sblib][UART]")
+{
+    byte data[300];
+    fillData(data, sizeof(data));
+
+    periphEmu.begin();
+    serial.begin(115200);
+    periphEmu.uartClearSent();
+
+    // Wrap around the end of the write buffer a few times
+    int pos = 0;
+    while (pos < (int) sizeof(data))
+    {
+        serial.write(data[pos++]);
+        int len = sizeof(data) - pos;
+        if (len > 45)
+            len = 45;
+        REQUIRE(serial.write(data + pos, len) == len);
+        pos += len;
+    }
+    serial.flush();
+
+    REQUIRE(periphEmu.uartSentLength == (int) sizeof(data));
+    REQUIRE(memcmp(periphEmu.uartSent, data, sizeof(data)) == 0);
+
+    serial.end();
+    periphEmu.end();
+}
@@ -0,0 +1,160 @@
+/*
+ *  telegram_latency_test.cpp - Tests of the latency measurement of the telegram stages
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "bus_sim.h"
+#include "iap_emu.h"
+#include "periph_emu.h"
+#include "report_buffer.h"
+
+#include <sblib/eib/bcu.h>
+#include <sblib/eib/telegram_latency.h>
+#include <sblib/print.h>
+#include <sblib/timer.h>
+
+#include <string.h>
+
+#define OWN_ADDR   0x11fe
+#define NODE_ADDR  0x1101
+#define GROUP_ADDR 0x0801
+
+// The maximum time of a test in microseconds
+#define TIMEOUT 2000000
+
+// A group write telegram to GROUP_ADDR, without the checksum
+static const byte groupWrite[] = { 0xbc, 0x00, 0x00, 0x08, 0x01, 0xe1, 0x00, 0x81 };
+
+// A broadcast of A_IndividualAddress_Read, without the checksum
+static const byte individualAddressRead[] = { 0xb0, 0x00, 0x00, 0x00, 0x00, 0xe1, 0x01, 0x00 };
+
+// The time the BCU processed the last telegram
+static unsigned int processedTime;
+
+// The main loop of the device: the BCU processes the telegram when it is received
+static void _receivedByBcu(const byte* telegram, int length)
+{
+    processedTime = micros();
+    bcu.loop();
+}
+
+TEST_CASE("Telegram latency: a group write and its response", "[BUS][SIM][LATENCY]")
+{
+    IAP_Init_Flash(0xff);
+    bcu.begin(0, 0, 0);
+
+    BusSim sim;
+    sim.begin(OWN_ADDR);
+    sim.addGroup(GROUP_ADDR);
+    sim.received = _receivedByBcu;
+
+    int node = sim.addNode(NODE_ADDR);
+    sim.node(node).groups[sim.node(node).groupCount++] = GROUP_ADDR;
+
+    telegramLatencyReset();
+
+    REQUIRE(sim.nodeSend(node, groupWrite, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+    REQUIRE(sim.stats.dutReceived == 1);
+
+    // The BCU processed the telegram, the application queues the response later
+    sim.run(3000);
+    unsigned int queuedTime = micros();
+
+    byte telegram[SIM_TELEGRAM_SIZE];
+    memcpy(telegram, groupWrite, sizeof(groupWrite));
+    REQUIRE(sim.send(telegram, sizeof(groupWrite)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+    REQUIRE(sim.stats.dutDelivered == 1);
+
+    for (int interval = 0; interval < LATENCY_INTERVALS; ++interval)
+        REQUIRE(telegramLatencyCount(interval) == 1);
+
+    // The simulation calls bcu.loop() at the time the telegram is received
+    REQUIRE(telegramLatencyMax(LATENCY_RX_PROCESSED) == 0);
+    REQUIRE(telegramLatencyMax(LATENCY_PROCESSED_QUEUED) == queuedTime - processedTime);
+
+    // A free bus: pre send time and the low priority
+    unsigned int onWire = telegramLatencyMax(LATENCY_QUEUED_ON_WIRE);
+    REQUIRE(onWire >= 4 * SIM_BIT_TIME);
+    REQUIRE(onWire <= 5 * SIM_BIT_TIME);
+
+    // 9 characters of 13 bits without the last pause, 15 bits until the ACK, the ACK
+    // character and the 4 bit times until the receiver detects the end of the frame
+    unsigned int ack = telegramLatencyMax(LATENCY_ON_WIRE_ACK);
+    REQUIRE(ack >= (9 * 13 - 2 + 15 + 11) * SIM_BIT_TIME);
+    REQUIRE(ack <= (9 * 13 - 2 + 15 + 11 + 4) * SIM_BIT_TIME);
+
+    // A single telegram: all percentiles are the latency
+    REQUIRE(telegramLatencyPercentile(LATENCY_ON_WIRE_ACK, 50) == ack);
+    REQUIRE(telegramLatencyPercentile(LATENCY_ON_WIRE_ACK, 99) == ack);
+
+    ReportBuffer report;
+    telegramLatencyReport(report);
+    REQUIRE(strstr(report.text, "processed->queued: 1 telegrams") != 0);
+
+    bcu.end();
+}
+
+TEST_CASE("Telegram latency: a response of the BCU", "[BUS][SIM][LATENCY]")
+{
+    IAP_Init_Flash(0xff);
+    bcu.begin(0, 0, 0);
+
+    BusSim sim;
+    sim.begin(OWN_ADDR);
+    sim.received = _receivedByBcu;
+    int node = sim.addNode(NODE_ADDR);
+
+    telegramLatencyReset();
+
+    // The response is queued by the BCU while it processes the request
+    userRam.status |= BCU_STATUS_PROG;
+    REQUIRE(sim.nodeSend(node, individualAddressRead, sizeof(individualAddressRead)));
+    REQUIRE(sim.runUntilIdle(TIMEOUT));
+    REQUIRE(sim.stats.dutReceived == 1);
+    REQUIRE(sim.node(node).received == 1);
+    REQUIRE(sim.node(node).rxTelegram[7] == 0x40); // A_IndividualAddress_Response
+
+    for (int interval = 0; interval < LATENCY_INTERVALS; ++interval)
+        REQUIRE(telegramLatencyCount(interval) == 1);
+    REQUIRE(telegramLatencyMax(LATENCY_PROCESSED_QUEUED) < 100);
+
+    userRam.status &= ~BCU_STATUS_PROG;
+    bcu.end();
+}
+
+TEST_CASE("Telegram latency: percentiles", "[LATENCY]")
+{
+    periphEmu.begin();
+    telegramLatencyReset();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        telegramLatencyMark(LATENCY_RECEIVED);
+        delayMicroseconds(i < 98 ? 100 : 5000);
+        telegramLatencyMark(LATENCY_PROCESSED);
+    }
+
+    REQUIRE(telegramLatencyCount(LATENCY_RX_PROCESSED) == 100);
+    REQUIRE(telegramLatencyMax(LATENCY_RX_PROCESSED) == 5000);
+
+    // The latencies are rounded up to the end of their bucket: 96..127 usec
+    unsigned int p50 = telegramLatencyPercentile(LATENCY_RX_PROCESSED, 50);
+    REQUIRE(p50 >= 100);
+    REQUIRE(p50 <= 127);
+    REQUIRE(telegramLatencyPercentile(LATENCY_RX_PROCESSED, 98) == p50);
+    REQUIRE(telegramLatencyPercentile(LATENCY_RX_PROCESSED, 99) == 5000);
+
+    // Nothing was queued
+    REQUIRE(telegramLatencyCount(LATENCY_PROCESSED_QUEUED) == 0);
+    REQUIRE(telegramLatencyPercentile(LATENCY_PROCESSED_QUEUED, 50) == 0);
+
+    telegramLatencyReset();
+    REQUIRE(telegramLatencyCount(LATENCY_RX_PROCESSED) == 0);
+    periphEmu.end();
+}
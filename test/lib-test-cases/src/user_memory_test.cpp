@@ -0,0 +1,145 @@
+/*
+ *  user_memory_test.cpp - Tests of the user memory address space
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "catch.hpp"
+#include "iap_emu.h"
+
+#include <sblib/eib/config_image.h>
+#include <sblib/eib/user_memory.h>
+#include <sblib/internal/functions.h>
+#include <sblib/internal/iap.h>
+#include <sblib/mem_mapper.h>
+
+#include <string.h>
+
+extern unsigned char FLASH[];
+
+// A flash page of the user EEPROM in the last flash sector
+#define EEPROM_PAGE(index) (FLASH + FLASH_SIZE - SECTOR_SIZE + (index) * USER_EEPROM_FLASH_SIZE)
+
+// The flash of the memory mapper and the address of its range
+#define MAPPER_FLASH_BASE 0x5000
+#define MAPPER_FLASH_SIZE 0x1000
+#define MAPPED_ADDR       0x9000
+
+static ConfigImage configImage(0x8000);
+
+static void writeEeprom(byte value)
+{
+    userEepromData[0] = value;
+    userEeprom.modified();
+    writeUserEeprom();
+}
+
+TEST_CASE("User memory: regions of the address space", "[SBLIB][USER_MEMORY]")
+{
+    byte data[4];
+
+    setUserRamStart(USER_RAM_START_DEFAULT);
+    setUserMemoryConfigImage(0);
+
+    REQUIRE(userMemoryPtr(USER_RAM_START_DEFAULT + 2) == userRamData + 2);
+    REQUIRE(userMemoryPtr(USER_EEPROM_START + 5) == userEepromData + 5);
+    REQUIRE(userMemoryPtr(USER_EEPROM_END) == 0);
+
+    // Without a configuration image its window is not mapped
+    REQUIRE(!userMemoryRead(0x8000, data, 4));
+    REQUIRE(userMemoryPtr(0x8000) == 0);
+
+    setUserMemoryConfigImage(&configImage);
+    REQUIRE(userMemoryRead(0x8000, data, 4));
+    REQUIRE(data[0] == CIS_IDLE);
+
+    // The window is only accessible with userMemoryRead() and userMemoryWrite()
+    REQUIRE(userMemoryPtr(0x8000) == 0);
+
+    // A block must not cross the end of a region
+    REQUIRE(!userMemoryRead(USER_EEPROM_END - 2, data, 4));
+    REQUIRE(userMemoryRead(USER_EEPROM_END - 4, data, 4));
+
+    setUserMemoryConfigImage(0);
+    REQUIRE(!userMemoryRead(0x8000, data, 4));
+}
+
+TEST_CASE("User memory: addresses of the memory mapper", "[SBLIB][USER_MEMORY]")
+{
+    const byte values[4] = { 0x12, 0x34, 0x56, 0x78 };
+    byte data[4];
+
+    IAP_Init_Flash(0xff);
+    MemMapper mapper(MAPPER_FLASH_BASE, MAPPER_FLASH_SIZE);
+    REQUIRE(mapper.addRange(MAPPED_ADDR, 0x100) == MEM_MAPPER_SUCCESS);
+    REQUIRE(mapper.addRange(USER_EEPROM_START, 0x100) == MEM_MAPPER_SUCCESS);
+
+    // Without the memory mapper the range is not mapped
+    setUserMemoryMapper(0);
+    REQUIRE(!userMemoryWrite(MAPPED_ADDR + 0x10, values, 4));
+    REQUIRE(!userMemoryRead(MAPPED_ADDR + 0x10, data, 4));
+
+    setUserMemoryMapper(&mapper);
+    REQUIRE(userMemoryWrite(MAPPED_ADDR + 0x10, values, 4));
+    REQUIRE(userMemoryRead(MAPPED_ADDR + 0x10, data, 4));
+    REQUIRE(data[0] == 0x12);
+    REQUIRE(data[3] == 0x78);
+
+    byte value;
+    REQUIRE(mapper.readMem(MAPPED_ADDR + 0x11, value) == MEM_MAPPER_SUCCESS);
+    REQUIRE(value == 0x34);
+
+    // The mapped memory is only contiguous within a page, so there is no pointer to it
+    REQUIRE(userMemoryPtr(MAPPED_ADDR + 0x10) == 0);
+
+    // Addresses outside of the range of the memory mapper
+    REQUIRE(!userMemoryWrite(MAPPED_ADDR + 0x100, values, 4));
+    REQUIRE(!userMemoryRead(MAPPED_ADDR + 0x100, data, 4));
+
+    // The user EEPROM takes precedence over the memory mapper
+    REQUIRE(userMemoryWrite(USER_EEPROM_START, values, 4));
+    REQUIRE(userEepromData[1] == 0x34);
+    REQUIRE(mapper.readMem(USER_EEPROM_START + 1, value) == MEM_MAPPER_SUCCESS);
+    REQUIRE(value == 0);
+    REQUIRE(userMemoryPtr(USER_EEPROM_START) == userEepromData);
+
+    setUserMemoryMapper(0);
+}
+
+// The test needs at least four pages of the user EEPROM in the flash sector
+#if SECTOR_SIZE / USER_EEPROM_FLASH_SIZE >= 4
+TEST_CASE("User memory: the flash page of the user EEPROM", "[SBLIB][USER_MEMORY][EEPROM]")
+{
+    IAP_Init_Flash(0xff);
+    iapFlashSize();
+    readUserEeprom();
+
+    // Every write uses the next page
+    writeEeprom(1);
+    writeEeprom(2);
+    REQUIRE(EEPROM_PAGE(0)[0] == 1);
+    REQUIRE(EEPROM_PAGE(1)[0] == 2);
+
+    // The sector is erased, e.g. by a flash update
+    IAP_Init_Flash(0xff);
+    writeEeprom(3);
+    REQUIRE(EEPROM_PAGE(0)[0] == 3);
+    REQUIRE(EEPROM_PAGE(1)[USER_EEPROM_SIZE - 1] == 0xff);
+    REQUIRE(EEPROM_PAGE(2)[USER_EEPROM_SIZE - 1] == 0xff);
+
+    // Two more pages are written behind the known page
+    for (int index = 1; index <= 2; ++index)
+    {
+        memset(EEPROM_PAGE(index), 0, USER_EEPROM_SIZE);
+        EEPROM_PAGE(index)[0] = 10 + index;
+    }
+    writeEeprom(4);
+    REQUIRE(EEPROM_PAGE(2)[0] == 12);
+    REQUIRE(EEPROM_PAGE(3)[0] == 4);
+
+    readUserEeprom();
+    REQUIRE(userEepromData[0] == 4);
+}
+#endif
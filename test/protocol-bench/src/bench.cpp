@@ -0,0 +1,354 @@
+/*
+ *  bench.cpp - Micro benchmark of the protocol functions in the host emulation.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  The benchmark measures the time of the functions of the EIB stack that
+ *  depend on the size of the address, association and communication object
+ *  tables. Synthetic tables with 1 to 255 entries are created in the user
+ *  memory of the emulation: group address i is associated with com-object
+ *  i - 1, every com-object is a 1 byte object in the user RAM.
+ *
+ *  The functions are called with the worst case argument of the linear table
+ *  searches: the last entry of the tables. Every benchmark is run RUNS times,
+ *  the fastest run is reported to reduce the noise of the PC.
+ *
+ *  Usage: protocol-bench [-c results.csv]
+ *    -c writes the results as CSV: benchmark,entries,ops,ns_per_op
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define private public
+#include <sblib/eib/bus.h>
+#undef private
+#include <sblib/eib.h>
+#include <sblib/eib/apci.h>
+#include <sblib/eib/addr_tables.h>
+#include <sblib/eib/com_objects.h>
+#include <sblib/eib/datapoint_types.h>
+#include <sblib/eib/user_memory.h>
+#include <sblib/eib/sblib_default_objects.h>
+#include <sblib/internal/functions.h>
+
+#if BCU_TYPE != 0x701
+#  error "The tables with 255 entries need the user memory of a BIM112, compile with BCU_TYPE=0x701"
+#endif
+
+// The number of runs of a benchmark, the fastest run is reported
+#define RUNS 5
+
+// The minimum time of a run in nanoseconds
+#define MIN_RUN_NS 20000000LL
+
+// The maximum number of table entries
+#define MAX_ENTRIES 255
+
+// The offsets of the tables in the user EEPROM. The address table starts at
+// the usual location of the BCU1/BCU2 address table.
+#define ADDR_TAB_OFFSET   0x016
+#define ASSOC_TAB_OFFSET  0x400
+#define CONFIG_TAB_OFFSET 0x600
+
+// The offsets of the object values and flags in the user RAM
+#define VALUES_OFFSET 0x100
+#define FLAGS_OFFSET  0x200
+
+// The physical address of the device
+#define OWN_ADDR 0x11fe
+
+// The group address of the table entry with the index i (1..MAX_ENTRIES)
+#define GROUP_ADDR(i) (0x0800 + (i))
+
+/*
+ * The current time in nanoseconds.
+ */
+static long long nanoTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void setWord(byte* ptr, int value)
+{
+    ptr[0] = value;
+    ptr[1] = value >> 8;
+}
+
+// The number of table entries of the current benchmark
+static int entries;
+
+// The group write telegram to the last group address
+static byte groupTelegram[10];
+
+/*
+ * Create the address, association and com-object tables with the given
+ * number of entries.
+ */
+static void createTables(int count)
+{
+    byte* addrTab = userEepromData + ADDR_TAB_OFFSET;
+    byte* assocTab = userEepromData + ASSOC_TAB_OFFSET;
+    byte* configTab = userEepromData + CONFIG_TAB_OFFSET;
+    int flagsAddr = getUserRamStart() + FLAGS_OFFSET;
+
+    memset(userEepromData, 0, USER_EEPROM_SIZE);
+    memset(userRamData, 0, USER_RAM_SIZE);
+    entries = count;
+
+    setWord((byte*) &userEeprom.addrTabAddr, USER_EEPROM_START + ADDR_TAB_OFFSET);
+    setWord((byte*) &userEeprom.assocTabAddr, USER_EEPROM_START + ASSOC_TAB_OFFSET);
+    setWord((byte*) &userEeprom.commsTabAddr, USER_EEPROM_START + CONFIG_TAB_OFFSET);
+
+    addrTab[0] = count;
+    addrTab[1] = OWN_ADDR >> 8;
+    addrTab[2] = OWN_ADDR;
+
+    assocTab[0] = count;
+
+    // The com-object table with big endian pointers, see le_ptr
+    configTab[0] = count;
+    configTab[1] = flagsAddr >> 8;
+    configTab[2] = flagsAddr;
+
+    for (int i = 1; i <= count; ++i)
+    {
+        int objno = i - 1;
+        int valueAddr = getUserRamStart() + VALUES_OFFSET + objno;
+        byte* cfg = configTab + 3 + objno * sizeof(ComConfig);
+
+        addrTab[1 + i * 2] = GROUP_ADDR(i) >> 8;
+        addrTab[2 + i * 2] = GROUP_ADDR(i);
+
+        assocTab[i * 2 - 1] = i;
+        assocTab[i * 2] = objno;
+
+        cfg[0] = valueAddr >> 8;
+        cfg[1] = valueAddr;
+        cfg[2] = COMCONF_TRANS | COMCONF_WRITE | COMCONF_READ | COMCONF_COMM | COMCONF_PRIO_LOW;
+        cfg[3] = BYTE_1;
+    }
+
+    groupTelegram[0] = 0xbc;
+    groupTelegram[1] = 0x11;
+    groupTelegram[2] = 0x01;
+    groupTelegram[3] = GROUP_ADDR(count) >> 8;
+    groupTelegram[4] = GROUP_ADDR(count);
+    groupTelegram[5] = 0xe2;
+    groupTelegram[6] = 0x00;
+    groupTelegram[7] = 0x80;
+    groupTelegram[8] = 0x42;
+}
+
+/*
+ * Check that the library finds the com-object of the last group address.
+ */
+static void verifyTables()
+{
+    processGroupTelegram(GROUP_ADDR(entries), APCI_GROUP_VALUE_WRITE_PDU, groupTelegram);
+
+    if (indexOfAddr(GROUP_ADDR(entries)) != entries || objectOfAddr(GROUP_ADDR(entries)) != entries - 1
+        || objectRead(entries - 1) != groupTelegram[8] || nextUpdatedObject() != entries - 1)
+    {
+        fprintf(stderr, "the tables with %d entries are not valid\n", entries);
+        exit(1);
+    }
+    while (nextUpdatedObject() >= 0)
+        ;
+}
+
+/*
+ * Discard the telegrams that the library wanted to send.
+ */
+static void clearSendQueue()
+{
+    bus.sendCurTelegram = 0;
+    bus.sendNextTel = 0;
+    bus.state = Bus::IDLE;
+}
+
+//
+//  The benchmarks. An operation is one call of the function, with the
+//  arguments of the worst case for the current table size.
+//
+
+static volatile int sink;
+
+static void benchIndexOfAddr(int i)
+{
+    sink = indexOfAddr(GROUP_ADDR(entries));
+}
+
+static void benchIndexOfAddrMiss(int i)
+{
+    sink = indexOfAddr(0x7fff);
+}
+
+static void benchProcessGroupTelegram(int i)
+{
+    groupTelegram[8] = i;
+    processGroupTelegram(GROUP_ADDR(entries), APCI_GROUP_VALUE_WRITE_PDU, groupTelegram);
+}
+
+static void benchProcessTelegram(int i)
+{
+    memcpy(bus.telegram, groupTelegram, sizeof(groupTelegram));
+    bus.telegram[8] = i;
+    bus.telegramLen = sizeof(groupTelegram);
+    bcu.processTelegram();
+}
+
+// objectWritten() and the calls of sendNextGroupTelegram() until no object is pending
+static void benchSendNextGroupTelegram(int i)
+{
+    objectWritten(entries - 1);
+    while (sendNextGroupTelegram())
+        clearSendQueue();
+}
+
+// objectUpdate() and the calls of nextUpdatedObject() until no object is updated
+static void benchNextUpdatedObject(int i)
+{
+    objectUpdate(entries - 1, i);
+    while (nextUpdatedObject() >= 0)
+        ;
+}
+
+static void benchObjectRead(int i)
+{
+    sink = objectRead(entries - 1);
+}
+
+static void benchObjectWrite(int i)
+{
+    extern void _objectWrite(int objno, unsigned int val, int flags);
+    _objectWrite(entries - 1, i, 0);
+}
+
+static void benchDptToFloat(int i)
+{
+    sink = dptToFloat((i & 0xffff) * 1021 - 0x800000);
+}
+
+struct Benchmark
+{
+    const char* name;          //!< The name of the benchmark
+    void (*func)(int i);       //!< The operation
+    bool tableSize;            //!< True if the operation depends on the table size
+};
+
+static const Benchmark benchmarks[] =
+{
+    { "indexOfAddr",            benchIndexOfAddr,           true },
+    { "indexOfAddr_miss",       benchIndexOfAddrMiss,       true },
+    { "processGroupTelegram",   benchProcessGroupTelegram,  true },
+    { "BCU::processTelegram",   benchProcessTelegram,       true },
+    { "sendNextGroupTelegram",  benchSendNextGroupTelegram, true },
+    { "nextUpdatedObject",      benchNextUpdatedObject,     true },
+    { "objectRead",             benchObjectRead,            true },
+    { "_objectWrite",           benchObjectWrite,           true },
+    { "dptToFloat",             benchDptToFloat,            false },
+    { 0, 0, false }
+};
+
+// The table sizes of the benchmarks
+static const int tableSizes[] = { 1, 8, 32, 64, 128, 192, 255, 0 };
+
+/*
+ * Run a benchmark.
+ *
+ * @param func - the operation.
+ * @param ops - set to the number of operations of the fastest run.
+ * @return The time of an operation in nanoseconds.
+ */
+static double measure(void (*func)(int), long long* ops)
+{
+    long long count = 1;
+    double best = 0;
+
+    // Find the number of operations for a run of MIN_RUN_NS
+    for (;;)
+    {
+        long long start = nanoTime();
+        for (long long i = 0; i < count; ++i)
+            func(i);
+        if (nanoTime() - start >= MIN_RUN_NS / 10)
+            break;
+        count *= 2;
+    }
+    count *= 10;
+
+    for (int run = 0; run < RUNS; ++run)
+    {
+        long long start = nanoTime();
+        for (long long i = 0; i < count; ++i)
+            func(i);
+        double ns = (double) (nanoTime() - start) / count;
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+
+    *ops = count;
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    FILE* csv = 0;
+
+    if (argc == 3 && !strcmp(argv[1], "-c"))
+    {
+        csv = fopen(argv[2], "w");
+        if (!csv)
+        {
+            perror(argv[2]);
+            return 1;
+        }
+        fprintf(csv, "benchmark,entries,ops,ns_per_op\n");
+    }
+    else if (argc != 1)
+    {
+        fprintf(stderr, "usage: %s [-c results.csv]\n", argv[0]);
+        return 1;
+    }
+
+    if (sizeof(UserEeprom) > ASSOC_TAB_OFFSET)
+    {
+        fprintf(stderr, "the tables overlap the system EEPROM\n");
+        return 1;
+    }
+
+    printf("%-24s %7s %12s %10s\n", "benchmark", "entries", "ops", "ns/op");
+    for (const Benchmark* bench = benchmarks; bench->name; ++bench)
+    {
+        for (const int* size = tableSizes; *size; ++size)
+        {
+            int count = bench->tableSize ? *size : MAX_ENTRIES;
+            long long ops;
+
+            createTables(count);
+            verifyTables();
+            double ns = measure(bench->func, &ops);
+            clearSendQueue();
+
+            if (!bench->tableSize)
+                count = 0;
+            printf("%-24s %7d %12lld %10.1f\n", bench->name, count, ops, ns);
+            if (csv)
+                fprintf(csv, "%s,%d,%lld,%.1f\n", bench->name, count, ops, ns);
+
+            if (!bench->tableSize)
+                break;
+        }
+    }
+
+    if (csv)
+        fclose(csv);
+    return 0;
+}
@@ -30,6 +30,8 @@
 #ifndef __LPC11xx_H__
 #define __LPC11xx_H__
 
+#include "emu_register.h"
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -314,21 +316,21 @@ typedef struct {                            /*!< (@ 0x4003C000) FLASHCTRL Struct
 typedef struct
 {
   union {
-    __IO uint32_t MASKED_ACCESS[4096];  /*!< Offset: 0x0000 to 0x3FFC Port data Register for pins PIOn_0 to PIOn_11 (R/W) */
+    __EMU_REG(__IO) MASKED_ACCESS[4096]; /*!< Offset: 0x0000 to 0x3FFC Port data Register for pins PIOn_0 to PIOn_11 (R/W) */
     struct {
          uint32_t RESERVED0[4095];
-    __IO uint32_t DATA;                 /*!< Offset: 0x3FFC Port data Register (R/W) */
+    __EMU_REG(__IO) DATA;               /*!< Offset: 0x3FFC Port data Register (R/W) */
     };
   };
        uint32_t RESERVED1[4096];
-  __IO uint32_t DIR;                    /*!< Offset: 0x8000 Data direction Register (R/W) */
-  __IO uint32_t IS;                     /*!< Offset: 0x8004 Interrupt sense Register (R/W) */
-  __IO uint32_t IBE;                    /*!< Offset: 0x8008 Interrupt both edges Register (R/W) */
-  __IO uint32_t IEV;                    /*!< Offset: 0x800C Interrupt event Register  (R/W) */
-  __IO uint32_t IE;                     /*!< Offset: 0x8010 Interrupt mask Register (R/W) */
-  __I uint32_t RIS;                    /*!< Offset: 0x8014 Raw interrupt status Register (R/ ) */
-  __I uint32_t MIS;                    /*!< Offset: 0x8018 Masked interrupt status Register (R/ ) */
-  __O uint32_t IC;                     /*!< Offset: 0x801C Interrupt clear Register (/W) */
+  __EMU_REG(__IO) DIR;                  /*!< Offset: 0x8000 Data direction Register (R/W) */
+  __EMU_REG(__IO) IS;                   /*!< Offset: 0x8004 Interrupt sense Register (R/W) */
+  __EMU_REG(__IO) IBE;                  /*!< Offset: 0x8008 Interrupt both edges Register (R/W) */
+  __EMU_REG(__IO) IEV;                  /*!< Offset: 0x800C Interrupt event Register  (R/W) */
+  __EMU_REG(__IO) IE;                   /*!< Offset: 0x8010 Interrupt mask Register (R/W) */
+  __EMU_REG(__I) RIS;                  /*!< Offset: 0x8014 Raw interrupt status Register (R/ ) */
+  __EMU_REG(__I) MIS;                  /*!< Offset: 0x8018 Masked interrupt status Register (R/ ) */
+  __EMU_REG(__O) IC;                   /*!< Offset: 0x801C Interrupt clear Register (/W) */
 } LPC_GPIO_TypeDef;
 /*@}*/ /* end of group LPC11xx_GPIO */
 
@@ -338,24 +340,24 @@ typedef struct
 */
 typedef struct
 {
-  __IO uint32_t IR;                     /*!< Offset: 0x000 Interrupt Register (R/W) */
-  __IO uint32_t TCR;                    /*!< Offset: 0x004 Timer Control Register (R/W) */
-  __IO uint32_t TC;                     /*!< Offset: 0x008 Timer Counter Register (R/W) */
-  __IO uint32_t PR;                     /*!< Offset: 0x00C Prescale Register (R/W) */
-  __IO uint32_t PC;                     /*!< Offset: 0x010 Prescale Counter Register (R/W) */
-  __IO uint32_t MCR;                    /*!< Offset: 0x014 Match Control Register (R/W) */
-  __IO uint32_t MR0;                    /*!< Offset: 0x018 Match Register 0 (R/W) */
-  __IO uint32_t MR1;                    /*!< Offset: 0x01C Match Register 1 (R/W) */
-  __IO uint32_t MR2;                    /*!< Offset: 0x020 Match Register 2 (R/W) */
-  __IO uint32_t MR3;                    /*!< Offset: 0x024 Match Register 3 (R/W) */
-  __IO uint32_t CCR;                    /*!< Offset: 0x028 Capture Control Register (R/W) */
-  __I  uint32_t CR0;                    /*!< Offset: 0x02C Capture Register 0 (R/ ) */
-  __I  uint32_t CR1;                    /*!< Offset: 0x030 Capture Register 1 (R/ ) */
+  __EMU_REG(__IO) IR;                 /*!< Offset: 0x000 Interrupt Register (R/W) */
+  __EMU_REG(__IO) TCR;                /*!< Offset: 0x004 Timer Control Register (R/W) */
+  __EMU_REG(__IO) TC;                 /*!< Offset: 0x008 Timer Counter Register (R/W) */
+  __EMU_REG(__IO) PR;                 /*!< Offset: 0x00C Prescale Register (R/W) */
+  __EMU_REG(__IO) PC;                 /*!< Offset: 0x010 Prescale Counter Register (R/W) */
+  __EMU_REG(__IO) MCR;                /*!< Offset: 0x014 Match Control Register (R/W) */
+  __EMU_REG(__IO) MR0;                /*!< Offset: 0x018 Match Register 0 (R/W) */
+  __EMU_REG(__IO) MR1;                /*!< Offset: 0x01C Match Register 1 (R/W) */
+  __EMU_REG(__IO) MR2;                /*!< Offset: 0x020 Match Register 2 (R/W) */
+  __EMU_REG(__IO) MR3;                /*!< Offset: 0x024 Match Register 3 (R/W) */
+  __EMU_REG(__IO) CCR;                /*!< Offset: 0x028 Capture Control Register (R/W) */
+  __EMU_REG(__I) CR0;                 /*!< Offset: 0x02C Capture Register 0 (R/ ) */
+  __EMU_REG(__I) CR1;                 /*!< Offset: 0x030 Capture Register 1 (R/ ) */
        uint32_t RESERVED1[2];
-  __IO uint32_t EMR;                    /*!< Offset: 0x03C External Match Register (R/W) */
+  __EMU_REG(__IO) EMR;                /*!< Offset: 0x03C External Match Register (R/W) */
        uint32_t RESERVED2[12];
-  __IO uint32_t CTCR;                   /*!< Offset: 0x070 Count Control Register (R/W) */
-  __IO uint32_t PWMC;                   /*!< Offset: 0x074 PWM Control Register (R/W) */
+  __EMU_REG(__IO) CTCR;               /*!< Offset: 0x070 Count Control Register (R/W) */
+  __EMU_REG(__IO) PWMC;               /*!< Offset: 0x074 PWM Control Register (R/W) */
 } LPC_TMR_TypeDef;
 /*@}*/ /* end of group LPC11xx_TMR */
 
@@ -367,33 +369,33 @@ typedef struct
 typedef struct
 {
   union {
-  __I  uint32_t  RBR;                   /*!< Offset: 0x000 Receiver Buffer  Register (R/ ) */
-  __O  uint32_t  THR;                   /*!< Offset: 0x000 Transmit Holding Register ( /W) */
-  __IO uint32_t  DLL;                   /*!< Offset: 0x000 Divisor Latch LSB (R/W) */
+  __EMU_REG(__I) RBR;                   /*!< Offset: 0x000 Receiver Buffer  Register (R/ ) */
+  __EMU_REG(__O) THR;                   /*!< Offset: 0x000 Transmit Holding Register ( /W) */
+  __EMU_REG(__IO) DLL;                  /*!< Offset: 0x000 Divisor Latch LSB (R/W) */
   };
   union {
-  __IO uint32_t  DLM;                   /*!< Offset: 0x004 Divisor Latch MSB (R/W) */
-  __IO uint32_t  IER;                   /*!< Offset: 0x000 Interrupt Enable Register (R/W) */
+  __EMU_REG(__IO) DLM;                  /*!< Offset: 0x004 Divisor Latch MSB (R/W) */
+  __EMU_REG(__IO) IER;                  /*!< Offset: 0x000 Interrupt Enable Register (R/W) */
   };
   union {
-  __I  uint32_t  IIR;                   /*!< Offset: 0x008 Interrupt ID Register (R/ ) */
-  __O  uint32_t  FCR;                   /*!< Offset: 0x008 FIFO Control Register ( /W) */
+  __EMU_REG(__I) IIR;                   /*!< Offset: 0x008 Interrupt ID Register (R/ ) */
+  __EMU_REG(__O) FCR;                   /*!< Offset: 0x008 FIFO Control Register ( /W) */
   };
-  __IO uint32_t  LCR;                   /*!< Offset: 0x00C Line Control Register (R/W) */
-  __IO uint32_t  MCR;                   /*!< Offset: 0x010 Modem control Register (R/W) */
-  __I  uint32_t  LSR;                   /*!< Offset: 0x014 Line Status Register (R/ ) */
-  __I  uint32_t  MSR;                   /*!< Offset: 0x018 Modem status Register (R/ ) */
-  __IO uint32_t  SCR;                   /*!< Offset: 0x01C Scratch Pad Register (R/W) */
-  __IO uint32_t  ACR;                   /*!< Offset: 0x020 Auto-baud Control Register (R/W) */
+  __EMU_REG(__IO) LCR;                  /*!< Offset: 0x00C Line Control Register (R/W) */
+  __EMU_REG(__IO) MCR;                  /*!< Offset: 0x010 Modem control Register (R/W) */
+  __EMU_REG(__I) LSR;                   /*!< Offset: 0x014 Line Status Register (R/ ) */
+  __EMU_REG(__I) MSR;                   /*!< Offset: 0x018 Modem status Register (R/ ) */
+  __EMU_REG(__IO) SCR;                  /*!< Offset: 0x01C Scratch Pad Register (R/W) */
+  __EMU_REG(__IO) ACR;                  /*!< Offset: 0x020 Auto-baud Control Register (R/W) */
        uint32_t  RESERVED0;
-  __IO uint32_t  FDR;                   /*!< Offset: 0x028 Fractional Divider Register (R/W) */
+  __EMU_REG(__IO) FDR;                  /*!< Offset: 0x028 Fractional Divider Register (R/W) */
        uint32_t  RESERVED1;
-  __IO uint32_t  TER;                   /*!< Offset: 0x030 Transmit Enable Register (R/W) */
+  __EMU_REG(__IO) TER;                  /*!< Offset: 0x030 Transmit Enable Register (R/W) */
        uint32_t  RESERVED2[6];
-  __IO uint32_t  RS485CTRL;             /*!< Offset: 0x04C RS-485/EIA-485 Control Register (R/W) */
-  __IO uint32_t  ADRMATCH;              /*!< Offset: 0x050 RS-485/EIA-485 address match Register (R/W) */
-  __IO uint32_t  RS485DLY;              /*!< Offset: 0x054 RS-485/EIA-485 direction control delay Register (R/W) */
-  __I  uint32_t  FIFOLVL;               /*!< Offset: 0x058 FIFO Level Register (R) */
+  __EMU_REG(__IO) RS485CTRL;            /*!< Offset: 0x04C RS-485/EIA-485 Control Register (R/W) */
+  __EMU_REG(__IO) ADRMATCH;             /*!< Offset: 0x050 RS-485/EIA-485 address match Register (R/W) */
+  __EMU_REG(__IO) RS485DLY;             /*!< Offset: 0x054 RS-485/EIA-485 direction control delay Register (R/W) */
+  __EMU_REG(__I) FIFOLVL;               /*!< Offset: 0x058 FIFO Level Register (R) */
 } LPC_UART_TypeDef;
 /*@}*/ /* end of group LPC11xx_UART */
 
@@ -404,15 +406,15 @@ typedef struct
 */
 typedef struct
 {
-  __IO uint32_t CR0;                    /*!< Offset: 0x000 Control Register 0 (R/W) */
-  __IO uint32_t CR1;                    /*!< Offset: 0x004 Control Register 1 (R/W) */
-  __IO uint32_t DR;                     /*!< Offset: 0x008 Data Register (R/W) */
-  __I  uint32_t SR;                     /*!< Offset: 0x00C Status Registe (R/ ) */
-  __IO uint32_t CPSR;                   /*!< Offset: 0x010 Clock Prescale Register (R/W) */
-  __IO uint32_t IMSC;                   /*!< Offset: 0x014 Interrupt Mask Set and Clear Register (R/W) */
-  __I uint32_t RIS;                    /*!< Offset: 0x018 Raw Interrupt Status Register (R/) */
-  __I uint32_t MIS;                    /*!< Offset: 0x01C Masked Interrupt Status Register (R/) */
-  __O uint32_t ICR;                    /*!< Offset: 0x020 SSPICR Interrupt Clear Register (/W) */
+  __EMU_REG(__IO) CR0;                  /*!< Offset: 0x000 Control Register 0 (R/W) */
+  __EMU_REG(__IO) CR1;                  /*!< Offset: 0x004 Control Register 1 (R/W) */
+  __EMU_REG(__IO) DR;                   /*!< Offset: 0x008 Data Register (R/W) */
+  __EMU_REG(__I) SR;                    /*!< Offset: 0x00C Status Registe (R/ ) */
+  __EMU_REG(__IO) CPSR;                 /*!< Offset: 0x010 Clock Prescale Register (R/W) */
+  __EMU_REG(__IO) IMSC;                 /*!< Offset: 0x014 Interrupt Mask Set and Clear Register (R/W) */
+  __EMU_REG(__I) RIS;                  /*!< Offset: 0x018 Raw Interrupt Status Register (R/) */
+  __EMU_REG(__I) MIS;                  /*!< Offset: 0x01C Masked Interrupt Status Register (R/) */
+  __EMU_REG(__O) ICR;                  /*!< Offset: 0x020 SSPICR Interrupt Clear Register (/W) */
 } LPC_SSP_TypeDef;
 /*@}*/ /* end of group LPC11xx_SSP */
 
@@ -423,22 +425,22 @@ typedef struct
 */
 typedef struct
 {
-  __IO uint32_t CONSET;                 /*!< Offset: 0x000 I2C Control Set Register (R/W) */
-  __I  uint32_t STAT;                   /*!< Offset: 0x004 I2C Status Register (R/ ) */
-  __IO uint32_t DAT;                    /*!< Offset: 0x008 I2C Data Register (R/W) */
-  __IO uint32_t ADR0;                   /*!< Offset: 0x00C I2C Slave Address Register 0 (R/W) */
-  __IO uint32_t SCLH;                   /*!< Offset: 0x010 SCH Duty Cycle Register High Half Word (R/W) */
-  __IO uint32_t SCLL;                   /*!< Offset: 0x014 SCL Duty Cycle Register Low Half Word (R/W) */
-  __O  uint32_t CONCLR;                 /*!< Offset: 0x018 I2C Control Clear Register ( /W) */
-  __IO uint32_t MMCTRL;                 /*!< Offset: 0x01C Monitor mode control register (R/W) */
-  __IO uint32_t ADR1;                   /*!< Offset: 0x020 I2C Slave Address Register 1 (R/W) */
-  __IO uint32_t ADR2;                   /*!< Offset: 0x024 I2C Slave Address Register 2 (R/W) */
-  __IO uint32_t ADR3;                   /*!< Offset: 0x028 I2C Slave Address Register 3 (R/W) */
-  __I  uint32_t DATA_BUFFER;            /*!< Offset: 0x02C Data buffer register ( /W) */
-  __IO uint32_t MASK0;                  /*!< Offset: 0x030 I2C Slave address mask register 0 (R/W) */
-  __IO uint32_t MASK1;                  /*!< Offset: 0x034 I2C Slave address mask register 1 (R/W) */
-  __IO uint32_t MASK2;                  /*!< Offset: 0x038 I2C Slave address mask register 2 (R/W) */
-  __IO uint32_t MASK3;                  /*!< Offset: 0x03C I2C Slave address mask register 3 (R/W) */
+  __EMU_REG(__IO) CONSET;               /*!< Offset: 0x000 I2C Control Set Register (R/W) */
+  __EMU_REG(__I) STAT;                  /*!< Offset: 0x004 I2C Status Register (R/ ) */
+  __EMU_REG(__IO) DAT;                  /*!< Offset: 0x008 I2C Data Register (R/W) */
+  __EMU_REG(__IO) ADR0;                 /*!< Offset: 0x00C I2C Slave Address Register 0 (R/W) */
+  __EMU_REG(__IO) SCLH;                 /*!< Offset: 0x010 SCH Duty Cycle Register High Half Word (R/W) */
+  __EMU_REG(__IO) SCLL;                 /*!< Offset: 0x014 SCL Duty Cycle Register Low Half Word (R/W) */
+  __EMU_REG(__O) CONCLR;                /*!< Offset: 0x018 I2C Control Clear Register ( /W) */
+  __EMU_REG(__IO) MMCTRL;               /*!< Offset: 0x01C Monitor mode control register (R/W) */
+  __EMU_REG(__IO) ADR1;                 /*!< Offset: 0x020 I2C Slave Address Register 1 (R/W) */
+  __EMU_REG(__IO) ADR2;                 /*!< Offset: 0x024 I2C Slave Address Register 2 (R/W) */
+  __EMU_REG(__IO) ADR3;                 /*!< Offset: 0x028 I2C Slave Address Register 3 (R/W) */
+  __EMU_REG(__I) DATA_BUFFER;           /*!< Offset: 0x02C Data buffer register ( /W) */
+  __EMU_REG(__IO) MASK0;                /*!< Offset: 0x030 I2C Slave address mask register 0 (R/W) */
+  __EMU_REG(__IO) MASK1;                /*!< Offset: 0x034 I2C Slave address mask register 1 (R/W) */
+  __EMU_REG(__IO) MASK2;                /*!< Offset: 0x038 I2C Slave address mask register 2 (R/W) */
+  __EMU_REG(__IO) MASK3;                /*!< Offset: 0x03C I2C Slave address mask register 3 (R/W) */
 } LPC_I2C_TypeDef;
 /*@}*/ /* end of group LPC11xx_I2C */
 
@@ -466,12 +468,12 @@ typedef struct
 */
 typedef struct
 {
-  __IO uint32_t CR;                     /*!< Offset: 0x000       A/D Control Register (R/W) */
-  __IO uint32_t GDR;                    /*!< Offset: 0x004       A/D Global Data Register (R/W) */
+  __EMU_REG(__IO) CR;                   /*!< Offset: 0x000       A/D Control Register (R/W) */
+  __EMU_REG(__IO) GDR;                  /*!< Offset: 0x004       A/D Global Data Register (R/W) */
        uint32_t RESERVED0;
-  __IO uint32_t INTEN;                  /*!< Offset: 0x00C       A/D Interrupt Enable Register (R/W) */
-  __IO uint32_t DR[8];                  /*!< Offset: 0x010-0x02C A/D Channel 0..7 Data Register (R/W) */
-  __I  uint32_t STAT;                   /*!< Offset: 0x030       A/D Status Register (R/ ) */
+  __EMU_REG(__IO) INTEN;                /*!< Offset: 0x00C       A/D Interrupt Enable Register (R/W) */
+  __EMU_REG(__IO) DR[8];                /*!< Offset: 0x010-0x02C A/D Channel 0..7 Data Register (R/W) */
+  __EMU_REG(__I) STAT;                  /*!< Offset: 0x030       A/D Status Register (R/ ) */
 } LPC_ADC_TypeDef;
 /*@}*/ /* end of group LPC11xx_ADC */
 
@@ -0,0 +1,63 @@
+/*
+ *  emu_register.h - A register of an emulated peripheral
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef EMU_REGISTER_H_
+#define EMU_REGISTER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+
+/*
+ * A register of a peripheral that is emulated by PeriphEmu, see periph_emu.h.
+ *
+ * The register has the size and layout of a uint32_t, but every read and
+ * write of the software is passed to the emulation, so the emulation can
+ * react like the hardware does: a write to the transmit register of the UART
+ * starts the transmission, the status register shows when it is over, and so
+ * on. While the emulation is not active the register is plain memory.
+ *
+ * The registers of the timers are EmuRegisters too, only to count their
+ * accesses. They are emulated by TIMER_Emu_xx, see timer_emu.h.
+ *
+ * A read whose value is not used, like "LPC_ADC->DR[0];", does not reach the
+ * emulation.
+ */
+class EmuRegister
+{
+public:
+    operator uint32_t() const;
+    EmuRegister& operator=(uint32_t val);
+    EmuRegister& operator|=(uint32_t val);
+    EmuRegister& operator&=(uint32_t val);
+    EmuRegister& operator^=(uint32_t val);
+
+    uint32_t value;     // The value while the emulation is not active
+};
+
+/*
+ * The number of reads and writes of the registers by the software, also while
+ * the emulation is not active. A read-modify-write counts twice. The profiler
+ * of the bus interrupt handler uses it as its clock, see bus_isr_profile.h.
+ */
+extern unsigned int emuRegisterAccesses;
+
+/*
+ * Declare a register of an emulated peripheral.
+ *
+ * @param access - the access qualifier of the register: __I, __O or __IO
+ */
+#define __EMU_REG(access)  EmuRegister
+
+#else
+
+#define __EMU_REG(access)  access uint32_t
+
+#endif
+
+#endif /* EMU_REGISTER_H_ */
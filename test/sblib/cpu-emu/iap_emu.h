@@ -22,16 +22,21 @@ enum IAP_Function
     I_ERASE = 1,
     I_BLANK_CHECK = 2,
     I_RAM2FLASH = 3,
-    I_COMPARE = 4
+    I_COMPARE = 4,
+    I_ERASE_PAGE = 5
 };
 
-extern int iap_calls[5];
+extern int iap_calls[6];
+extern unsigned int iap_programmed_bytes;
 void IAP_Init_Flash(unsigned char value);
 
 
 // Size of a flash sector: 4k
 #define SECTOR_SIZE  0x1000
 
+// Size of a flash page: 256 bytes
+#define PAGE_SIZE  0x100
+
 // Size for the simulated flash: 32k (8 * 4k)
 #define FLASH_SIZE  0x8000
 
@@ -0,0 +1,1237 @@
+/*
+ *  periph_emu.cpp - Emulation of the UART, SSP, I2C, GPIO and ADC peripherals
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "periph_emu.h"
+#include <string.h>
+
+// The registers of the emulated peripherals
+LPC_I2C_TypeDef    _LPC_I2C;
+LPC_UART_TypeDef   _LPC_UART;
+LPC_ADC_TypeDef    _LPC_ADC;
+LPC_SSP_TypeDef    _LPC_SSP0;
+LPC_SSP_TypeDef    _LPC_SSP1;
+LPC_GPIO_TypeDef   _LPC_GPIO0;
+LPC_GPIO_TypeDef   _LPC_GPIO1;
+LPC_GPIO_TypeDef   _LPC_GPIO2;
+LPC_GPIO_TypeDef   _LPC_GPIO3;
+
+PeriphEmu periphEmu;
+
+unsigned int emuRegisterAccesses;
+
+extern volatile unsigned int systemTime;
+
+// The interrupt handlers of the library, if they are linked
+extern "C"
+{
+    void SysTick_Handler() __attribute__ ((weak));
+    void UART_IRQHandler() __attribute__ ((weak));
+    void SSP0_IRQHandler() __attribute__ ((weak));
+    void SSP1_IRQHandler() __attribute__ ((weak));
+    void I2C_IRQHandler() __attribute__ ((weak));
+    void ADC_IRQHandler() __attribute__ ((weak));
+    void PIOINT0_IRQHandler() __attribute__ ((weak));
+    void PIOINT1_IRQHandler() __attribute__ ((weak));
+    void PIOINT2_IRQHandler() __attribute__ ((weak));
+    void PIOINT3_IRQHandler() __attribute__ ((weak));
+}
+
+// UART: line status register bits
+#define LSR_RDR   0x01
+#define LSR_OE    0x02
+#define LSR_THRE  0x20
+#define LSR_TEMT  0x40
+
+// UART: interrupt enable register bits
+#define IER_RBR   0x01
+#define IER_THRE  0x02
+#define IER_RLS   0x04
+
+// UART: the divisor latch access bit of LCR
+#define LCR_DLAB  0x80
+
+// SSP: control register 1 bits
+#define SSP_CR1_LBM  0x01
+#define SSP_CR1_SSE  0x02
+
+// SSP: status register bits
+#define SSP_SR_TFE   0x01
+#define SSP_SR_TNF   0x02
+#define SSP_SR_RNE   0x04
+#define SSP_SR_RFF   0x08
+#define SSP_SR_BSY   0x10
+
+// SSP: raw interrupt status bits
+#define SSP_RIS_ROR  0x01
+#define SSP_RIS_RX   0x04
+#define SSP_RIS_TX   0x08
+
+// I2C: control register bits
+#define I2C_AA    0x04
+#define I2C_SI    0x08
+#define I2C_STO   0x10
+#define I2C_STA   0x20
+#define I2C_I2EN  0x40
+
+// I2C: the status when no state information is available
+#define I2C_STAT_IDLE  0xf8
+
+// ADC: data register bits
+#define ADC_DONE     0x80000000
+#define ADC_OVERRUN  0x40000000
+
+// ADC: control register bits
+#define ADC_BURST    (1 << 16)
+#define ADC_START_NOW  1
+
+// The number of ADC clocks of a conversion
+#define ADC_CONVERSION_CLOCKS 11
+
+// The number of ports of the GPIO
+#define GPIO_PORTS 4
+
+// The pins of a GPIO port
+#define GPIO_PINS_MASK 0xfff
+
+
+/*
+ * @return The offset of a register in a peripheral, -1 if the register is
+ *         not in the peripheral.
+ */
+static int offsetIn(const void* reg, const void* regs, unsigned int size)
+{
+    const char* ptr = (const char*) reg;
+    const char* base = (const char*) regs;
+
+    if (ptr < base || ptr >= base + size)
+        return -1;
+    return ptr - base;
+}
+
+/*
+ * @return The divider of a clock, 1 if it is not set.
+ */
+static unsigned int clockDiv(unsigned int div)
+{
+    return div ? div : 1;
+}
+
+/*
+ * @return The number of CPU cycles of a clock of a peripheral with a clock divider.
+ */
+static EmuTime peripheralCycles(unsigned int div)
+{
+    return clockDiv(div) / clockDiv(LPC_SYSCON->SYSAHBCLKDIV);
+}
+
+
+EmuRegister::operator uint32_t() const
+{
+    ++emuRegisterAccesses;
+    if (periphEmu.active())
+        return periphEmu.readRegister(this);
+    return value;
+}
+
+EmuRegister& EmuRegister::operator=(uint32_t val)
+{
+    ++emuRegisterAccesses;
+    if (periphEmu.active())
+        periphEmu.writeRegister(this, val);
+    else value = val;
+    return *this;
+}
+
+EmuRegister& EmuRegister::operator|=(uint32_t val)
+{
+    return *this = (uint32_t) *this | val;
+}
+
+EmuRegister& EmuRegister::operator&=(uint32_t val)
+{
+    return *this = (uint32_t) *this & val;
+}
+
+EmuRegister& EmuRegister::operator^=(uint32_t val)
+{
+    return *this = (uint32_t) *this ^ val;
+}
+
+
+PeriphEmu::PeriphEmu()
+:accessCycles(4)
+,isActive(false)
+{
+}
+
+void PeriphEmu::begin()
+{
+    isActive = false;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&uart, 0, sizeof(uart));
+    memset(ssp, 0, sizeof(ssp));
+    memset(&i2c, 0, sizeof(i2c));
+    memset(&adc, 0, sizeof(adc));
+    memset(gpio, 0, sizeof(gpio));
+    pinDeviceCount = 0;
+    uartSentLength = 0;
+
+    uart.fdr = 0x10;
+    i2c.stat = I2C_STAT_IDLE;
+    adc.channel = -1;
+    for (int port = 0; port < GPIO_PORTS; ++port)
+        gpio[port].input = gpio[port].drive = GPIO_PINS_MASK;
+
+    if (!LPC_SYSCON->SYSAHBCLKDIV)
+        LPC_SYSCON->SYSAHBCLKDIV = 1;
+
+    time = 0;
+    nextTick = SystemCoreClock / 1000;
+    SysTick->LOAD = SystemCoreClock / 1000 - 1;
+    SysTick->VAL = SysTick->LOAD;
+    enabledIrqs = 0;
+    inInterrupt = false;
+    NVIC->ISER[0] = 0;
+    NVIC->ICER[0] = 0;
+
+    isActive = true;
+}
+
+void PeriphEmu::end()
+{
+    isActive = false;
+}
+
+unsigned long long PeriphEmu::micros() const
+{
+    return time / (SystemCoreClock / 1000000);
+}
+
+EmuTime PeriphEmu::cycles(unsigned int usec) const
+{
+    return (EmuTime) usec * (SystemCoreClock / 1000000);
+}
+
+void PeriphEmu::advance(EmuTime cycles)
+{
+    if (!isActive)
+        return;
+
+    EmuTime target = time + cycles;
+    for (;;)
+    {
+        EmuTime next = nextEvent();
+        if (next > target)
+            break;
+
+        setTime(next);
+        processEvents();
+        dispatchInterrupts();
+    }
+
+    setTime(target);
+    dispatchInterrupts();
+}
+
+void PeriphEmu::idle()
+{
+    EmuTime next = nextEvent();
+    if (next <= time)
+        next = time + 1;
+
+    stats.idleTime += next - time;
+    advance(next - time);
+}
+
+EmuTime PeriphEmu::nextEvent() const
+{
+    EmuTime next = nextTick;
+
+    if (uart.shifting && uart.shiftDone < next)
+        next = uart.shiftDone;
+    if (uart.inputCount && uart.nextInput < next)
+        next = uart.nextInput;
+    for (int port = 0; port < 2; ++port)
+    {
+        if (ssp[port].busy && ssp[port].frameDone < next)
+            next = ssp[port].frameDone;
+    }
+    if (i2c.scheduled && i2c.stepDone < next)
+        next = i2c.stepDone;
+    if (adc.channel >= 0 && adc.done < next)
+        next = adc.done;
+
+    return next;
+}
+
+void PeriphEmu::setTime(EmuTime newTime)
+{
+    if (newTime > time)
+        time = newTime;
+
+    // SysTick counts down to 0 at the next tick
+    if (nextTick > time)
+        SysTick->VAL = (uint32_t) (nextTick - time - 1);
+}
+
+void PeriphEmu::processEvents()
+{
+    while (nextTick <= time)
+    {
+        nextTick += SystemCoreClock / 1000;
+        tick();
+    }
+
+    if (uart.shifting && uart.shiftDone <= time)
+    {
+        uart.shifting = false;
+        if (uartSentLength < EMU_UART_BUFFER_SIZE)
+            uartSent[uartSentLength++] = uart.shiftByte;
+        ++stats.uartSent;
+        uartStartShift();
+    }
+
+    if (uart.inputCount && uart.nextInput <= time)
+    {
+        if (uart.rxCount < EMU_UART_FIFO_SIZE)
+        {
+            uart.rxFifo[(uart.rxHead + uart.rxCount) % EMU_UART_FIFO_SIZE] = uart.input[uart.inputHead];
+            ++uart.rxCount;
+        }
+        else
+        {
+            uart.lsrErrors |= LSR_OE;
+            ++stats.uartOverruns;
+        }
+        ++stats.uartReceived;
+
+        uart.inputHead = (uart.inputHead + 1) % EMU_UART_BUFFER_SIZE;
+        --uart.inputCount;
+        uart.nextInput += uartFrameCycles();
+    }
+
+    for (int port = 0; port < 2; ++port)
+    {
+        if (ssp[port].busy && ssp[port].frameDone <= time)
+            sspFrameDone(port);
+    }
+
+    if (i2c.scheduled && i2c.stepDone <= time)
+    {
+        i2cStep();
+        i2cSchedule();
+    }
+
+    if (adc.channel >= 0 && adc.done <= time)
+        adcDone();
+}
+
+void PeriphEmu::tick()
+{
+    if (SysTick_Handler)
+        SysTick_Handler();
+    else ++systemTime;
+}
+
+void PeriphEmu::dispatchInterrupts()
+{
+    for (int calls = 0; ; ++calls)
+    {
+        // Apply the writes to the NVIC
+        if (NVIC->ICER[0])
+        {
+            enabledIrqs &= ~NVIC->ICER[0];
+            NVIC->ICER[0] = 0;
+        }
+        if (NVIC->ISER[0])
+        {
+            enabledIrqs |= NVIC->ISER[0];
+            NVIC->ISER[0] = 0;
+        }
+
+        // Stop after a number of calls if a handler does not clear its interrupt
+        if (inInterrupt || calls >= 16)
+            return;
+
+        void (*handler)() = 0;
+
+        if ((enabledIrqs & (1 << UART_IRQn)) && uartInterrupt())
+            handler = UART_IRQHandler;
+        else if ((enabledIrqs & (1 << SSP0_IRQn)) && (ssp[0].ris & ssp[0].imsc))
+            handler = SSP0_IRQHandler;
+        else if ((enabledIrqs & (1 << SSP1_IRQn)) && (ssp[1].ris & ssp[1].imsc))
+            handler = SSP1_IRQHandler;
+        else if ((enabledIrqs & (1 << I2C_IRQn)) && (i2c.conset & I2C_SI))
+            handler = I2C_IRQHandler;
+        else if ((enabledIrqs & (1 << ADC_IRQn)) && (adc.stat & adc.inten & 0xff))
+            handler = ADC_IRQHandler;
+        else
+        {
+            static void (* const pinHandlers[GPIO_PORTS])() = {
+                PIOINT0_IRQHandler, PIOINT1_IRQHandler, PIOINT2_IRQHandler, PIOINT3_IRQHandler
+            };
+            for (int port = 0; port < GPIO_PORTS && !handler; ++port)
+            {
+                if ((enabledIrqs & (1 << (EINT0_IRQn - port))) && (gpio[port].ris & gpio[port].ie))
+                    handler = pinHandlers[port];
+            }
+        }
+
+        if (!handler)
+            return;
+
+        inInterrupt = true;
+        ++stats.interrupts;
+        handler();
+        inInterrupt = false;
+    }
+}
+
+void PeriphEmu::access()
+{
+    ++stats.accesses;
+    advance(accessCycles);
+}
+
+uint32_t PeriphEmu::readRegister(const EmuRegister* reg)
+{
+    uint32_t val = reg->value;
+    int offset;
+
+    access();
+
+    if ((offset = offsetIn(reg, LPC_UART, sizeof(LPC_UART_TypeDef))) >= 0)
+        val = uartRead(offset, val);
+    else if ((offset = offsetIn(reg, LPC_SSP0, sizeof(LPC_SSP_TypeDef))) >= 0)
+        val = sspRead(0, offset, val);
+    else if ((offset = offsetIn(reg, LPC_SSP1, sizeof(LPC_SSP_TypeDef))) >= 0)
+        val = sspRead(1, offset, val);
+    else if ((offset = offsetIn(reg, LPC_I2C, sizeof(LPC_I2C_TypeDef))) >= 0)
+        val = i2cRead(offset, val);
+    else if ((offset = offsetIn(reg, LPC_ADC, sizeof(LPC_ADC_TypeDef))) >= 0)
+        val = adcRead(offset, val);
+    else
+    {
+        static LPC_GPIO_TypeDef* const ports[GPIO_PORTS] = { LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3 };
+        for (int port = 0; port < GPIO_PORTS; ++port)
+        {
+            if ((offset = offsetIn(reg, ports[port], sizeof(LPC_GPIO_TypeDef))) >= 0)
+            {
+                val = gpioRead(port, offset, val);
+                break;
+            }
+        }
+    }
+
+    dispatchInterrupts();
+    return val;
+}
+
+void PeriphEmu::writeRegister(EmuRegister* reg, uint32_t val)
+{
+    int offset;
+
+    access();
+    reg->value = val;
+
+    if ((offset = offsetIn(reg, LPC_UART, sizeof(LPC_UART_TypeDef))) >= 0)
+        uartWrite(offset, val);
+    else if ((offset = offsetIn(reg, LPC_SSP0, sizeof(LPC_SSP_TypeDef))) >= 0)
+        sspWrite(0, offset, val);
+    else if ((offset = offsetIn(reg, LPC_SSP1, sizeof(LPC_SSP_TypeDef))) >= 0)
+        sspWrite(1, offset, val);
+    else if ((offset = offsetIn(reg, LPC_I2C, sizeof(LPC_I2C_TypeDef))) >= 0)
+        i2cWrite(offset, val);
+    else if ((offset = offsetIn(reg, LPC_ADC, sizeof(LPC_ADC_TypeDef))) >= 0)
+        adcWrite(offset, val);
+    else
+    {
+        static LPC_GPIO_TypeDef* const ports[GPIO_PORTS] = { LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3 };
+        for (int port = 0; port < GPIO_PORTS; ++port)
+        {
+            if ((offset = offsetIn(reg, ports[port], sizeof(LPC_GPIO_TypeDef))) >= 0)
+            {
+                gpioWrite(port, offset, val);
+                break;
+            }
+        }
+    }
+
+    dispatchInterrupts();
+}
+
+
+//----- UART ------------------------------------------------------------------
+
+void PeriphEmu::uartReceive(const uint8_t* data, int length)
+{
+    if (!uart.inputCount)
+        uart.nextInput = time + uartFrameCycles();
+
+    for (; length > 0 && uart.inputCount < EMU_UART_BUFFER_SIZE; --length, ++data)
+    {
+        uart.input[(uart.inputHead + uart.inputCount) % EMU_UART_BUFFER_SIZE] = *data;
+        ++uart.inputCount;
+    }
+}
+
+void PeriphEmu::uartClearSent()
+{
+    uartSentLength = 0;
+}
+
+/*
+ * @return The time of a character: start bit, data bits, parity bit and stop bits.
+ */
+EmuTime PeriphEmu::uartFrameCycles() const
+{
+    int bits = 1 + 5 + (uart.lcr & 3) + ((uart.lcr & 8) ? 1 : 0) + ((uart.lcr & 4) ? 2 : 1);
+    unsigned int divisor = clockDiv((uart.dlm << 8) | uart.dll);
+    unsigned int divAdd = uart.fdr & 15;
+    unsigned int mul = clockDiv((uart.fdr >> 4) & 15);
+
+    return bits * 16ULL * divisor * (mul + divAdd) / mul * peripheralCycles(LPC_SYSCON->UARTCLKDIV);
+}
+
+/*
+ * Move the next byte of the transmit FIFO to the shift register.
+ */
+void PeriphEmu::uartStartShift()
+{
+    if (uart.shifting || !uart.txCount)
+        return;
+
+    uart.shiftByte = uart.txFifo[uart.txHead];
+    uart.txHead = (uart.txHead + 1) % EMU_UART_FIFO_SIZE;
+    --uart.txCount;
+
+    uart.shifting = true;
+    uart.shiftDone = time + uartFrameCycles();
+}
+
+bool PeriphEmu::uartInterrupt() const
+{
+    return ((uart.ier & IER_RBR) && uart.rxCount)
+        || ((uart.ier & IER_THRE) && !uart.txCount)
+        || ((uart.ier & IER_RLS) && uart.lsrErrors);
+}
+
+uint32_t PeriphEmu::uartRead(int offset, uint32_t plain)
+{
+    uint32_t val;
+
+    switch (offset)
+    {
+    case 0x00: // RBR, DLL
+        if (uart.lcr & LCR_DLAB)
+            return uart.dll;
+        if (!uart.rxCount)
+            return 0;
+        val = uart.rxFifo[uart.rxHead];
+        uart.rxHead = (uart.rxHead + 1) % EMU_UART_FIFO_SIZE;
+        --uart.rxCount;
+        return val;
+
+    case 0x04: // IER, DLM
+        return (uart.lcr & LCR_DLAB) ? uart.dlm : uart.ier;
+
+    case 0x08: // IIR
+        if ((uart.ier & IER_RLS) && uart.lsrErrors)
+            return 0xc6;
+        if ((uart.ier & IER_RBR) && uart.rxCount)
+            return 0xc4;
+        if ((uart.ier & IER_THRE) && !uart.txCount)
+            return 0xc2;
+        return 0xc1;
+
+    case 0x0c: // LCR
+        return uart.lcr;
+
+    case 0x10: // MCR
+        return uart.mcr;
+
+    case 0x14: // LSR
+        val = uart.lsrErrors;
+        uart.lsrErrors = 0;
+        if (uart.rxCount)
+            val |= LSR_RDR;
+        if (!uart.txCount)
+            val |= LSR_THRE;
+        if (!uart.txCount && !uart.shifting)
+            val |= LSR_TEMT;
+        return val;
+
+    case 0x1c: // SCR
+        return uart.scr;
+
+    case 0x28: // FDR
+        return uart.fdr;
+
+    case 0x58: // FIFOLVL
+        return uart.rxCount | (uart.txCount << 8);
+    }
+
+    return plain;
+}
+
+void PeriphEmu::uartWrite(int offset, uint32_t val)
+{
+    switch (offset)
+    {
+    case 0x00: // THR, DLL
+        if (uart.lcr & LCR_DLAB)
+            uart.dll = val & 0xff;
+        else if (uart.txCount < EMU_UART_FIFO_SIZE)
+        {
+            uart.txFifo[(uart.txHead + uart.txCount) % EMU_UART_FIFO_SIZE] = val;
+            ++uart.txCount;
+            uartStartShift();
+        }
+        break;
+
+    case 0x04: // IER, DLM
+        if (uart.lcr & LCR_DLAB)
+            uart.dlm = val & 0xff;
+        else uart.ier = val & 0x307;
+        break;
+
+    case 0x08: // FCR
+        if (val & 2)
+            uart.rxCount = 0;
+        if (val & 4)
+            uart.txCount = 0;
+        break;
+
+    case 0x0c: // LCR
+        uart.lcr = val & 0xff;
+        break;
+
+    case 0x10: // MCR
+        uart.mcr = val;
+        break;
+
+    case 0x1c: // SCR
+        uart.scr = val & 0xff;
+        break;
+
+    case 0x28: // FDR
+        uart.fdr = val & 0xff;
+        break;
+    }
+}
+
+
+//----- SSP -------------------------------------------------------------------
+
+void PeriphEmu::attachSpi(int port, EmuSPIDevice* device)
+{
+    ssp[port].device = device;
+}
+
+/*
+ * Move the next frame of the transmit FIFO to the shift register.
+ */
+void PeriphEmu::sspStartFrame(int port)
+{
+    Ssp& s = ssp[port];
+    if (s.busy || !s.txCount)
+        return;
+
+    s.frame = s.txFifo[s.txHead];
+    s.txHead = (s.txHead + 1) % EMU_SSP_FIFO_SIZE;
+    --s.txCount;
+
+    int bits = (s.cr0 & 15) + 1;
+    unsigned int scr = (s.cr0 >> 8) & 255;
+    unsigned int div = port ? LPC_SYSCON->SSP1CLKDIV : LPC_SYSCON->SSP0CLKDIV;
+
+    s.busy = true;
+    s.frameDone = time + bits * peripheralCycles(div) * clockDiv(s.cpsr) * (scr + 1);
+}
+
+void PeriphEmu::sspFrameDone(int port)
+{
+    Ssp& s = ssp[port];
+    int bits = (s.cr0 & 15) + 1;
+    int mask = (1 << bits) - 1;
+    int rx;
+
+    if (s.cr1 & SSP_CR1_LBM)
+        rx = s.frame;
+    else if (s.device)
+        rx = s.device->transfer(s.frame & mask, bits);
+    else rx = mask;
+
+    if (s.rxCount < EMU_SSP_FIFO_SIZE)
+    {
+        s.rxFifo[(s.rxHead + s.rxCount) % EMU_SSP_FIFO_SIZE] = rx & mask;
+        ++s.rxCount;
+    }
+    else s.ris |= SSP_RIS_ROR;
+
+    ++stats.spiFrames;
+    s.busy = false;
+    sspStartFrame(port);
+}
+
+uint32_t PeriphEmu::sspRead(int port, int offset, uint32_t plain)
+{
+    Ssp& s = ssp[port];
+    uint32_t val;
+
+    // The FIFO levels of the interrupt status
+    s.ris &= SSP_RIS_ROR;
+    if (s.rxCount >= EMU_SSP_FIFO_SIZE / 2)
+        s.ris |= SSP_RIS_RX;
+    if (s.txCount <= EMU_SSP_FIFO_SIZE / 2)
+        s.ris |= SSP_RIS_TX;
+
+    switch (offset)
+    {
+    case 0x00: // CR0
+        return s.cr0;
+
+    case 0x04: // CR1
+        return s.cr1;
+
+    case 0x08: // DR
+        if (!s.rxCount)
+            return 0;
+        val = s.rxFifo[s.rxHead];
+        s.rxHead = (s.rxHead + 1) % EMU_SSP_FIFO_SIZE;
+        --s.rxCount;
+        return val;
+
+    case 0x0c: // SR
+        val = 0;
+        if (!s.txCount)
+            val |= SSP_SR_TFE;
+        if (s.txCount < EMU_SSP_FIFO_SIZE)
+            val |= SSP_SR_TNF;
+        if (s.rxCount)
+            val |= SSP_SR_RNE;
+        if (s.rxCount >= EMU_SSP_FIFO_SIZE)
+            val |= SSP_SR_RFF;
+        if (s.busy || s.txCount)
+            val |= SSP_SR_BSY;
+        return val;
+
+    case 0x10: // CPSR
+        return s.cpsr;
+
+    case 0x14: // IMSC
+        return s.imsc;
+
+    case 0x18: // RIS
+        return s.ris;
+
+    case 0x1c: // MIS
+        return s.ris & s.imsc;
+    }
+
+    return plain;
+}
+
+void PeriphEmu::sspWrite(int port, int offset, uint32_t val)
+{
+    Ssp& s = ssp[port];
+
+    switch (offset)
+    {
+    case 0x00: // CR0
+        s.cr0 = val & 0xffff;
+        break;
+
+    case 0x04: // CR1
+        s.cr1 = val & 15;
+        break;
+
+    case 0x08: // DR
+        if ((s.cr1 & SSP_CR1_SSE) && s.txCount < EMU_SSP_FIFO_SIZE)
+        {
+            s.txFifo[(s.txHead + s.txCount) % EMU_SSP_FIFO_SIZE] = val;
+            ++s.txCount;
+            sspStartFrame(port);
+        }
+        break;
+
+    case 0x10: // CPSR
+        s.cpsr = val & 0xfe;
+        break;
+
+    case 0x14: // IMSC
+        s.imsc = val & 15;
+        break;
+
+    case 0x20: // ICR
+        s.ris &= ~(val & 3);
+        break;
+    }
+}
+
+
+//----- I2C -------------------------------------------------------------------
+
+void PeriphEmu::attachI2C(EmuI2CDevice* device)
+{
+    if (i2c.deviceCount < EMU_MAX_I2C_DEVICES)
+        i2c.devices[i2c.deviceCount++] = device;
+}
+
+uint32_t PeriphEmu::i2cRead(int offset, uint32_t plain)
+{
+    switch (offset)
+    {
+    case 0x00: // CONSET
+        return i2c.conset;
+
+    case 0x04: // STAT
+        return i2c.stat;
+
+    case 0x08: // DAT
+        return i2c.dat;
+
+    case 0x0c: // ADR0
+        return i2c.adr0;
+
+    case 0x10: // SCLH
+        return i2c.sclh;
+
+    case 0x14: // SCLL
+        return i2c.scll;
+    }
+
+    return plain;
+}
+
+void PeriphEmu::i2cWrite(int offset, uint32_t val)
+{
+    switch (offset)
+    {
+    case 0x00: // CONSET
+        i2c.conset |= val & (I2C_I2EN | I2C_STA | I2C_STO | I2C_SI | I2C_AA);
+        break;
+
+    case 0x08: // DAT
+        i2c.dat = val & 0xff;
+        break;
+
+    case 0x0c: // ADR0
+        i2c.adr0 = val & 0xff;
+        break;
+
+    case 0x10: // SCLH
+        i2c.sclh = val & 0xffff;
+        break;
+
+    case 0x14: // SCLL
+        i2c.scll = val & 0xffff;
+        break;
+
+    case 0x18: // CONCLR
+        i2c.conset &= ~(val & (I2C_I2EN | I2C_STA | I2C_SI | I2C_AA));
+        break;
+    }
+
+    i2cSchedule();
+}
+
+/*
+ * @return The time of a bit on the I2C bus in cycles.
+ */
+EmuTime PeriphEmu::i2cBitCycles() const
+{
+    EmuTime bitTime = i2c.sclh + i2c.scll;
+    if (bitTime < 8)
+        bitTime = 8;
+    return bitTime * peripheralCycles(1);
+}
+
+/*
+ * Schedule the next step of the I2C controller if the software released it
+ * (SI is clear) and there is something to do.
+ */
+void PeriphEmu::i2cSchedule()
+{
+    if (i2c.scheduled || (i2c.conset & I2C_SI) || !(i2c.conset & I2C_I2EN))
+        return;
+
+    EmuTime duration;
+    if (i2c.conset & (I2C_STA | I2C_STO))
+        duration = i2cBitCycles();
+    else if (i2c.started && !i2cWaiting())
+        duration = 9 * i2cBitCycles();
+    else return;
+
+    i2c.scheduled = true;
+    i2c.stepDone = time + duration;
+}
+
+/*
+ * @return True if the controller waits for a stop or start condition.
+ */
+bool PeriphEmu::i2cWaiting() const
+{
+    return i2c.stat == 0x20 || i2c.stat == 0x30 || i2c.stat == 0x48 || i2c.stat == 0x58;
+}
+
+/*
+ * The scheduled step of the I2C controller is done: send the start or stop
+ * condition or transfer a byte, and set SI for the new state.
+ */
+void PeriphEmu::i2cStep()
+{
+    i2c.scheduled = false;
+
+    if (i2c.conset & I2C_STO)
+    {
+        if (i2c.started)
+        {
+            if (i2c.device)
+                i2c.device->stop();
+            ++stats.i2cTransfers;
+        }
+        i2c.conset &= ~I2C_STO;
+        i2c.started = false;
+        i2c.device = 0;
+        i2c.stat = I2C_STAT_IDLE;
+
+        // A stop condition does not set SI
+        if (!(i2c.conset & I2C_STA))
+            return;
+    }
+
+    if (i2c.conset & I2C_STA)
+    {
+        i2c.stat = i2c.started ? 0x10 : 0x08;
+        i2c.started = true;
+        i2c.addressed = false;
+        i2c.device = 0;
+    }
+    else if (!i2c.started || i2cWaiting())
+    {
+        return;
+    }
+    else if (!i2c.addressed)
+    {
+        // Send the address
+        ++stats.i2cBytes;
+
+        i2c.read = i2c.dat & 1;
+        i2c.addressed = true;
+        for (int i = 0; i < i2c.deviceCount; ++i)
+        {
+            if (i2c.devices[i]->address == (int) (i2c.dat >> 1))
+            {
+                if (i2c.devices[i]->start(i2c.read))
+                    i2c.device = i2c.devices[i];
+                break;
+            }
+        }
+
+        if (i2c.read)
+            i2c.stat = i2c.device ? 0x40 : 0x48;
+        else i2c.stat = i2c.device ? 0x18 : 0x20;
+    }
+    else if (!i2c.read)
+    {
+        // Send a data byte
+        ++stats.i2cBytes;
+        i2c.stat = i2c.device->write(i2c.dat) ? 0x28 : 0x30;
+    }
+    else
+    {
+        // Receive a data byte, acknowledge it if AA is set
+        ++stats.i2cBytes;
+        i2c.dat = i2c.device->read();
+        i2c.stat = (i2c.conset & I2C_AA) ? 0x50 : 0x58;
+    }
+
+    i2c.conset |= I2C_SI;
+}
+
+
+//----- ADC -------------------------------------------------------------------
+
+void PeriphEmu::setAnalogInput(int channel, int value)
+{
+    adc.input[channel] = value & 0x3ff;
+}
+
+void PeriphEmu::adcStart(int channel)
+{
+    unsigned int clkdiv = ((adc.cr >> 8) & 255) + 1;
+
+    adc.channel = channel;
+    adc.done = time + ADC_CONVERSION_CLOCKS * clkdiv * peripheralCycles(1);
+}
+
+void PeriphEmu::adcDone()
+{
+    int channel = adc.channel;
+    uint32_t val = ADC_DONE | (adc.input[channel] << 6);
+
+    if (adc.dr[channel] & ADC_DONE)
+    {
+        val |= ADC_OVERRUN;
+        adc.stat |= 1 << (channel + 8);
+    }
+    adc.dr[channel] = val;
+    adc.stat |= 1 << channel;
+    adc.channel = -1;
+    ++stats.adcConversions;
+
+    // In burst mode, convert the next selected channel
+    if (adc.cr & ADC_BURST)
+    {
+        for (int i = 1; i <= 8; ++i)
+        {
+            int next = (channel + i) & 7;
+            if (adc.cr & (1 << next))
+            {
+                adcStart(next);
+                break;
+            }
+        }
+    }
+}
+
+uint32_t PeriphEmu::adcRead(int offset, uint32_t plain)
+{
+    uint32_t val;
+    int channel;
+
+    switch (offset)
+    {
+    case 0x00: // CR
+        return adc.cr;
+
+    case 0x04: // GDR
+        for (channel = 0; channel < 8; ++channel)
+        {
+            if (adc.dr[channel] & ADC_DONE)
+                return adc.dr[channel] | (channel << 24);
+        }
+        return 0;
+
+    case 0x0c: // INTEN
+        return adc.inten;
+
+    case 0x30: // STAT
+        return adc.stat;
+    }
+
+    if (offset >= 0x10 && offset < 0x30)
+    {
+        // DRn: reading clears the done and overrun flags
+        channel = (offset - 0x10) >> 2;
+        val = adc.dr[channel];
+        adc.dr[channel] &= ~(ADC_DONE | ADC_OVERRUN);
+        adc.stat &= ~((1 << channel) | (1 << (channel + 8)));
+        return val;
+    }
+
+    return plain;
+}
+
+void PeriphEmu::adcWrite(int offset, uint32_t val)
+{
+    switch (offset)
+    {
+    case 0x00: // CR
+        adc.cr = val;
+        if (((val >> 24) & 7) == ADC_START_NOW || ((val & ADC_BURST) && adc.channel < 0))
+        {
+            for (int channel = 0; channel < 8; ++channel)
+            {
+                if (val & (1 << channel))
+                {
+                    // The library clears the done flag with a read of DR that
+                    // does not reach the emulation, see emu_register.h
+                    adc.dr[channel] &= ~(ADC_DONE | ADC_OVERRUN);
+                    adcStart(channel);
+                    break;
+                }
+            }
+        }
+        break;
+
+    case 0x0c: // INTEN
+        adc.inten = val & 0x1ff;
+        break;
+    }
+}
+
+
+//----- GPIO ------------------------------------------------------------------
+
+void PeriphEmu::attachPin(int pin, EmuPinDevice* device)
+{
+    if (pinDeviceCount >= EMU_MAX_PIN_DEVICES)
+        return;
+
+    PinDevice& dev = pinDevices[pinDeviceCount++];
+    dev.port = (pin >> 5) & 3;
+    dev.mask = 1 << (pin & 31);
+    dev.device = device;
+}
+
+void PeriphEmu::setPinInput(int pin, int level)
+{
+    int port = (pin >> 5) & 3;
+    uint32_t mask = 1 << (pin & 31);
+    uint32_t oldLevels = gpioLevels(port);
+
+    if (level)
+        gpio[port].input |= mask;
+    else gpio[port].input &= ~mask;
+
+    gpioEdges(port, oldLevels);
+    dispatchInterrupts();
+}
+
+int PeriphEmu::pinLevel(int pin)
+{
+    return (gpioLevels((pin >> 5) & 3) >> (pin & 31)) & 1;
+}
+
+/*
+ * @return The levels of the pins of a GPIO port.
+ */
+uint32_t PeriphEmu::gpioLevels(int port)
+{
+    uint32_t levels = gpio[port].drive & gpio[port].input;
+
+    for (int i = 0; i < pinDeviceCount; ++i)
+    {
+        if (pinDevices[i].port == port && !pinDevices[i].device->level(time))
+            levels &= ~pinDevices[i].mask;
+    }
+
+    return levels;
+}
+
+/*
+ * The output or the direction of a port was written: tell the devices when
+ * the level that the processor drives changes.
+ */
+void PeriphEmu::gpioDriveChanged(int port)
+{
+    Gpio& g = gpio[port];
+    uint32_t drive = (g.out | ~g.dir) & GPIO_PINS_MASK;
+    uint32_t changed = drive ^ g.drive;
+
+    g.drive = drive;
+    for (int i = 0; i < pinDeviceCount; ++i)
+    {
+        if (pinDevices[i].port == port && (changed & pinDevices[i].mask))
+            pinDevices[i].device->driveChanged((drive & pinDevices[i].mask) != 0, time);
+    }
+}
+
+/*
+ * Set the raw interrupt status of the edges of a GPIO port.
+ */
+void PeriphEmu::gpioEdges(int port, uint32_t oldLevels)
+{
+    Gpio& g = gpio[port];
+    uint32_t levels = gpioLevels(port);
+    uint32_t rising = levels & ~oldLevels;
+    uint32_t falling = oldLevels & ~levels;
+    uint32_t edges = g.ibe ? (rising | falling) & g.ibe : 0;
+
+    edges |= rising & g.iev & ~g.ibe;
+    edges |= falling & ~g.iev & ~g.ibe;
+    g.ris |= edges & ~g.is;
+}
+
+uint32_t PeriphEmu::gpioRead(int port, int offset, uint32_t plain)
+{
+    Gpio& g = gpio[port];
+
+    if (offset < 0x4000)
+        return gpioLevels(port) & (offset >> 2);
+
+    switch (offset)
+    {
+    case 0x8000: // DIR
+        return g.dir;
+
+    case 0x8004: // IS
+        return g.is;
+
+    case 0x8008: // IBE
+        return g.ibe;
+
+    case 0x800c: // IEV
+        return g.iev;
+
+    case 0x8010: // IE
+        return g.ie;
+
+    case 0x8014: // RIS
+        return g.ris;
+
+    case 0x8018: // MIS
+        return g.ris & g.ie;
+    }
+
+    return plain;
+}
+
+void PeriphEmu::gpioWrite(int port, int offset, uint32_t val)
+{
+    Gpio& g = gpio[port];
+
+    if (offset < 0x4000)
+    {
+        uint32_t mask = offset >> 2;
+        g.out = (g.out & ~mask) | (val & mask);
+        gpioDriveChanged(port);
+        return;
+    }
+
+    switch (offset)
+    {
+    case 0x8000: // DIR
+        g.dir = val & GPIO_PINS_MASK;
+        gpioDriveChanged(port);
+        break;
+
+    case 0x8004: // IS
+        g.is = val & GPIO_PINS_MASK;
+        break;
+
+    case 0x8008: // IBE
+        g.ibe = val & GPIO_PINS_MASK;
+        break;
+
+    case 0x800c: // IEV
+        g.iev = val & GPIO_PINS_MASK;
+        break;
+
+    case 0x8010: // IE
+        g.ie = val & GPIO_PINS_MASK;
+        break;
+
+    case 0x801c: // IC
+        g.ris &= ~val;
+        break;
+    }
+}
+
+
+int PERIPH_Emu_Idle(void)
+{
+    if (!periphEmu.active())
+        return 0;
+
+    periphEmu.idle();
+    return 1;
+}
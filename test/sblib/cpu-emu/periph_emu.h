@@ -0,0 +1,431 @@
+/*
+ *  periph_emu.h - Emulation of the UART, SSP, I2C, GPIO and ADC peripherals
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef PERIPH_EMU_H_
+#define PERIPH_EMU_H_
+
+#include "LPC11xx.h"
+
+/**
+ * The virtual time of the emulation in cycles of the CPU clock (SystemCoreClock).
+ */
+typedef unsigned long long EmuTime;
+
+/**
+ * The size of the buffers for the data that the UART sends and receives.
+ */
+#define EMU_UART_BUFFER_SIZE 4096
+
+/**
+ * The size of the transmit and receive FIFOs of the UART.
+ */
+#define EMU_UART_FIFO_SIZE 16
+
+/**
+ * The size of the transmit and receive FIFOs of a SSP port.
+ */
+#define EMU_SSP_FIFO_SIZE 8
+
+/**
+ * The maximum number of devices on the I2C bus.
+ */
+#define EMU_MAX_I2C_DEVICES 8
+
+/**
+ * The maximum number of devices on the GPIO pins.
+ */
+#define EMU_MAX_PIN_DEVICES 8
+
+/**
+ * A device on the I2C bus.
+ */
+class EmuI2CDevice
+{
+public:
+    /**
+     * @param address - the 7 bit address of the device.
+     */
+    EmuI2CDevice(int address) : address(address) {}
+    virtual ~EmuI2CDevice() {}
+
+    /**
+     * The device is addressed after a (repeated) start condition.
+     *
+     * @param read - true for a read transfer, false for a write transfer.
+     * @return True to acknowledge the address.
+     */
+    virtual bool start(bool read) { return true; }
+
+    /**
+     * The master sends a byte.
+     *
+     * @return True to acknowledge the byte.
+     */
+    virtual bool write(uint8_t data) = 0;
+
+    /**
+     * The master reads a byte.
+     */
+    virtual uint8_t read() = 0;
+
+    /**
+     * The transfer ends with a stop condition.
+     */
+    virtual void stop() {}
+
+    const int address;      //!< The 7 bit address of the device
+};
+
+/**
+ * A device on a SSP (SPI) port.
+ */
+class EmuSPIDevice
+{
+public:
+    virtual ~EmuSPIDevice() {}
+
+    /**
+     * Exchange a frame.
+     *
+     * @param data - the frame that the port sends.
+     * @param bits - the number of bits of the frame, 4..16.
+     * @return The frame that the port receives.
+     */
+    virtual int transfer(int data, int bits) = 0;
+};
+
+/**
+ * A device on a GPIO pin, e.g. a 1-Wire sensor. The pin is a wired-AND line:
+ * the level is low if the processor or a device drives it low.
+ */
+class EmuPinDevice
+{
+public:
+    virtual ~EmuPinDevice() {}
+
+    /**
+     * The level that the processor drives changed: 0 when it drives the
+     * pin low, 1 when it drives the pin high or releases it.
+     *
+     * @param level - the new level.
+     * @param time - the time of the change.
+     */
+    virtual void driveChanged(int level, EmuTime time) {}
+
+    /**
+     * @param time - the current time.
+     * @return The level of the device: 0 if it drives the pin low, else 1.
+     */
+    virtual int level(EmuTime time) { return 1; }
+};
+
+/**
+ * The statistics of the peripheral emulation.
+ */
+struct PeriphEmuStats
+{
+    unsigned int accesses;          //!< The number of register accesses
+    unsigned int interrupts;        //!< The number of calls of interrupt handlers
+    unsigned int uartSent;          //!< The number of bytes the UART sent
+    unsigned int uartReceived;      //!< The number of bytes the UART received
+    unsigned int uartOverruns;      //!< The number of bytes lost because the receive FIFO was full
+    unsigned int spiFrames;         //!< The number of frames of the SSP ports
+    unsigned int i2cTransfers;      //!< The number of I2C transfers (start to stop)
+    unsigned int i2cBytes;          //!< The number of I2C bytes, addresses included
+    unsigned int adcConversions;    //!< The number of A/D conversions
+    EmuTime idleTime;               //!< The time the processor waited in WFI
+};
+
+/**
+ * A behavioural emulation of the UART, the SSP ports, the I2C controller, the
+ * GPIO ports and the ADC of the LPC11xx with a virtual time.
+ *
+ * The registers of these peripherals are EmuRegister objects (see
+ * emu_register.h), so every register access of the library is passed to the
+ * emulation. The virtual time advances by accessCycles with every register
+ * access, with delayMicroseconds() and with WFI (waitForInterrupt(),
+ * delay()), which waits for the next event. In the meantime the peripherals
+ * work: the UART sends and receives with its baud rate, a SSP frame needs its
+ * bit times, an A/D conversion 11 ADC clocks. SysTick_Handler() is called
+ * every millisecond, so systemTime runs with the virtual time.
+ *
+ * The interrupt handlers of the peripherals (UART_IRQHandler() etc.) are
+ * called after a register access or while the time advances, if the interrupt
+ * is enabled in the peripheral and in the NVIC. The NVIC writes are applied at
+ * the next register access, disabling before enabling. Interrupt handlers do
+ * not nest.
+ *
+ * The I2C controller sends the start and stop conditions and transfers the
+ * bytes with the bus time of SCLH + SCLL per bit. It sets SI and calls the
+ * I2C interrupt handler for every state, like the hardware does.
+ *
+ * A GPIO pin reads as the wired-AND of the level the processor drives, the
+ * levels of the devices on the pin and the input level set with
+ * setPinInput(), which is high by default. Pin interrupts are raised by
+ * setPinInput() only.
+ *
+ * While the emulation is not active, the registers are plain memory.
+ *
+ * Usage:
+ *     periphEmu.begin();
+ *     periphEmu.attachI2C(&rtc);
+ *     ... call the drivers, check periphEmu.now() and the devices ...
+ *     periphEmu.end();
+ */
+class PeriphEmu
+{
+public:
+    PeriphEmu();
+
+    /**
+     * Activate the emulation. Resets all emulated peripherals, removes all
+     * devices and clears the statistics. The time starts at 0.
+     */
+    void begin();
+
+    /**
+     * Deactivate the emulation. The registers are plain memory again.
+     */
+    void end();
+
+    /**
+     * @return True if the emulation is active.
+     */
+    bool active() const { return isActive; }
+
+    /**
+     * @return The current time in cycles.
+     */
+    EmuTime now() const { return time; }
+
+    /**
+     * @return The current time in microseconds.
+     */
+    unsigned long long micros() const;
+
+    /**
+     * Convert microseconds to cycles.
+     */
+    EmuTime cycles(unsigned int usec) const;
+
+    /**
+     * Let time pass. The peripherals work and the interrupt handlers are
+     * called.
+     *
+     * @param cycles - the time in cycles.
+     */
+    void advance(EmuTime cycles);
+
+    /**
+     * Wait for an interrupt (WFI): let time pass until the next event of a
+     * peripheral, at most until the next SysTick.
+     */
+    void idle();
+
+    /**
+     * The UART receives data. The bytes arrive with the baud rate of the UART,
+     * one after the other.
+     *
+     * @param data - the data.
+     * @param length - the length of the data.
+     */
+    void uartReceive(const uint8_t* data, int length);
+
+    /**
+     * Clear the buffer of the data that the UART sent.
+     */
+    void uartClearSent();
+
+    /**
+     * Connect a device to a SSP port.
+     *
+     * @param port - the port: 0 or 1.
+     * @param device - the device, 0 to disconnect.
+     */
+    void attachSpi(int port, EmuSPIDevice* device);
+
+    /**
+     * Connect a device to the I2C bus.
+     */
+    void attachI2C(EmuI2CDevice* device);
+
+    /**
+     * Connect a device to a GPIO pin.
+     *
+     * @param pin - the pin, e.g. PIO0_3.
+     * @param device - the device.
+     */
+    void attachPin(int pin, EmuPinDevice* device);
+
+    /**
+     * Set the external level of a GPIO pin. Raises a pin interrupt if the
+     * pin is configured for it.
+     *
+     * @param pin - the pin, e.g. PIO0_3.
+     * @param level - 0 for low, 1 for high.
+     */
+    void setPinInput(int pin, int level);
+
+    /**
+     * @return The level of a GPIO pin.
+     */
+    int pinLevel(int pin);
+
+    /**
+     * Set the voltage of an analog input.
+     *
+     * @param channel - the channel: 0..7.
+     * @param value - the value the ADC converts: 0..1023.
+     */
+    void setAnalogInput(int channel, int value);
+
+    unsigned int accessCycles;      //!< The cycles of a register access, default: 4
+
+    uint8_t uartSent[EMU_UART_BUFFER_SIZE]; //!< The data the UART sent
+    int uartSentLength;                     //!< The length of uartSent, stops at EMU_UART_BUFFER_SIZE
+
+    PeriphEmuStats stats;           //!< The statistics
+
+    // Called by EmuRegister
+    uint32_t readRegister(const EmuRegister* reg);
+    void writeRegister(EmuRegister* reg, uint32_t val);
+
+protected:
+    struct Uart
+    {
+        uint32_t ier, lcr, dll, dlm, mcr, scr, fdr, lsrErrors;
+        uint8_t txFifo[EMU_UART_FIFO_SIZE];
+        int txHead, txCount;
+        bool shifting;                  // The transmit shift register is busy
+        uint8_t shiftByte;              // The byte in the transmit shift register
+        EmuTime shiftDone;
+        uint8_t rxFifo[EMU_UART_FIFO_SIZE];
+        int rxHead, rxCount;
+        uint8_t input[EMU_UART_BUFFER_SIZE];
+        int inputHead, inputCount;
+        EmuTime nextInput;              // The time the next byte of input[] is received
+    };
+
+    struct Ssp
+    {
+        uint32_t cr0, cr1, cpsr, imsc, ris;
+        uint16_t txFifo[EMU_SSP_FIFO_SIZE];
+        int txHead, txCount;
+        uint16_t rxFifo[EMU_SSP_FIFO_SIZE];
+        int rxHead, rxCount;
+        bool busy;
+        uint16_t frame;                 // The frame being sent
+        EmuTime frameDone;
+        EmuSPIDevice* device;
+    };
+
+    struct I2c
+    {
+        uint32_t conset, stat, dat, adr0, sclh, scll;
+        bool scheduled;                 // A step of the controller is scheduled, see i2cSchedule()
+        EmuTime stepDone;               // The time the scheduled step is done
+        bool started;                   // A start condition was sent, but no stop condition
+        bool addressed;                 // The address byte of the transfer was sent
+        bool read;                      // The transfer is a read transfer
+        EmuI2CDevice* device;           // The addressed device, 0 if none
+        EmuI2CDevice* devices[EMU_MAX_I2C_DEVICES];
+        int deviceCount;
+    };
+
+    struct Adc
+    {
+        uint32_t cr, inten, stat;
+        uint32_t dr[8];
+        int input[8];
+        int channel;                    // The channel being converted, -1 if none
+        EmuTime done;
+    };
+
+    struct Gpio
+    {
+        uint32_t out, dir, is, ibe, iev, ie, ris;
+        uint32_t input;                 // The levels of setPinInput()
+        uint32_t drive;                 // The levels the processor drives
+    };
+
+    struct PinDevice
+    {
+        int port;
+        uint32_t mask;
+        EmuPinDevice* device;
+    };
+
+    EmuTime nextEvent() const;
+    void setTime(EmuTime newTime);
+    void processEvents();
+    void dispatchInterrupts();
+    void access();
+
+    uint32_t uartRead(int offset, uint32_t plain);
+    void uartWrite(int offset, uint32_t val);
+    EmuTime uartFrameCycles() const;
+    void uartStartShift();
+    bool uartInterrupt() const;
+
+    uint32_t sspRead(int port, int offset, uint32_t plain);
+    void sspWrite(int port, int offset, uint32_t val);
+    void sspStartFrame(int port);
+    void sspFrameDone(int port);
+
+    uint32_t i2cRead(int offset, uint32_t plain);
+    void i2cWrite(int offset, uint32_t val);
+    EmuTime i2cBitCycles() const;
+    void i2cSchedule();
+    bool i2cWaiting() const;
+    void i2cStep();
+
+    uint32_t adcRead(int offset, uint32_t plain);
+    void adcWrite(int offset, uint32_t val);
+    void adcStart(int channel);
+    void adcDone();
+
+    uint32_t gpioRead(int port, int offset, uint32_t plain);
+    void gpioWrite(int port, int offset, uint32_t val);
+    uint32_t gpioLevels(int port);
+    void gpioDriveChanged(int port);
+    void gpioEdges(int port, uint32_t oldLevels);
+    void tick();
+
+    bool isActive;
+    EmuTime time;
+    EmuTime nextTick;               // The time of the next SysTick
+    uint32_t enabledIrqs;           // The interrupts enabled in the NVIC
+    bool inInterrupt;               // An interrupt handler is running
+
+    Uart uart;
+    Ssp ssp[2];
+    I2c i2c;
+    Adc adc;
+    Gpio gpio[4];
+    PinDevice pinDevices[EMU_MAX_PIN_DEVICES];
+    int pinDeviceCount;
+};
+
+/**
+ * The peripheral emulation.
+ */
+extern PeriphEmu periphEmu;
+
+extern "C"
+{
+
+/**
+ * Wait for an interrupt, called by __WFI().
+ *
+ * @return 1 if the emulation is active and the time advanced, else 0.
+ */
+int PERIPH_Emu_Idle(void);
+
+}
+
+#endif /* PERIPH_EMU_H_ */
@@ -6,25 +6,18 @@ SCB_Type           _SCB;
 SysTick_Type       _SysTick;
 NVIC_Type          _NVIC;
 
-LPC_I2C_TypeDef    _LPC_I2C;
 LPC_WDT_TypeDef    _LPC_WDT;
-LPC_UART_TypeDef   _LPC_UART;
 LPC_TMR_TypeDef    _LPC_TMR16B0;
 LPC_TMR_TypeDef    _LPC_TMR16B1;
 LPC_TMR_TypeDef    _LPC_TMR32B0;
 LPC_TMR_TypeDef    _LPC_TMR32B1;
-LPC_ADC_TypeDef    _LPC_ADC;
 LPC_PMU_TypeDef    _LPC_PMU;
 LPC_FLASHCTRL_Type _LPC_FLASHCTRL;
-LPC_SSP_TypeDef    _LPC_SSP0;
-LPC_SSP_TypeDef    _LPC_SSP1;
 LPC_CAN_TypeDef    _LPC_CAN;
 LPC_IOCON_TypeDef  _LPC_IOCON;
 LPC_SYSCON_TypeDef _LPC_SYSCON;
-LPC_GPIO_TypeDef   _LPC_GPIO0;
-LPC_GPIO_TypeDef   _LPC_GPIO1;
-LPC_GPIO_TypeDef   _LPC_GPIO2;
-LPC_GPIO_TypeDef   _LPC_GPIO3;
+
+// The registers of the UART, SSP, I2C, ADC and GPIO are defined in periph_emu.cpp
 
 
 // Flash emulation array
@@ -65,7 +58,8 @@ typedef enum
     BUSY
 } IAP_Status;
 
-int iap_calls [5] = {0, 0, 0, 0, 0};
+int iap_calls [6] = {0, 0, 0, 0, 0, 0};
+unsigned int iap_programmed_bytes = 0;
 
 void IAP_Init_Flash(unsigned char value)
 {
@@ -114,10 +108,26 @@ void IAP_Call (unsigned int * cmd, unsigned int * stat)
         break;
     case IAP_COPY_RAM2FLASH :
         iap_calls [I_RAM2FLASH]++;
+        iap_programmed_bytes += * (cmd + 3);
         rom = (unsigned int *) (int) (* (cmd + 1));
         ram = (unsigned int *) (* (cmd + 2));
         i   = * (cmd + 3);
-        memcpy (rom, ram, i);
+        // programming can only clear bits
+        {
+            unsigned char * dst = (unsigned char *) rom;
+            unsigned char * src = (unsigned char *) ram;
+            while (i--)
+                * dst++ &= * src++;
+        }
+        break;
+    case IAP_ERASE_PAGE :
+        iap_calls [I_ERASE_PAGE]++;
+        i    =  * (cmd + 1)      * PAGE_SIZE;
+        end  = (* (cmd + 2) + 1) * PAGE_SIZE;
+        for (; i < end && i < FLASH_SIZE; i++)
+        {
+            FLASH [i] = 0xFF;
+        }
         break;
     case IAP_COMPARE :
         iap_calls [I_COMPARE]++;
@@ -136,7 +146,9 @@ void IAP_Call (unsigned int * cmd, unsigned int * stat)
 
 extern unsigned int systemTime;
 extern unsigned int wfiSystemTimeInc;
+extern int PERIPH_Emu_Idle(void);
 void _test_wfi(void)
 {
-	systemTime +=  wfiSystemTimeInc;
+    if (!PERIPH_Emu_Idle())
+        systemTime +=  wfiSystemTimeInc;
 }
@@ -8,7 +8,11 @@
  *  published by the Free Software Foundation.
  */
 
+#include "periph_emu.h"
+
 void delayMicroseconds(unsigned int usec)
 {
-
+    // The time passes only for the peripheral emulation
+    if (periphEmu.active())
+        periphEmu.advance(periphEmu.cycles(usec));
 }
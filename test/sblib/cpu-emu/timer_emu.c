@@ -0,0 +1,190 @@
+/*
+ *  timer_emu.c - Emulation of the counter/timers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "timer_emu.h"
+#include <string.h>
+
+// A bit that does not exist in IR and TCR. It is set before the software runs,
+// if it is cleared afterwards the software assigned the register.
+#define SENTINEL 0x80000000
+
+// The number of match channels
+#define MATCH_CHANNELS 4
+
+// The interrupt flags of the match and capture channels in IR
+#define IR_FLAGS 0x3f
+
+void TIMER_Emu_Init(TimerEmu * timer, LPC_TMR_TypeDef * regs, int bits)
+{
+    memset(regs, 0, sizeof(LPC_TMR_TypeDef));
+    timer->regs = regs;
+    timer->max  = bits == 16 ? 0xffff : 0xffffffff;
+    timer->tc   = 0;
+    timer->ir   = 0;
+    timer->pwm  = 0;
+}
+
+static int running(TimerEmu * timer)
+{
+    return (timer->regs->TCR & 3) == 1;
+}
+
+static unsigned int matchValue(TimerEmu * timer, int channel)
+{
+    return (&timer->regs->MR0)[channel] & timer->max;
+}
+
+/*
+ * @return 1 if the match channel has to be evaluated.
+ */
+static int matchActive(TimerEmu * timer, int channel)
+{
+    LPC_TMR_TypeDef * regs = timer->regs;
+
+    return ((regs->MCR >> (channel * 3)) & 7)
+        || (regs->PWMC & (1 << channel))
+        || ((regs->EMR >> (4 + channel * 2)) & 3);
+}
+
+void TIMER_Emu_Enter(TimerEmu * timer)
+{
+    timer->regs->IR   = timer->ir | SENTINEL;
+    timer->regs->TC   = timer->tc;
+    timer->regs->TCR |= SENTINEL;
+}
+
+void TIMER_Emu_Leave(TimerEmu * timer)
+{
+    LPC_TMR_TypeDef * regs = timer->regs;
+    int valueWritten = regs->TC != timer->tc;
+
+    if (!(regs->IR & SENTINEL))
+        timer->ir &= ~regs->IR;     // writing 1 clears a flag
+    regs->IR = timer->ir;
+
+    if (!(regs->TCR & SENTINEL))
+    {   // Timer::restart()
+        timer->tc = 0;
+        timer->pwm = 0;
+    }
+    regs->TCR &= ~SENTINEL;
+
+    if (valueWritten)
+        timer->tc = regs->TC & timer->max;
+    if (regs->TCR & 2)
+        timer->tc = 0;              // held in reset
+    regs->TC = timer->tc;
+}
+
+unsigned int TIMER_Emu_NextEvent(TimerEmu * timer)
+{
+    unsigned long long wrap = (unsigned long long) timer->max + 1;
+    unsigned long long next = wrap - timer->tc;  // the overflow of the counter
+    int channel;
+
+    if (!running(timer))
+        return 0;
+
+    for (channel = 0; channel < MATCH_CHANNELS; channel++)
+    {
+        unsigned long long ticks;
+        unsigned int mr = matchValue(timer, channel);
+
+        if (!matchActive(timer, channel))
+            continue;
+        if (mr > timer->tc)
+            ticks = mr - timer->tc;
+        else ticks = wrap - timer->tc + mr;
+        if (ticks < next)
+            next = ticks;
+    }
+    return next > 0xffffffff ? 0xffffffff : (unsigned int) next;
+}
+
+void TIMER_Emu_Advance(TimerEmu * timer, unsigned int ticks)
+{
+    LPC_TMR_TypeDef * regs = timer->regs;
+    unsigned long long tc = (unsigned long long) timer->tc + ticks;
+    int reset = 0;
+    int stop = 0;
+    int channel;
+
+    if (!running(timer))
+        return;
+    if (tc > timer->max)
+    {   // overflow: a new PWM cycle
+        tc -= (unsigned long long) timer->max + 1;
+        reset = 1;
+    }
+    timer->tc = (unsigned int) tc;
+
+    for (channel = 0; channel < MATCH_CHANNELS; channel++)
+    {
+        int mode = (regs->MCR >> (channel * 3)) & 7;
+
+        if (!matchActive(timer, channel) || matchValue(timer, channel) != timer->tc)
+            continue;
+
+        if (regs->PWMC & (1 << channel))
+            timer->pwm |= 1 << channel;
+        if (mode & 1)
+            timer->ir |= 1 << channel;
+        if (mode & 2)
+            reset = 1;
+        if (mode & 4)
+            stop = 1;
+
+        switch ((regs->EMR >> (4 + channel * 2)) & 3)
+        {
+        case 1: regs->EMR &= ~(1 << channel); break;
+        case 2: regs->EMR |= 1 << channel; break;
+        case 3: regs->EMR ^= 1 << channel; break;
+        }
+    }
+
+    if (reset)
+    {   // the PWM outputs are low at the start of a cycle, unless the match value is 0
+        timer->tc = 0;
+        timer->pwm = 0;
+        for (channel = 0; channel < MATCH_CHANNELS; channel++)
+        {
+            if ((regs->PWMC & (1 << channel)) && matchValue(timer, channel) == 0)
+                timer->pwm |= 1 << channel;
+        }
+    }
+    if (stop)
+        regs->TCR &= ~1;
+    regs->TC = timer->tc;
+    regs->IR = timer->ir;
+}
+
+void TIMER_Emu_Capture(TimerEmu * timer, int channel, int rising)
+{
+    int mode = (timer->regs->CCR >> (channel * 3)) & 7;
+
+    if (!(mode & (rising ? 1 : 2)))
+        return;
+
+    // CRx is read only for the software
+    * (uint32_t *) &(&timer->regs->CR0)[channel] = timer->tc;
+    if (mode & 4)
+        timer->ir |= 16 << channel;
+    timer->regs->IR = timer->ir;
+}
+
+int TIMER_Emu_MatchOutput(TimerEmu * timer, int channel)
+{
+    if (timer->regs->PWMC & (1 << channel))
+        return (timer->pwm >> channel) & 1;
+    return (timer->regs->EMR >> channel) & 1;
+}
+
+int TIMER_Emu_Pending(TimerEmu * timer)
+{
+    return (timer->ir & IR_FLAGS) != 0;
+}
@@ -0,0 +1,105 @@
+/*
+ *  timer_emu.h - Emulation of the counter/timers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef TIMER_EMU_H_
+#define TIMER_EMU_H_
+
+#include "LPC11xx.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * The state of an emulated timer.
+ *
+ * The registers of the emulated timers are plain memory, so the emulation
+ * cannot see the writes of the software while they happen. Every call of
+ * software that accesses the timer (an interrupt handler or a library
+ * function) has to be enclosed in TIMER_Emu_Enter() and TIMER_Emu_Leave().
+ * They detect the writes that have a side effect on the hardware:
+ *   - writing 1 to a bit of IR clears the flag
+ *   - assigning TCR (Timer::restart()) resets the counter
+ *   - writing TC sets the counter
+ * Timer::reset() is not detected, it leaves the registers unchanged.
+ *
+ * The counter runs in timer ticks, the prescaler is not emulated.
+ *
+ * A PWM output is set when its match event occurs and cleared when the
+ * counter is reset by a match or overflows, like the real hardware. Setting
+ * a match value below the counter does not change the output.
+ */
+typedef struct
+{
+    LPC_TMR_TypeDef * regs;     // The registers of the timer
+    unsigned int      max;      // The maximum value of the counter
+    unsigned int      tc;       // The counter
+    unsigned int      ir;       // The interrupt flags
+    unsigned int      pwm;      // The levels of the PWM outputs
+} TimerEmu;
+
+/*
+ * Initialize the emulation of a timer and clear its registers.
+ *
+ * @param timer - the timer emulation
+ * @param regs - the registers of the timer, e.g. LPC_TMR16B1
+ * @param bits - the width of the counter: 16 or 32
+ */
+void TIMER_Emu_Init(TimerEmu * timer, LPC_TMR_TypeDef * regs, int bits);
+
+/*
+ * Prepare the registers before software accesses the timer.
+ */
+void TIMER_Emu_Enter(TimerEmu * timer);
+
+/*
+ * Apply the writes of the software to the timer.
+ */
+void TIMER_Emu_Leave(TimerEmu * timer);
+
+/*
+ * @return The number of ticks until the next match event, 0 if the timer
+ *         is stopped.
+ */
+unsigned int TIMER_Emu_NextEvent(TimerEmu * timer);
+
+/*
+ * Let the timer run. The ticks must not be more than TIMER_Emu_NextEvent()
+ * returned, the match events are processed at the end.
+ *
+ * @param timer - the timer emulation
+ * @param ticks - the number of ticks
+ */
+void TIMER_Emu_Advance(TimerEmu * timer, unsigned int ticks);
+
+/*
+ * An edge on a capture input.
+ *
+ * @param timer - the timer emulation
+ * @param channel - the capture channel
+ * @param rising - 1 for a rising edge, 0 for a falling edge
+ */
+void TIMER_Emu_Capture(TimerEmu * timer, int channel, int rising);
+
+/*
+ * @return The level of a match output: the PWM output if PWM is enabled for
+ *         the channel, else the external match bit.
+ */
+int TIMER_Emu_MatchOutput(TimerEmu * timer, int channel);
+
+/*
+ * @return 1 if an interrupt flag is set.
+ */
+int TIMER_Emu_Pending(TimerEmu * timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMER_EMU_H_ */
@@ -0,0 +1,119 @@
+/*
+ *  bus_backend.h - Connect the library to a host bus backend
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef BUS_BACKEND_H_
+#define BUS_BACKEND_H_
+
+#include <sblib/types.h>
+#include <sblib/eib/bus.h>
+
+/**
+ * The types of the events of a bus backend.
+ */
+enum BusEventType
+{
+    BUS_EVENT_NONE,     //!< Nothing happened within the timeout
+    BUS_EVENT_FRAME,    //!< A frame of another device, it must be answered with acknowledge()
+    BUS_EVENT_SENT,     //!< The frame of send() is over, ack contains the acknowledge
+    BUS_EVENT_CLOSED    //!< The backend is closed or failed
+};
+
+/**
+ * An event of a bus backend.
+ */
+struct BusEvent
+{
+    int type;                           //!< The type of the event, see BusEventType
+    int length;                         //!< BUS_EVENT_FRAME: the length of the frame, with the checksum
+    int ack;                            //!< BUS_EVENT_SENT: the acknowledge, -1 if there was none
+    byte data[Bus::TELEGRAM_SIZE];      //!< BUS_EVENT_FRAME: the frame
+};
+
+/**
+ * The transport of L_Data frames between a device and a bus on the host.
+ *
+ * A backend transmits one frame at a time. The frame is over when wait()
+ * returns BUS_EVENT_SENT. Every frame of another device is answered with
+ * acknowledge(), also if the frame is not for the device.
+ */
+class BusBackend
+{
+public:
+    virtual ~BusBackend() {}
+
+    /**
+     * Transmit a frame.
+     *
+     * @param frame - the frame with the checksum.
+     * @param length - the length of the frame, with the checksum.
+     * @return True if the frame was accepted for transmission.
+     */
+    virtual bool send(const byte* frame, int length) = 0;
+
+    /**
+     * Answer the last frame of BUS_EVENT_FRAME.
+     *
+     * @param ack - the acknowledge, e.g. SB_BUS_ACK, or -1 for no acknowledge.
+     * @return True on success.
+     */
+    virtual bool acknowledge(int ack) = 0;
+
+    /**
+     * Wait for the next event.
+     *
+     * @param event - the event.
+     * @param timeout - the maximum time to wait in milliseconds.
+     * @return The type of the event.
+     */
+    virtual int wait(BusEvent* event, int timeout) = 0;
+};
+
+/**
+ * Connects the global "bus" object of the library to a bus backend, instead
+ * of the timer interrupt handler.
+ *
+ * The connector takes the telegrams from the send queue of the bus, repeats
+ * them up to Bus::maxSendTries() times if they are not acknowledged, and
+ * places the received frames in bus.telegram like Bus::handleTelegram() does.
+ *
+ * Usage:
+ *     BusConnector connector(backend);
+ *     while (connector.poll(1))
+ *         bcu.loop();
+ */
+class BusConnector
+{
+public:
+    BusConnector(BusBackend& backend);
+
+    /**
+     * Pass the telegrams between the bus and the backend.
+     *
+     * @param timeout - the maximum time to wait for the backend in milliseconds.
+     * @return False if the backend is closed.
+     */
+    bool poll(int timeout);
+
+    unsigned int received;      //!< The number of frames received from the backend
+    unsigned int accepted;      //!< The number of frames placed in bus.telegram
+    unsigned int overwritten;   //!< The number of frames that replaced an unprocessed telegram
+    unsigned int sent;          //!< The number of frames sent, repeats included
+    unsigned int repeats;       //!< The number of repeated frames
+    unsigned int acked;         //!< The number of acknowledged telegrams
+    unsigned int failed;        //!< The number of telegrams given up after all repeats
+
+private:
+    void frameReceived(const BusEvent& event);
+    void frameSent(int ack);
+
+    BusBackend& backend;
+    bool sending;               //!< A frame of bus.sendCurTelegram is being sent
+    int tries;                  //!< The number of repeats of the current telegram
+};
+
+#endif /* BUS_BACKEND_H_ */
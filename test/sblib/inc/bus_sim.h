@@ -0,0 +1,293 @@
+/*
+ *  bus_sim.h - Simulation of the KNX TP1 bus
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef BUS_SIM_H_
+#define BUS_SIM_H_
+
+#include <sblib/types.h>
+#include "timer_emu.h"
+
+/**
+ * The time of the simulation in microseconds.
+ */
+typedef unsigned long long SimTime;
+
+/**
+ * The time of one bit on the bus in microseconds.
+ */
+#define SIM_BIT_TIME 104
+
+/**
+ * The time a sender pulls the bus low for a 0 bit in microseconds.
+ */
+#define SIM_PULSE_TIME 35
+
+/**
+ * The maximum number of virtual nodes.
+ */
+#define SIM_MAX_NODES 8
+
+/**
+ * The maximum number of group addresses of a virtual node.
+ */
+#define SIM_MAX_GROUPS 8
+
+/**
+ * The number of telegrams in the send queue of a virtual node.
+ */
+#define SIM_QUEUE_SIZE 8
+
+/**
+ * The maximum size of a telegram, with the checksum.
+ */
+#define SIM_TELEGRAM_SIZE 24
+
+/**
+ * The statistics of the simulated bus.
+ */
+struct BusSimStats
+{
+    unsigned int telegrams;     //!< The number of telegrams on the bus, repeats included
+    unsigned int repeats;       //!< The number of telegrams with the repeat flag
+    unsigned int acks;          //!< The number of acknowledges
+    unsigned int nacks;         //!< The number of NACK and BUSY acknowledges
+    unsigned int missedAcks;    //!< The number of telegrams that were not acknowledged
+    unsigned int corrupted;     //!< The number of frames with a parity, stop bit or checksum error
+    unsigned int collisions;    //!< The number of times a virtual node lost the arbitration
+    unsigned int delivered;     //!< The number of acknowledged telegrams of the virtual nodes
+    unsigned int failed;        //!< The number of telegrams the virtual nodes gave up after all repeats
+    unsigned int dutReceived;   //!< The number of telegrams the device received
+    unsigned int dutDelivered;  //!< The number of acknowledged telegrams of the device
+    unsigned int dutFinished;   //!< The number of telegrams the device removed from its send queue
+    unsigned int interrupts;    //!< The number of calls of the interrupt handler of the device
+    unsigned int payloadBytes;  //!< The bytes of the acknowledged telegrams, with the checksum
+    SimTime busyTime;           //!< The time the bus carried frames
+};
+
+/**
+ * A virtual node: a KNX TP1 device that sends and acknowledges telegrams.
+ */
+struct BusSimNode
+{
+    int address;                //!< The physical address
+    int groups[SIM_MAX_GROUPS]; //!< The group addresses that are acknowledged
+    int groupCount;             //!< The number of group addresses
+    unsigned int startDelay;    //!< Microseconds the node waits in addition to the 50 bit times of a free bus
+    bool ack;                   //!< Acknowledge the telegrams to the node
+
+    unsigned int sent;          //!< The number of telegrams sent, repeats included
+    unsigned int repeats;       //!< The number of repeated telegrams
+    unsigned int lost;          //!< The number of lost arbitrations
+    unsigned int acked;         //!< The number of acknowledged telegrams
+    unsigned int failed;        //!< The number of telegrams given up after all repeats
+    unsigned int received;      //!< The number of telegrams received
+    byte rxTelegram[SIM_TELEGRAM_SIZE]; //!< The last telegram received, with the checksum
+    int rxLength;               //!< The length of rxTelegram
+
+    // The send queue
+    byte queue[SIM_QUEUE_SIZE][SIM_TELEGRAM_SIZE];
+    int queueLength[SIM_QUEUE_SIZE];
+    int queueHead;
+    int queueCount;
+    int tries;
+
+    // The transmitter
+    int state;
+    SimTime nextAction;
+    SimTime charStart;
+    int charIndex;
+    int slot;
+    SimTime driveUntil;
+
+    // The acknowledge transmitter
+    SimTime ackAt;
+    int ackSlot;
+};
+
+/**
+ * A discrete event simulation of the KNX TP1 bus.
+ *
+ * The device under test is the global "bus" object of the library. Its timer
+ * (timer16_1) is emulated by TIMER_Emu_xx and its interrupt handler
+ * Bus::timerInterruptHandler() is called on the timer events, so the real
+ * receive and send state machine runs. The match output of the device and the
+ * virtual nodes drive a shared wired-AND line. Every falling edge of the line
+ * is a capture event of the device. The system timer runs with the simulated
+ * time, so millis() and micros() of the device follow it.
+ *
+ * The virtual nodes send and receive on bit level: they wait 50 bit times for a
+ * free bus, arbitrate bit by bit, acknowledge the telegrams to them 15 bit times
+ * after the end of the telegram, and repeat a telegram up to 3 times if it is
+ * not acknowledged.
+ *
+ * Usage:
+ *     BusSim sim;
+ *     sim.begin(0x11fe);
+ *     int node = sim.addNode(0x1101);
+ *     sim.nodeSend(node, telegram, length);
+ *     sim.run(100000);
+ */
+class BusSim
+{
+public:
+    BusSim();
+
+    /**
+     * Reset the simulation and start the bus of the device.
+     *
+     * @param ownAddr - the physical address of the device.
+     */
+    void begin(int ownAddr);
+
+    /**
+     * Add a group address to the address table of the device.
+     *
+     * @param groupAddr - the group address.
+     */
+    void addGroup(int groupAddr);
+
+    /**
+     * Add a virtual node.
+     *
+     * @param address - the physical address of the node.
+     * @return The index of the node, -1 if there are too many nodes.
+     */
+    int addNode(int address);
+
+    /**
+     * @return The virtual node.
+     */
+    BusSimNode& node(int index);
+
+    /**
+     * Queue a telegram of a virtual node. The sender address and the checksum
+     * are set by the simulation.
+     *
+     * @param index - the index of the node.
+     * @param telegram - the telegram, without the checksum.
+     * @param length - the length of the telegram.
+     * @return True if the telegram was queued, false if the queue is full.
+     */
+    bool nodeSend(int index, const byte* telegram, int length);
+
+    /**
+     * Send a telegram by the device, see Bus::sendTelegram().
+     *
+     * @param telegram - the telegram, with one byte space for the checksum.
+     * @param length - the length of the telegram, without the checksum.
+     * @return True if the telegram was queued, false if the send queue is full.
+     */
+    bool send(byte* telegram, int length);
+
+    /**
+     * Run the simulation.
+     *
+     * @param usec - the time to simulate in microseconds.
+     */
+    void run(unsigned int usec);
+
+    /**
+     * Run the simulation until no telegram is waiting to be sent and the bus
+     * is free, or the time is over.
+     *
+     * @param usec - the maximum time to simulate in microseconds.
+     * @return True if the bus is idle.
+     */
+    bool runUntilIdle(unsigned int usec);
+
+    /**
+     * @return True if no telegram is waiting to be sent and the bus is free.
+     */
+    bool idle() const;
+
+    /**
+     * @return The time of the simulation in microseconds.
+     */
+    SimTime time() const;
+
+    /**
+     * @return The acknowledged bytes per second, with the checksum.
+     */
+    double goodput() const;
+
+    /**
+     * Called when the device received a telegram. The default is to discard it.
+     */
+    void (*received)(const byte* telegram, int length);
+
+    /**
+     * The latency of the interrupt handler of the device in microseconds.
+     */
+    unsigned int isrLatency;
+
+    /**
+     * The statistics of the bus.
+     */
+    BusSimStats stats;
+
+private:
+    void step(SimTime limit);
+    void interrupt();
+    void updateLine();
+    void lineEdge();
+    void charComplete();
+    void frameComplete();
+    void ackResult(bool acked);
+    void nodeAction(BusSimNode& node);
+    void nodeAckAction(BusSimNode& node);
+    void nodeStart(BusSimNode& node);
+    void nodeReceive(BusSimNode& node);
+    void nodeDone(BusSimNode& node, bool acked);
+    void rearmNodes();
+    bool nodeDriving(const BusSimNode& node) const;
+    void updateSystemTime();
+
+    TimerEmu timer;             //!< The timer of the device
+    SimTime now;                //!< The current time
+    SimTime isrAt;              //!< The time of the next call of the interrupt handler
+    byte* dutTelegram;          //!< The telegram the device is sending
+    bool lineLow;               //!< The state of the line
+    unsigned int systemTimeStart; //!< The system time of the device at the start
+
+    BusSimNode nodes[SIM_MAX_NODES];
+    int nodeCount;
+
+    // The decoder of the line
+    bool inChar;                //!< A character is being received
+    bool inFrame;               //!< A frame is being received
+    SimTime charStart;          //!< The start bit of the current character
+    unsigned int charBits;      //!< The bits of the current character, bit 0 is the start bit
+    SimTime frameStart;         //!< The start of the current frame
+    SimTime lastEnd;            //!< The end of the stop bit of the last character
+    byte frame[SIM_TELEGRAM_SIZE];
+    int frameLength;
+    bool frameValid;
+
+    // The acknowledge of the last telegram
+    bool awaitAck;              //!< An acknowledge is expected
+    SimTime ackDeadline;        //!< The time the acknowledge has to start
+    int ackSender;              //!< The index of the sending node, -1 for the device
+    int ackLength;              //!< The length of the telegram to acknowledge
+};
+
+
+//
+//  Inline functions
+//
+
+inline BusSimNode& BusSim::node(int index)
+{
+    return nodes[index];
+}
+
+inline SimTime BusSim::time() const
+{
+    return now;
+}
+
+#endif /* BUS_SIM_H_ */
@@ -0,0 +1,103 @@
+/*
+ *  bus_trace.h - Binary trace of the telegrams on the bus
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef BUS_TRACE_H_
+#define BUS_TRACE_H_
+
+#include <stdio.h>
+
+/*
+ * The format of a trace file:
+ *
+ *   Header, 8 bytes:
+ *     "KNXT"    magic
+ *     version   1 byte, TRACE_VERSION
+ *     reserved  3 bytes, 0
+ *
+ *   A record for every frame:
+ *     delta     the time since the previous frame in microseconds, unsigned
+ *               LEB128: 7 bits per byte, least significant first, bit 7 is
+ *               set if another byte follows
+ *     ack       the acknowledge of the frame: SB_BUS_ACK, SB_BUS_NACK,
+ *               SB_BUS_BUSY, or 0 if none or unknown
+ *     length    the number of bytes of the frame, 1..255
+ *     data      the bytes of the frame, with the checksum
+ *
+ * The time of a frame is the end of its last byte, when the receiver has the
+ * complete frame. The time of the first frame is relative to the start of the
+ * trace.
+ */
+
+/**
+ * The version of the trace format.
+ */
+#define TRACE_VERSION 1
+
+/**
+ * The maximum length of a frame.
+ */
+#define TRACE_MAX_FRAME 255
+
+/**
+ * A frame of a trace.
+ */
+struct TraceRecord
+{
+    unsigned long long time;        //!< The time of the frame in microseconds since the start
+    unsigned char ack;              //!< The acknowledge, 0 if none or unknown
+    unsigned char length;           //!< The number of bytes of the frame
+    unsigned char data[TRACE_MAX_FRAME]; //!< The bytes of the frame, with the checksum
+};
+
+/**
+ * Write the header of a trace.
+ *
+ * @param file - the trace file, opened for binary writing.
+ * @return True on success.
+ */
+bool traceWriteHeader(FILE* file);
+
+/**
+ * Write a frame to a trace.
+ *
+ * @param file - the trace file.
+ * @param record - the frame. The frames must be written in the order of time.
+ * @param lastTime - the time of the previous frame, 0 for the first frame.
+ * @return True on success.
+ */
+bool traceWrite(FILE* file, const TraceRecord* record, unsigned long long lastTime);
+
+/**
+ * Read and check the header of a trace.
+ *
+ * @param file - the trace file, opened for binary reading.
+ * @return True if the file is a trace of a supported version.
+ */
+bool traceReadHeader(FILE* file);
+
+/**
+ * Read the next frame of a trace.
+ *
+ * @param file - the trace file.
+ * @param record - the frame that is read. Its time must contain the time of
+ *                 the previous frame, 0 for the first frame.
+ * @return 1 if a frame was read, 0 at the end of the trace, -1 if the trace
+ *         is truncated or invalid.
+ */
+int traceRead(FILE* file, TraceRecord* record);
+
+/**
+ * Calculate the time that a frame occupies the bus: 13 bit times per byte
+ * (start bit, 8 data bits, parity, stop bit and 2 bits pause).
+ *
+ * @param length - the number of bytes of the frame.
+ * @return The time in microseconds.
+ */
+unsigned int traceFrameTime(int length);
+
+#endif /* BUS_TRACE_H_ */
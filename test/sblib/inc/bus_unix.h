@@ -0,0 +1,80 @@
+/*
+ *  bus_unix.h - Bus backend for a virtual bus over a UNIX domain socket
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef BUS_UNIX_H_
+#define BUS_UNIX_H_
+
+#include "bus_backend.h"
+
+/**
+ * The default path of the socket of the virtual bus hub.
+ */
+#define VBUS_DEFAULT_SOCKET "/tmp/sblib-vbus.sock"
+
+/**
+ * The messages between the devices and the hub, one message per packet of a
+ * SOCK_SEQPACKET socket. The first byte is the type of the message.
+ */
+enum VbusMessage
+{
+    VBUS_MSG_SEND = 1,  //!< Device to hub: transmit the frame that follows
+    VBUS_MSG_ACK = 2,   //!< Device to hub: the answer to VBUS_MSG_FRAME, see below
+    VBUS_MSG_FRAME = 3, //!< Hub to device: the frame that follows was on the bus
+    VBUS_MSG_SENT = 4   //!< Hub to device: the frame of VBUS_MSG_SEND is over, see below
+};
+
+// VBUS_MSG_ACK and VBUS_MSG_SENT have two bytes: 1 if there is an acknowledge
+// and the acknowledge byte.
+
+/**
+ * The maximum size of a message.
+ */
+#define VBUS_MSG_SIZE (1 + Bus::TELEGRAM_SIZE)
+
+/**
+ * A bus backend that connects to the hub of a virtual bus, see test/virtual-bus.
+ */
+class UnixBusBackend: public BusBackend
+{
+public:
+    UnixBusBackend();
+    virtual ~UnixBusBackend();
+
+    /**
+     * Connect to the hub.
+     *
+     * @param path - the path of the socket of the hub.
+     * @return True on success.
+     */
+    bool open(const char* path);
+
+    /**
+     * Close the connection.
+     */
+    void close();
+
+    virtual bool send(const byte* frame, int length);
+    virtual bool acknowledge(int ack);
+    virtual int wait(BusEvent* event, int timeout);
+
+private:
+    int fd;                     //!< The socket, -1 if not connected
+};
+
+/**
+ * Send a message over a virtual bus socket.
+ *
+ * @param fd - the socket.
+ * @param type - the type of the message.
+ * @param data - the data of the message.
+ * @param length - the length of the data.
+ * @return True on success.
+ */
+bool vbusSend(int fd, int type, const byte* data, int length);
+
+#endif /* BUS_UNIX_H_ */
@@ -0,0 +1,234 @@
+/*
+ *  periph_models.h - Models of devices for the peripheral emulation
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef PERIPH_MODELS_H_
+#define PERIPH_MODELS_H_
+
+#include "periph_emu.h"
+
+/**
+ * A 1-Wire slave on a GPIO pin. Decodes the time slots of the master,
+ * handles the ROM commands and passes the function commands to the
+ * subclass.
+ *
+ * Usage:
+ *     EmuDS18B20 sensor(rom);
+ *     periphEmu.attachPin(PIO0_7, &sensor);
+ */
+class EmuOneWireDevice: public EmuPinDevice
+{
+public:
+    /**
+     * @param rom - the 8 bytes of the ROM code: family code, serial number,
+     *              CRC. The CRC is calculated if it is 0.
+     */
+    EmuOneWireDevice(const uint8_t* rom);
+
+    virtual void driveChanged(int level, EmuTime time);
+    virtual int level(EmuTime time);
+
+    uint8_t rom[8];             //!< The ROM code
+    unsigned int resets;        //!< The number of reset pulses
+    unsigned int functions;     //!< The number of function commands for this device
+
+protected:
+    /**
+     * The master sent a function command after selecting this device.
+     * Call send() or receive() to continue.
+     */
+    virtual void function(uint8_t cmd) = 0;
+
+    /**
+     * A byte that was requested with receive() arrived.
+     */
+    virtual void received(uint8_t data) {}
+
+    /**
+     * All bytes of send() were sent.
+     */
+    virtual void sent() {}
+
+    /**
+     * @return The bit that the device sends in a read slot when it has
+     *         nothing to send after a function command.
+     */
+    virtual int idleBit(EmuTime time) { return 1; }
+
+    /**
+     * Send bytes in the next read slots.
+     */
+    void send(const uint8_t* data, int length);
+
+    /**
+     * Receive a byte in the next write slots, see received().
+     */
+    void receive();
+
+    /**
+     * Calculate the 1-Wire CRC8.
+     */
+    static uint8_t crc8(const uint8_t* data, int length);
+
+    enum State
+    {
+        IDLE,           // Waiting for a reset pulse
+        ROM_COMMAND,    // Receiving the ROM command
+        MATCH_ROM,      // Receiving the ROM code of MATCH ROM
+        SEARCH_ROM,     // Sending and receiving the bits of SEARCH ROM
+        READ_ROM,       // Sending the ROM code of READ ROM
+        FUNCTION,       // Receiving the function command
+        RECEIVE,        // Receiving bytes for the subclass
+        SEND,           // Sending bytes of the subclass
+        DONE            // The function command has nothing to send or receive
+    };
+
+    bool sending() const;
+    int nextBit(EmuTime time);
+    void receivedBit(int bit);
+
+    State state;
+    EmuTime lowSince;           // The time the master pulled the line low
+    bool readSlot;              // The current slot is a read slot
+    EmuTime holdUntil;          // The device pulls the line low until this time
+    EmuTime holdFrom;           // ... from this time
+    uint8_t buffer[16];         // The bytes to send or the byte being received
+    int length;                 // The length of the data to send
+    int bitPos;                 // The number of bits sent or received
+};
+
+/**
+ * A DS18B20 temperature sensor with external power.
+ *
+ * Commands: CONVERT T, READ SCRATCHPAD, WRITE SCRATCHPAD, READ POWER SUPPLY.
+ * A conversion takes 750 msec at 12 bit resolution; read slots return 0
+ * until it is done.
+ */
+class EmuDS18B20: public EmuOneWireDevice
+{
+public:
+    EmuDS18B20(const uint8_t* rom);
+
+    float temperature;          //!< The temperature that the next conversion measures
+    uint8_t scratchpad[9];      //!< The scratchpad, CRC included
+    unsigned int conversions;   //!< The number of conversions
+
+protected:
+    virtual void function(uint8_t cmd);
+    virtual void received(uint8_t data);
+    virtual int idleBit(EmuTime time);
+
+    EmuTime convertDone;        // The time the conversion is done
+    uint8_t command;            // The function command
+    int writePos;               // The byte of WRITE SCRATCHPAD received next
+};
+
+/**
+ * A DS3231 real time clock on the I2C bus, address 0x68.
+ *
+ * The first byte of a write sets the register pointer, the following bytes
+ * are written to the registers. A read returns the registers from the
+ * pointer on. The pointer wraps after the last register. The clock does
+ * not run: set the time registers to test the driver.
+ */
+class EmuDS3231: public EmuI2CDevice
+{
+public:
+    EmuDS3231();
+
+    virtual bool start(bool read);
+    virtual bool write(uint8_t data);
+    virtual uint8_t read();
+
+    uint8_t regs[0x13];         //!< The registers: time, alarms, control, status, aging, temperature
+    int pointer;                //!< The register pointer
+
+protected:
+    bool pointerSet;            // The pointer was written in this write transfer
+};
+
+/**
+ * A BH1750 ambient light sensor on the I2C bus, address 0x23.
+ *
+ * A measurement command starts a measurement of 120 msec (16 msec in low
+ * resolution mode). Reads return the result of the last finished
+ * measurement: lux * 1.2, doubled in high resolution mode 2.
+ */
+class EmuBH1750: public EmuI2CDevice
+{
+public:
+    EmuBH1750();
+
+    virtual bool start(bool read);
+    virtual bool write(uint8_t data);
+    virtual uint8_t read();
+
+    float lux;                  //!< The illuminance that the next measurement measures
+    int mode;                   //!< The last measurement command
+    bool powerOn;               //!< The power state
+    unsigned int measurements;  //!< The number of measurement commands
+
+protected:
+    int result();
+
+    int value;                  // The result of the last finished measurement
+    int pendingValue;           // The result of the running measurement
+    EmuTime measureDone;        // The time the running measurement is done
+    int readPos;                // The byte of the result to read next
+};
+
+/**
+ * A sink for an EA DOGS display with an UC1701 controller on a SSP port.
+ * The CD pin selects between commands (low) and data (high).
+ *
+ * The column and page address commands are decoded and the data is stored
+ * in the display RAM; other commands are counted.
+ */
+class EmuEADOGS: public EmuSPIDevice
+{
+public:
+    /**
+     * @param pinCD - the CD pin.
+     */
+    EmuEADOGS(int pinCD);
+
+    virtual int transfer(int data, int bits);
+
+    /**
+     * @return The byte of the display RAM at a position.
+     */
+    uint8_t pixels(int column, int page) const { return ram[page & 7][column % 132]; }
+
+    int column;                 //!< The column address
+    int page;                   //!< The page address
+    unsigned int commands;      //!< The number of command bytes
+    unsigned int dataBytes;     //!< The number of data bytes
+
+protected:
+    int pinCD;
+    uint8_t ram[8][132];
+};
+
+/**
+ * A device that pulls a GPIO pin low for a time, e.g. to test pulseIn().
+ */
+class EmuLowPulse: public EmuPinDevice
+{
+public:
+    /**
+     * @param start - the time the pulse starts.
+     * @param length - the length of the pulse.
+     */
+    EmuLowPulse(EmuTime start, EmuTime length) : start(start), length(length) {}
+
+    virtual int level(EmuTime time) { return time < start || time >= start + length; }
+
+    EmuTime start;              //!< The time the pulse starts
+    EmuTime length;             //!< The length of the pulse
+};
+
+#endif /* PERIPH_MODELS_H_ */
@@ -0,0 +1,42 @@
+/*
+ *  report_buffer.h - Collect the printed output of a report
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef REPORT_BUFFER_H_
+#define REPORT_BUFFER_H_
+
+#include <sblib/print.h>
+
+/*
+ * A Print that collects the output in a zero terminated text, e.g. the output
+ * of the report functions of the instrumentation. Output that does not fit
+ * is dropped.
+ *
+ * Usage:
+ *     ReportBuffer report;
+ *     cpuLoadReport(report);
+ *     REQUIRE(strstr(report.text, "cpu load ") != 0);
+ */
+class ReportBuffer: public Print
+{
+public:
+    ReportBuffer() : length(0) { text[0] = 0; }
+
+    virtual int write(byte ch)
+    {
+        if (length >= (int) sizeof(text) - 1)
+            return 0;
+        text[length++] = ch;
+        text[length] = 0;
+        return 1;
+    }
+
+    char text[2048];    //!< The output, zero terminated
+    int length;         //!< The length of the text
+};
+
+#endif /* REPORT_BUFFER_H_ */
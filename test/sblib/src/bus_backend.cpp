@@ -0,0 +1,133 @@
+/*
+ *  bus_backend.cpp - Connect the library to a host bus backend
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#define private public
+#define protected public
+#include "sblib/eib/bus.h"
+#undef protected
+#undef private
+#include "sblib/eib/addr_tables.h"
+#include "sblib/eib/user_memory.h"
+#include "bus_backend.h"
+
+#include <string.h>
+
+// The repeat flag in the control byte of a telegram, 0 if the telegram is repeated
+#define TEL_REPEAT_FLAG 0x20
+
+
+BusConnector::BusConnector(BusBackend& backend)
+:backend(backend)
+,sending(false)
+,tries(0)
+{
+    received = accepted = overwritten = 0;
+    sent = repeats = acked = failed = 0;
+}
+
+bool BusConnector::poll(int timeout)
+{
+    BusEvent event;
+
+    // Nobody runs the state machine of the bus
+    bus.state = Bus::IDLE;
+
+    if (!sending && bus.sendCurTelegram)
+    {
+        if (!backend.send((const byte*) bus.sendCurTelegram, telegramSize(bus.sendCurTelegram) + 1))
+            return false;
+        sending = true;
+        ++sent;
+    }
+
+    switch (backend.wait(&event, timeout))
+    {
+    case BUS_EVENT_FRAME:
+        frameReceived(event);
+        break;
+
+    case BUS_EVENT_SENT:
+        frameSent(event.ack);
+        break;
+
+    case BUS_EVENT_CLOSED:
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Accept a frame like Bus::handleTelegram() does.
+ */
+void BusConnector::frameReceived(const BusEvent& event)
+{
+    int ack = -1;
+
+    ++received;
+    if (event.length >= 8 && event.length == telegramSize(event.data) + 1)
+    {
+        int destAddr = (event.data[3] << 8) | event.data[4];
+        bool processTel = false;
+
+        if (event.data[5] & 0x80)
+            processTel = destAddr == 0 || indexOfAddr(destAddr) >= 0;
+        else processTel = destAddr == bus.ownAddr;
+
+        if (processTel || !(userRam.status & BCU_STATUS_TL))
+        {
+            // The bus overwrites a telegram that is not processed yet
+            if (bus.telegramLen)
+                ++overwritten;
+
+            memcpy(bus.telegram, event.data, event.length);
+            bus.telegramLen = event.length;
+            ++accepted;
+
+            if (processTel || (userRam.status & BCU_STATUS_LL))
+                ack = SB_BUS_ACK;
+        }
+    }
+    else ack = SB_BUS_NACK;
+
+    backend.acknowledge(ack);
+}
+
+/*
+ * The current telegram was sent: repeat it or take the next one.
+ */
+void BusConnector::frameSent(int ack)
+{
+    if (!sending)
+        return;
+    sending = false;
+
+    if (ack == SB_BUS_ACK)
+        ++acked;
+    else if (tries < bus.sendTriesMax)
+    {
+        if (!tries)
+        {
+            // The first repeat: mark the telegram as repeated and correct the checksum
+            int length = telegramSize(bus.sendCurTelegram) + 1;
+            bus.sendCurTelegram[0] &= ~TEL_REPEAT_FLAG;
+            bus.sendCurTelegram[length - 1] ^= TEL_REPEAT_FLAG;
+        }
+
+        // poll() sends it again
+        ++tries;
+        ++repeats;
+        return;
+    }
+    else ++failed;
+
+    // Like Bus::sendNextTelegram()
+    tries = 0;
+    bus.sendCurTelegram[0] = 0;
+    bus.sendCurTelegram = bus.sendNextTel;
+    bus.sendNextTel = 0;
+}
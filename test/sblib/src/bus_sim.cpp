@@ -0,0 +1,656 @@
+/*
+ *  bus_sim.cpp - Simulation of the KNX TP1 bus
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#define private public
+#define protected public
+#include "sblib/eib/bus.h"
+#undef protected
+#undef private
+#include "sblib/eib/addr_tables.h"
+#include "sblib/eib/user_memory.h"
+#include "bus_sim.h"
+
+#include <string.h>
+
+extern volatile unsigned int systemTime;
+
+// An event that does not happen
+#define NEVER ((SimTime) -1)
+
+// The time a sender waits for a free bus after the last character
+#define FREE_BUS_TIME (50 * SIM_BIT_TIME)
+
+// The time from the end of a telegram to the start of the acknowledge
+#define ACK_START_TIME (15 * SIM_BIT_TIME)
+
+// The latest start of the acknowledge after the end of a telegram
+#define ACK_TIMEOUT (20 * SIM_BIT_TIME)
+
+// The time after the last stop bit when the end of a frame is detected
+#define FRAME_END_TIME (4 * SIM_BIT_TIME)
+
+// The bits of a character: start bit, 8 data bits, parity, stop bit
+#define CHAR_BITS 11
+
+// The distance of two characters of a telegram: 11 bits and 2 bits pause
+#define CHAR_TIME (13 * SIM_BIT_TIME)
+
+// A virtual node starts sending even if another sender started up to this time before
+#define START_TOLERANCE 10
+
+// The number of repeats of a telegram that is not acknowledged
+#define MAX_REPEATS 3
+
+// Telegram repeat flag in byte #0 of the telegram: 1=not repeated, 0=repeated
+#define REPEAT_FLAG 0x20
+
+// The states of the transmitter of a virtual node
+enum
+{
+    NODE_IDLE,      //!< Nothing to send
+    NODE_WAIT,      //!< Waiting for a free bus
+    NODE_SEND,      //!< Sending a telegram
+    NODE_WAIT_ACK   //!< Waiting for the acknowledge
+};
+
+/*
+ * The bits of a character in the order they are sent: start bit, 8 data
+ * bits LSB first, even parity, stop bit.
+ */
+static unsigned int encodeChar(byte ch)
+{
+    unsigned int parity = 0;
+
+    for (int i = 0; i < 8; ++i)
+        parity ^= (ch >> i) & 1;
+    return (ch << 1) | (parity << 9) | (1 << 10);
+}
+
+BusSim::BusSim()
+:received(0)
+,isrLatency(0)
+{
+    memset(&stats, 0, sizeof(stats));
+    nodeCount = 0;
+    now = 0;
+}
+
+void BusSim::begin(int ownAddr)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(nodes, 0, sizeof(nodes));
+    nodeCount = 0;
+    now = 0;
+    isrAt = NEVER;
+    lineLow = false;
+    inChar = false;
+    inFrame = false;
+    lastEnd = 0;
+    frameLength = 0;
+    awaitAck = false;
+    ackSender = -1;
+    systemTimeStart = systemTime;
+
+    userEeprom.addrTab[0] = ownAddr >> 8;
+    userEeprom.addrTab[1] = ownAddr;
+    addrTable()[0] = 0;
+    userRam.status |= BCU_STATUS_LL | BCU_STATUS_TL;
+
+    TIMER_Emu_Init(&timer, LPC_TMR16B1, 16);
+    TIMER_Emu_Enter(&timer);
+    bus.begin();
+    TIMER_Emu_Leave(&timer);
+    dutTelegram = (byte*) bus.sendCurTelegram;
+
+    // Bus::begin() lets the counter overflow to set the match output low before
+    // the pin is configured. This does not reach the bus.
+    TIMER_Emu_Advance(&timer, TIMER_Emu_NextEvent(&timer));
+}
+
+void BusSim::addGroup(int groupAddr)
+{
+    byte* tab = addrTable();
+    int count = tab[0];
+
+    tab[3 + count * 2] = groupAddr >> 8;
+    tab[4 + count * 2] = groupAddr;
+    tab[0] = count + 1;
+}
+
+int BusSim::addNode(int address)
+{
+    if (nodeCount >= SIM_MAX_NODES)
+        return -1;
+
+    BusSimNode& node = nodes[nodeCount];
+    memset(&node, 0, sizeof(node));
+    node.address = address;
+    node.ack = true;
+    node.state = NODE_IDLE;
+    node.nextAction = NEVER;
+    node.ackAt = NEVER;
+    return nodeCount++;
+}
+
+bool BusSim::nodeSend(int index, const byte* telegram, int length)
+{
+    BusSimNode& node = nodes[index];
+    byte checksum = 0xff;
+
+    if (node.queueCount >= SIM_QUEUE_SIZE || length + 1 > SIM_TELEGRAM_SIZE)
+        return false;
+
+    int pos = (node.queueHead + node.queueCount) % SIM_QUEUE_SIZE;
+    byte* tel = node.queue[pos];
+    memcpy(tel, telegram, length);
+    tel[1] = node.address >> 8;
+    tel[2] = node.address;
+    for (int i = 0; i < length; ++i)
+        checksum ^= tel[i];
+    tel[length] = checksum;
+    node.queueLength[pos] = length + 1;
+    ++node.queueCount;
+
+    if (node.state == NODE_IDLE)
+    {
+        node.state = NODE_WAIT;
+        node.tries = 0;
+        node.nextAction = lastEnd + FREE_BUS_TIME + node.startDelay;
+        if (node.nextAction < now)
+            node.nextAction = now;
+    }
+    return true;
+}
+
+bool BusSim::send(byte* telegram, int length)
+{
+    if (bus.sendNextTel)
+        return false;
+
+    TIMER_Emu_Enter(&timer);
+    bus.sendTelegram(telegram, length);
+    TIMER_Emu_Leave(&timer);
+
+    if (!dutTelegram)
+        dutTelegram = (byte*) bus.sendCurTelegram;
+    return true;
+}
+
+void BusSim::run(unsigned int usec)
+{
+    SimTime end = now + usec;
+
+    while (now < end)
+        step(end);
+}
+
+bool BusSim::runUntilIdle(unsigned int usec)
+{
+    SimTime end = now + usec;
+
+    while (now < end)
+    {
+        if (idle())
+            return true;
+        step(end);
+    }
+    return idle();
+}
+
+bool BusSim::idle() const
+{
+    if (inFrame || awaitAck || bus.sendCurTelegram || bus.state != Bus::IDLE)
+        return false;
+
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        if (nodes[i].state != NODE_IDLE || nodes[i].ackAt != NEVER)
+            return false;
+    }
+    return true;
+}
+
+double BusSim::goodput() const
+{
+    if (!now)
+        return 0;
+    return stats.payloadBytes * 1000000.0 / now;
+}
+
+/*
+ * Process the next event, but not after limit.
+ */
+void BusSim::step(SimTime limit)
+{
+    SimTime next = limit;
+    unsigned int ticks = TIMER_Emu_NextEvent(&timer);
+    int i;
+
+    if (ticks && now + ticks < next)
+        next = now + ticks;
+    if (isrAt < next)
+        next = isrAt;
+    for (i = 0; i < nodeCount; ++i)
+    {
+        BusSimNode& node = nodes[i];
+        if (node.nextAction < next)
+            next = node.nextAction;
+        if (node.ackAt < next)
+            next = node.ackAt;
+        if (node.driveUntil > now && node.driveUntil < next)
+            next = node.driveUntil;
+    }
+    if (inChar && charStart + CHAR_BITS * SIM_BIT_TIME < next)
+        next = charStart + CHAR_BITS * SIM_BIT_TIME;
+    if (inFrame && !inChar && lastEnd + FRAME_END_TIME < next)
+        next = lastEnd + FRAME_END_TIME;
+    if (awaitAck && !inFrame && ackDeadline < next)
+        next = ackDeadline;
+    if (next < now)
+        next = now;
+
+    if (ticks)
+        TIMER_Emu_Advance(&timer, next - now);
+    now = next;
+    updateSystemTime();
+
+    for (i = 0; i < nodeCount; ++i)
+    {
+        if (nodes[i].ackAt <= now)
+            nodeAckAction(nodes[i]);
+        if (nodes[i].nextAction <= now)
+            nodeAction(nodes[i]);
+    }
+    updateLine();
+
+    if (inChar && now >= charStart + CHAR_BITS * SIM_BIT_TIME)
+        charComplete();
+    if (inFrame && !inChar && now >= lastEnd + FRAME_END_TIME)
+        frameComplete();
+    if (awaitAck && !inFrame && now >= ackDeadline)
+    {
+        ++stats.missedAcks;
+        ackResult(false);
+        rearmNodes();
+    }
+
+    if (isrAt == NEVER && TIMER_Emu_Pending(&timer))
+        isrAt = now + isrLatency;
+    if (isrAt <= now)
+    {
+        isrAt = NEVER;
+        interrupt();
+        updateLine();
+    }
+}
+
+/*
+ * Let the system timer of the device follow the simulated time, see micros().
+ */
+void BusSim::updateSystemTime()
+{
+    SysTick->LOAD = SystemCoreClock / 1000 - 1;
+    SysTick->VAL = SysTick->LOAD - (now % 1000) * (SystemCoreClock / 1000000);
+    systemTime = systemTimeStart + (unsigned int) (now / 1000);
+}
+
+/*
+ * Call the interrupt handler of the device.
+ */
+void BusSim::interrupt()
+{
+    ++stats.interrupts;
+    TIMER_Emu_Enter(&timer);
+    bus.timerInterruptHandler();
+    TIMER_Emu_Leave(&timer);
+
+    if (dutTelegram != bus.sendCurTelegram)
+    {
+        if (dutTelegram)
+            ++stats.dutFinished;
+        dutTelegram = (byte*) bus.sendCurTelegram;
+    }
+
+    if (bus.telegramLen)
+    {
+        ++stats.dutReceived;
+        if (received)
+            received(bus.telegram, bus.telegramLen);
+        bus.telegramLen = 0;
+    }
+}
+
+bool BusSim::nodeDriving(const BusSimNode& node) const
+{
+    return node.driveUntil > now;
+}
+
+/*
+ * Calculate the state of the wired-AND line. A falling edge is captured by
+ * the device and decoded.
+ */
+void BusSim::updateLine()
+{
+    bool low = TIMER_Emu_MatchOutput(&timer, bus.pwmChannel);
+
+    for (int i = 0; i < nodeCount && !low; ++i)
+        low = nodeDriving(nodes[i]);
+
+    if (low == lineLow)
+        return;
+
+    lineLow = low;
+    TIMER_Emu_Capture(&timer, bus.captureChannel, !low);
+    if (low)
+        lineEdge();
+}
+
+/*
+ * A falling edge on the line: a 0 bit.
+ */
+void BusSim::lineEdge()
+{
+    if (!inChar)
+    {   // a start bit
+        if (!inFrame)
+        {
+            inFrame = true;
+            frameStart = now;
+            frameLength = 0;
+            frameValid = true;
+        }
+        inChar = true;
+        charStart = now;
+        charBits = 0x7fe;
+    }
+    else
+    {
+        unsigned int slot = (now - charStart + SIM_BIT_TIME / 2) / SIM_BIT_TIME;
+        if (slot >= 1 && slot < CHAR_BITS)
+            charBits &= ~(1 << slot);
+    }
+
+    // A sending node that sends a 1 bit while the line is low lost the arbitration
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        BusSimNode& node = nodes[i];
+        if (node.state != NODE_SEND || now < node.charStart)
+            continue;
+
+        unsigned int slot = (now - node.charStart + SIM_BIT_TIME / 2) / SIM_BIT_TIME;
+        unsigned int bits = encodeChar(node.queue[node.queueHead][node.charIndex]);
+        if (slot >= 1 && slot < CHAR_BITS && (bits & (1 << slot)))
+        {
+            node.state = NODE_WAIT;
+            node.nextAction = NEVER;
+            ++node.lost;
+            ++stats.collisions;
+        }
+    }
+}
+
+/*
+ * The stop bit of a character is over.
+ */
+void BusSim::charComplete()
+{
+    unsigned int ones = 0;
+
+    inChar = false;
+    lastEnd = charStart + CHAR_BITS * SIM_BIT_TIME;
+
+    for (int i = 1; i <= 9; ++i)
+        ones += (charBits >> i) & 1;
+    if ((ones & 1) || !(charBits & 0x400))
+        frameValid = false;
+
+    if (frameLength < SIM_TELEGRAM_SIZE)
+        frame[frameLength++] = charBits >> 1;
+    else frameValid = false;
+}
+
+/*
+ * No start bit followed the last character: the frame is complete.
+ */
+void BusSim::frameComplete()
+{
+    byte checksum = 0xff;
+    int i;
+
+    inFrame = false;
+    stats.busyTime += lastEnd - frameStart;
+
+    if (frameLength == 1 && frameValid)
+    {   // an acknowledge
+        if (frame[0] == SB_BUS_ACK)
+            ++stats.acks;
+        else ++stats.nacks;
+
+        if (awaitAck && frameStart <= ackDeadline)
+            ackResult(frame[0] == SB_BUS_ACK);
+        rearmNodes();
+        return;
+    }
+
+    for (i = 0; i < frameLength; ++i)
+        checksum ^= frame[i];
+
+    if (awaitAck)
+    {   // a frame instead of the acknowledge
+        ++stats.missedAcks;
+        ackResult(false);
+    }
+
+    if (!frameValid || checksum || frameLength < 8 || frameLength != telegramSize(frame) + 1)
+    {
+        ++stats.corrupted;
+        for (i = 0; i < nodeCount; ++i)
+        {
+            if (nodes[i].state == NODE_WAIT_ACK)
+                nodeDone(nodes[i], false);
+        }
+        rearmNodes();
+        return;
+    }
+
+    ++stats.telegrams;
+    if (!(frame[0] & REPEAT_FLAG))
+        ++stats.repeats;
+
+    awaitAck = true;
+    ackDeadline = lastEnd + ACK_TIMEOUT;
+    ackLength = frameLength;
+    ackSender = -1;
+    for (i = 0; i < nodeCount; ++i)
+    {
+        if (nodes[i].state == NODE_WAIT_ACK)
+            ackSender = i;
+    }
+
+    for (i = 0; i < nodeCount; ++i)
+    {
+        if (i != ackSender)
+            nodeReceive(nodes[i]);
+    }
+    rearmNodes();
+}
+
+/*
+ * The acknowledge of the last telegram was received, or not.
+ */
+void BusSim::ackResult(bool acked)
+{
+    awaitAck = false;
+
+    if (acked)
+    {
+        stats.payloadBytes += ackLength;
+        if (ackSender < 0)
+            ++stats.dutDelivered;
+        else ++stats.delivered;
+    }
+
+    if (ackSender >= 0)
+        nodeDone(nodes[ackSender], acked);
+    ackSender = -1;
+}
+
+/*
+ * Let the waiting nodes send after the bus is free.
+ */
+void BusSim::rearmNodes()
+{
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        BusSimNode& node = nodes[i];
+        if (node.state != NODE_WAIT)
+            continue;
+
+        node.nextAction = lastEnd + FREE_BUS_TIME + node.startDelay;
+        if (node.nextAction < now)
+            node.nextAction = now;
+    }
+}
+
+/*
+ * The next bit of the telegram of a node.
+ */
+void BusSim::nodeAction(BusSimNode& node)
+{
+    if (node.state == NODE_WAIT)
+    {
+        if (inFrame && now - frameStart > START_TOLERANCE)
+        {   // somebody else is sending, wait for the end of the frame
+            node.nextAction = NEVER;
+            return;
+        }
+        nodeStart(node);
+    }
+
+    if (node.state != NODE_SEND)
+    {
+        node.nextAction = NEVER;
+        return;
+    }
+
+    if (node.slot < CHAR_BITS)
+    {
+        unsigned int bits = encodeChar(node.queue[node.queueHead][node.charIndex]);
+        if (!(bits & (1 << node.slot)))
+            node.driveUntil = now + SIM_PULSE_TIME;
+
+        ++node.slot;
+        node.nextAction = node.charStart + node.slot * SIM_BIT_TIME;
+    }
+    else if (++node.charIndex < node.queueLength[node.queueHead])
+    {
+        node.charStart += CHAR_TIME;
+        node.slot = 0;
+        node.nextAction = node.charStart;
+    }
+    else
+    {
+        node.state = NODE_WAIT_ACK;
+        node.nextAction = NEVER;
+    }
+}
+
+/*
+ * Start to send the first telegram of the queue.
+ */
+void BusSim::nodeStart(BusSimNode& node)
+{
+    node.state = NODE_SEND;
+    node.charIndex = 0;
+    node.charStart = now;
+    node.slot = 0;
+    ++node.sent;
+}
+
+/*
+ * The next bit of the acknowledge of a node.
+ */
+void BusSim::nodeAckAction(BusSimNode& node)
+{
+    unsigned int bits = encodeChar(SB_BUS_ACK);
+
+    if (!(bits & (1 << node.ackSlot)))
+        node.driveUntil = now + SIM_PULSE_TIME;
+
+    if (++node.ackSlot < CHAR_BITS)
+        node.ackAt += SIM_BIT_TIME;
+    else node.ackAt = NEVER;
+}
+
+/*
+ * A valid telegram was received. Acknowledge it if it is for the node.
+ */
+void BusSim::nodeReceive(BusSimNode& node)
+{
+    int dest = (frame[3] << 8) | frame[4];
+    bool forNode = false;
+
+    if (frame[5] & 0x80)
+    {
+        forNode = dest == 0;
+        for (int i = 0; i < node.groupCount && !forNode; ++i)
+            forNode = node.groups[i] == dest;
+    }
+    else forNode = dest == node.address;
+
+    if (!forNode)
+        return;
+
+    ++node.received;
+    memcpy(node.rxTelegram, frame, frameLength);
+    node.rxLength = frameLength;
+
+    if (node.ack)
+    {
+        node.ackAt = lastEnd + ACK_START_TIME;
+        node.ackSlot = 0;
+    }
+}
+
+/*
+ * The transmission of the first telegram of the queue is over.
+ */
+void BusSim::nodeDone(BusSimNode& node, bool acked)
+{
+    bool next = true;
+
+    if (acked)
+        ++node.acked;
+    else if (node.tries < MAX_REPEATS)
+    {
+        byte* tel = node.queue[node.queueHead];
+        if (tel[0] & REPEAT_FLAG)
+        {   // mark the telegram as repeated and correct the checksum
+            tel[0] &= ~REPEAT_FLAG;
+            tel[node.queueLength[node.queueHead] - 1] ^= REPEAT_FLAG;
+        }
+        ++node.tries;
+        ++node.repeats;
+        next = false;
+    }
+    else
+    {
+        ++node.failed;
+        ++stats.failed;
+    }
+
+    if (next)
+    {
+        node.queueHead = (node.queueHead + 1) % SIM_QUEUE_SIZE;
+        --node.queueCount;
+        node.tries = 0;
+    }
+
+    node.state = node.queueCount ? NODE_WAIT : NODE_IDLE;
+    node.nextAction = NEVER;
+}
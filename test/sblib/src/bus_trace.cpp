@@ -0,0 +1,104 @@
+/*
+ *  bus_trace.cpp - Binary trace of the telegrams on the bus
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "bus_trace.h"
+
+#include <string.h>
+
+// The magic at the start of a trace file
+static const char traceMagic[4] = { 'K', 'N', 'X', 'T' };
+
+// The time of one bit on the bus in microseconds
+#define BIT_TIME 104
+
+bool traceWriteHeader(FILE* file)
+{
+    unsigned char header[8] = { 0 };
+
+    memcpy(header, traceMagic, sizeof(traceMagic));
+    header[4] = TRACE_VERSION;
+    return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+bool traceWrite(FILE* file, const TraceRecord* record, unsigned long long lastTime)
+{
+    unsigned char buffer[10 + 2 + TRACE_MAX_FRAME];
+    unsigned long long delta = record->time - lastTime;
+    int pos = 0;
+
+    if (record->time < lastTime || !record->length)
+        return false;
+
+    do
+    {
+        buffer[pos] = delta & 0x7f;
+        delta >>= 7;
+        if (delta)
+            buffer[pos] |= 0x80;
+        ++pos;
+    }
+    while (delta);
+
+    buffer[pos++] = record->ack;
+    buffer[pos++] = record->length;
+    memcpy(buffer + pos, record->data, record->length);
+    pos += record->length;
+
+    return fwrite(buffer, pos, 1, file) == 1;
+}
+
+bool traceReadHeader(FILE* file)
+{
+    unsigned char header[8];
+
+    if (fread(header, sizeof(header), 1, file) != 1)
+        return false;
+    return memcmp(header, traceMagic, sizeof(traceMagic)) == 0 && header[4] == TRACE_VERSION;
+}
+
+int traceRead(FILE* file, TraceRecord* record)
+{
+    unsigned long long delta = 0;
+    int shift = 0;
+    int ch;
+
+    ch = fgetc(file);
+    if (ch == EOF)
+        return 0;
+
+    for (;;)
+    {
+        if (shift > 56)
+            return -1;
+        delta |= (unsigned long long) (ch & 0x7f) << shift;
+        if (!(ch & 0x80))
+            break;
+        shift += 7;
+        if ((ch = fgetc(file)) == EOF)
+            return -1;
+    }
+
+    if ((ch = fgetc(file)) == EOF)
+        return -1;
+    record->ack = ch;
+
+    if ((ch = fgetc(file)) == EOF || ch == 0)
+        return -1;
+    record->length = ch;
+
+    if (fread(record->data, record->length, 1, file) != 1)
+        return -1;
+
+    record->time += delta;
+    return 1;
+}
+
+unsigned int traceFrameTime(int length)
+{
+    return length * 13 * BIT_TIME;
+}
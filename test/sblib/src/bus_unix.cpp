@@ -0,0 +1,123 @@
+/*
+ *  bus_unix.cpp - Bus backend for a virtual bus over a UNIX domain socket
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "bus_unix.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+bool vbusSend(int fd, int type, const byte* data, int length)
+{
+    byte msg[VBUS_MSG_SIZE];
+
+    if (length < 0 || length > VBUS_MSG_SIZE - 1)
+        return false;
+
+    msg[0] = type;
+    memcpy(msg + 1, data, length);
+    return ::send(fd, msg, length + 1, MSG_NOSIGNAL) == length + 1;
+}
+
+UnixBusBackend::UnixBusBackend()
+:fd(-1)
+{
+}
+
+UnixBusBackend::~UnixBusBackend()
+{
+    close();
+}
+
+bool UnixBusBackend::open(const char* path)
+{
+    struct sockaddr_un addr;
+
+    close();
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return false;
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0)
+        return false;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UnixBusBackend::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+bool UnixBusBackend::send(const byte* frame, int length)
+{
+    return fd >= 0 && vbusSend(fd, VBUS_MSG_SEND, frame, length);
+}
+
+bool UnixBusBackend::acknowledge(int ack)
+{
+    byte data[2] = { ack >= 0, (byte) ack };
+
+    return fd >= 0 && vbusSend(fd, VBUS_MSG_ACK, data, 2);
+}
+
+int UnixBusBackend::wait(BusEvent* event, int timeout)
+{
+    struct pollfd pfd;
+    byte msg[VBUS_MSG_SIZE];
+
+    event->type = BUS_EVENT_CLOSED;
+    if (fd < 0)
+        return event->type;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    int ready = ::poll(&pfd, 1, timeout);
+    if (ready < 0 && errno == EINTR)
+        ready = 0;
+    if (ready == 0)
+        return event->type = BUS_EVENT_NONE;
+    if (ready < 0)
+        return event->type;
+
+    int length = recv(fd, msg, sizeof(msg), 0);
+    if (length <= 0)
+    {
+        close();
+        return event->type;
+    }
+
+    if (msg[0] == VBUS_MSG_FRAME && length > 1)
+    {
+        event->type = BUS_EVENT_FRAME;
+        event->length = length - 1;
+        memcpy(event->data, msg + 1, event->length);
+    }
+    else if (msg[0] == VBUS_MSG_SENT && length == 3)
+    {
+        event->type = BUS_EVENT_SENT;
+        event->ack = msg[1] ? msg[2] : -1;
+    }
+    else event->type = BUS_EVENT_NONE;
+
+    return event->type;
+}
@@ -0,0 +1,496 @@
+/*
+ *  periph_models.cpp - Models of devices for the peripheral emulation
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ */
+
+#include "periph_models.h"
+#include <string.h>
+
+// 1-Wire: the minimum time of a reset pulse that the device accepts, in usec
+#define OW_RESET_MIN 400
+
+// 1-Wire: a write slot that is low longer than this writes a 0 bit, in usec
+#define OW_WRITE_0_MIN 15
+
+// 1-Wire: the time between the end of the reset pulse and the presence pulse, in usec
+#define OW_PRESENCE_WAIT 30
+
+// 1-Wire: the time of the presence pulse, in usec
+#define OW_PRESENCE_TIME 120
+
+// 1-Wire: the time the device pulls the line low for a 0 bit in a read slot, in usec
+#define OW_READ_0_TIME 30
+
+// 1-Wire ROM commands
+#define OW_READ_ROM    0x33
+#define OW_MATCH_ROM   0x55
+#define OW_SKIP_ROM    0xcc
+#define OW_SEARCH_ROM  0xf0
+
+// DS18B20 function commands
+#define DS_CONVERT_T          0x44
+#define DS_READ_SCRATCHPAD    0xbe
+#define DS_WRITE_SCRATCHPAD   0x4e
+#define DS_READ_POWER_SUPPLY  0xb4
+
+// DS18B20: the time of a conversion at 12 bit resolution, in msec
+#define DS_CONVERSION_TIME 750
+
+// BH1750 instructions
+#define BH_POWER_DOWN  0x00
+#define BH_POWER_ON    0x01
+#define BH_RESET       0x07
+
+// UC1701 commands
+#define UC_COL_ADDR_LSB  0x00
+#define UC_COL_ADDR_MSB  0x10
+#define UC_PAGE_ADDR     0xb0
+
+
+//----- EmuOneWireDevice ------------------------------------------------------
+
+EmuOneWireDevice::EmuOneWireDevice(const uint8_t* rom)
+:resets(0)
+,functions(0)
+,state(IDLE)
+,lowSince(0)
+,readSlot(false)
+,holdUntil(0)
+,holdFrom(0)
+,length(0)
+,bitPos(0)
+{
+    memcpy(this->rom, rom, sizeof(this->rom));
+    if (!this->rom[7])
+        this->rom[7] = crc8(this->rom, 7);
+}
+
+uint8_t EmuOneWireDevice::crc8(const uint8_t* data, int length)
+{
+    uint8_t crc = 0;
+
+    while (length--)
+    {
+        uint8_t byte = *data++;
+        for (int i = 0; i < 8; ++i, byte >>= 1)
+        {
+            uint8_t mix = (crc ^ byte) & 1;
+            crc >>= 1;
+            if (mix)
+                crc ^= 0x8c;
+        }
+    }
+
+    return crc;
+}
+
+void EmuOneWireDevice::send(const uint8_t* data, int length)
+{
+    if (length > (int) sizeof(buffer))
+        length = sizeof(buffer);
+
+    memcpy(buffer, data, length);
+    this->length = length;
+    bitPos = 0;
+    state = SEND;
+}
+
+void EmuOneWireDevice::receive()
+{
+    buffer[0] = 0;
+    bitPos = 0;
+    state = RECEIVE;
+}
+
+/*
+ * @return True if the device sends in the next slot, false if it receives.
+ */
+bool EmuOneWireDevice::sending() const
+{
+    switch (state)
+    {
+    case READ_ROM:
+    case SEND:
+    case DONE:
+        return true;
+
+    case SEARCH_ROM:
+        return bitPos % 3 != 2;
+
+    default:
+        return false;
+    }
+}
+
+/*
+ * @return The bit that the device sends in this read slot.
+ */
+int EmuOneWireDevice::nextBit(EmuTime time)
+{
+    int bit;
+
+    switch (state)
+    {
+    case READ_ROM:
+        bit = (rom[bitPos >> 3] >> (bitPos & 7)) & 1;
+        if (++bitPos >= 64)
+        {
+            state = FUNCTION;
+            bitPos = 0;
+            buffer[0] = 0;
+        }
+        return bit;
+
+    case SEARCH_ROM:
+        // The bit of the ROM code, then its complement
+        bit = (rom[bitPos / 24] >> ((bitPos / 3) & 7)) & 1;
+        if (bitPos++ % 3)
+            bit ^= 1;
+        return bit;
+
+    case SEND:
+        bit = (buffer[bitPos >> 3] >> (bitPos & 7)) & 1;
+        if (++bitPos >= length * 8)
+        {
+            state = DONE;
+            sent();
+        }
+        return bit;
+
+    case DONE:
+        return idleBit(time);
+
+    default:
+        return 1;
+    }
+}
+
+/*
+ * Process a bit of a write slot.
+ */
+void EmuOneWireDevice::receivedBit(int bit)
+{
+    if (state == SEARCH_ROM)
+    {
+        // The master selects the devices with this bit
+        if (bit != ((rom[bitPos / 24] >> ((bitPos / 3) & 7)) & 1))
+            state = IDLE;
+        else if (++bitPos >= 64 * 3)
+        {
+            state = FUNCTION;
+            bitPos = 0;
+            buffer[0] = 0;
+        }
+        return;
+    }
+
+    if (bit)
+        buffer[bitPos >> 3] |= 1 << (bitPos & 7);
+    ++bitPos;
+
+    if (state == MATCH_ROM)
+    {
+        if (bitPos < 64)
+        {
+            if (!(bitPos & 7))
+                buffer[bitPos >> 3] = 0;
+            return;
+        }
+
+        state = memcmp(buffer, rom, sizeof(rom)) ? IDLE : FUNCTION;
+        bitPos = 0;
+        buffer[0] = 0;
+        return;
+    }
+
+    if (bitPos < 8)
+        return;
+
+    uint8_t data = buffer[0];
+    bitPos = 0;
+    buffer[0] = 0;
+
+    switch (state)
+    {
+    case ROM_COMMAND:
+        if (data == OW_READ_ROM)
+            state = READ_ROM;
+        else if (data == OW_MATCH_ROM)
+            state = MATCH_ROM;
+        else if (data == OW_SKIP_ROM)
+            state = FUNCTION;
+        else if (data == OW_SEARCH_ROM)
+            state = SEARCH_ROM;
+        else state = IDLE;
+        break;
+
+    case FUNCTION:
+        ++functions;
+        state = DONE;
+        function(data);
+        break;
+
+    case RECEIVE:
+        state = DONE;
+        received(data);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void EmuOneWireDevice::driveChanged(int level, EmuTime time)
+{
+    if (!level)
+    {
+        // The start of a slot: pull the line low for a 0 bit if we send
+        lowSince = time;
+        readSlot = sending();
+        if (readSlot && !nextBit(time))
+        {
+            holdFrom = time;
+            holdUntil = time + periphEmu.cycles(OW_READ_0_TIME);
+        }
+        return;
+    }
+
+    EmuTime low = time - lowSince;
+    if (low >= periphEmu.cycles(OW_RESET_MIN))
+    {
+        // A reset pulse: answer with a presence pulse
+        ++resets;
+        state = ROM_COMMAND;
+        bitPos = 0;
+        buffer[0] = 0;
+        holdFrom = time + periphEmu.cycles(OW_PRESENCE_WAIT);
+        holdUntil = holdFrom + periphEmu.cycles(OW_PRESENCE_TIME);
+    }
+    else if (state != IDLE && !readSlot)
+    {
+        receivedBit(low < periphEmu.cycles(OW_WRITE_0_MIN));
+    }
+}
+
+int EmuOneWireDevice::level(EmuTime time)
+{
+    return time < holdFrom || time >= holdUntil;
+}
+
+
+//----- EmuDS18B20 ------------------------------------------------------------
+
+EmuDS18B20::EmuDS18B20(const uint8_t* rom)
+:EmuOneWireDevice(rom)
+,temperature(20)
+,conversions(0)
+,convertDone(0)
+,command(0)
+,writePos(0)
+{
+    // The power-on values: 85 degrees, TH, TL, 12 bit resolution
+    static const uint8_t defaults[8] = { 0x50, 0x05, 0x4b, 0x46, 0x7f, 0xff, 0x0c, 0x10 };
+    memcpy(scratchpad, defaults, sizeof(defaults));
+    scratchpad[8] = crc8(scratchpad, 8);
+}
+
+void EmuDS18B20::function(uint8_t cmd)
+{
+    command = cmd;
+
+    switch (cmd)
+    {
+    case DS_CONVERT_T:
+    {
+        int16_t raw = (int16_t) (temperature * 16 + (temperature < 0 ? -0.5f : 0.5f));
+        scratchpad[0] = raw & 0xff;
+        scratchpad[1] = (raw >> 8) & 0xff;
+        scratchpad[8] = crc8(scratchpad, 8);
+
+        ++conversions;
+        convertDone = periphEmu.now() + periphEmu.cycles(DS_CONVERSION_TIME * 1000);
+        break;
+    }
+
+    case DS_READ_SCRATCHPAD:
+        send(scratchpad, sizeof(scratchpad));
+        break;
+
+    case DS_WRITE_SCRATCHPAD:
+        writePos = 0;
+        receive();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void EmuDS18B20::received(uint8_t data)
+{
+    // TH, TL and the configuration register
+    scratchpad[2 + writePos] = data;
+    if (++writePos < 3)
+        receive();
+    scratchpad[8] = crc8(scratchpad, 8);
+}
+
+int EmuDS18B20::idleBit(EmuTime time)
+{
+    if (command == DS_CONVERT_T)
+        return time >= convertDone;
+    return 1;
+}
+
+
+//----- EmuDS3231 -------------------------------------------------------------
+
+EmuDS3231::EmuDS3231()
+:EmuI2CDevice(0x68)
+,pointer(0)
+,pointerSet(false)
+{
+    memset(regs, 0, sizeof(regs));
+    regs[0x0e] = 0x1c;  // control: INTCN, RS2, RS1
+    regs[0x0f] = 0x88;  // status: OSF, EN32kHz
+}
+
+bool EmuDS3231::start(bool read)
+{
+    pointerSet = false;
+    return true;
+}
+
+bool EmuDS3231::write(uint8_t data)
+{
+    if (!pointerSet)
+    {
+        pointer = data % sizeof(regs);
+        pointerSet = true;
+    }
+    else
+    {
+        regs[pointer] = data;
+        pointer = (pointer + 1) % sizeof(regs);
+    }
+    return true;
+}
+
+uint8_t EmuDS3231::read()
+{
+    uint8_t data = regs[pointer];
+    pointer = (pointer + 1) % sizeof(regs);
+    return data;
+}
+
+
+//----- EmuBH1750 -------------------------------------------------------------
+
+EmuBH1750::EmuBH1750()
+:EmuI2CDevice(0x23)
+,lux(0)
+,mode(0)
+,powerOn(false)
+,measurements(0)
+,value(0)
+,pendingValue(0)
+,measureDone(0)
+,readPos(0)
+{
+}
+
+bool EmuBH1750::start(bool read)
+{
+    readPos = 0;
+    return true;
+}
+
+bool EmuBH1750::write(uint8_t data)
+{
+    if (data == BH_POWER_DOWN)
+        powerOn = false;
+    else if (data == BH_POWER_ON)
+        powerOn = true;
+    else if (data == BH_RESET)
+    {
+        if (powerOn)
+            value = pendingValue = 0;
+    }
+    else if ((data & 0xf0) == 0x10 || (data & 0xf0) == 0x20)
+    {
+        // A measurement command: the sensor powers on for it
+        float counts = lux * 1.2f;
+        if ((data & 3) == 1)
+            counts *= 2;
+        if (counts > 65535)
+            counts = 65535;
+
+        result();
+        mode = data;
+        powerOn = true;
+        pendingValue = (int) (counts + 0.5f);
+        measureDone = periphEmu.now() + periphEmu.cycles((data & 3) == 3 ? 16000 : 120000);
+        ++measurements;
+    }
+    return true;
+}
+
+/*
+ * @return The result of the last finished measurement.
+ */
+int EmuBH1750::result()
+{
+    if (measureDone && periphEmu.now() >= measureDone)
+    {
+        value = pendingValue;
+        measureDone = 0;
+    }
+    return value;
+}
+
+uint8_t EmuBH1750::read()
+{
+    int val = result();
+    return (readPos++ & 1) ? val & 0xff : (val >> 8) & 0xff;
+}
+
+
+//----- EmuEADOGS -------------------------------------------------------------
+
+EmuEADOGS::EmuEADOGS(int pinCD)
+:column(0)
+,page(0)
+,commands(0)
+,dataBytes(0)
+,pinCD(pinCD)
+{
+    memset(ram, 0, sizeof(ram));
+}
+
+int EmuEADOGS::transfer(int data, int bits)
+{
+    data &= 0xff;
+
+    if (periphEmu.pinLevel(pinCD))
+    {
+        ++dataBytes;
+        ram[page & 7][column % 132] = data;
+        if (column < 131)
+            ++column;
+    }
+    else
+    {
+        ++commands;
+        if ((data & 0xf0) == UC_COL_ADDR_LSB)
+            column = (column & 0xf0) | (data & 15);
+        else if ((data & 0xf0) == UC_COL_ADDR_MSB)
+            column = (column & 15) | ((data & 15) << 4);
+        else if ((data & 0xf0) == UC_PAGE_ADDR)
+            page = data & 15;
+    }
+
+    return 0xff;
+}
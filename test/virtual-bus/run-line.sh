@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+#  run-line.sh - Run a virtual KNX TP1 line with many devices on the PC.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License version 3 as
+#  published by the Free Software Foundation.
+#
+#  Starts the hub and <count> devices with the same EEPROM image and the
+#  physical addresses 1.1.1, 1.1.2, ... All devices send their com objects
+#  after the start (a startup storm). The hub stops after <seconds> of bus
+#  time and prints the statistics of the bus. The bus trace is written to
+#  line.trace, see ../bus-trace.
+#
+#  Usage: run-line.sh count eeprom.bin seconds [factor]
+#  The programs are taken from $VBUS_BIN, default: the current directory.
+#  Commands can be sent to the line while it runs, e.g. a scene recall:
+#      $VBUS_BIN/vbus-send -s $VBUS_SOCKET -b 1/0/1 4
+
+if [ $# -lt 3 ]; then
+    echo "usage: $0 count eeprom.bin seconds [factor]" >&2
+    exit 1
+fi
+
+count=$1
+eeprom=$2
+seconds=$3
+factor=${4:-1}
+bin=${VBUS_BIN:-.}
+socket=${VBUS_SOCKET:-/tmp/sblib-vbus-$$.sock}
+
+"$bin/vbus-hub" -s "$socket" -t "$factor" -d "$seconds" -w line.trace &
+hub=$!
+
+# Wait for the socket of the hub
+while [ ! -S "$socket" ]; do
+    sleep 0.1
+done
+
+pids=""
+i=0
+while [ $i -lt "$count" ]; do
+    line=$((i / 255 + 1))
+    device=$((i % 255 + 1))
+    "$bin/vbus-device" -s "$socket" -t "$factor" -a "1.$line.$device" -i "$eeprom" &
+    pids="$pids $!"
+    i=$((i + 1))
+done
+
+wait $hub
+kill $pids 2>/dev/null
+wait
@@ -0,0 +1,171 @@
+/*
+ *  device.cpp - A device with the library on a virtual KNX TP1 line.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  The device loads its user EEPROM image into the emulated flash, starts the
+ *  BCU and connects the bus of the library to the hub (vbus-hub) with a
+ *  BusConnector, see test/sblib/inc/bus_backend.h. Then it runs bcu.loop(),
+ *  so it answers like a real device: it acknowledges, responds to group
+ *  reads, updates its com objects and sends its updated com objects with the
+ *  rate limit of the library.
+ *
+ *  Usage: vbus-device [-s socket] [-a address] [-t factor] [-i] [-v] eeprom.bin
+ *    -s  the path of the socket of the hub, default /tmp/sblib-vbus.sock
+ *    -a  the physical address, e.g. 1.1.10, default: from the EEPROM image
+ *    -t  the time factor of the hub
+ *    -i  send all com objects with the transmit flag after the start, like
+ *        a device that sends its state after a bus voltage recovery
+ *    -v  print the statistics of the device at the end
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sblib/eib.h>
+#include <sblib/eib/user_memory.h>
+#include <sblib/eib/sblib_default_objects.h>
+#include <sblib/internal/iap.h>
+#include <sblib/internal/variables.h>
+#include "iap_emu.h"
+#include "bus_unix.h"
+
+static volatile bool stop;
+
+static void onSignal(int signal)
+{
+    stop = true;
+}
+
+static long long realMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Parse a physical address like 1.1.10
+ *
+ * @return The address, -1 if it is invalid.
+ */
+static int parseAddress(const char* text)
+{
+    int area, line, device;
+    char end;
+
+    if (sscanf(text, "%d.%d.%d%c", &area, &line, &device, &end) != 3 ||
+        area < 0 || area > 15 || line < 0 || line > 15 || device < 0 || device > 255)
+    {
+        return -1;
+    }
+    return (area << 12) | (line << 8) | device;
+}
+
+static void loadEeprom(const char* fileName)
+{
+    static byte image[USER_EEPROM_SIZE];
+
+    FILE* file = fopen(fileName, "rb");
+    if (!file)
+    {
+        perror(fileName);
+        exit(1);
+    }
+    memset(image, 0xff, sizeof(image));
+    size_t size = fread(image, 1, sizeof(image), file);
+    fclose(file);
+    if (!size)
+    {
+        fprintf(stderr, "%s: the EEPROM image is empty\n", fileName);
+        exit(1);
+    }
+
+    IAP_Init_Flash(0xFF);
+    memcpy(FLASH_BASE_ADDRESS + iapFlashSize() - FLASH_SECTOR_SIZE, image, USER_EEPROM_SIZE);
+
+    // Start with the manufacturer, device type and version of the image
+    const UserEeprom& eeprom = *(const UserEeprom*) image;
+    bcu.begin((eeprom.manufacturerH << 8) | eeprom.manufacturerL,
+              (eeprom.deviceTypeH << 8) | eeprom.deviceTypeL, eeprom.version);
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = VBUS_DEFAULT_SOCKET;
+    double factor = 1;
+    const char* addressText = 0;
+    int address = -1;
+    bool usage = false;
+    bool initialSend = false;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:a:t:iv")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': path = optarg; break;
+        case 'a': addressText = optarg; break;
+        case 't': factor = atof(optarg); break;
+        case 'i': initialSend = true; break;
+        case 'v': verbose = true; break;
+        default: usage = true; break;
+        }
+    }
+    if (addressText)
+        address = parseAddress(addressText);
+    if (usage || optind != argc - 1 || (addressText && address < 0) || factor <= 0)
+    {
+        fprintf(stderr, "usage: %s [-s socket] [-a address] [-t factor] [-i] [-v] eeprom.bin\n", argv[0]);
+        return 1;
+    }
+
+    loadEeprom(argv[optind]);
+    if (address >= 0)
+        bcu.setOwnAddress(address);
+
+    UnixBusBackend backend;
+    if (!backend.open(path))
+    {
+        perror(path);
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (initialSend)
+    {
+        int count = *objectConfigTable();
+        for (int objno = 0; objno < count; ++objno)
+        {
+            if (objectConfig(objno).config & COMCONF_TRANS)
+                objectWritten(objno);
+        }
+    }
+
+    BusConnector connector(backend);
+    long long start = realMillis();
+
+    while (!stop && connector.poll(1))
+    {
+        systemTime = (unsigned int) ((realMillis() - start) * factor);
+        bcu.loop();
+    }
+
+    if (verbose)
+    {
+        printf("%d.%d.%d: %u received, %u accepted, %u overwritten, %u sent, %u repeated, %u acked, %u failed\n",
+               bus.ownAddress() >> 12, (bus.ownAddress() >> 8) & 15, bus.ownAddress() & 255,
+               connector.received, connector.accepted, connector.overwritten, connector.sent,
+               connector.repeats, connector.acked, connector.failed);
+    }
+    return 0;
+}
@@ -0,0 +1,488 @@
+/*
+ *  hub.cpp - The hub of a virtual KNX TP1 line on the PC.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  The devices (vbus-device, vbus-send) connect to the UNIX domain socket of
+ *  the hub, see test/sblib/inc/bus_unix.h. The hub is the bus medium: it
+ *  transmits one frame at a time with the timing of TP1:
+ *    - a sender waits 50 bit times after the bus is free
+ *    - if several devices want to send, the frame that wins the bitwise
+ *      arbitration (0 is dominant) is sent, the others wait
+ *    - a frame needs 13 bit times per byte
+ *    - the frame is passed to all other devices, which answer with their
+ *      acknowledge; the acknowledges are combined like on the wire (AND)
+ *    - the acknowledge slot needs 15 + 13 bit times
+ *  The sender gets the combined acknowledge and repeats the frame if needed.
+ *
+ *  The hub waits for the answers of all devices before the acknowledge slot is
+ *  over, so a slow device stretches the bus time instead of missing frames.
+ *
+ *  Usage: vbus-hub [-s socket] [-t factor] [-d seconds] [-w output.trace]
+ *    -s  the path of the socket, default /tmp/sblib-vbus.sock
+ *    -t  run the bus faster than real time by this factor, default 1. The
+ *        devices must be started with the same factor.
+ *    -d  stop after this time of the bus in seconds, default: until SIGINT
+ *    -w  write the frames to a bus trace, see bus_trace.h
+ *  The statistics of the bus are printed at the end.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bus_unix.h"
+#include "bus_trace.h"
+
+// The time of one bit on the bus in microseconds
+#define BIT_TIME 104
+
+// The time a sender waits for a free bus: 50 bit times
+#define FREE_BUS_TIME (50 * BIT_TIME)
+
+// The time of the acknowledge slot after a frame: 15 bit times pause and one byte
+#define ACK_TIME (15 * BIT_TIME + 13 * BIT_TIME)
+
+// The maximum number of devices
+#define MAX_CLIENTS 1024
+
+// The real time in milliseconds the hub waits for the answers of the devices
+#define ANSWER_TIMEOUT 500
+
+// The states of the bus
+enum
+{
+    BUS_IDLE,       //!< The bus is free or waits 50 bit times
+    BUS_FRAME,      //!< A frame is transmitted
+    BUS_ANSWERS     //!< The frame is over, waiting for the answers of the devices
+};
+
+/*
+ * A connected device.
+ */
+struct Client
+{
+    int fd;                             //!< The socket, -1 if the slot is free
+    bool pending;                       //!< The device waits to send frame[]
+    byte frame[Bus::TELEGRAM_SIZE];     //!< The frame to send
+    int length;                         //!< The length of frame[]
+    unsigned long long requestAt;       //!< The bus time of the send request
+    bool awaited;                       //!< The answer of the device is awaited
+};
+
+static Client clients[MAX_CLIENTS];
+static int clientCount, maxClients;
+static int listenFd = -1;
+
+static int busState = BUS_IDLE;
+static unsigned long long busFreeAt;    // The bus time the last frame or acknowledge ended
+static int sender = -1;                 // The client that transmits, -1 if it is gone
+static byte frame[Bus::TELEGRAM_SIZE];  // The frame on the bus
+static int frameLength;
+static unsigned long long frameEnd;
+static long long answerDeadline;        // The real time of ANSWER_TIMEOUT
+static int awaitedAnswers;
+static bool haveAck;
+static int combinedAck;
+
+static double factor = 1;
+static long long realStart;
+static volatile bool stop;
+
+// The statistics
+static unsigned int frames, repeatFrames, acks, nacks, busys, noAcks, lateAnswers;
+static unsigned int maxPending;
+static double waitSum, waitMax;
+static unsigned long long busyTime;
+
+static FILE* trace;
+static unsigned long long traceLast;
+
+static long long realMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static unsigned long long busTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long usec = ts.tv_sec * 1000000LL + ts.tv_nsec / 1000 - realStart * 1000;
+    return (unsigned long long) (usec * factor);
+}
+
+/*
+ * @return The real time in milliseconds until the bus time is reached, at least 0.
+ */
+static int realDelay(unsigned long long time)
+{
+    unsigned long long now = busTime();
+    if (time <= now)
+        return 0;
+    return (int) ((time - now) / factor / 1000) + 1;
+}
+
+static void onSignal(int signal)
+{
+    stop = true;
+}
+
+/*
+ * @return True if frame a wins the arbitration against frame b.
+ */
+static bool winsArbitration(const Client& a, const Client& b)
+{
+    int length = a.length < b.length ? a.length : b.length;
+
+    for (int i = 0; i < length; ++i)
+    {
+        int diff = a.frame[i] ^ b.frame[i];
+        if (diff)
+        {
+            // The bits are sent LSB first, the first different bit decides: 0 wins
+            int bit = diff & -diff;
+            return !(a.frame[i] & bit);
+        }
+    }
+    return a.requestAt <= b.requestAt;
+}
+
+static void dropClient(int index)
+{
+    Client& client = clients[index];
+
+    close(client.fd);
+    client.fd = -1;
+    client.pending = false;
+    if (client.awaited)
+    {
+        client.awaited = false;
+        --awaitedAnswers;
+    }
+    if (sender == index)
+        sender = -1;
+    --clientCount;
+}
+
+static void acceptClient()
+{
+    int fd = accept(listenFd, 0, 0);
+    if (fd < 0)
+        return;
+
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+    {
+        if (clients[i].fd < 0)
+        {
+            memset(&clients[i], 0, sizeof(Client));
+            clients[i].fd = fd;
+            if (++clientCount > maxClients)
+                maxClients = clientCount;
+            return;
+        }
+    }
+
+    fprintf(stderr, "too many devices, max %d\n", MAX_CLIENTS);
+    close(fd);
+}
+
+static void readClient(int index)
+{
+    Client& client = clients[index];
+    byte msg[VBUS_MSG_SIZE];
+
+    int length = recv(client.fd, msg, sizeof(msg), 0);
+    if (length <= 0)
+    {
+        dropClient(index);
+        return;
+    }
+
+    if (msg[0] == VBUS_MSG_SEND && length >= 9 && !client.pending && sender != index)
+    {
+        client.pending = true;
+        client.length = length - 1;
+        memcpy(client.frame, msg + 1, client.length);
+        client.requestAt = busTime();
+    }
+    else if (msg[0] == VBUS_MSG_ACK && length == 3 && client.awaited)
+    {
+        client.awaited = false;
+        --awaitedAnswers;
+        if (msg[1])
+        {
+            combinedAck = haveAck ? combinedAck & msg[2] : msg[2];
+            haveAck = true;
+        }
+    }
+}
+
+static void startFrame(unsigned long long now)
+{
+    int pending = 0;
+
+    sender = -1;
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+    {
+        if (clients[i].fd < 0 || !clients[i].pending)
+            continue;
+        ++pending;
+        if (sender < 0 || winsArbitration(clients[i], clients[sender]))
+            sender = i;
+    }
+    if (sender < 0)
+        return;
+
+    if ((unsigned int) pending > maxPending)
+        maxPending = pending;
+
+    Client& client = clients[sender];
+    double wait = (now - client.requestAt) / 1000.0;
+    waitSum += wait;
+    if (wait > waitMax)
+        waitMax = wait;
+
+    client.pending = false;
+    frameLength = client.length;
+    memcpy(frame, client.frame, frameLength);
+    frameEnd = now + traceFrameTime(frameLength);
+    busState = BUS_FRAME;
+}
+
+static void endFrame()
+{
+    ++frames;
+    if (!(frame[0] & 0x20))
+        ++repeatFrames;
+
+    haveAck = false;
+    awaitedAnswers = 0;
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+    {
+        if (clients[i].fd < 0 || i == sender)
+            continue;
+        if (vbusSend(clients[i].fd, VBUS_MSG_FRAME, frame, frameLength))
+        {
+            clients[i].awaited = true;
+            ++awaitedAnswers;
+        }
+    }
+
+    answerDeadline = realMillis() + ANSWER_TIMEOUT;
+    busState = BUS_ANSWERS;
+}
+
+static void endAnswers(unsigned long long now)
+{
+    if (awaitedAnswers)
+    {
+        ++lateAnswers;
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+            clients[i].awaited = false;
+        awaitedAnswers = 0;
+    }
+
+    if (!haveAck)
+        ++noAcks;
+    else if (combinedAck == SB_BUS_ACK)
+        ++acks;
+    else if (combinedAck == SB_BUS_NACK)
+        ++nacks;
+    else ++busys;
+
+    busFreeAt = frameEnd + ACK_TIME;
+    if (busFreeAt < now)
+        busFreeAt = now;
+    busyTime += traceFrameTime(frameLength) + (haveAck ? ACK_TIME : 0);
+
+    if (sender >= 0)
+    {
+        byte result[2] = { haveAck, (byte) combinedAck };
+        vbusSend(clients[sender].fd, VBUS_MSG_SENT, result, 2);
+    }
+
+    if (trace)
+    {
+        TraceRecord record;
+        record.time = frameEnd;
+        record.ack = haveAck ? combinedAck : 0;
+        record.length = frameLength;
+        memcpy(record.data, frame, frameLength);
+        traceWrite(trace, &record, traceLast);
+        traceLast = frameEnd;
+    }
+    sender = -1;
+    busState = BUS_IDLE;
+}
+
+/*
+ * Advance the bus and return the time in milliseconds until the next step.
+ */
+static int step()
+{
+    unsigned long long now = busTime();
+
+    if (busState == BUS_IDLE)
+    {
+        if (now < busFreeAt + FREE_BUS_TIME)
+            return realDelay(busFreeAt + FREE_BUS_TIME);
+        startFrame(now);
+        if (busState == BUS_IDLE)
+            return 100;
+    }
+
+    if (busState == BUS_FRAME)
+    {
+        if (now < frameEnd)
+            return realDelay(frameEnd);
+        endFrame();
+    }
+
+    if (busState == BUS_ANSWERS)
+    {
+        long long realNow = realMillis();
+        unsigned long long slotEnd = frameEnd + ACK_TIME;
+
+        if (awaitedAnswers && realNow < answerDeadline)
+            return answerDeadline - realNow;
+        if (now < slotEnd)
+            return realDelay(slotEnd);
+        endAnswers(now);
+        return 0;
+    }
+    return 0;
+}
+
+static bool openSocket(const char* path)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return false;
+
+    listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listenFd < 0)
+        return false;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    return bind(listenFd, (struct sockaddr*) &addr, sizeof(addr)) == 0 &&
+           listen(listenFd, 128) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    static struct pollfd fds[MAX_CLIENTS + 1];
+    static int fdClient[MAX_CLIENTS + 1];
+    const char* path = VBUS_DEFAULT_SOCKET;
+    double duration = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:t:d:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': path = optarg; break;
+        case 't': factor = atof(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'w':
+            trace = fopen(optarg, "wb");
+            if (!trace || !traceWriteHeader(trace))
+            {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s socket] [-t factor] [-d seconds] [-w output.trace]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (factor <= 0 || optind != argc)
+    {
+        fprintf(stderr, "usage: %s [-s socket] [-t factor] [-d seconds] [-w output.trace]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+        clients[i].fd = -1;
+
+    if (!openSocket(path))
+    {
+        perror(path);
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+    realStart = realMillis();
+
+    while (!stop)
+    {
+        int timeout = step();
+        if (duration > 0 && busTime() >= duration * 1e6)
+            break;
+
+        int count = 0;
+        fds[count].fd = listenFd;
+        fds[count].events = POLLIN;
+        fdClient[count++] = -1;
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+        {
+            if (clients[i].fd < 0)
+                continue;
+            fds[count].fd = clients[i].fd;
+            fds[count].events = POLLIN;
+            fdClient[count++] = i;
+        }
+
+        int ready = poll(fds, count, timeout);
+        if (ready < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        for (int i = 0; ready > 0 && i < count; ++i)
+        {
+            if (!fds[i].revents)
+                continue;
+            if (fdClient[i] < 0)
+                acceptClient();
+            else if (clients[fdClient[i]].fd == fds[i].fd)
+                readClient(fdClient[i]);
+        }
+    }
+
+    double seconds = busTime() / 1e6;
+
+    close(listenFd);
+    unlink(path);
+    if (trace)
+        fclose(trace);
+
+    printf("%.3f s bus time, %d devices at most\n", seconds, maxClients);
+    printf("%u frames, %u repeated, %.1f frames/s, bus load %.1f%%\n", frames, repeatFrames,
+           seconds > 0 ? frames / seconds : 0.0, seconds > 0 ? busyTime / seconds / 1e4 : 0.0);
+    printf("acknowledges: %u ACK, %u NACK, %u BUSY, %u none\n", acks, nacks, busys, noAcks);
+    printf("send wait: avg %.1f ms, max %.1f ms, %u senders waiting at most\n",
+           frames ? waitSum / frames : 0.0, waitMax, maxPending);
+    if (lateAnswers)
+        printf("%u frames with devices that did not answer within %d ms\n", lateAnswers, ANSWER_TIMEOUT);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ *  send.cpp - Send a group telegram on a virtual KNX TP1 line.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  Sends a group value write or read to the hub (vbus-hub) and prints the
+ *  acknowledge. With -r the group value responses are printed that arrive
+ *  within one second after the read.
+ *
+ *  Usage: vbus-send [-s socket] [-a address] [-b] [-r] group [value]
+ *    -s  the path of the socket of the hub, default /tmp/sblib-vbus.sock
+ *    -a  the physical address of the sender, default 15.15.254
+ *    -b  send the value as one byte (DPT 5, DPT 17 scene number),
+ *        default: 6 bit value (DPT 1 switch)
+ *    -r  send a group value read instead of a write
+ *    group  the group address, e.g. 1/2/3
+ *
+ *  Example: recall scene 5 on the group address 1/0/1
+ *    vbus-send -b 1/0/1 4
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bus_unix.h"
+
+// The time in milliseconds to wait until the telegram is sent
+#define SEND_TIMEOUT 10000
+
+// The time in milliseconds to wait for the responses to a read
+#define RESPONSE_TIME 1000
+
+static long long realMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Parse a group address like 1/2/3
+ *
+ * @return The address, -1 if it is invalid.
+ */
+static int parseGroup(const char* text)
+{
+    int mainGroup, middleGroup, subGroup;
+    char end;
+
+    if (sscanf(text, "%d/%d/%d%c", &mainGroup, &middleGroup, &subGroup, &end) != 3 ||
+        mainGroup < 0 || mainGroup > 31 || middleGroup < 0 || middleGroup > 7 ||
+        subGroup < 0 || subGroup > 255)
+    {
+        return -1;
+    }
+    return (mainGroup << 11) | (middleGroup << 8) | subGroup;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = VBUS_DEFAULT_SOCKET;
+    int address = 0xfffe;
+    bool byteValue = false;
+    bool read = false;
+    bool usage = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:a:br")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': path = optarg; break;
+        case 'a':
+        {
+            int area, line, device;
+            if (sscanf(optarg, "%d.%d.%d", &area, &line, &device) == 3)
+                address = ((area & 15) << 12) | ((line & 15) << 8) | (device & 255);
+            else usage = true;
+            break;
+        }
+        case 'b': byteValue = true; break;
+        case 'r': read = true; break;
+        default: usage = true; break;
+        }
+    }
+
+    int group = optind < argc ? parseGroup(argv[optind]) : -1;
+    if (usage || group < 0 || argc - optind != (read ? 1 : 2))
+    {
+        fprintf(stderr, "usage: %s [-s socket] [-a address] [-b] [-r] group [value]\n", argv[0]);
+        return 1;
+    }
+
+    byte telegram[Bus::TELEGRAM_SIZE];
+    int length = 8;
+
+    telegram[0] = 0xbc;
+    telegram[1] = address >> 8;
+    telegram[2] = address;
+    telegram[3] = group >> 8;
+    telegram[4] = group;
+    telegram[5] = 0xe1;
+    telegram[6] = 0x00;
+    telegram[7] = 0x00;
+    if (!read)
+    {
+        int value = atoi(argv[optind + 1]);
+        if (byteValue)
+        {
+            telegram[5] = 0xe2;
+            telegram[7] = 0x80;
+            telegram[length++] = value;
+        }
+        else telegram[7] = 0x80 | (value & 0x3f);
+    }
+
+    byte checksum = 0xff;
+    for (int i = 0; i < length; ++i)
+        checksum ^= telegram[i];
+    telegram[length++] = checksum;
+
+    UnixBusBackend backend;
+    if (!backend.open(path) || !backend.send(telegram, length))
+    {
+        perror(path);
+        return 1;
+    }
+
+    BusEvent event;
+    long long end = realMillis() + SEND_TIMEOUT;
+    bool sent = false;
+    int result = 1;
+
+    while (realMillis() < end)
+    {
+        int type = backend.wait(&event, 10);
+        if (type == BUS_EVENT_CLOSED)
+            break;
+
+        if (type == BUS_EVENT_SENT && !sent)
+        {
+            sent = true;
+            if (event.ack < 0)
+                printf("sent, no acknowledge\n");
+            else printf("sent, acknowledge %02X\n", event.ack);
+            result = event.ack == SB_BUS_ACK ? 0 : 2;
+            if (!read)
+                break;
+            end = realMillis() + RESPONSE_TIME;
+        }
+        else if (type == BUS_EVENT_FRAME)
+        {
+            backend.acknowledge(-1);
+
+            // A group value response to the read?
+            if (read && event.length >= 9 && (event.data[5] & 0x80) &&
+                ((event.data[3] << 8) | event.data[4]) == group &&
+                (event.data[6] & 3) == 0 && (event.data[7] & 0xc0) == 0x40)
+            {
+                printf("response from %d.%d.%d:", event.data[1] >> 4, event.data[1] & 15, event.data[2]);
+                if ((event.data[5] & 15) == 1)
+                    printf(" %02X", event.data[7] & 0x3f);
+                for (int i = 8; i < event.length - 1; ++i)
+                    printf(" %02X", event.data[i]);
+                printf("\n");
+            }
+        }
+    }
+
+    if (!sent)
+        printf("not sent\n");
+    return result;
+}